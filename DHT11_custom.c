@@ -160,3 +160,76 @@ float HAL_DHT11_ReadHumidity(DHT11_InitTypeDef *DHT11) {
 	return DHT11->Humidity;
 }
 */
+
+/*
+ * The libdriver interface (driver_dht11_interface.h) for this board, in
+ * place of driver_dht11_interface_template.c: the sensor on PC_8, held
+ * low to start and released to its pull-up, the delays of delay.h, and
+ * the DWT cycle counter to time the bits.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "platform.h"
+#include "gpio.h"
+#include "delay.h"
+#include "uart.h"
+#include "driver_dht11_interface.h"
+
+#define DHT11_INTERFACE_PIN PC_8
+
+uint8_t dht11_interface_init(void) {
+	cycle_counter_init();
+	gpio_set_mode(DHT11_INTERFACE_PIN, Input);
+	return 0;
+}
+
+uint8_t dht11_interface_deinit(void) {
+	return 0;
+}
+
+uint8_t dht11_interface_read(uint8_t *value) {
+	*value = gpio_get(DHT11_INTERFACE_PIN) ? 1 : 0;
+	return 0;
+}
+
+uint8_t dht11_interface_write(uint8_t value) {
+	if (value != 0) {
+		gpio_set_mode(DHT11_INTERFACE_PIN, Input); // released, pulled up
+	} else {
+		gpio_set(DHT11_INTERFACE_PIN, 0);
+		gpio_set_mode(DHT11_INTERFACE_PIN, Output);
+	}
+	return 0;
+}
+
+void dht11_interface_delay_ms(uint32_t ms) {
+	delay_ms(ms);
+}
+
+void dht11_interface_delay_us(uint32_t us) {
+	delay_us(us);
+}
+
+void dht11_interface_enable_irq(void) {
+	__enable_irq();
+}
+
+void dht11_interface_disable_irq(void) {
+	__disable_irq();
+}
+
+// Only called if driver_dht11_basic.c links it
+void dht11_interface_debug_print(const char *const fmt, ...) {
+	char str[128];
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(str, sizeof(str), fmt, args);
+	va_end(args);
+	uart_print(str);
+}
+
+uint32_t dht11_interface_cycles(void) {
+	return cycle_count();
+}
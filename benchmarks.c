@@ -0,0 +1,571 @@
+#include <stdio.h>
+#include "benchmarks.h"
+#include "bench.h"
+#include "adc.h"
+#include "adc_scan.h"
+#include "checksum.h"
+#include "comparator.h"
+#include "delay.h"
+#include "format.h"
+#include "gpio.h"
+#include "hasher.h"
+#include "i2c.h"
+#include "oversample.h"
+#include "queue.h"
+#include "uart.h"
+
+extern void delay_cycles(unsigned int cycles);
+
+#define BUFFER_SIZE 1024
+#define MAP_SIZE    4096
+#define SCAN_PINS   4
+#define SCAN_SCANS  64
+
+static Pin output_pin, analog_pin;
+static int output_level, analog_ready, interrupt_ready, scan_ready, i2c_ready;
+static uint8_t queue_storage[64];
+static Queue queue;
+static char buffer[BUFFER_SIZE + 1]; // a string of BUFFER_SIZE characters
+static char map_text[MAP_SIZE + 4];  // every character but 0, at four offsets
+static const char *map_string;       // what map() hashes in the benchmark
+static int map_checked;
+static int arithmetic_checked;
+static uint32_t fibonacci_n;         // the n of the fibonacci benchmarks
+static char line[128];
+static uint16_t scan_buffer[SCAN_PINS * SCAN_SCANS];
+static uint16_t scan_copy[SCAN_PINS * 16];
+static Oversampler filters[SCAN_PINS];
+static volatile uint32_t sink;       // keeps the results
+static volatile uint32_t argument = 123456789;
+static volatile uint32_t interrupts;
+
+/*      Drivers      */
+
+static void run_queue(void) {
+	uint8_t item;
+
+	for (int i = 0; i < 32; i++) queue_enqueue(&queue, (uint8_t)i);
+	for (int i = 0; i < 32; i++) queue_dequeue(&queue, &item);
+}
+
+// The transmit buffer is empty, so uart_tx() does not wait
+static void setup_uart(void) {
+	uart_flush();
+}
+
+static void run_uart(void) {
+	for (int i = 0; i < 16; i++) uart_tx('\0'); // Not shown by a terminal
+}
+
+static void setup_gpio(void) {
+	output_level = gpio_get(output_pin) != 0;
+}
+
+static void run_gpio_set(void) {
+	for (int i = 0; i < 8; i++) {
+		gpio_set(output_pin, !output_level);
+		gpio_set(output_pin, output_level);
+	}
+}
+
+static void run_gpio_get(void) {
+	uint32_t sum = 0;
+
+	for (int i = 0; i < 16; i++) sum += gpio_get(output_pin);
+	sink = sum;
+}
+
+static void run_gpio_toggle(void) {
+	for (int i = 0; i < 16; i++) gpio_toggle(output_pin);
+}
+
+static void run_gpio_pin_write(void) {
+	GpioPin pin = GPIO_PIN(output_pin);
+
+	for (int i = 0; i < 8; i++) {
+		gpio_pin_write(pin, !output_level);
+		gpio_pin_write(pin, output_level);
+	}
+}
+
+static void run_gpio_pin_toggle(void) {
+	GpioPin pin = GPIO_PIN(output_pin);
+
+	for (int i = 0; i < 16; i++) gpio_pin_toggle(pin);
+}
+
+static void run_gpio_port_write(void) {
+	uint32_t mask = 1UL << GET_PIN_INDEX(output_pin);
+
+	for (int i = 0; i < 8; i++) {
+		gpio_port_write(output_pin, mask, output_level ? 0 : mask);
+		gpio_port_write(output_pin, mask, output_level ? mask : 0);
+	}
+}
+
+static void count_interrupt(void *context, int level) {
+	(*(volatile uint32_t *)context)++;
+}
+
+// Software interrupts on the output pin's line: no edge is enabled, so
+// nothing else raises it. From the write to the end of the handler.
+static void setup_interrupt(void) {
+	if (!interrupt_ready) {
+		gpio_set_handler(output_pin, count_interrupt, (void *)&interrupts);
+		interrupt_ready = 1;
+	}
+}
+
+static void run_interrupt(void) {
+	uint32_t mask = 1UL << GET_PIN_INDEX(output_pin);
+
+	EXTI->IMR |= mask;
+	for (int i = 0; i < 8; i++) {
+		uint32_t before = interrupts;
+
+		EXTI->SWIER = mask;
+		while (interrupts == before) {}
+	}
+	EXTI->IMR &= ~mask;
+}
+
+static void run_delay_us_1(void) {
+	delay_us(1);
+}
+
+static void run_delay_us_2(void) {
+	delay_us(2);
+}
+
+static void run_delay_us_10(void) {
+	delay_us(10);
+}
+
+static void run_delay_us_40(void) {
+	delay_us(40);
+}
+
+static void run_delay_ms_1(void) {
+	delay_ms(1);
+}
+
+// delay_cycles() alone, as the delays used it before they were calibrated
+static void run_delay_cycles_40_us(void) {
+	delay_cycles(40 * (SystemCoreClock / 1000000));
+}
+
+static void setup_adc(void) {
+	if (!analog_ready) {
+		adc_init(analog_pin); // Allocates, so only once
+		analog_ready = 1;
+	}
+}
+
+static void run_adc(void) {
+	sink = adc_read(analog_pin);
+}
+
+// The analogue pin four times over, back to back: 533 kS/s at 16 MHz
+static void setup_scan(void) {
+	if (!scan_ready) {
+		Pin pins[SCAN_PINS] = { analog_pin, analog_pin, analog_pin, analog_pin };
+
+		adc_scan_init(pins, SCAN_PINS, scan_buffer, SCAN_SCANS);
+		scan_ready = 1;
+	}
+	if (!adc_scan_running()) {
+		adc_scan_start(0);
+	}
+}
+
+static void stop_scan(void) {
+	adc_scan_stop();
+}
+
+static void run_scan_latest(void) {
+	uint32_t sum = 0;
+
+	for (uint32_t i = 0; i < 16; i++) sum += adc_scan_latest(i & (SCAN_PINS - 1));
+	sink = sum;
+}
+
+// 16 whole scans waiting, and part of the next
+static void setup_scan_read(void) {
+	uint32_t until;
+
+	setup_scan();
+	while (adc_scan_read(scan_copy, 16) == 16) {}
+	until = adc_scan_position() + 17 * SCAN_PINS;
+	while ((int32_t)(adc_scan_position() - until) < 0) {}
+}
+
+static void run_scan_read(void) {
+	sink = adc_scan_read(scan_copy, 16);
+}
+
+static void count_crossing(int state) {
+	interrupts++;
+}
+
+// Started by the first sample, left running for the others
+static void setup_comparator(void) {
+	if (!comparator_running()) {
+		comparator_init();
+	}
+	comparator_set_callback(count_crossing);
+	comparator_set_trigger(CompBoth);
+}
+
+// The threshold moved past the input at one end or the other: from the
+// write to the end of the handler, about a conversion and the interrupt.
+static void run_comparator(void) {
+	for (int i = 0; i < 8; i++) {
+		uint32_t before = interrupts;
+
+		comparator_set_threshold(comparator_read() ? 0x0FFF : 0, 0);
+		while (interrupts == before) {}
+	}
+}
+
+static void stop_comparator(void) {
+	comparator_stop();
+}
+
+// An address nobody answers at 400 kHz: start, address, NACK and stop,
+// sleeping in between
+static void setup_i2c(void) {
+	if (!i2c_ready) {
+		i2c_init(I2C_FAST_HZ);
+		i2c_ready = 1;
+	}
+}
+
+static void run_i2c_probe(void) {
+	sink = i2c_write(0x50, 0, 0);
+}
+
+/*      Oversampling, 16 samples an output, per sample      */
+
+static void setup_filters(OversampleMode mode) {
+	for (uint32_t i = 0; i < SCAN_PINS; i++) oversample_init(&filters[i], mode, 4);
+}
+
+static void setup_average(void) {
+	setup_filters(OversampleAverage);
+}
+
+static void setup_cic(void) {
+	setup_filters(OversampleCic);
+}
+
+static void setup_moving_average(void) {
+	setup_filters(OversampleMovingAverage);
+}
+
+static void run_oversample(void) {
+	oversample_scans(filters, SCAN_PINS, scan_buffer, SCAN_SCANS);
+	sink = oversample_value(&filters[0]);
+}
+
+/*      hasher.s, against the C references      */
+
+// Compares map() with map_reference() the first time, at the four
+// offsets from a word and with the terminator at every byte of the
+// first words and at the ends of the timed lengths.
+static void check_map(void) {
+	static const uint32_t long_lengths[] = { 255, 256, 257, 1023, 1024, 1025, MAP_SIZE - 1, MAP_SIZE };
+
+	if (map_checked) return;
+	map_checked = 1;
+	for (uint32_t offset = 0; offset < 4; offset++) {
+		for (uint32_t i = 0; i < 72 + sizeof(long_lengths) / sizeof(long_lengths[0]); i++) {
+			uint32_t length = i < 72 ? i : long_lengths[i - 72];
+			char *string = map_text + offset;
+			char saved = string[length];
+			uint32_t result, expected;
+
+			string[length] = '\0';
+			result = map(string);
+			expected = map_reference(string);
+			string[length] = saved;
+			if (result != expected) {
+				format_uart("\r\nbench: map() of %lu characters at offset %lu gives %lu, not %lu",
+				            (unsigned long)length, (unsigned long)offset, (unsigned long)result,
+				            (unsigned long)expected);
+				return;
+			}
+		}
+	}
+}
+
+static void setup_map(uint32_t length) {
+	check_map();
+	map_string = map_text + MAP_SIZE + 3 - length; // the last length characters
+}
+
+static void setup_map_16(void) {
+	setup_map(16);
+}
+
+static void setup_map_64(void) {
+	setup_map(64);
+}
+
+static void setup_map_256(void) {
+	setup_map(256);
+}
+
+static void setup_map_1024(void) {
+	setup_map(1024);
+}
+
+static void setup_map_4096(void) {
+	setup_map(4096);
+}
+
+static void run_map(void) {
+	sink = map(map_string);
+}
+
+static void run_map_reference(void) {
+	sink = map_reference(map_string);
+}
+
+static int check_result(const char *name, uint32_t argument, uint32_t result, uint32_t expected) {
+	if (result != expected) {
+		format_uart("\r\nbench: %s(%lu) gives %lu, not %lu", name, (unsigned long)argument,
+		            (unsigned long)result, (unsigned long)expected);
+		return 0;
+	}
+	return 1;
+}
+
+static int check_reduce(uint32_t number) {
+	uint32_t expected = reduce_reference(number);
+
+	// The SDIV version is signed
+	return check_result("reduce", number, reduce(number), expected) &&
+	       (number >= 0x80000000UL || check_result("reduce_sdiv", number, reduce_sdiv(number), expected));
+}
+
+// fibonacci_mod() is compared with the reference modulo m, for some m
+// up to 65536.
+static int check_fibonacci(uint32_t n) {
+	static const uint32_t moduli[] = { 1, 2, 7, 10, 65521, 65536 };
+	uint64_t expected = fibonacci_reference(n);
+
+	if (!check_result("fibonacci", n, fibonacci(n), (uint32_t)expected) ||
+	    (n <= 24 && !check_result("fibonacci_recursive", n, fibonacci_recursive(n), (uint32_t)expected))) {
+		return 0;
+	}
+	if (fibonacci64(n) != expected) {
+		format_uart("\r\nbench: fibonacci64(%lu) is wrong", (unsigned long)n);
+		return 0;
+	}
+	for (uint32_t i = 0; i < sizeof(moduli) / sizeof(moduli[0]); i++) {
+		uint32_t result = fibonacci_mod(n, moduli[i]);
+
+		if (result != expected % moduli[i]) {
+			format_uart("\r\nbench: fibonacci_mod(%lu, %lu) gives %lu, not %lu", (unsigned long)n,
+			            (unsigned long)moduli[i], (unsigned long)result, (unsigned long)(expected % moduli[i]));
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Compares the routines of hasher.s, the old and the new, with the C
+// references the first time: reduce() on the numbers up to 1000, either
+// side of each power of ten and a series of others, the fibonacci ones
+// for every n up to 90, where fibonacci_reference() is exact.
+static void check_arithmetic(void) {
+	uint32_t number = 1;
+
+	if (arithmetic_checked) return;
+	arithmetic_checked = 1;
+	for (uint32_t i = 0; i <= 1000; i++) {
+		if (!check_reduce(i)) return;
+	}
+	for (uint32_t power = 10; power <= 1000000000UL; power *= 10) {
+		if (!check_reduce(power - 1) || !check_reduce(power)) return;
+	}
+	for (uint32_t i = 0; i < 1000; i++) {
+		number = number * 1664525UL + 1013904223UL;
+		if (!check_reduce(number)) return;
+	}
+	if (!check_reduce(0x7FFFFFFFUL) || !check_reduce(0xFFFFFFFFUL)) return;
+	for (uint32_t n = 0; n <= 90; n++) {
+		if (!check_fibonacci(n)) return;
+	}
+}
+
+static void setup_reduce(void) {
+	check_arithmetic();
+}
+
+static void run_reduce(void) {
+	sink = reduce(argument);
+}
+
+static void run_reduce_sdiv(void) {
+	sink = reduce_sdiv(argument);
+}
+
+static void run_reduce_reference(void) {
+	sink = reduce_reference(argument);
+}
+
+static void setup_fibonacci(uint32_t n) {
+	check_arithmetic();
+	fibonacci_n = n;
+}
+
+static void setup_fibonacci_10(void) {
+	setup_fibonacci(10);
+}
+
+static void setup_fibonacci_24(void) {
+	setup_fibonacci(24);
+}
+
+static void setup_fibonacci_47(void) {
+	setup_fibonacci(47);
+}
+
+static void setup_fibonacci_90(void) {
+	setup_fibonacci(90);
+}
+
+static void run_fibonacci(void) {
+	sink = fibonacci(fibonacci_n);
+}
+
+static void run_fibonacci64(void) {
+	sink = (uint32_t)fibonacci64(fibonacci_n);
+}
+
+static void run_fibonacci_mod(void) {
+	sink = fibonacci_mod(fibonacci_n, 65521);
+}
+
+static void run_fibonacci_reference(void) {
+	sink = (uint32_t)fibonacci_reference(fibonacci_n);
+}
+
+static void run_fibonacci_recursive(void) {
+	sink = fibonacci_recursive(fibonacci_n);
+}
+
+/*      Checks, per byte      */
+
+static void run_xor(void) {
+	sink = checksum_xor(buffer, BUFFER_SIZE);
+}
+
+static void run_crc8(void) {
+	sink = checksum_crc8(buffer, 12);
+}
+
+static void run_crc16(void) {
+	sink = checksum_crc16(buffer, 20);
+}
+
+static void run_crc32(void) {
+	sink = checksum_crc32(buffer, BUFFER_SIZE);
+}
+
+/*      The data line of the screen      */
+
+static void run_sprintf(void) {
+	float temperature = (argument % 100) * 0.1f + 20.0f;
+	sprintf(line, "Humidity: %d, Temperature: %f, reading with period = %d sec ", 45, temperature, 6);
+}
+
+static void run_format_string(void) {
+	format_string(line, sizeof(line), "Humidity: %d, Temperature: %.1d, reading with period = %d sec ", 45,
+	              (int)(argument % 100) + 200, 6);
+}
+
+static BenchCase cases[] = {
+	{ "queue_enqueue_dequeue",    0,          run_queue,               64 },
+	{ "uart_tx",                  setup_uart, run_uart,                16 },
+	{ "gpio_set",                 setup_gpio, run_gpio_set,            16 },
+	{ "gpio_get",                 0,          run_gpio_get,            16 },
+	{ "gpio_toggle",              0,          run_gpio_toggle,         16 },
+	{ "gpio_pin_write",           setup_gpio, run_gpio_pin_write,      16 },
+	{ "gpio_pin_toggle",          0,          run_gpio_pin_toggle,     16 },
+	{ "gpio_port_write",          setup_gpio, run_gpio_port_write,     16 },
+	{ "gpio_interrupt",           setup_interrupt, run_interrupt,      8 },
+	{ "delay_us_1",               0,          run_delay_us_1,          1, 0, 1000 },
+	{ "delay_us_2",               0,          run_delay_us_2,          1, 0, 2000 },
+	{ "delay_us_10",              0,          run_delay_us_10,         1, 0, 10000 },
+	{ "delay_us_40",              0,          run_delay_us_40,         1, 0, 40000 },
+	{ "delay_ms_1",               0,          run_delay_ms_1,          1, 0, 1000000 },
+	{ "delay_cycles_40_us",       0,          run_delay_cycles_40_us,  1, 0, 40000 },
+	{ "adc_read",                 setup_adc,  run_adc,                 1 },
+	{ "adc_scan_latest",          setup_scan, run_scan_latest,         16, 0, 0, stop_scan },
+	{ "adc_scan_read_16",         setup_scan_read, run_scan_read,      16 * SCAN_PINS, 0, 0, stop_scan },
+	{ "comparator_crossing",      setup_comparator, run_comparator,    8, 0, 0, stop_comparator },
+	{ "i2c_probe",                setup_i2c,  run_i2c_probe,           1 },
+	{ "oversample_average",       setup_average, run_oversample,       SCAN_PINS * SCAN_SCANS },
+	{ "oversample_cic",           setup_cic,  run_oversample,          SCAN_PINS * SCAN_SCANS },
+	{ "oversample_moving_average", setup_moving_average, run_oversample, SCAN_PINS * SCAN_SCANS },
+	{ "map_16",                   setup_map_16, run_map,               16 },
+	{ "map_64",                   setup_map_64, run_map,               64 },
+	{ "map_256",                  setup_map_256, run_map,              256 },
+	{ "map_1024",                 setup_map_1024, run_map,             1024 },
+	{ "map_4096",                 setup_map_4096, run_map,             4096 },
+	{ "map_reference_16",         setup_map_16, run_map_reference,     16 },
+	{ "map_reference_64",         setup_map_64, run_map_reference,     64 },
+	{ "map_reference_256",        setup_map_256, run_map_reference,    256 },
+	{ "map_reference_1024",       setup_map_1024, run_map_reference,   1024 },
+	{ "map_reference_4096",       setup_map_4096, run_map_reference,   4096 },
+	{ "reduce",                   setup_reduce, run_reduce,            1 },
+	{ "reduce_sdiv",              setup_reduce, run_reduce_sdiv,       1 },
+	{ "reduce_reference",         setup_reduce, run_reduce_reference,  1 },
+	{ "fibonacci_10",             setup_fibonacci_10, run_fibonacci,   1 },
+	{ "fibonacci_24",             setup_fibonacci_24, run_fibonacci,   1 },
+	{ "fibonacci_47",             setup_fibonacci_47, run_fibonacci,   1 },
+	{ "fibonacci_90",             setup_fibonacci_90, run_fibonacci,   1 },
+	{ "fibonacci64_10",           setup_fibonacci_10, run_fibonacci64, 1 },
+	{ "fibonacci64_24",           setup_fibonacci_24, run_fibonacci64, 1 },
+	{ "fibonacci64_47",           setup_fibonacci_47, run_fibonacci64, 1 },
+	{ "fibonacci64_90",           setup_fibonacci_90, run_fibonacci64, 1 },
+	{ "fibonacci_mod_10",         setup_fibonacci_10, run_fibonacci_mod, 1 },
+	{ "fibonacci_mod_24",         setup_fibonacci_24, run_fibonacci_mod, 1 },
+	{ "fibonacci_mod_47",         setup_fibonacci_47, run_fibonacci_mod, 1 },
+	{ "fibonacci_mod_90",         setup_fibonacci_90, run_fibonacci_mod, 1 },
+	{ "fibonacci_reference_10",   setup_fibonacci_10, run_fibonacci_reference, 1 },
+	{ "fibonacci_reference_24",   setup_fibonacci_24, run_fibonacci_reference, 1 },
+	{ "fibonacci_reference_47",   setup_fibonacci_47, run_fibonacci_reference, 1 },
+	{ "fibonacci_reference_90",   setup_fibonacci_90, run_fibonacci_reference, 1 },
+	{ "fibonacci_recursive_10",   setup_fibonacci_10, run_fibonacci_recursive, 1 },
+	{ "fibonacci_recursive_24",   setup_fibonacci_24, run_fibonacci_recursive, 1 },
+	{ "checksum_xor_1024",        0,          run_xor,                 BUFFER_SIZE },
+	{ "checksum_crc8_12",         0,          run_crc8,                12 },
+	{ "checksum_crc16_20",        0,          run_crc16,               20 },
+	{ "checksum_crc32_1024",      0,          run_crc32,               BUFFER_SIZE },
+	{ "sprintf_data_line",        0,          run_sprintf,             1 },
+	{ "format_string_data_line",  0,          run_format_string,       1 },
+};
+
+void benchmarks_register(Pin output, Pin analog) {
+	output_pin = output;
+	analog_pin = analog;
+	queue_init(&queue, queue_storage, sizeof(queue_storage));
+
+	// Printable text, with every class of character map() tells apart
+	for (uint32_t i = 0; i < BUFFER_SIZE; i++) {
+		buffer[i] = (char)(' ' + (i * 7) % 95);
+	}
+	buffer[BUFFER_SIZE] = '\0';
+	// Every value a character can have, so the whole table of map() is used
+	for (uint32_t i = 0; i < MAP_SIZE + 3; i++) {
+		map_text[i] = (char)(1 + (i * 7) % 255);
+	}
+	map_text[MAP_SIZE + 3] = '\0';
+
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		bench_register(&cases[i]);
+	}
+}
@@ -0,0 +1,19 @@
+/*!
+ * \file      benchmarks.h
+ * \brief     Benchmarks of the drivers and of hasher.s, for the bench
+ *            command (see bench.h).
+ */
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+#include "platform.h"
+
+/*! \brief Registers the benchmarks of the drivers, hasher.s and the
+ *         formatter. Must be called once, after uart_init().
+ *  \param output  Output pin set and toggled by the GPIO benchmarks; its
+ *                 level is the same before and after.
+ *  \param analog  Pin read by the ADC benchmark, initialised on the first
+ *                 run.
+ */
+void benchmarks_register(Pin output, Pin analog);
+
+#endif // BENCHMARKS_H
@@ -146,6 +146,79 @@ static uint8_t a_dht11_reset(dht11_handle_t *handle)
     return 0;                                                        /* success return 0 */
 }
 
+/**
+ * @brief      wait for a bus level
+ * @param[in]  *handle pointer to a dht11 handle structure
+ * @param[in]  level awaited level
+ * @param[out] *edge pointer to the cycle count when the level was seen
+ * @return     status code
+ *             - 0 success
+ *             - 1 read failed
+ * @note       gives up after about 100us, like the untimed path
+ */
+static uint8_t a_dht11_wait_level(dht11_handle_t *handle, uint8_t level, uint32_t *edge)
+{
+    uint8_t retry = 0;
+    uint8_t value;
+    
+    do
+    {
+        if (handle->bus_read((uint8_t *)&value) != 0)                /* read 1 bit */
+        {
+            handle->debug_print("dht11: bus read failed.\n");        /* read failed */
+            
+            return 1;                                                /* return error */
+        }
+        *edge = handle->cycles();                                    /* time stamp the sample */
+        if ((value != 0) == (level != 0))                            /* check level */
+        {
+            return 0;                                                /* success return 0 */
+        }
+        retry++;                                                     /* retry times++ */
+        handle->delay_us(1);                                         /* wait 1 us */
+    } while (retry < 100);
+    
+    return 0;                                                        /* time out, like the untimed path */
+}
+
+/**
+ * @brief      read one bit by timing it against the cycle counter
+ * @param[in]  *handle pointer to a dht11 handle structure
+ * @param[out] *value pointer to a value buffer
+ * @return     status code
+ *             - 0 success
+ *             - 1 read failed
+ * @note       every bit is a 50us low preamble and a high of 26-28us (0)
+ *             or 70us (1); the high time is compared with the preamble
+ *             measured on the same bit, so the decision follows the sensor's
+ *             own timing and does not depend on the core clock or on how
+ *             long a bus read takes
+ */
+static uint8_t a_dht11_read_bit_timed(dht11_handle_t *handle, uint8_t *value)
+{
+    uint32_t fall;
+    uint32_t rise;
+    uint32_t end;
+    
+    if (a_dht11_wait_level(handle, 0, &fall) != 0)                  /* start of the preamble */
+    {
+        return 1;                                                    /* return error */
+    }
+    if (a_dht11_wait_level(handle, 1, &rise) != 0)                  /* end of the preamble */
+    {
+        return 1;                                                    /* return error */
+    }
+    if (a_dht11_wait_level(handle, 0, &end) != 0)                   /* end of the bit */
+    {
+        return 1;                                                    /* return error */
+    }
+    handle->low_cycles = rise - fall;                                /* save the widths */
+    handle->high_cycles = end - rise;                                /* for the caller */
+    *value = (handle->high_cycles > handle->low_cycles) ? 1 : 0;     /* 70us > 50us > 28us */
+    
+    return 0;                                                        /* success return 0 */
+}
+
 /**
  * @brief      read one bit
  * @param[in]  *handle pointer to a dht11 handle structure
@@ -160,6 +233,10 @@ static uint8_t a_dht11_read_bit(dht11_handle_t *handle, uint8_t *value)
     uint8_t retry = 0;
     uint8_t res;
     
+    if (handle->cycles != NULL)                                      /* check cycles */
+    {
+        return a_dht11_read_bit_timed(handle, value);                /* time the pulses */
+    }
     res = handle->bus_read((uint8_t *)value);                        /* read 1 bit */
     if (res != 0)                                                    /* check result */
     {
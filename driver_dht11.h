@@ -71,6 +71,9 @@ typedef struct dht11_handle_s
     void (*enable_irq)(void);                               /**< point to an enable_irq function address */
     void (*disable_irq)(void);                              /**< point to a disable_irq function address */
     void (*debug_print)(const char *const fmt, ...);        /**< point to a debug_print function address */
+    uint32_t (*cycles)(void);                               /**< point to a cycles function address, optional */
+    uint32_t low_cycles;                                    /**< low preamble of the last bit read, in cycles */
+    uint32_t high_cycles;                                   /**< high time of the last bit read, in cycles */
     uint8_t inited;                                         /**< inited flag */
 } dht11_handle_t;
 
@@ -181,6 +184,15 @@ typedef struct dht11_info_s
  */
 #define DRIVER_DHT11_LINK_DEBUG_PRINT(HANDLE, FUC) (HANDLE)->debug_print = FUC
 
+/**
+ * @brief     link cycles function
+ * @param[in] HANDLE pointer to a dht11 handle structure
+ * @param[in] FUC pointer to a cycles function address
+ * @note      optional, a free running cycle counter such as DWT->CYCCNT;
+ *            when linked, bits are decided from measured pulse widths
+ */
+#define DRIVER_DHT11_LINK_CYCLES(HANDLE, FUC)      (HANDLE)->cycles = FUC
+
 /**
  * @}
  */
@@ -61,6 +61,7 @@ uint8_t dht11_basic_init(void)
     DRIVER_DHT11_LINK_ENABLE_IRQ(&gs_handle, dht11_interface_enable_irq);
     DRIVER_DHT11_LINK_DISABLE_IRQ(&gs_handle, dht11_interface_disable_irq);
     // DRIVER_DHT11_LINK_DEBUG_PRINT(&gs_handle, dht11_interface_debug_print);
+    DRIVER_DHT11_LINK_CYCLES(&gs_handle, dht11_interface_cycles);
     
     /* dht11 init */
     res = dht11_init(&gs_handle);
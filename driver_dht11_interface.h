@@ -122,6 +122,13 @@ void dht11_interface_disable_irq(void);
  */
 void dht11_interface_debug_print(const char *const fmt, ...);
 
+/**
+ * @brief  interface cycle counter
+ * @return free running count of core cycles
+ * @note   none
+ */
+uint32_t dht11_interface_cycles(void);
+
 /**
  * @}
  */
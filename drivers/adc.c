@@ -1,6 +1,8 @@
 #include "platform.h"
 #include "stdlib.h"
 #include "adc.h"
+#include "adc_scan.h"
+#include "comparator.h"
 
 ADC_HandleTypeDef AdcHandle;
 
@@ -418,6 +420,15 @@ void _GPIO_Init(GPIO_TypeDef  *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
 uint16_t adc_read(Pin pin)
 {
 	uint16_t adc_value = 0;
+	
+	// ADC1 is busy with the scan, which has the value already
+	if (adc_scan_running()) {
+		int index = adc_scan_index(pin);
+		return index >= 0 ? adc_scan_latest((uint32_t)index) : 0;
+	}
+	if (comparator_running()) {
+		return pin == P_CMP_PLUS ? comparator_sample() : 0;
+	}
 	switch (pin)
 	{
 		case PA_0:
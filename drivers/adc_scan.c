@@ -0,0 +1,338 @@
+#include "platform.h"
+#include "adc.h"
+#include "adc_scan.h"
+#include "comparator.h"
+#include "delay.h"
+
+/*
+ * The DMA is at sample lap * length + done, where done = length - NDTR
+ * and lap is half the count of half and full transfer interrupts. One of
+ * them may still be pending when NDTR is read: if the count says the
+ * second half but NDTR is back in the first, the full transfer has not
+ * been counted yet. A pending half transfer changes nothing.
+ *
+ * Scans are counted the same way for adc_scan_read(), modulo 2^32; the
+ * place of a scan in the buffer is kept apart, since the buffer length
+ * does not divide 2^32.
+ */
+
+#define DMA_FLAGS (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+
+#define EXTSEL_TIM2_TRGO (ADC_CR2_EXTSEL_2 | ADC_CR2_EXTSEL_1)
+
+static Pin scan_pins[ADC_SCAN_MAX_PINS];
+static uint32_t pin_count;
+static uint16_t *samples_buffer;
+static uint32_t scan_count;   // scans in the buffer
+static uint32_t length;       // samples in the buffer
+static uint32_t sequence[3];  // SQR1 to SQR3
+static volatile uint32_t halves;
+static volatile int running;
+static int configured;        // adc_scan_init() has succeeded
+
+static uint32_t read_total;   // scans taken by adc_scan_read()
+static uint32_t read_scan;    // where the next one is in the buffer
+static uint32_t lost;
+
+static void (*scan_callback)(const uint16_t *scans, uint32_t count);
+static uint32_t delivered_total; // scans passed to the callback
+static uint32_t delivered_scan;  // where the next one is in the buffer
+
+// TIM2 runs at HCLK, or twice PCLK1 when the APB1 prescaler divides.
+static uint32_t adc_scan_timer_clock(void) {
+	uint32_t ppre1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> 10;
+
+	if (ppre1 & 4) {
+		return SystemCoreClock >> (ppre1 & 3);
+	}
+	return SystemCoreClock;
+}
+
+// The smallest ADC clock divider that keeps it within 36 MHz: PCLK2
+// divided by 2, 4, 6 or 8.
+static uint32_t adc_scan_prescaler(void) {
+	uint32_t ppre2 = (RCC->CFGR & RCC_CFGR_PPRE2) >> 13;
+	uint32_t pclk2 = ppre2 & 4 ? SystemCoreClock >> ((ppre2 & 3) + 1) : SystemCoreClock;
+	uint32_t adcpre = 0;
+
+	while (adcpre < 3 && pclk2 / ((adcpre + 1) * 2) > 36000000UL) {
+		adcpre++;
+	}
+	return adcpre << 16;
+}
+
+// Where the DMA is: in which lap, and how far into it.
+static void adc_scan_where(uint32_t *lap, uint32_t *done) {
+	uint32_t counted, remaining;
+
+	do {
+		counted = halves;
+		remaining = DMA2_Stream0->NDTR;
+	} while (counted != halves);
+
+	*done = length - remaining;
+	*lap = counted / 2;
+	if ((counted & 1) && *done < length - length / 2) {
+		(*lap)++;
+	}
+}
+
+int adc_scan_init(const Pin *pins, uint32_t count, uint16_t *buffer, uint32_t scans) {
+	uint32_t channels[ADC_SCAN_MAX_PINS];
+
+	if (count == 0 || count > ADC_SCAN_MAX_PINS || scans < 2 || scans > 0xFFFF / count) {
+		return 0;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (pinmap_peripheral(pins[i]) != ADC1_BASE) {
+			return 0;
+		}
+		channels[i] = STM_PIN_CHANNEL(pinmap_function(pins[i]));
+	}
+	adc_scan_stop();
+
+	for (uint32_t i = 0; i < count; i++) {
+		scan_pins[i] = pins[i];
+		pinmap_pinout(pins[i]); // Analogue mode
+	}
+	pin_count = count;
+	samples_buffer = buffer;
+	scan_count = scans;
+	length = count * scans;
+
+	RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+
+	// The regular sequence, written to ADC1 by adc_scan_start()
+	sequence[0] = ADC_SQR1(count);
+	sequence[1] = 0;
+	sequence[2] = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t rank = i + 1;
+
+		if (rank <= 6) {
+			sequence[2] |= ADC_SQR3_RK(channels[i], rank);
+		} else if (rank <= 12) {
+			sequence[1] |= ADC_SQR2_RK(channels[i], rank);
+		} else {
+			sequence[0] |= ADC_SQR1_RK(channels[i], rank);
+		}
+	}
+
+	// DMA2 Stream0 channel 0 (ADC1): DR into the buffer, round and round
+	DMA2_Stream0->CR = 0;
+	while (DMA2_Stream0->CR & DMA_SxCR_EN) {
+	}
+	DMA2->LIFCR = DMA_FLAGS;
+	DMA2_Stream0->PAR = (uint32_t)(uintptr_t)&ADC1->DR;
+	DMA2_Stream0->M0AR = (uint32_t)(uintptr_t)buffer;
+	DMA2_Stream0->FCR = 0; // Direct mode
+	DMA2_Stream0->CR = DMA_SxCR_PL_1 |                       // High priority
+	                   DMA_SxCR_PSIZE_0 | DMA_SxCR_MSIZE_0 | // Half-words
+	                   DMA_SxCR_MINC | DMA_SxCR_CIRC |
+	                   DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+
+	// TIM2 only counts; its update is the trigger output (TRGO)
+	TIM2->CR1 = 0;
+	TIM2->CR2 = TIM_CR2_MMS_1;
+	TIM2->DIER = 0;
+
+	NVIC_SetPriority(DMA2_Stream0_IRQn, 2);
+	NVIC_ClearPendingIRQ(DMA2_Stream0_IRQn);
+	NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+	configured = 1;
+	return 1;
+}
+
+void adc_scan_start(uint32_t rate_hz) {
+	if (!configured) {
+		return; // No pins or buffer to scan into
+	}
+	comparator_stop();
+	adc_scan_stop();
+	halves = 0;
+	read_total = 0;
+	read_scan = 0;
+	lost = 0;
+	delivered_total = 0;
+	delivered_scan = 0;
+
+	DMA2->LIFCR = DMA_FLAGS;
+	DMA2_Stream0->NDTR = length;
+	DMA2_Stream0->CR |= DMA_SxCR_EN;
+
+	// 12 bits, 3 clocks of sampling: 15 ADC clocks a sample. Powered up
+	// again, so the sequence starts from its first rank.
+	MODIFY_REG(ADC->CCR, ADC_CCR_ADCPRE, adc_scan_prescaler());
+	ADC1->CR1 = ADC_CR1_SCAN;
+	ADC1->SMPR1 = 0;
+	ADC1->SMPR2 = 0;
+	ADC1->SQR1 = sequence[0];
+	ADC1->SQR2 = sequence[1];
+	ADC1->SQR3 = sequence[2];
+	ADC1->SR = 0;
+	ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_DDS | (rate_hz ? 0 : ADC_CR2_CONT);
+	delay_us(ADC_STAB_DELAY_US);
+	(void)ADC1->DR; // Drop a stale result
+	running = 1;
+
+	if (rate_hz) {
+		ADC1->CR2 |= ADC_CR2_EXTEN_0 | EXTSEL_TIM2_TRGO; // Rising edge of TRGO
+		TIM2->PSC = 0;
+		TIM2->ARR = adc_scan_timer_clock() / rate_hz - 1;
+		TIM2->CNT = 0;
+		TIM2->EGR = TIM_EGR_UG;
+		TIM2->CR1 = TIM_CR1_CEN;
+	} else {
+		ADC1->CR2 |= ADC_CR2_SWSTART;
+	}
+}
+
+void adc_scan_stop(void) {
+	TIM2->CR1 = 0;
+	ADC1->CR2 = 0; // Off: a conversion in progress is dropped
+	// Back to the single conversions of adc_read()
+	ADC1->CR1 = 0;
+	ADC1->SQR1 = 0;
+	DMA2_Stream0->CR &= ~DMA_SxCR_EN;
+	while (DMA2_Stream0->CR & DMA_SxCR_EN) {
+	}
+	running = 0;
+}
+
+int adc_scan_running(void) {
+	return running;
+}
+
+int adc_scan_index(Pin pin) {
+	for (uint32_t i = 0; i < pin_count; i++) {
+		if (scan_pins[i] == pin) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+uint32_t adc_scan_position(void) {
+	uint32_t lap, done;
+
+	adc_scan_where(&lap, &done);
+	return lap * length + done;
+}
+
+uint16_t adc_scan_latest(uint32_t index) {
+	uint32_t lap, done, scan;
+
+	adc_scan_where(&lap, &done);
+	scan = done / pin_count;
+	if (done % pin_count <= index) {
+		// Not converted yet in this scan: the one before
+		if (scan == 0) {
+			if (lap == 0) {
+				return 0;
+			}
+			scan = scan_count;
+		}
+		scan--;
+	}
+	return samples_buffer[scan * pin_count + index];
+}
+
+uint32_t adc_scan_read(uint16_t *samples, uint32_t max_scans) {
+	uint32_t lap, done, written, available, first;
+
+	adc_scan_where(&lap, &done);
+	written = lap * scan_count + done / pin_count;
+	available = written - read_total;
+
+	// The DMA writes the scan after the last complete one, so one less
+	// than the buffer holds is safe.
+	if (available > scan_count - 1) {
+		uint32_t skipped = available - (scan_count - 1);
+
+		lost += skipped;
+		read_total += skipped;
+		read_scan = (read_scan + skipped) % scan_count;
+		available = scan_count - 1;
+	}
+	if (available > max_scans) {
+		available = max_scans;
+	}
+
+	first = read_total;
+	for (uint32_t i = 0; i < available; i++) {
+		const uint16_t *scan = samples_buffer + read_scan * pin_count;
+
+		for (uint32_t k = 0; k < pin_count; k++) {
+			*samples++ = scan[k];
+		}
+		if (++read_scan == scan_count) {
+			read_scan = 0;
+		}
+	}
+	read_total += available;
+
+	// Went over while they were copied: the copy cannot be trusted
+	adc_scan_where(&lap, &done);
+	written = lap * scan_count + done / pin_count;
+	if (written - first > scan_count - 1) {
+		lost += available;
+		return 0;
+	}
+	return available;
+}
+
+uint32_t adc_scan_lost(void) {
+	return lost;
+}
+
+void adc_scan_set_callback(void (*callback)(const uint16_t *scans, uint32_t count)) {
+	scan_callback = callback;
+}
+
+// Passes the scans completed since the last time to the callback.
+static void adc_scan_deliver(void) {
+	uint32_t lap, done, pending;
+
+	adc_scan_where(&lap, &done);
+	pending = lap * scan_count + done / pin_count - delivered_total;
+	if (pending > scan_count - 1) {
+		// Held off for a whole lap: the oldest are gone
+		uint32_t skipped = pending - (scan_count - 1);
+
+		delivered_total += skipped;
+		delivered_scan = (delivered_scan + skipped) % scan_count;
+		pending = scan_count - 1;
+	}
+	while (pending > 0) {
+		uint32_t run = scan_count - delivered_scan;
+
+		if (run > pending) {
+			run = pending;
+		}
+		scan_callback(samples_buffer + delivered_scan * pin_count, run);
+		delivered_total += run;
+		delivered_scan += run;
+		if (delivered_scan == scan_count) {
+			delivered_scan = 0;
+		}
+		pending -= run;
+	}
+}
+
+void DMA2_Stream0_IRQHandler(void) {
+	uint32_t flags = DMA2->LISR;
+
+	DMA2->LIFCR = flags & DMA_FLAGS;
+	NVIC_ClearPendingIRQ(DMA2_Stream0_IRQn);
+	if (flags & DMA_LISR_HTIF0) {
+		halves++;
+	}
+	if (flags & DMA_LISR_TCIF0) {
+		halves++;
+	}
+	if (scan_callback) {
+		adc_scan_deliver();
+	}
+}
@@ -0,0 +1,96 @@
+/*!
+ * \file      adc_scan.h
+ * \brief     Continuous conversion of several analogue pins by ADC1, moved
+ *            to memory by DMA.
+ *
+ * The pins are set up once, as the regular sequence of ADC1 in scan mode,
+ * and DMA2 Stream0 (channel 0) copies every result into a circular buffer
+ * of whole scans: sample i of the buffer is pin i % count. The sequence
+ * starts again as soon as it ends, or on every update of TIM2, which
+ * then sets the scan rate. The CPU only takes the DMA half and full
+ * transfer interrupts, which count the laps of the buffer; readers find
+ * where the DMA is from the count and NDTR, and need no lock.
+ *
+ * While the scan runs ADC1 belongs to it: adc_read() of a pin in the scan
+ * returns its latest sample, and of any other pin 0. Starting a scan stops
+ * the comparator of comparator.h.
+ */
+#ifndef ADC_SCAN_H
+#define ADC_SCAN_H
+#include <stdint.h>
+#include "platform.h"
+
+/*! Most pins in a scan, the length of the regular sequence. */
+#define ADC_SCAN_MAX_PINS 16
+
+/*! \brief Configures the pins, ADC1, DMA2 Stream0 and TIM2 for a scan.
+ *         Stops a scan that runs.
+ *  \param pins     The pins, in the order they are converted; the same pin
+ *                  may appear twice.
+ *  \param count    Number of pins, 1 to ADC_SCAN_MAX_PINS.
+ *  \param buffer   Where the samples go, \a scans times \a count of them.
+ *  \param scans    Scans the buffer holds, at least 2 and at most
+ *                  65535 / \a count.
+ *  \return True (1), or false (0) if a pin has no ADC channel or a size is
+ *          out of range.
+ */
+int adc_scan_init(const Pin *pins, uint32_t count, uint16_t *buffer, uint32_t scans);
+
+/*! \brief Starts converting. Does nothing before adc_scan_init() has
+ *         succeeded.
+ *  \param rate_hz  Scans a second, paced by TIM2, or 0 to convert back to
+ *                  back: 15 ADC clocks a sample, about 530 kS/s at 16 MHz.
+ */
+void adc_scan_start(uint32_t rate_hz);
+
+/*! \brief Stops converting. The samples in the buffer stay. */
+void adc_scan_stop(void);
+
+/*! \brief Checks if a scan runs.
+ *  \return True (1) from adc_scan_start() to adc_scan_stop().
+ */
+int adc_scan_running(void);
+
+/*! \brief Finds a pin in the scan.
+ *  \return Its index in the pins passed to adc_scan_init(), or -1.
+ */
+int adc_scan_index(Pin pin);
+
+/*! \brief Samples written since adc_scan_start(), counted modulo 2^32.
+ *         May be called from any context.
+ */
+uint32_t adc_scan_position(void);
+
+/*! \brief Latest complete sample of a pin.
+ *  \param index  The pin's index, see adc_scan_index().
+ *  \return Its 12-bit value, or 0 before the first scan.
+ */
+uint16_t adc_scan_latest(uint32_t index);
+
+/*! \brief Copies the whole scans taken since the last call, oldest first.
+ *
+ *  Scans the DMA went over again before they were copied are dropped and
+ *  counted by adc_scan_lost(). Only one context may read.
+ *
+ *  \param samples    Where the scans go, \a max_scans times the pin count.
+ *  \param max_scans  Most scans to copy; the others are kept for later.
+ *  \return Scans copied.
+ */
+uint32_t adc_scan_read(uint16_t *samples, uint32_t max_scans);
+
+/*! \brief Scans dropped by adc_scan_read() since adc_scan_start(). */
+uint32_t adc_scan_lost(void);
+
+/*! \brief Sets a function that gets every scan, from the DMA half and full
+ *         transfer interrupt.
+ *
+ *  The scans since the last call are passed in place, in at most two
+ *  runs when they wrap around the buffer, about half the buffer at a
+ *  time. The callback must be done with them before the DMA comes back,
+ *  half the buffer later. It does not stop adc_scan_read().
+ *
+ *  \param callback  Takes \a count scans at \a scans, or 0 for none.
+ */
+void adc_scan_set_callback(void (*callback)(const uint16_t *scans, uint32_t count));
+
+#endif // ADC_SCAN_H
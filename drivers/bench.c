@@ -0,0 +1,89 @@
+#include <string.h>
+#include "platform.h"
+#include "bench.h"
+#include "delay.h"
+#include "format.h"
+
+static BenchCase *first, *last;
+
+static void empty(void) {
+}
+
+// Cycles of one call of run(), less the call itself.
+static uint32_t sample(void (*run)(void), uint32_t overhead) {
+	uint32_t start = cycle_count();
+	uint32_t cycles;
+
+	run();
+	cycles = cycle_count() - start;
+	return cycles > overhead ? cycles - overhead : 0;
+}
+
+static void sort(uint32_t *values, uint32_t count) {
+	for (uint32_t i = 1; i < count; i++) {
+		uint32_t value = values[i], j = i;
+
+		while (j > 0 && values[j - 1] > value) {
+			values[j] = values[j - 1];
+			j--;
+		}
+		values[j] = value;
+	}
+}
+
+// Cycles per operation in tenths, for %.1d.
+static uint32_t per_operation(uint32_t cycles, uint32_t operations) {
+	return (uint32_t)(((uint64_t)cycles * 10 + operations / 2) / operations);
+}
+
+void bench_register(BenchCase *bench) {
+	bench->next = 0;
+	if (last) {
+		last->next = bench;
+	} else {
+		first = bench;
+	}
+	last = bench;
+}
+
+uint32_t bench_run(const char *prefix) {
+	uint32_t cycles[BENCH_MAX_SAMPLES];
+	uint32_t overhead = UINT32_MAX;
+	uint32_t count = 0;
+
+	cycle_counter_init();
+	for (int i = 0; i < BENCH_SAMPLES; i++) {
+		uint32_t cost = sample(empty, 0);
+		if (cost < overhead) overhead = cost;
+	}
+
+	format_uart("\r\nbench: cycles per operation at %lu Hz, less %lu cycles a sample",
+	            (unsigned long)SystemCoreClock, (unsigned long)overhead);
+	format_uart("\r\nbench,name,operations,samples,min,median,max,error");
+	for (BenchCase *bench = first; bench; bench = bench->next) {
+		uint32_t samples = bench->samples ? bench->samples : BENCH_SAMPLES;
+		uint32_t operations = bench->operations ? bench->operations : 1;
+		uint32_t median;
+
+		if (strncmp(bench->name, prefix, strlen(prefix))) {
+			continue;
+		}
+		if (samples > BENCH_MAX_SAMPLES) samples = BENCH_MAX_SAMPLES;
+		for (uint32_t i = 0; i < samples; i++) {
+			if (bench->setup) bench->setup();
+			cycles[i] = sample(bench->run, overhead);
+		}
+		if (bench->teardown) bench->teardown();
+		sort(cycles, samples);
+		median = per_operation(cycles[samples / 2], operations);
+		format_uart("\r\nbench,%s,%lu,%lu,%.1lu,%.1lu,%.1lu,", bench->name, (unsigned long)operations,
+		            (unsigned long)samples, (unsigned long)per_operation(cycles[0], operations),
+		            (unsigned long)median, (unsigned long)per_operation(cycles[samples - 1], operations));
+		if (bench->target_ns) {
+			long target = (long)(((uint64_t)bench->target_ns * SystemCoreClock + 50000000) / 100000000);
+			format_uart("%.1ld", (long)median - target);
+		}
+		count++;
+	}
+	return count;
+}
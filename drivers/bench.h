@@ -0,0 +1,61 @@
+/*!
+ * \file      bench.h
+ * \brief     Registry of benchmarks timed on the board with the DWT
+ *            cycle counter.
+ *
+ * A benchmark is a function that does a known number of operations. It
+ * is called a number of times (the samples), each call timed as a whole
+ * with DWT->CYCCNT less the cost of calling an empty function, and the
+ * minimum, median and maximum cycles per operation are printed. Interrupts
+ * stay enabled, so a sample that took one shows in the maximum; the
+ * minimum and median are the figures to compare.
+ *
+ * A benchmark is added with a static BenchCase:
+ *
+ *     static void run_crc16(void) { checksum_crc16(buffer, 64); }
+ *     static BenchCase crc16 = { "checksum_crc16_64", 0, run_crc16, 64 };
+ *     bench_register(&crc16);
+ *
+ * bench_run() prints one line per benchmark, for a program to read:
+ *
+ *     bench,<name>,<operations>,<samples>,<min>,<median>,<max>,<error>
+ *
+ * with cycles per operation to a tenth, after a line with the core clock.
+ * A benchmark that should take a set time (a delay) gives it, and the
+ * error is the median less that time, in cycles; otherwise it is empty.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+#include <stdint.h>
+
+/*! Samples taken when a benchmark does not say. */
+#define BENCH_SAMPLES 15
+
+/*! Most samples of a benchmark. */
+#define BENCH_MAX_SAMPLES 31
+
+/*! A benchmark. Allocated by the user, usually static. */
+typedef struct BenchCase {
+	const char *name;        //!< Without commas or spaces.
+	void (*setup)(void);     //!< Called before every sample, not timed, or 0.
+	void (*run)(void);       //!< One sample, timed.
+	uint32_t operations;     //!< Operations run() does.
+	uint32_t samples;        //!< Samples to take, 0 for BENCH_SAMPLES.
+	uint32_t target_ns;      //!< Time an operation should take, 0 if none.
+	void (*teardown)(void);  //!< Called after the last sample, or 0.
+	struct BenchCase *next;  //!< Set by bench_register().
+} BenchCase;
+
+/*! \brief Adds a benchmark, after the ones already registered. A case
+ *         must be registered once.
+ *  \param bench  The benchmark.
+ */
+void bench_register(BenchCase *bench);
+
+/*! \brief Runs benchmarks and prints their lines with format_uart().
+ *  \param prefix  Runs the benchmarks whose name starts with it; "" for all.
+ *  \return Number of benchmarks run.
+ */
+uint32_t bench_run(const char *prefix);
+
+#endif // BENCH_H
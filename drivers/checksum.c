@@ -0,0 +1,112 @@
+#include <string.h>
+#include "platform.h"
+#include "checksum.h"
+
+/*
+ * The CRCs are taken most significant bit first. A table entry is the
+ * CRC register after the top 4 bits, equal to its index, are shifted
+ * out: the next register is the rest shifted up by 4, XOR the entry.
+ */
+
+static const uint8_t crc8_table[16] = {
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+static const uint16_t crc16_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+void checksum_init(void) {
+	RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+}
+
+uint32_t checksum(ChecksumKind kind, const void *data, uint32_t length) {
+	switch (kind) {
+		case ChecksumXor:
+			return checksum_xor(data, length);
+		case ChecksumCrc8:
+			return checksum_crc8(data, length);
+		case ChecksumCrc16:
+			return checksum_crc16(data, length);
+		case ChecksumCrc32:
+			return checksum_crc32(data, length);
+	}
+	return 0;
+}
+
+uint8_t checksum_xor(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	const uint32_t *words;
+	uint32_t fold = 0;
+
+	// Up to a word boundary, then four words a turn; the lanes of the
+	// word are folded together at the end.
+	while (length > 0 && ((uintptr_t)bytes & 3)) {
+		fold ^= *bytes++;
+		length--;
+	}
+	words = (const uint32_t *)bytes;
+	while (length >= 16) {
+		fold ^= words[0] ^ words[1] ^ words[2] ^ words[3];
+		words += 4;
+		length -= 16;
+	}
+	while (length >= 4) {
+		fold ^= *words++;
+		length -= 4;
+	}
+	bytes = (const uint8_t *)words;
+	while (length-- > 0) {
+		fold ^= *bytes++;
+	}
+	fold ^= fold >> 16;
+	fold ^= fold >> 8;
+	return (uint8_t)fold;
+}
+
+uint8_t checksum_crc8(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	uint32_t crc = 0;
+
+	while (length-- > 0) {
+		crc ^= *bytes++;
+		crc = ((crc << 4) & 0xFF) ^ crc8_table[crc >> 4];
+		crc = ((crc << 4) & 0xFF) ^ crc8_table[crc >> 4];
+	}
+	return (uint8_t)crc;
+}
+
+uint16_t checksum_crc16(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	uint32_t crc = 0xFFFF;
+
+	while (length-- > 0) {
+		crc ^= (uint32_t)*bytes++ << 8;
+		crc = ((crc << 4) & 0xFFFF) ^ crc16_table[crc >> 12];
+		crc = ((crc << 4) & 0xFFFF) ^ crc16_table[crc >> 12];
+	}
+	return (uint16_t)crc;
+}
+
+uint32_t checksum_crc32(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	uint32_t word, crc;
+
+	// The unit takes the most significant byte of a word first
+	CRC->CR = CRC_CR_RESET;
+	while (length >= 4) {
+		memcpy(&word, bytes, 4);
+		CRC->DR = __REV(word);
+		bytes += 4;
+		length -= 4;
+	}
+	crc = CRC->DR;
+	while (length-- > 0) {
+		crc ^= (uint32_t)*bytes++ << 24;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = crc & 0x80000000UL ? (crc << 1) ^ 0x04C11DB7UL : crc << 1;
+		}
+	}
+	return crc;
+}
@@ -0,0 +1,72 @@
+/*!
+ * \file      checksum.h
+ * \brief     Checksums and CRCs of byte arrays.
+ *
+ * Four ways to check data, from the cheapest to the strongest:
+ *
+ * - XOR fold: the XOR of all the bytes, as crc_like_checksum() in
+ *   hasher.s, but taken a word at a time. Misses any two equal errors.
+ * - CRC-8 (polynomial 0x07, initial value 0): any error of up to 8
+ *   bits in a row, and most others; for records of a few words.
+ * - CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ * - CRC-32/MPEG-2 (polynomial 0x04C11DB7, initial value 0xFFFFFFFF,
+ *   no reflection), on the CRC calculation unit of the STM32F4, a word
+ *   every 4 AHB cycles.
+ *
+ * The CRC-8 and CRC-16 take 4 bits at a time from a table of 16 entries,
+ * for 48 bytes of flash; that is two to three times as fast as a bit at
+ * a time (make bench). The CRC unit is not reentrant: checksum_crc32()
+ * must not be called from an interrupt handler while the main loop uses
+ * it.
+ */
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+#include <stdint.h>
+
+/*! The checks, for checksum(). */
+typedef enum {
+	ChecksumXor,
+	ChecksumCrc8,
+	ChecksumCrc16,
+	ChecksumCrc32
+} ChecksumKind;
+
+/*! \brief Enables the clock of the CRC calculation unit. Must be called
+ *         once before checksum_crc32().
+ */
+void checksum_init(void);
+
+/*! \brief Any of the checks below.
+ *  \param kind    The check.
+ *  \param data    Bytes to check.
+ *  \param length  Number of bytes.
+ *  \return The check value, in the low bits for the shorter ones.
+ */
+uint32_t checksum(ChecksumKind kind, const void *data, uint32_t length);
+
+/*! \brief XOR of the bytes.
+ *  \param data    Bytes to check, at any alignment.
+ *  \param length  Number of bytes.
+ */
+uint8_t checksum_xor(const void *data, uint32_t length);
+
+/*! \brief CRC-8 of the bytes.
+ *  \param data    Bytes to check.
+ *  \param length  Number of bytes.
+ */
+uint8_t checksum_crc8(const void *data, uint32_t length);
+
+/*! \brief CRC-16/CCITT-FALSE of the bytes.
+ *  \param data    Bytes to check.
+ *  \param length  Number of bytes.
+ */
+uint16_t checksum_crc16(const void *data, uint32_t length);
+
+/*! \brief CRC-32/MPEG-2 of the bytes, on the CRC unit. A length that
+ *         is not a multiple of 4 ends in software.
+ *  \param data    Bytes to check, at any alignment.
+ *  \param length  Number of bytes.
+ */
+uint32_t checksum_crc32(const void *data, uint32_t length);
+
+#endif // CHECKSUM_H
@@ -1,26 +1,135 @@
 #include "platform.h"
 #include "comparator.h"
-#include <stdlib.h>
+#include "adc_scan.h"
+#include "delay.h"
 
-//Note: the interrupt can be only triggered once!
-void comparator_init(void) {
-	adc_init(P_CMP_NEG);	
-	adc_init(P_CMP_PLUS);	
+/*
+ * The watchdog flags a result above HTR or below LTR. While the output is
+ * low the window is 0 to level + hysteresis, while high level - hysteresis
+ * to 4095. The window is widened before it is moved, so a conversion in
+ * between never sees a half-moved one.
+ */
+
+#define SAMPLE_15_CYCLES 1UL // 15 + 12 ADC clocks a conversion
+
+static int pins_ready; // adc_init() allocates, so once only
+static uint32_t channel;
+static uint16_t threshold;
+static uint16_t margin;
+static volatile int output;
+static volatile int running;
+static ComparatorTriggerMode trigger;
+static void (*comparator_callback)(int state);
+
+// The window that lets the output stay as it is.
+static void comparator_window(void) {
+	uint32_t high = threshold + margin;
+	uint32_t low = threshold > margin ? threshold - margin : 0;
+
+	if (output) {
+		ADC1->LTR = 0;
+		ADC1->HTR = 0x0FFF;
+		ADC1->LTR = low;
+	} else {
+		ADC1->HTR = 0x0FFF;
+		ADC1->LTR = 0;
+		ADC1->HTR = high < 0x0FFF ? high : 0x0FFF;
+	}
 }
 
+void comparator_init(void) {
+	comparator_stop();
+	if (adc_scan_running()) {
+		adc_scan_stop();
+	}
+	if (!pins_ready) {
+		adc_init(P_CMP_NEG);
+		adc_init(P_CMP_PLUS);
+		pins_ready = 1;
+	}
+	channel = STM_PIN_CHANNEL(pinmap_function(P_CMP_PLUS));
+	threshold = adc_read(P_CMP_NEG) & 0x0FFF;
+	margin = COMPARATOR_HYSTERESIS;
+	output = (adc_read(P_CMP_PLUS) & 0x0FFF) > threshold;
+
+	// P_CMP_PLUS alone, converted back to back
+	ADC1->CR2 = 0;
+	ADC1->SQR1 = ADC_SQR1(1);
+	ADC1->SQR3 = ADC_SQR3_RK(channel, 1);
+	if (channel < 10) {
+		MODIFY_REG(ADC1->SMPR2, ADC_SMPR2(7UL, channel), ADC_SMPR2(SAMPLE_15_CYCLES, channel));
+	} else {
+		MODIFY_REG(ADC1->SMPR1, ADC_SMPR1(7UL, channel), ADC_SMPR1(SAMPLE_15_CYCLES, channel));
+	}
+	comparator_window();
+	ADC1->CR1 = ADC_CR1_AWDIE | ADC_CR1_AWDEN | ADC_CR1_AWDSGL | channel;
+	ADC1->SR = 0;
+	NVIC_SetPriority(ADC_IRQn, 1);
+	NVIC_ClearPendingIRQ(ADC_IRQn);
+	NVIC_EnableIRQ(ADC_IRQn);
 
-int comparator_read(void) {	
-	uint16_t comp_neg = ( adc_read(P_CMP_NEG) & (uint16_t)0x0FFF) ;			
-	//Create some delay
-	for (int i=0; i < 1000;i++);
-	
-	uint16_t comp_pos = ( adc_read(P_CMP_PLUS) & (uint16_t)0x0FFF) ;
-	if (comp_pos > comp_neg) {
-		return 1;
+	ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_CONT;
+	delay_us(ADC_STAB_DELAY_US);
+	running = 1;
+	ADC1->CR2 |= ADC_CR2_SWSTART;
+}
+
+void comparator_stop(void) {
+	if (!running) {
+		return;
 	}
-	else {
-		return 0;
+	NVIC_DisableIRQ(ADC_IRQn);
+	ADC1->CR2 = 0;
+	// Back to the single conversions of adc_read()
+	ADC1->CR1 = 0;
+	ADC1->SQR1 = 0;
+	ADC1->SR = 0;
+	NVIC_ClearPendingIRQ(ADC_IRQn);
+	running = 0;
+}
+
+int comparator_running(void) {
+	return running;
+}
+
+void comparator_set_threshold(uint16_t level, uint16_t hysteresis) {
+	NVIC_DisableIRQ(ADC_IRQn);
+	threshold = level & 0x0FFF;
+	margin = hysteresis;
+	if (running) {
+		comparator_window();
+		NVIC_EnableIRQ(ADC_IRQn);
 	}
 }
 
+int comparator_read(void) {
+	return output;
+}
+
+uint16_t comparator_sample(void) {
+	return running ? ADC1->DR & 0x0FFF : 0;
+}
+
+void comparator_set_trigger(ComparatorTriggerMode trig) {
+	trigger = trig;
+}
+
+void comparator_set_callback(void (*callback)(int state)) {
+	comparator_callback = callback;
+}
 
+void ADC_IRQHandler(void) {
+	if (!(ADC1->SR & ADC_SR_AWD)) {
+		return;
+	}
+	output = !output;
+	comparator_window();
+	ADC1->SR = ~ADC_SR_AWD;
+	NVIC_ClearPendingIRQ(ADC_IRQn);
+
+	if (comparator_callback && (trigger == CompBoth ||
+	                            (trigger == CompRising && output) ||
+	                            (trigger == CompFalling && !output))) {
+		comparator_callback(output);
+	}
+}
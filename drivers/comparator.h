@@ -1,29 +1,61 @@
 /*!
  * \file      comparator.h
- * \brief     Exposes functions of an internal comparator.
+ * \brief     A comparator of P_CMP_PLUS against a threshold, on the analog
+ *            watchdog of ADC1.
+ *
+ * The F411 has no analogue comparator. Instead ADC1 converts P_CMP_PLUS
+ * back to back, about every 3.4 us at 16 MHz, and its analog watchdog
+ * raises an interrupt only when a result leaves a window around the
+ * output: above the threshold plus the hysteresis while the output is
+ * low, below it less the hysteresis while high. The interrupt flips the
+ * output and moves the window, so the CPU does nothing between
+ * crossings.
+ *
+ * While the comparator runs ADC1 belongs to it: adc_read() of P_CMP_PLUS
+ * returns its latest sample, and of any other pin 0. Starting an ADC1
+ * scan stops it.
  * \copyright ARM University Program &copy; ARM Ltd 2014.
  */
 #include "adc.h"
 #ifndef COMPARATOR_H
 #define COMPARATOR_H
 
+/*! Hysteresis set by comparator_init(), in LSB either side. */
+#define COMPARATOR_HYSTERESIS 16
 
 /*! Defines the triggering mode of the comparator's interrupt. */
 typedef enum {
 	CompNone,    //!< Disables the interrupt.
-	CompRising,  //!< Enables an interrupt on the falling edge.
-	CompFalling, //!< Enables an interrupt on the rising edge.
+	CompRising,  //!< Enables an interrupt on the rising edge.
+	CompFalling, //!< Enables an interrupt on the falling edge.
 	CompBoth     //!< Enables an interrupt on both the rising and falling edges.
 } ComparatorTriggerMode;
 
 
-/*! \brief Initializes the internal comparator. */
+/*! \brief Initializes the comparator and starts it. The threshold is
+ *         P_CMP_NEG, sampled once, with COMPARATOR_HYSTERESIS.
+ */
 void comparator_init(void);
 
+/*! \brief Stops the comparator and gives ADC1 back to adc_read(). */
+void comparator_stop(void);
+
+/*! \brief Checks if the comparator runs.
+ *  \return True (1) from comparator_init() to comparator_stop().
+ */
+int comparator_running(void);
+
+/*! \brief Sets the threshold.
+ *  \param level       Threshold, 0 to 4095.
+ *  \param hysteresis  The output goes high above \a level + \a hysteresis
+ *                     and low below \a level - \a hysteresis.
+ */
+void comparator_set_threshold(uint16_t level, uint16_t hysteresis);
+
 /*! \brief Reads the current value of the comparator.
  *  \return Output value of the comparator.
  */
-//int comparator_read(void);
+int comparator_read(void);
 
 /*! \brief Configures the event which will cause an interrupt.
  *  \param trig  New triggering mode.
@@ -35,10 +67,11 @@ void comparator_set_trigger(ComparatorTriggerMode trig);
  *
  *  \sa comparator_set_trigger to configure and enable the interrupt.
  *
- *  \param callback  Callback function.
+ *  \param callback  Callback function, given the new output.
  */
 void comparator_set_callback(void (*callback)(int state));
 
-int comparator_read(void);
+/*! \brief Latest sample of P_CMP_PLUS while the comparator runs. */
+uint16_t comparator_sample(void);
 
 #endif // COMPARATOR_H
@@ -2,27 +2,112 @@
 #include <stdint.h>
 #include "delay.h"
 
+/*
+ * delay_cycles() (delay_as.s) spins for about 4 cycles per iteration, but
+ * how many exactly depends on the flash wait states, the prefetch and
+ * the ART cache. delay_calibrate() times it with the cycle counter, as
+ * cost = overhead + cycles * slope, and the delays ask it for what the
+ * measured line says. They also watch the cycle counter, so time spent
+ * in interrupt handlers counts towards the delay.
+ */
+
+#define CALIBRATION_SHORT  64
+#define CALIBRATION_LONG   (CALIBRATION_SHORT + 4096)
+#define STEP_CYCLES        (1UL << 24) // Longest spin between two looks at the counter
 
 extern void delay_cycles(unsigned int cycles);
 
+static uint32_t calibrated_clock;  // SystemCoreClock at the calibration, 0 before
+static uint32_t calibrated_acr;    // FLASH->ACR at the calibration
+static uint32_t loop_overhead;     // cycles of delay_cycles(0) and of looking at the counter
+static uint32_t loop_scale;        // cycles to ask delay_cycles() for a real cycle, Q16
+static uint32_t read_cost;         // cycles between two reads of the counter
+
+static uint32_t time_loop(uint32_t cycles) {
+	uint32_t start = DWT->CYCCNT;
+	delay_cycles(cycles);
+	return DWT->CYCCNT - start;
+}
+
+void delay_calibrate(void) {
+	uint32_t primask = __get_PRIMASK();
+	uint32_t short_cycles, long_cycles;
+
+	cycle_counter_init();
+	__disable_irq();
+	read_cost = DWT->CYCCNT;
+	read_cost = DWT->CYCCNT - read_cost;
+	time_loop(CALIBRATION_SHORT); // Fills the cache with the loop
+	short_cycles = time_loop(CALIBRATION_SHORT);
+	long_cycles = time_loop(CALIBRATION_LONG);
+	__set_PRIMASK(primask);
+
+	if (long_cycles <= short_cycles) {
+		long_cycles = short_cycles + 1;
+	}
+	loop_scale = (uint32_t)(((uint64_t)(CALIBRATION_LONG - CALIBRATION_SHORT) << 16) / (long_cycles - short_cycles));
+	loop_overhead = short_cycles - (uint32_t)(((uint64_t)CALIBRATION_SHORT << 16) / loop_scale);
+	calibrated_clock = SystemCoreClock;
+	calibrated_acr = FLASH->ACR;
+}
+
+// Again if the clock or the wait states changed.
+static void check_calibration(void) {
+	if (calibrated_clock != SystemCoreClock || calibrated_acr != FLASH->ACR) {
+		delay_calibrate();
+	}
+}
+
+// Waits until the counter is cycles past start, less the last read.
+static void wait_until(uint32_t start, uint32_t cycles) {
+	uint32_t elapsed;
+
+	cycles = cycles > read_cost ? cycles - read_cost : 0;
+	while ((elapsed = DWT->CYCCNT - start) + loop_overhead < cycles) {
+		uint32_t spin = cycles - elapsed - loop_overhead;
+		if (spin > STEP_CYCLES) spin = STEP_CYCLES;
+		delay_cycles((uint32_t)(((uint64_t)spin * loop_scale) >> 16));
+	}
+}
+
 void delay_ms(unsigned int ms) {
-	unsigned int max_step = 1000 * (UINT32_MAX / SystemCoreClock);
-	unsigned int max_sleep_cycles = max_step * (SystemCoreClock / 1000);
-	while (ms > max_step) {
-		ms -= max_step;
-		delay_cycles(max_sleep_cycles);
+	uint32_t start, per_ms = SystemCoreClock / 1000;
+
+	check_calibration();
+	start = cycle_count();
+	// A second at a time, so that the counter does not wrap
+	while (ms > 1000) {
+		wait_until(start, 1000 * per_ms);
+		start += 1000 * per_ms;
+		ms -= 1000;
 	}
-	delay_cycles(ms * (SystemCoreClock / 1000));
+	wait_until(start, ms * per_ms);
 }
 
 void delay_us(unsigned int us) {
-	unsigned int max_step = 1000000 * (UINT32_MAX / SystemCoreClock);
-	unsigned int max_sleep_cycles = max_step * (SystemCoreClock / 1000000);
-	while (us > max_step) {
-		us -= max_step;
-		delay_cycles(max_sleep_cycles);
+	uint32_t start, per_us = SystemCoreClock / 1000000;
+
+	check_calibration();
+	start = cycle_count();
+	while (us > 1000000) {
+		wait_until(start, 1000000 * per_us);
+		start += 1000000 * per_us;
+		us -= 1000000;
 	}
-	delay_cycles(us * (SystemCoreClock / 1000000));
+	wait_until(start, us * per_us);
+}
+
+void cycle_counter_init(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t cycle_count(void) {
+	return DWT->CYCCNT;
+}
+
+uint32_t cycles_to_us(uint32_t cycles) {
+	return (uint32_t)(((uint64_t)cycles * 1000000) / SystemCoreClock);
 }
 
 
@@ -5,17 +5,45 @@
  */
 #ifndef DELAY_H
 #define DELAY_H
+#include <stdint.h>
 
-/*! \brief Delays for a duration milliseconds.
+/*! \brief Delays for a duration milliseconds. Time spent in interrupt
+ *         handlers counts towards it.
  *  \param ms   Duration to delay in milliseconds.
  */
 void delay_ms(unsigned int ms);
 
-/*! \brief Delays for a duration in microseconds.
+/*! \brief Delays for a duration in microseconds, to a cycle or so
+ *         from 1 us up. Time spent in interrupt handlers counts towards it.
  *  \param us   Duration to delay in microseconds.
  */
 void delay_us(unsigned int us);
 
+/*! \brief Times the delay loop against the cycle counter. Called by the
+ *         delays on their first call and whenever SystemCoreClock or the
+ *         flash wait states (FLASH->ACR) have changed since; takes a few
+ *         thousand cycles with interrupts disabled.
+ */
+void delay_calibrate(void);
+
+/*! \brief Starts the DWT cycle counter, used to time events in
+ *         core cycles. Safe to call more than once.
+ */
+void cycle_counter_init(void);
+
+/*! \brief Reads the DWT cycle counter.
+ *  The difference of two readings is exact across the wrap, for
+ *  intervals up to 2^32 cycles (268 s at 16 MHz).
+ *  \return Cycles counted since cycle_counter_init().
+ */
+uint32_t cycle_count(void);
+
+/*! \brief Converts a number of cycles to microseconds at the current
+ *         core clock (SystemCoreClock), rounding down.
+ *  \param cycles   Cycles to convert.
+ */
+uint32_t cycles_to_us(uint32_t cycles);
+
 /*! \brief Delays for \a cycles.
  *  \param cycles   Cycles to delay for.
  */
@@ -0,0 +1,225 @@
+#include "platform.h"
+#include "dht11_capture.h"
+
+/*
+ * The line is sampled by the timer, not the CPU: TIM3 counts microseconds
+ * and latches the count into CCR3 on both edges of PC_8, and the DMA
+ * copies every latched count into edge_times. Channel 4 is a compare
+ * that ends the start signal and, later, the frame.
+ *
+ * A frame is: response low and high, 40 bits of a 50 us low and a high
+ * of 27 us (0) or 70 us (1), a final 50 us low, then the line is
+ * released. The decoder walks it from the end, where the line is known
+ * to be high again, so an edge caught (or not) when the line is released
+ * at the start does not matter.
+ */
+
+#define START_US        20000U  // start signal, at least 18 ms
+#define FRAME_US        6000U   // release to end of frame, 5.1 ms at most
+#define FRAME_EDGES     (2 + 2 * DHT11_MAX_DATA_BITS + 2)
+#define MAX_EDGES       (FRAME_EDGES + 4)
+
+#define DMA_FLAGS (DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7)
+
+typedef enum {
+	Idle,
+	Start,   // MCU holds the line low
+	Receive  // line released, edges are being captured
+} CapturePhase;
+
+static void (*DHT11_callback)(const DHT11_Reading *);
+static volatile CapturePhase phase;
+static uint16_t edge_times[MAX_EDGES];
+
+void dht11_capture_init(void) {
+	RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+
+	// Free running 1 MHz counter, the prescaler is set by every start
+	TIM3->CR1 = 0;
+	TIM3->ARR = 0xFFFF;
+	TIM3->EGR = TIM_EGR_UG;
+	TIM3->SR = 0;
+	// Channel 3 captures TI3 on both edges, after 4 samples of the 16 MHz
+	// clock agree; channel 4 stays a compare.
+	TIM3->CCMR2 = TIM_CCMR2_CC3S_0 | TIM_CCMR2_IC3F_0 | TIM_CCMR2_IC3F_1;
+	TIM3->CCER = TIM_CCER_CC3P | TIM_CCER_CC3NP;
+	TIM3->DIER = 0;
+	TIM3->CR1 = TIM_CR1_CEN;
+
+	// DMA1 Stream7 channel 5 (TIM3_CH3): CCR3 into edge_times
+	DMA1_Stream7->CR = 0;
+	while (DMA1_Stream7->CR & DMA_SxCR_EN) {
+	}
+	DMA1->HIFCR = DMA_FLAGS;
+	DMA1_Stream7->PAR = (uint32_t)(uintptr_t)&TIM3->CCR3;
+	DMA1_Stream7->M0AR = (uint32_t)(uintptr_t)edge_times;
+	DMA1_Stream7->FCR = 0; // Direct mode
+	DMA1_Stream7->CR = DMA_SxCR_CHSEL_2 | DMA_SxCR_CHSEL_0 | // Channel 5
+	                   DMA_SxCR_PSIZE_0 | DMA_SxCR_MSIZE_0 | // Half-words
+	                   DMA_SxCR_MINC |
+	                   DMA_SxCR_TCIE;
+
+	phase = Idle;
+	NVIC_SetPriority(TIM3_IRQn, 2);
+	NVIC_ClearPendingIRQ(TIM3_IRQn);
+	NVIC_EnableIRQ(TIM3_IRQn);
+	NVIC_SetPriority(DMA1_Stream7_IRQn, 2);
+	NVIC_ClearPendingIRQ(DMA1_Stream7_IRQn);
+	NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+}
+
+// TIM3 runs at HCLK, or twice PCLK1 when the APB1 prescaler divides.
+static uint32_t dht11_capture_timer_clock(void) {
+	uint32_t ppre1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> 10;
+
+	if (ppre1 & 4) {
+		return SystemCoreClock >> (ppre1 & 3);
+	}
+	return SystemCoreClock;
+}
+
+// Hands the line to TIM3_CH3 (AF2). The line is released: the sensor answers.
+static void dht11_capture_release(void) {
+	GPIO_TypeDef* p = GET_PORT(DHT11_CAPTURE_PIN);
+	uint32_t pin_index = GET_PIN_INDEX(DHT11_CAPTURE_PIN);
+
+	DMA1->HIFCR = DMA_FLAGS;
+	DMA1_Stream7->NDTR = MAX_EDGES;
+	DMA1_Stream7->CR |= DMA_SxCR_EN;
+	(void)TIM3->CCR3; // Drop a stale capture
+	TIM3->SR = ~(TIM_SR_CC3IF | TIM_SR_CC3OF);
+	TIM3->CCER |= TIM_CCER_CC3E;
+	TIM3->DIER |= TIM_DIER_CC3DE;
+
+	MODIFY_REG(p->AFR[pin_index >> 3], 0xFUL << ((pin_index & 7) * 4), 2UL << ((pin_index & 7) * 4));
+	MODIFY_REG(p->MODER, 3UL << (pin_index * 2), 2UL << (pin_index * 2));
+}
+
+// Decodes the frame from its time stamps; 16 bit differences are exact
+// since no pulse is anywhere near 65 ms long.
+static void dht11_capture_decode(DHT11_Reading *reading, uint32_t edges) {
+	const uint16_t *end = &edge_times[edges];
+	uint32_t preambles = 0;
+
+	reading->edges = edges;
+	reading->status = DHT11_OK;
+	for (int i = 0; i < DHT11_MAX_BYTE_PACKETS; i++) {
+		reading->data[i] = 0;
+	}
+	reading->humidity = 0.0f;
+	reading->temperature = 0.0f;
+	reading->threshold_us = 0;
+
+	if (edges < 2) {
+		reading->status = DHT11_ERROR; // No answer
+		return;
+	}
+	if (edges < FRAME_EDGES || !gpio_get(DHT11_CAPTURE_PIN)) {
+		reading->status = DHT11_TIMEOUT; // Frame cut short
+		return;
+	}
+
+	// end[-1] is the release, end[-2] the end of the last bit. Bit k
+	// falls at end[-82 + 2k], rises at end[-81 + 2k] and ends at end[-80 + 2k].
+	for (int bit = 0; bit < DHT11_MAX_DATA_BITS; bit++) {
+		const uint16_t *fall = end - (2 * DHT11_MAX_DATA_BITS + 2) + 2 * bit;
+		uint16_t low = (uint16_t)(fall[1] - fall[0]);
+		uint16_t high = (uint16_t)(fall[2] - fall[1]);
+
+		reading->low_us[bit] = low > 0xFF ? 0xFF : (uint8_t)low;
+		reading->high_us[bit] = high > 0xFF ? 0xFF : (uint8_t)high;
+		preambles += reading->low_us[bit];
+	}
+
+	// The preambles last 50 us by the sensor's clock, a 0 is about half
+	// of that and a 1 half as much again: their mean splits the two.
+	reading->threshold_us = (uint8_t)(preambles / DHT11_MAX_DATA_BITS);
+	for (int bit = 0; bit < DHT11_MAX_DATA_BITS; bit++) {
+		reading->data[bit / 8] = (uint8_t)(reading->data[bit / 8] << 1);
+		reading->data[bit / 8] |= (reading->high_us[bit] > reading->threshold_us);
+	}
+
+	reading->humidity = reading->data[0] + reading->data[1] * 0.1f;
+	reading->temperature = reading->data[2] + reading->data[3] * 0.1f;
+
+	// Last 8 bits are Checksum, which is the sum of all the previously transmitted 4 bytes
+	if (reading->data[4] != (uint8_t)(reading->data[0] + reading->data[1] + reading->data[2] + reading->data[3])) {
+		reading->status = DHT11_CHECKSUM_MISMATCH;
+	}
+}
+
+static void dht11_capture_finish(void) {
+	DHT11_Reading reading;
+	void (*callback)(const DHT11_Reading *) = DHT11_callback;
+
+	TIM3->DIER &= ~(TIM_DIER_CC3DE | TIM_DIER_CC4IE);
+	TIM3->CCER &= ~TIM_CCER_CC3E;
+	DMA1_Stream7->CR &= ~DMA_SxCR_EN;
+	while (DMA1_Stream7->CR & DMA_SxCR_EN) {
+	}
+	DMA1->HIFCR = DMA_FLAGS;
+	NVIC_ClearPendingIRQ(DMA1_Stream7_IRQn);
+
+	dht11_capture_decode(&reading, MAX_EDGES - DMA1_Stream7->NDTR);
+	gpio_set_mode(DHT11_CAPTURE_PIN, Input);
+
+	phase = Idle;
+	if (callback) {
+		callback(&reading);
+	}
+}
+
+int dht11_capture_start(void (*callback)(const DHT11_Reading *reading)) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (phase != Idle) {
+		__set_PRIMASK(primask);
+		return 0;
+	}
+	phase = Start;
+	__set_PRIMASK(primask);
+
+	DHT11_callback = callback;
+
+	// Microsecond ticks at whatever the clocks are now
+	TIM3->PSC = dht11_capture_timer_clock() / 1000000 - 1;
+	TIM3->EGR = TIM_EGR_UG;
+	TIM3->SR = ~TIM_SR_UIF;
+
+	// PULLING the Line to Low for START_US, the compare ends it
+	gpio_pin_low(GPIO_PIN(DHT11_CAPTURE_PIN));
+	gpio_set_mode(DHT11_CAPTURE_PIN, Output);
+	TIM3->CCR4 = (uint16_t)(TIM3->CNT + START_US);
+	TIM3->SR = ~TIM_SR_CC4IF;
+	TIM3->DIER |= TIM_DIER_CC4IE;
+	return 1;
+}
+
+int dht11_capture_busy(void) {
+	return phase != Idle;
+}
+
+void TIM3_IRQHandler(void) {
+	if (!(TIM3->SR & TIM_SR_CC4IF)) {
+		return;
+	}
+	TIM3->SR = ~TIM_SR_CC4IF;
+	NVIC_ClearPendingIRQ(TIM3_IRQn);
+
+	if (phase == Start) {
+		dht11_capture_release();
+		TIM3->CCR4 = (uint16_t)(TIM3->CCR4 + FRAME_US);
+		phase = Receive;
+	} else if (phase == Receive) {
+		dht11_capture_finish();
+	}
+}
+
+// The buffer filled up before the frame timed out: noise on the line.
+void DMA1_Stream7_IRQHandler(void) {
+	if (DMA1->HISR & DMA_HISR_TCIF7) {
+		dht11_capture_finish();
+	}
+}
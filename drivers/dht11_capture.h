@@ -0,0 +1,51 @@
+/*!
+ * \file      dht11_capture.h
+ * \brief     Interrupt-free DHT11 acquisition with timer input capture.
+ *
+ * The DHT11 data line is wired to PC_8, which is TIM3 channel 3 (AF2).
+ * The start signal is timed by TIM3 channel 4, then every edge of the
+ * sensor's answer is time stamped by channel 3 and moved to memory by
+ * DMA1 Stream7 (channel 5). The bits are decoded from the time stamps
+ * once the frame is over, so interrupts stay enabled throughout and the
+ * CPU is free for the 25 ms a reading takes. The threshold between a 0
+ * and a 1 follows the preambles the sensor actually sent.
+ */
+#ifndef DHT11_CAPTURE_H
+#define DHT11_CAPTURE_H
+#include <stdint.h>
+#include "gpio.h"
+
+#define DHT11_CAPTURE_PIN PC_8
+
+/*! Result of one acquisition, passed to the completion callback. */
+typedef struct {
+	DHT11_StatusTypeDef status; //!< DHT11_OK, or why the frame was rejected.
+	uint8_t data[5];            //!< Humidity, its tenths, temperature, its tenths, checksum.
+	float humidity;             //!< Relative humidity in %.
+	float temperature;          //!< Temperature in degrees Celsius.
+	uint32_t edges;             //!< Edges captured on the line.
+	uint8_t low_us[DHT11_MAX_DATA_BITS];  //!< Measured low preamble of every bit.
+	uint8_t high_us[DHT11_MAX_DATA_BITS]; //!< Measured high time of every bit.
+	uint8_t threshold_us;       //!< High times above this were read as ones.
+} DHT11_Reading;
+
+/*! \brief Configures TIM3, DMA1 Stream7 and their interrupts.
+ *         Must be called once before dht11_capture_start().
+ */
+void dht11_capture_init(void);
+
+/*! \brief Starts an acquisition and returns immediately.
+ *  \param callback  Called from the TIM3 or DMA1 Stream7 interrupt
+ *                   handler once the reading is complete. The reading
+ *                   is only valid during the call.
+ *  \return True (1) if the acquisition started, false (0) if one is
+ *          already in progress.
+ */
+int dht11_capture_start(void (*callback)(const DHT11_Reading *reading));
+
+/*! \brief Checks if an acquisition is in progress.
+ *  \return True (1) from dht11_capture_start() until the callback returns.
+ */
+int dht11_capture_busy(void);
+
+#endif // DHT11_CAPTURE_H
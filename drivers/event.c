@@ -0,0 +1,111 @@
+#include "platform.h"
+#include "event.h"
+#include "delay.h"
+#include "timer.h"
+
+/*
+ * Pending events are bits of one word, bit n for event n, so posting is
+ * setting a bit and finding the next event to run is isolating the
+ * lowest bit set and counting the zeros above it.
+ */
+
+static void (*handlers[EVENT_MAX])(void);
+static volatile uint32_t pending;
+static uint32_t posted_at[EVENT_MAX]; // cycle count of the first post
+static EventStats stats[EVENT_MAX];
+
+void event_init(void) {
+	cycle_counter_init();
+	pending = 0;
+	for (int i = 0; i < EVENT_MAX; i++) {
+		handlers[i] = 0;
+		stats[i] = (EventStats){0};
+	}
+}
+
+void event_set_handler(uint32_t event, void (*handler)(void)) {
+	if (event < EVENT_MAX) {
+		handlers[event] = handler;
+	}
+}
+
+void event_post(uint32_t event) {
+	uint32_t primask;
+
+	if (event >= EVENT_MAX) {
+		return;
+	}
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (!(pending & (1UL << event))) {
+		posted_at[event] = cycle_count();
+		pending |= 1UL << event;
+	}
+	stats[event].posted++;
+	__set_PRIMASK(primask);
+}
+
+int event_pending(void) {
+	return pending != 0;
+}
+
+int event_dispatch(void) {
+	uint32_t primask = __get_PRIMASK();
+	uint32_t event, posted, start, cycles;
+	EventStats *s;
+
+	__disable_irq();
+	if (!pending) {
+		__set_PRIMASK(primask);
+		return 0;
+	}
+	event = 31 - __CLZ(pending & (0UL - pending));
+	pending &= ~(1UL << event);
+	posted = posted_at[event];
+	__set_PRIMASK(primask);
+
+	// Posts during the run make the event pending again, nothing is lost
+	s = &stats[event];
+	start = cycle_count();
+	if (start - posted > s->max_latency) {
+		s->max_latency = start - posted;
+	}
+	if (handlers[event]) {
+		handlers[event]();
+	}
+	cycles = cycle_count() - start;
+	s->runs++;
+	s->cycles += cycles;
+	if (cycles > s->max_cycles) {
+		s->max_cycles = cycles;
+	}
+	return 1;
+}
+
+void event_loop(void) {
+	while (1) {
+		// Deferred timer callbacks are due before any event
+		timer_run_deferred();
+		if (event_dispatch()) {
+			continue;
+		}
+		// An interrupt between the check and __WFI() still wakes it: it
+		// stays pending while PRIMASK is set, and runs once it is cleared.
+		__disable_irq();
+		if (!pending && !timer_deferred_pending()) {
+			__WFI(); // Wait for Interrupt
+		}
+		__enable_irq();
+	}
+}
+
+void event_get_stats(uint32_t event, EventStats *copy) {
+	uint32_t primask = __get_PRIMASK();
+
+	if (event >= EVENT_MAX) {
+		return;
+	}
+	__disable_irq();
+	*copy = stats[event];
+	__set_PRIMASK(primask);
+}
@@ -0,0 +1,64 @@
+/*!
+ * \file      event.h
+ * \brief     Event dispatcher for the main loop.
+ *
+ * Interrupt handlers post events, the main loop runs their handlers.
+ * An event is a number from 0 to EVENT_MAX - 1 and also its priority:
+ * when several are pending, the lowest number runs first, as with the
+ * NVIC. An event posted again before its handler runs is handled once,
+ * so handlers take everything waiting for them (the whole receive queue,
+ * for example). The main loop sleeps in __WFI() while nothing is pending.
+ */
+#ifndef EVENT_H
+#define EVENT_H
+#include <stdint.h>
+
+/*! Number of distinct events. */
+#define EVENT_MAX 32
+
+/*! Run-time statistics of one event and its handler. */
+typedef struct {
+	uint32_t posted;      //!< Calls of event_post().
+	uint32_t runs;        //!< Calls of the handler.
+	uint32_t cycles;      //!< Core cycles spent in the handler, in total.
+	uint32_t max_cycles;  //!< Longest run of the handler, in core cycles.
+	uint32_t max_latency; //!< Longest wait from the first post to the run, in core cycles.
+} EventStats;
+
+/*! \brief Clears all handlers, pending events and statistics, and
+ *         starts the cycle counter the statistics are taken with.
+ */
+void event_init(void);
+
+/*! \brief Sets the handler of an event, which runs in the main loop.
+ *  \param event    Event number, 0 is the highest priority.
+ *  \param handler  Function called once the event is posted.
+ */
+void event_set_handler(uint32_t event, void (*handler)(void));
+
+/*! \brief Marks an event as pending. Safe to call from any interrupt
+ *         handler and from the main loop.
+ *  \param event  Event number.
+ */
+void event_post(uint32_t event);
+
+/*! \brief Checks if any event is waiting for its handler. */
+int event_pending(void);
+
+/*! \brief Runs the handler of the highest priority pending event.
+ *  \return True (1) if a handler ran, false (0) if nothing was pending.
+ */
+int event_dispatch(void);
+
+/*! \brief Dispatches events forever, sleeping while none are pending.
+ *         Runs the deferred software timers (timer_run_deferred()) too.
+ */
+void event_loop(void) __attribute__((noreturn));
+
+/*! \brief Copies the statistics of an event.
+ *  \param event  Event number.
+ *  \param stats  Where the statistics are stored.
+ */
+void event_get_stats(uint32_t event, EventStats *stats);
+
+#endif // EVENT_H
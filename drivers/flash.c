@@ -0,0 +1,78 @@
+#include "platform.h"
+#include "flash.h"
+
+#define FLASH_KEY1  0x45670123UL
+#define FLASH_KEY2  0xCDEF89ABUL
+#define FLASH_ERRORS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+
+static const uint32_t sector_kb[FLASH_SECTORS] = {16, 16, 16, 16, 64, 128, 128, 128};
+
+const uint32_t *flash_sector_start(uint32_t sector) {
+	uint32_t address = FLASH_BASE;
+
+	for (uint32_t i = 0; i < sector && i < FLASH_SECTORS; i++) {
+		address += sector_kb[i] * 1024;
+	}
+	return (const uint32_t *)(uintptr_t)address;
+}
+
+uint32_t flash_sector_size(uint32_t sector) {
+	return sector < FLASH_SECTORS ? sector_kb[sector] * 1024 : 0;
+}
+
+// Opens the control register and clears the flags of the last operation.
+static void flash_unlock(void) {
+	while (FLASH->SR & FLASH_SR_BSY) {
+	}
+	if (FLASH->CR & FLASH_CR_LOCK) {
+		FLASH->KEYR = FLASH_KEY1;
+		FLASH->KEYR = FLASH_KEY2;
+	}
+	FLASH->SR = FLASH_ERRORS | FLASH_SR_EOP;
+}
+
+static int flash_wait(void) {
+	while (FLASH->SR & FLASH_SR_BSY) {
+	}
+	return (FLASH->SR & FLASH_ERRORS) == 0;
+}
+
+int flash_erase_sector(uint32_t sector) {
+	int ok;
+
+	if (sector >= FLASH_SECTORS) {
+		return 0;
+	}
+	flash_unlock();
+	FLASH->CR = FLASH_CR_PSIZE_1 | FLASH_CR_SER | (sector << FLASH_CR_SNB_Pos);
+	FLASH->CR |= FLASH_CR_STRT;
+	ok = flash_wait();
+	FLASH->CR = FLASH_CR_LOCK;
+
+	// The data cache may still hold what the sector read before
+	if (FLASH->ACR & FLASH_ACR_DCEN) {
+		FLASH->ACR &= ~FLASH_ACR_DCEN;
+		FLASH->ACR |= FLASH_ACR_DCRST;
+		FLASH->ACR &= ~FLASH_ACR_DCRST;
+		FLASH->ACR |= FLASH_ACR_DCEN;
+	}
+	return ok;
+}
+
+int flash_program(const uint32_t *address, const uint32_t *words, uint32_t count) {
+	volatile uint32_t *word = (volatile uint32_t *)(uintptr_t)address;
+	int ok = 1;
+
+	if ((uintptr_t)address & 3) {
+		return 0;
+	}
+	flash_unlock();
+	FLASH->CR = FLASH_CR_PSIZE_1 | FLASH_CR_PG;
+	for (uint32_t i = 0; i < count && ok; i++) {
+		word[i] = words[i];
+		__DSB();
+		ok = flash_wait();
+	}
+	FLASH->CR = FLASH_CR_LOCK;
+	return ok;
+}
@@ -0,0 +1,52 @@
+/*!
+ * \file      flash.h
+ * \brief     Erasing and programming the STM32F411 internal flash.
+ *
+ * The 512 KB of flash are eight sectors: four of 16 KB, one of 64 KB
+ * and three of 128 KB. A sector is erased as a whole, to all ones, and
+ * a word can then be programmed once, which can only clear bits. The
+ * functions wait until the operation is over: there is a single bank,
+ * and the CPU stalls on any fetch from flash until then, interrupt
+ * handlers included. They assume a supply of 2.7 V or more, as on the
+ * Nucleo board, so words are programmed 32 bits at a time.
+ *
+ * Typical times (datasheet): 16 us a word, 250 ms to erase a 16 KB
+ * sector, 1 s for a 128 KB one.
+ */
+#ifndef FLASH_H
+#define FLASH_H
+#include <stdint.h>
+
+/*! Sectors of the flash. */
+#define FLASH_SECTORS 8
+
+/*! Value of an erased word. */
+#define FLASH_ERASED 0xFFFFFFFFUL
+
+/*! \brief First word of a sector, which may be read directly.
+ *  \param sector  Sector, 0 to FLASH_SECTORS - 1.
+ */
+const uint32_t *flash_sector_start(uint32_t sector);
+
+/*! \brief Size of a sector in bytes.
+ *  \param sector  Sector, 0 to FLASH_SECTORS - 1.
+ */
+uint32_t flash_sector_size(uint32_t sector);
+
+/*! \brief Erases a sector, which must not hold the program.
+ *  \param sector  Sector, 0 to FLASH_SECTORS - 1.
+ *  \return True (1) if successful, false (0) otherwise (bad sector,
+ *          write protection).
+ */
+int flash_erase_sector(uint32_t sector);
+
+/*! \brief Programs words, one at a time, in order.
+ *  \param address  First word to program, erased beforehand.
+ *  \param words    Values to program.
+ *  \param count    Number of words.
+ *  \return True (1) if successful, false (0) otherwise (alignment,
+ *          write protection).
+ */
+int flash_program(const uint32_t *address, const uint32_t *words, uint32_t count);
+
+#endif // FLASH_H
@@ -0,0 +1,276 @@
+#include "checksum.h"
+#include "flash.h"
+#include "flash_log.h"
+
+/*
+ * A sector of the log:
+ *
+ *   header   magic, sequence, erases, (erased)
+ *   slots    three words each: type | boot << 4 | detail << 16 | crc << 24,
+ *            time, value[0] | value[1] << 16
+ *
+ * The crc is the CRC-8 of the 12 bytes of the slot, taken with the crc
+ * byte zero; a record that fails it (a bit lost in the flash) is passed
+ * over. The first word of the header and of a record is programmed
+ * last, so neither counts until it is complete, and a record never has
+ * it erased since type 0xF is not allowed. The records of a sector are thus the
+ * slots before the first one whose first word is erased, which a binary
+ * search finds. A slot whose other words were programmed when the power
+ * failed is sealed with a first word of zero at the next boot, keeping
+ * the records after it in one run.
+ */
+
+#define MAGIC         0x32474C46UL // "FLG2"
+#define HEADER_WORDS  4
+#define RECORD_WORDS  3
+#define TYPE_VOID     0
+
+static uint32_t log_first, log_sectors;
+static uint32_t active;    // sector being written, from 0
+static uint32_t sequence;  // its sequence number, 0 before the first
+static uint32_t erases;    // times it has been erased
+static uint32_t position;  // its next free slot
+static uint32_t records, errors;
+static uint16_t boot;
+
+static uint32_t batch[FLASH_LOG_BATCH * RECORD_WORDS];
+static uint32_t batched;
+
+static const uint32_t *sector_words(uint32_t sector) {
+	return flash_sector_start(log_first + sector);
+}
+
+static uint32_t sector_slots(uint32_t sector) {
+	return (flash_sector_size(log_first + sector) / 4 - HEADER_WORDS) / RECORD_WORDS;
+}
+
+static const uint32_t *slot_words(uint32_t sector, uint32_t slot) {
+	return sector_words(sector) + HEADER_WORDS + slot * RECORD_WORDS;
+}
+
+static uint8_t record_crc(const uint32_t *words) {
+	uint32_t copy[RECORD_WORDS] = {words[0] & 0x00FFFFFFUL, words[1], words[2]};
+
+	return checksum_crc8(copy, sizeof(copy));
+}
+
+// A record, rather than an erased or sealed slot or a damaged record.
+static int record_valid(const uint32_t *words) {
+	return words[0] != FLASH_ERASED && (words[0] & 0xF) != TYPE_VOID && words[0] >> 24 == record_crc(words);
+}
+
+static int sector_valid(uint32_t sector) {
+	return sector_words(sector)[0] == MAGIC;
+}
+
+// Slots in use, including one cut short after the records.
+static uint32_t sector_end(uint32_t sector) {
+	uint32_t low = 0, high = sector_slots(sector);
+
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		if (slot_words(sector, middle)[0] != FLASH_ERASED) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if (low < sector_slots(sector) &&
+	    (slot_words(sector, low)[1] != FLASH_ERASED || slot_words(sector, low)[2] != FLASH_ERASED)) {
+		low++;
+	}
+	return low;
+}
+
+// Sector of the log, counting from the oldest.
+static uint32_t oldest_sector(uint32_t age) {
+	return (active + 1 + age) % log_sectors;
+}
+
+// Erases the sector after the active one and starts writing it.
+static int flash_log_rotate(void) {
+	uint32_t next = (active + 1) % log_sectors;
+	uint32_t dropped = 0;
+	uint32_t count = erases; // Unless it says, as often as the last one
+	uint32_t header[2];
+
+	if (sector_valid(next)) {
+		dropped = sector_end(next);
+		count = sector_words(next)[2];
+	}
+	if (!flash_erase_sector(log_first + next)) {
+		return 0;
+	}
+	records -= dropped;
+	header[0] = sequence + 1;
+	header[1] = count + 1;
+	if (!flash_program(sector_words(next) + 1, header, 2)) {
+		return 0;
+	}
+	header[0] = MAGIC;
+	if (!flash_program(sector_words(next), header, 1)) {
+		return 0;
+	}
+	active = next;
+	sequence++;
+	erases = count + 1;
+	position = 0;
+	return 1;
+}
+
+int flash_log_init(uint32_t first, uint32_t sectors) {
+	const uint32_t seal = TYPE_VOID;
+
+	if (sectors < 2 || first + sectors > FLASH_SECTORS) {
+		return 0;
+	}
+	log_first = first;
+	log_sectors = sectors;
+	active = sectors - 1; // So that a new log starts in the first sector
+	sequence = erases = 0;
+	records = errors = 0;
+	batched = 0;
+
+	// The newest sector has the highest sequence number
+	for (uint32_t sector = 0; sector < sectors; sector++) {
+		if (sector_valid(sector) && sector_words(sector)[1] > sequence) {
+			active = sector;
+			sequence = sector_words(sector)[1];
+			erases = sector_words(sector)[2];
+		}
+	}
+	if (sequence == 0) {
+		position = sector_slots(active); // Full, the first flush moves on
+	} else {
+		position = sector_end(active);
+		if (position > 0 && slot_words(active, position - 1)[0] == FLASH_ERASED) {
+			if (!flash_program(slot_words(active, position - 1), &seal, 1)) {
+				errors++;
+			}
+		}
+	}
+
+	// Count the records, and this boot after the one of the newest
+	boot = 0;
+	for (uint32_t age = 0; age < sectors; age++) {
+		uint32_t sector = oldest_sector(age);
+
+		if (sector_valid(sector)) {
+			uint32_t end = sector_end(sector);
+
+			records += end;
+			for (uint32_t slot = end; slot > 0; slot--) {
+				const uint32_t *words = slot_words(sector, slot - 1);
+				if (record_valid(words)) {
+					boot = (uint16_t)(words[0] >> 4 & 0xFFF);
+					break;
+				}
+			}
+		}
+	}
+	boot = (uint16_t)(boot % 0xFFF + 1);
+	return 1;
+}
+
+int flash_log_append(uint8_t type, uint8_t detail, uint32_t time, const int16_t *value) {
+	uint32_t *record = &batch[batched++ * RECORD_WORDS];
+
+	record[0] = (type & 0xFUL) | (uint32_t)boot << 4 | (uint32_t)detail << 16;
+	record[1] = time;
+	record[2] = (uint16_t)value[0] | (uint32_t)(uint16_t)value[1] << 16;
+	record[0] |= (uint32_t)record_crc(record) << 24;
+	if (batched == FLASH_LOG_BATCH) {
+		return flash_log_flush();
+	}
+	return 1;
+}
+
+int flash_log_flush(void) {
+	const uint32_t seal = TYPE_VOID;
+	int ok = log_sectors != 0;
+
+	for (uint32_t i = 0; i < batched && ok; i++) {
+		const uint32_t *record = &batch[i * RECORD_WORDS];
+
+		if (position == sector_slots(active)) {
+			ok = flash_log_rotate();
+		}
+		if (ok) {
+			const uint32_t *slot = slot_words(active, position++);
+
+			// The first word commits the record
+			ok = flash_program(slot + 1, record + 1, RECORD_WORDS - 1) && flash_program(slot, record, 1);
+			if (ok) {
+				records++;
+			} else {
+				flash_program(slot, &seal, 1);
+			}
+		}
+	}
+	if (!ok) {
+		errors++;
+	}
+	batched = 0;
+	return ok;
+}
+
+// Starts on the sector iterator->sector.
+static void flash_log_enter(FlashLogIterator *iterator) {
+	iterator->slot = 0;
+	iterator->end = 0;
+	if (iterator->sector < log_sectors && sector_valid(oldest_sector(iterator->sector))) {
+		iterator->end = sector_end(oldest_sector(iterator->sector));
+	}
+}
+
+void flash_log_iterate(FlashLogIterator *iterator, uint32_t skip) {
+	iterator->sector = 0;
+	flash_log_enter(iterator);
+	// Whole sectors are passed over without reading them
+	while (iterator->sector < log_sectors && skip >= iterator->end) {
+		skip -= iterator->end;
+		iterator->sector++;
+		flash_log_enter(iterator);
+	}
+	iterator->slot = skip;
+}
+
+int flash_log_next(FlashLogIterator *iterator, FlashLogRecord *record) {
+	while (iterator->sector < log_sectors) {
+		if (iterator->slot < iterator->end) {
+			const uint32_t *slot = slot_words(oldest_sector(iterator->sector), iterator->slot++);
+
+			if (record_valid(slot)) {
+				record->type = (uint8_t)(slot[0] & 0xF);
+				record->detail = (uint8_t)(slot[0] >> 16);
+				record->boot = (uint16_t)(slot[0] >> 4 & 0xFFF);
+				record->time = slot[1];
+				record->value[0] = (int16_t)slot[2];
+				record->value[1] = (int16_t)(slot[2] >> 16);
+				return 1;
+			}
+		} else {
+			iterator->sector++;
+			flash_log_enter(iterator);
+		}
+	}
+	return 0;
+}
+
+void flash_log_get_stats(FlashLogStats *stats) {
+	uint32_t largest = 0;
+
+	stats->records = records;
+	stats->capacity = 0;
+	for (uint32_t sector = 0; sector < log_sectors; sector++) {
+		stats->capacity += sector_slots(sector);
+		if (sector_slots(sector) > largest) {
+			largest = sector_slots(sector);
+		}
+	}
+	stats->capacity -= largest;
+	stats->sector = log_first + active;
+	stats->erases = erases;
+	stats->errors = errors;
+	stats->boot = boot;
+}
@@ -0,0 +1,99 @@
+/*!
+ * \file      flash_log.h
+ * \brief     Append-only log of records in internal flash sectors.
+ *
+ * The log keeps fixed size records in a few flash sectors that the
+ * program does not use, and survives resets and power cycles. Records
+ * are gathered in RAM and programmed a batch at a time, so the last
+ * FLASH_LOG_BATCH - 1 records are lost if the power fails first; call
+ * flash_log_flush() before a planned reset.
+ *
+ * The sectors are written in turn. When the one being written is full,
+ * the next is erased, dropping the oldest records, so every sector is
+ * erased equally often. Each sector starts with a header holding a
+ * sequence number, so flash_log_init() finds the newest sector from the
+ * headers alone, and the end of the records in it with a binary search.
+ * Every record carries a CRC-8, and one that fails it is not returned.
+ * Erasing a 128 KB sector stalls the CPU for about a second.
+ */
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+#include <stdint.h>
+
+/*! Records gathered in RAM before they are programmed. */
+#define FLASH_LOG_BATCH 8
+
+/*! Values carried by a record. */
+#define FLASH_LOG_VALUES 2
+
+/*! One record. Only type 0xF is reserved; type 0 marks the slot of a
+ *  record cut short by a power failure, which is never returned. */
+typedef struct {
+	uint8_t type;                    //!< Set by the user, 1 to 0xE.
+	uint8_t detail;                  //!< Set by the user.
+	uint16_t boot;                   //!< Boot the record was made in, 1 to 0xFFF and around.
+	uint32_t time;                   //!< Set by the user, seconds since the boot for example.
+	int16_t value[FLASH_LOG_VALUES]; //!< Set by the user.
+} FlashLogRecord;
+
+/*! Reads the records, oldest first. */
+typedef struct {
+	uint32_t sector;  //!< Sectors visited, from the oldest.
+	uint32_t slot;    //!< Next record in the sector.
+	uint32_t end;     //!< Records in the sector.
+} FlashLogIterator;
+
+/*! State of the log. */
+typedef struct {
+	uint32_t records;   //!< Records stored, not counting the ones in RAM.
+	uint32_t capacity;  //!< Records the sectors hold, less one sector.
+	uint32_t sector;    //!< Sector being written.
+	uint32_t erases;    //!< Times it has been erased.
+	uint32_t errors;    //!< Failed erases and programs since flash_log_init().
+	uint16_t boot;      //!< Number of this boot, 1 to 0xFFF and around.
+} FlashLogStats;
+
+/*! \brief Finds the newest records and counts this boot. Sectors that
+ *         hold no log are left alone until the log reaches them.
+ *  \param first    First sector of the log, after the program.
+ *  \param sectors  Number of sectors, at least 2.
+ *  \return True (1) if successful, false (0) otherwise (bad sectors).
+ */
+int flash_log_init(uint32_t first, uint32_t sectors);
+
+/*! \brief Adds a record, programming the batch once it is full. The
+ *         record is stamped with the number of this boot.
+ *  \param type    Kind of record, 1 to 0xE.
+ *  \param detail  Any value.
+ *  \param time    Any value, seconds since the boot for example.
+ *  \param value   FLASH_LOG_VALUES values.
+ *  \return True (1) if successful, false (0) otherwise (flash error).
+ */
+int flash_log_append(uint8_t type, uint8_t detail, uint32_t time, const int16_t *value);
+
+/*! \brief Programs the records gathered in RAM.
+ *  \return True (1) if successful, false (0) otherwise (flash error,
+ *          the records are dropped).
+ */
+int flash_log_flush(void);
+
+/*! \brief Positions an iterator before the oldest record.
+ *  \param iterator  Iterator to position.
+ *  \param skip      Records to pass over first.
+ */
+void flash_log_iterate(FlashLogIterator *iterator, uint32_t skip);
+
+/*! \brief Reads the next record. The log must not be flushed while it
+ *         is read.
+ *  \param iterator  Iterator to move.
+ *  \param record    Where the record is stored.
+ *  \return True (1) if there was a record, false (0) at the end.
+ */
+int flash_log_next(FlashLogIterator *iterator, FlashLogRecord *record);
+
+/*! \brief Copies the state of the log.
+ *  \param stats  Where the state is stored.
+ */
+void flash_log_get_stats(FlashLogStats *stats);
+
+#endif // FLASH_LOG_H
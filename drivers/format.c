@@ -0,0 +1,207 @@
+#include "format.h"
+#include "uart.h"
+
+/*
+ * One pass over the format string. A number is converted into a small
+ * array of digits, least significant first, and then sent with its sign,
+ * padding and decimal point, so nothing is built up in memory and the
+ * only arithmetic is a division by 10 or 16 per digit.
+ */
+
+typedef struct {
+	void (*put)(char c, void *context);
+	void *context;
+	uint32_t count;
+} FormatOutput;
+
+typedef struct {
+	char *buffer;
+	uint32_t size;
+	uint32_t length;
+} FormatBuffer;
+
+static void format_put(FormatOutput *out, char c) {
+	out->put(c, out->context);
+	out->count++;
+}
+
+static void format_pad(FormatOutput *out, char c, int count) {
+	while (count-- > 0) {
+		format_put(out, c);
+	}
+}
+
+static void format_number(FormatOutput *out, unsigned long magnitude, int negative, unsigned int base,
+                          int upper, int width, int decimals, int left, int zero) {
+	const char *symbols = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char digits[24];
+	int count = 0;
+	int length;
+
+	if (decimals > (int)sizeof(digits) - 2) {
+		decimals = sizeof(digits) - 2; // The digits and the 0 before the point
+	}
+	do {
+		digits[count++] = symbols[magnitude % base];
+		magnitude /= base;
+	} while (magnitude);
+	while (count <= decimals) {
+		digits[count++] = '0'; // "0.05" and not ".05"
+	}
+
+	length = count + negative + (decimals > 0);
+	if (!left && !zero) {
+		format_pad(out, ' ', width - length);
+	}
+	if (negative) {
+		format_put(out, '-');
+	}
+	if (!left && zero) {
+		format_pad(out, '0', width - length);
+	}
+	while (count > 0) {
+		if (count == decimals) {
+			format_put(out, '.');
+		}
+		format_put(out, digits[--count]);
+	}
+	if (left) {
+		format_pad(out, ' ', width - length);
+	}
+}
+
+uint32_t format_va(void (*put)(char c, void *context), void *context, const char *format, va_list arguments) {
+	FormatOutput out = {put, context, 0};
+
+	for (; *format; format++) {
+		int left = 0, zero = 0, is_long = 0;
+		int width = 0, precision = -1;
+
+		if (*format != '%') {
+			format_put(&out, *format);
+			continue;
+		}
+		format++;
+
+		for (;; format++) {
+			if (*format == '-') {
+				left = 1;
+			} else if (*format == '0') {
+				zero = 1;
+			} else {
+				break;
+			}
+		}
+		if (*format == '*') {
+			width = va_arg(arguments, int);
+			if (width < 0) {
+				left = 1;
+				width = -width;
+			}
+			format++;
+		} else {
+			while (*format >= '0' && *format <= '9') {
+				width = width * 10 + (*format++ - '0');
+			}
+		}
+		if (*format == '.') {
+			format++;
+			precision = 0;
+			if (*format == '*') {
+				precision = va_arg(arguments, int);
+				format++;
+			} else {
+				while (*format >= '0' && *format <= '9') {
+					precision = precision * 10 + (*format++ - '0');
+				}
+			}
+		}
+		if (*format == 'l') {
+			is_long = 1;
+			format++;
+		}
+
+		switch (*format) {
+			case 'd':
+			case 'i': {
+				long value = is_long ? va_arg(arguments, long) : va_arg(arguments, int);
+				unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+				format_number(&out, magnitude, value < 0, 10, 0, width, precision, left, zero);
+				break;
+			}
+			case 'u':
+			case 'x':
+			case 'X': {
+				unsigned long value = is_long ? va_arg(arguments, unsigned long) : va_arg(arguments, unsigned int);
+				format_number(&out, value, 0, *format == 'u' ? 10 : 16, *format == 'X', width,
+				              *format == 'u' ? precision : -1, left, zero);
+				break;
+			}
+			case 'c':
+				if (!left) format_pad(&out, ' ', width - 1);
+				format_put(&out, (char)va_arg(arguments, int));
+				if (left) format_pad(&out, ' ', width - 1);
+				break;
+			case 's': {
+				const char *text = va_arg(arguments, const char *);
+				int length = 0;
+
+				if (!text) text = "(null)";
+				while (text[length] && (precision < 0 || length < precision)) {
+					length++;
+				}
+				if (!left) format_pad(&out, ' ', width - length);
+				for (int i = 0; i < length; i++) {
+					format_put(&out, text[i]);
+				}
+				if (left) format_pad(&out, ' ', width - length);
+				break;
+			}
+			case '%':
+				format_put(&out, '%');
+				break;
+			case '\0':
+				return out.count; // A '%' ending the string
+			default:
+				format_put(&out, '%'); // Not understood, sent as it is
+				format_put(&out, *format);
+				break;
+		}
+	}
+	return out.count;
+}
+
+static void format_to_buffer(char c, void *context) {
+	FormatBuffer *buffer = (FormatBuffer *)context;
+
+	if (buffer->length + 1 < buffer->size) {
+		buffer->buffer[buffer->length++] = c;
+	}
+}
+
+static void format_to_uart(char c, void *context) {
+	uart_tx((uint8_t)c);
+}
+
+uint32_t format_string(char *buffer, uint32_t size, const char *format, ...) {
+	FormatBuffer out = {buffer, size, 0};
+	va_list arguments;
+
+	va_start(arguments, format);
+	format_va(format_to_buffer, &out, format, arguments);
+	va_end(arguments);
+	if (size > 0) {
+		buffer[out.length] = '\0';
+	}
+	return out.length;
+}
+
+uint32_t format_uart(const char *format, ...) {
+	va_list arguments;
+	uint32_t count;
+
+	va_start(arguments, format);
+	count = format_va(format_to_uart, 0, format, arguments);
+	va_end(arguments);
+	return count;
+}
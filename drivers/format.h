@@ -0,0 +1,55 @@
+/*!
+ * \file      format.h
+ * \brief     Small printf-style formatter with fixed-point output.
+ *
+ * Understands %d, %i, %u, %x, %X, %c, %s and %%, with the '-' and '0'
+ * flags, a field width and an 'l' length, and no floating point. The
+ * compiler checks the format strings by printf's rules: the conversions,
+ * and the number and types of the arguments, are the same. Only the
+ * meaning of the precision of a number is different, as below.
+ *
+ * The precision of %d, %i and %u does not set a number of digits as in
+ * printf: it places a decimal point that many digits from the right, so
+ * the argument is a fixed-point value. format_string(b, n, "%.1d", 234)
+ * gives "23.4" and "%.2d" of -5 gives "-0.05". A larger precision
+ * than 22 counts as 22. The precision of %s is the most characters
+ * printed, as in printf. Either may be given as '*'.
+ */
+#ifndef FORMAT_H
+#define FORMAT_H
+#include <stdarg.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) || defined(__clang__) || defined(__ARMCC_VERSION)
+#define FORMAT_CHECK(format_index, first_argument) \
+	__attribute__((format(printf, format_index, first_argument)))
+#else
+#define FORMAT_CHECK(format_index, first_argument)
+#endif
+
+/*! \brief Formats into a buffer. The output is cut to fit and always
+ *         null terminated.
+ *  \param buffer  Where the text is stored.
+ *  \param size    Size of the buffer, including the terminator.
+ *  \param format  Format string.
+ *  \return Length of the text stored, without the terminator.
+ */
+uint32_t format_string(char *buffer, uint32_t size, const char *format, ...) FORMAT_CHECK(3, 4);
+
+/*! \brief Formats straight into the UART transmit buffer, without an
+ *         intermediate copy.
+ *  \param format  Format string.
+ *  \return Number of characters queued.
+ */
+uint32_t format_uart(const char *format, ...) FORMAT_CHECK(1, 2);
+
+/*! \brief Formats into any output, one character at a time.
+ *  \param put        Called with every character produced.
+ *  \param context    Passed to put.
+ *  \param format     Format string.
+ *  \param arguments  The values to format.
+ *  \return Number of characters produced.
+ */
+uint32_t format_va(void (*put)(char c, void *context), void *context, const char *format, va_list arguments);
+
+#endif // FORMAT_H
@@ -4,41 +4,41 @@
 #include "uart.h"
 #include <stdio.h>
 
-uint32_t IRQ_status;
-uint32_t IRQ_port_num;
-uint32_t IRQ_pin_index;
-uint32_t EXTI_port_set;
-uint32_t prioritygroup;
-uint32_t priority;
-
-static void (*GPIO_callback)(int status);
+/*! What is called for an EXTI line. */
+typedef struct {
+	GpioHandler handler;
+	void *context;
+	void (*callback)(int status); // of gpio_set_callback()
+	GPIO_TypeDef *port;           // whose input is passed to the handler
+	TriggerMode trigger;
+} ExtiSlot;
+
+static ExtiSlot exti_slots[16];
+
+static const IRQn_Type exti_irqs[16] = {
+	EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn,
+	EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn,
+	EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn
+};
 
 void gpio_toggle(Pin pin) {
 	// Toggles a GPIO pin.
-	// In the absence of a pin toggle register, can be easily
-	// implemented with:
-	// gpio_set(pin, !gpio_get(pin));
+	// The level is taken from ODR, what the pin is driven to,
+	// rather than from IDR, which lags it and reads the line.
 	
-	gpio_set(pin, !gpio_get(pin));
+	gpio_pin_toggle(GPIO_PIN(pin));
 }
 
 void gpio_set(Pin pin, int value) {
 	// Sets the selected pin to the specified value.
 	
-	GPIO_TypeDef* p = GET_PORT(pin);
-	uint32_t pin_index = GET_PIN_INDEX(pin);
-	
-	MODIFY_REG(p->ODR,1UL<<pin_index,value<<pin_index);
+	gpio_pin_write(GPIO_PIN(pin), value);
 }
 
 int gpio_get(Pin pin) {
 	// Gets the current value of the specified pin.
 	
-	GPIO_TypeDef* p = GET_PORT(pin);
-	uint32_t pin_index = GET_PIN_INDEX(pin);
-	
-	return READ_BIT(p->IDR,(1<<pin_index));
-	
+	return gpio_pin_read(GPIO_PIN(pin));
 }
 
 void gpio_set_range(Pin pin_base, int count, int value) {
@@ -53,10 +53,9 @@ void gpio_set_range(Pin pin_base, int count, int value) {
 	// The mask for the value parameter should be:
 	// ((1 << count) - 1).
 	
-  GPIO_TypeDef* p = GET_PORT(pin_base);
 	uint32_t pin_index = GET_PIN_INDEX(pin_base);
 	
-	MODIFY_REG(p->ODR,((1UL<<count)-1)<<pin_index,value<<pin_index);
+	gpio_port_write(pin_base, ((1UL << count) - 1) << pin_index, (uint32_t)value << pin_index);
 }
 
 unsigned int gpio_get_range(Pin pin_base, int count) {
@@ -74,10 +73,29 @@ unsigned int gpio_get_range(Pin pin_base, int count) {
 	
 	// The mask for the value parameter should be:
 	// ((1 << count) - 1).
-	GPIO_TypeDef* p = GET_PORT(pin_base);
 	uint32_t pin_index = GET_PIN_INDEX(pin_base);
 	
-	return READ_BIT(p->IDR,(((1 << count) - 1)<<pin_index))>>pin_index;
+	return gpio_port_read(pin_base, ((1UL << count) - 1) << pin_index) >> pin_index;
+}
+
+// BSRR: the low half sets pins, the high half clears them, and a
+// store only changes the pins with a 1 in it.
+
+void gpio_port_set(Pin port, uint32_t mask) {
+	GET_PORT(port)->BSRR = mask & 0xFFFF;
+}
+
+void gpio_port_clear(Pin port, uint32_t mask) {
+	GET_PORT(port)->BSRR = (mask & 0xFFFF) << 16;
+}
+
+void gpio_port_write(Pin port, uint32_t mask, uint32_t value) {
+	mask &= 0xFFFF;
+	GET_PORT(port)->BSRR = (value & mask) | ((~value & mask) << 16);
+}
+
+uint32_t gpio_port_read(Pin port, uint32_t mask) {
+	return GET_PORT(port)->IDR & mask;
 }
 
 void gpio_set_mode(Pin pin, PinMode mode) {
@@ -140,220 +158,108 @@ void gpio_set_trigger(Pin pin, TriggerMode trig) {
 	//             high.
 	//  - Falling: Trigger on transition from logic high to
 	//             low.
+	//  - Both:    Trigger on either transition.
 	
 	uint32_t pin_index = GET_PIN_INDEX(pin);
-	
-	switch(trig){
-		case None:
-			EXTI->IMR &= ~(1<<pin_index);
-		break;
-		case Rising:
-			EXTI->IMR |= (1<<pin_index);
-			EXTI->RTSR|= (1<<pin_index);
-		break;
-		case Falling:
-			EXTI->IMR |= (1<<pin_index);
-			EXTI->FTSR|= (1<<pin_index);
-			EXTI->PR 	&= (0<<pin_index);
-		break;
+	uint32_t mask = 1UL << pin_index;
+	
+	exti_slots[pin_index].trigger = trig;
+	// Masked while it changes; an edge from before is dropped
+	EXTI->IMR &= ~mask;
+	MODIFY_REG(EXTI->RTSR, mask, (trig == Rising || trig == Both) ? mask : 0);
+	MODIFY_REG(EXTI->FTSR, mask, (trig == Falling || trig == Both) ? mask : 0);
+	EXTI->PR = mask;
+	if (trig != None) {
+		EXTI->IMR |= mask;
 	}
 }
 
-void gpio_set_callback(Pin pin, void (*callback)(int status)) {
-	// Set up and enable the interrupt on the passed pin's
-	// port.
+void gpio_set_handler(Pin pin, GpioHandler handler, void *context) {
+	uint32_t pin_index = GET_PIN_INDEX(pin);
+	uint32_t shift = (pin_index % 4) * 4;
+	ExtiSlot *slot = &exti_slots[pin_index];
+	IRQn_Type irq = exti_irqs[pin_index];
+	uint32_t primask = __get_PRIMASK();
+	
+	// A line pending on a shared vector may be taken between the stores:
+	// the handler goes last, once what it needs is in place
+	__disable_irq();
+	slot->port = GET_PORT(pin);
+	slot->context = context;
+	slot->handler = handler;
+	__set_PRIMASK(primask);
 	
-	// The callback function should be stored in an internal
-	// static function pointer.
+	//Connect the pin to external interrupt line
+	RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+	MODIFY_REG(SYSCFG->EXTICR[pin_index / 4], 0xFUL << shift, (uint32_t)GET_PORT_INDEX(pin) << shift);
 	
-	// When the port ISR is fired, the callback function
-	// should be executed. The status parameter should equal
-	// a mask of which pin triggered the interrupt, for
-	// example if a callback is set on pin P1_2 (port 1, pin
-	// 2) and the interrupt is triggered on port 1, the
-	// function callback should be called with argument
-	// status equalling 0b00000100.
-	// This allows the user to determine the interrupt source
-	// with (status & GET_PIN_INDEX(P1_2)).
-	__enable_irq();
-  IRQ_status = 0;
-	IRQ_port_num = GET_PORT_INDEX(pin);
-	IRQ_pin_index = GET_PIN_INDEX(pin);
-	EXTI_port_set = IRQ_port_num<<(IRQ_pin_index % 4) * 4;
+	// All the lines are at one priority, so none delays another more
+	// than its handler takes
+	NVIC_SetPriority(irq, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 1, 1)); // Pri=1 , SubPri=1
+	NVIC_EnableIRQ(irq);
+}
+
+// The handler of gpio_set_callback(): only an input at the level the
+// edge left it at is passed on.
+static void callback_handler(void *context, int level) {
+	ExtiSlot *slot = context;
 	
-	GPIO_callback = callback;
-	//Connect the pin to external interrupt line
-	switch(IRQ_pin_index){
-		case 0:
-			SYSCFG->EXTICR[0]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI0_IRQn, priority);
-		  NVIC_EnableIRQ(EXTI0_IRQn);		
-		break;
-
-		case 1:
-			SYSCFG->EXTICR[0]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI1_IRQn, priority);
-		  NVIC_EnableIRQ(EXTI1_IRQn);
-		break;
-		
-    case 2:
-			SYSCFG->EXTICR[0]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI2_IRQn, priority);
-		  NVIC_EnableIRQ(EXTI2_IRQn);
-		break;
-		
-		case 3:
-			SYSCFG->EXTICR[0]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI3_IRQn, priority);
-		  NVIC_EnableIRQ(EXTI3_IRQn);
-		break;
-		
-		case 4:
-			SYSCFG->EXTICR[1]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI4_IRQn, priority);
-		  NVIC_EnableIRQ(EXTI4_IRQn);
-		break;
-		
-		case 5:
-    case 6:
-		case 7:
-			SYSCFG->EXTICR[1]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI9_5_IRQn, priority);
-		  NVIC_EnableIRQ(EXTI9_5_IRQn);
-		break;
-		
-		case 8:
-		case 9:
-			SYSCFG->EXTICR[2]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI9_5_IRQn,3);
-		  NVIC_EnableIRQ(EXTI9_5_IRQn);
-		break;
-			
-		case 10:
-		case 11:
-			SYSCFG->EXTICR[2]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI15_10_IRQn,3);
-		  NVIC_EnableIRQ(EXTI15_10_IRQn);
-		break;
-		
-		case 12:
-		case 13:
-    case 14:
-		case 15:
-			SYSCFG->EXTICR[3]|= EXTI_port_set;
-			prioritygroup = NVIC_GetPriorityGrouping(); // will return 5
-			priority = NVIC_EncodePriority(prioritygroup, 1, 1 ); // Pri=1 , SubPri=1
-			NVIC_SetPriority(EXTI15_10_IRQn,0);
-		  NVIC_EnableIRQ(EXTI15_10_IRQn);
-		break;
+	if (slot->trigger == Both || level == (slot->trigger == Rising)) {
+		slot->callback(1 << (slot - exti_slots));
 	}
 }
 
-//Note: only four interrupt lines are implemented i.e. only use pin 0-4
-void EXTI0_IRQHandler(void){
+void gpio_set_callback(Pin pin, void (*callback)(int status)) {
+	ExtiSlot *slot = &exti_slots[GET_PIN_INDEX(pin)];
 	
-	GPIO_TypeDef* p = ((GPIO_TypeDef*)(AHB1PERIPH_BASE + 0x0400 * IRQ_port_num));
-	IRQ_status = EXTI->PR>>IRQ_pin_index & 1;		
-	NVIC_ClearPendingIRQ(EXTI0_IRQn);
-	EXTI->PR|=(1<<IRQ_pin_index);
+	slot->callback = callback;
+	gpio_set_handler(pin, callback_handler, slot);
+}
+
+// Calls the handler of every pending line in \a lines, highest first.
+// The lines are cleared before the handlers run, so that an edge during
+// one of them raises the interrupt again.
+static void exti_dispatch(uint32_t lines) {
+	uint32_t pending = EXTI->PR & lines;
 	
-	if(p->IDR&(1<<IRQ_pin_index)){
-		GPIO_callback(IRQ_pin_index);
+	EXTI->PR = pending; // Write one to clear
+	while (pending) {
+		uint32_t line = 31 - __CLZ(pending);
+		const ExtiSlot *slot = &exti_slots[line];
+		
+		pending ^= 1UL << line;
+		if (slot->handler) {
+			slot->handler(slot->context, (slot->port->IDR >> line) & 1);
+		}
 	}
 }
 
+void EXTI0_IRQHandler(void){
+	exti_dispatch(EXTI_PR_PR0);
+}
+
 void EXTI1_IRQHandler(void){
-	
-	GPIO_TypeDef* p = ((GPIO_TypeDef*)(AHB1PERIPH_BASE + 0x0400 * IRQ_port_num));
-	IRQ_status = EXTI->PR>>IRQ_pin_index & 1;	
-	NVIC_ClearPendingIRQ(EXTI1_IRQn);
-	EXTI->PR|=(1<<IRQ_pin_index);
-	
-	if(p->IDR&(1<<IRQ_pin_index)){
-		GPIO_callback(IRQ_pin_index);
-	}
-	
+	exti_dispatch(EXTI_PR_PR1);
 }
 
 void EXTI2_IRQHandler(void){
-	
-	GPIO_TypeDef* p = ((GPIO_TypeDef*)(AHB1PERIPH_BASE + 0x0400 * IRQ_port_num));
-	IRQ_status = EXTI->PR>>IRQ_pin_index & 1;	
-	NVIC_ClearPendingIRQ(EXTI2_IRQn);
-	EXTI->PR|=(1<<IRQ_pin_index);
-	
-	if(p->IDR&(1<<IRQ_pin_index)){
-		GPIO_callback(IRQ_pin_index);
-	}
-	
+	exti_dispatch(EXTI_PR_PR2);
 }
 
 void EXTI3_IRQHandler(void){
-	
-	GPIO_TypeDef* p = ((GPIO_TypeDef*)(AHB1PERIPH_BASE + 0x0400 * IRQ_port_num));
-	IRQ_status = EXTI->PR>>IRQ_pin_index & 1;	
-	NVIC_ClearPendingIRQ(EXTI3_IRQn);
-	EXTI->PR|=(1<<IRQ_pin_index);
-	
-	if(p->IDR&(1<<IRQ_pin_index)){
-		GPIO_callback(IRQ_pin_index);
-	}
-	
+	exti_dispatch(EXTI_PR_PR3);
 }
 
 void EXTI4_IRQHandler(void){
-	
-	GPIO_TypeDef* p = ((GPIO_TypeDef*)(AHB1PERIPH_BASE + 0x0400 * IRQ_port_num));
-	IRQ_status = EXTI->PR>>IRQ_pin_index & 1;
-	NVIC_ClearPendingIRQ(EXTI4_IRQn);
-	EXTI->PR|=(1<<IRQ_pin_index);
-	
-	if(p->IDR&(1<<IRQ_pin_index)){
-		GPIO_callback(IRQ_pin_index);
-	}
+	exti_dispatch(EXTI_PR_PR4);
 }
 
 void EXTI9_5_IRQHandler(void){
-	
-	GPIO_TypeDef* p = ((GPIO_TypeDef*)(AHB1PERIPH_BASE + 0x0400 * IRQ_port_num));
-	IRQ_status = (EXTI->PR>>IRQ_pin_index) & 1;
-	NVIC_ClearPendingIRQ(EXTI9_5_IRQn);
-	EXTI->PR|=(1<<IRQ_pin_index);
-	
-	if(p->IDR&(1<<IRQ_pin_index)){
-		GPIO_callback(IRQ_pin_index);
-	}
+	exti_dispatch(0x03E0); // Lines 5 to 9
 }
 
 void EXTI15_10_IRQHandler(void){
-	
-	GPIO_TypeDef* p = ((GPIO_TypeDef*)(AHB1PERIPH_BASE + 0x0400 * IRQ_port_num));
-	IRQ_status = (EXTI->PR>>IRQ_pin_index) & 1;
-	NVIC_ClearPendingIRQ(EXTI15_10_IRQn);
-	EXTI->PR|=(1<<IRQ_pin_index);
-	
-	GPIO_callback(IRQ_pin_index); // No check is needed, since we are using a Falling Edge trigger...
-	
-	// if(!(p->IDR&(1<<IRQ_pin_index))){
-	// 	GPIO_callback(IRQ_pin_index);
-	// }
-	
+	exti_dispatch(0xFC00); // Lines 10 to 15
 }
 
 // ****************** DHT11 *********************** //
@@ -396,19 +302,22 @@ DHT11_StatusTypeDef DHT11_ReadData(DHT11_InitTypeDef *DHT11) {
 	// sprintf(temp, "%d\r\n", DHT11->_Pin);
 	// uart_print(temp);
 	
+	GpioPin line = GPIO_PIN(DHT11->_Pin);
+	
+	// Low before it is an output, so the line has no glitch high
+	gpio_pin_low(line);
 	gpio_set_mode(DHT11->_Pin, Output);
 	// PULLING the Line to Low and waits for 20ms
-	gpio_set(DHT11->_Pin, 0);
 	delay_ms(20);
 	// PULLING the Line to HIGH and waits for 40us
-	gpio_set(DHT11->_Pin, 1);
+	gpio_pin_high(line);
 	delay_us(40);
 
 	// __disable_irq();
 	gpio_set_mode(DHT11->_Pin, Input);
 
 	// If the Line is still HIGH, that means DHT11 is not responding
-	if(gpio_get(DHT11->_Pin)) {
+	if(gpio_pin_read(line)) {
 		// __enable_irq();
 		return DHT11_ERROR;
 	}
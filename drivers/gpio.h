@@ -28,14 +28,21 @@ typedef enum {
 
 /*! Defines the triggering mode of an interrupt. */
 typedef enum {
-	None,   //!< Disables the interrupt.
-	Rising, //!< Enables an interrupt on the falling edge.
-	Falling //!< Enables an interrupt on the rising edge.
+	None,    //!< Disables the interrupt.
+	Rising,  //!< Enables an interrupt on the rising edge.
+	Falling, //!< Enables an interrupt on the falling edge.
+	Both     //!< Enables an interrupt on both edges.
 } TriggerMode;
 
+/*! \brief Handles the interrupt of a pin.
+ *  \param context  As passed to gpio_set_handler().
+ *  \param level    The pin's input when the interrupt was taken (0 or 1).
+ */
+typedef void (*GpioHandler)(void *context, int level);
+
 /*! \brief Toggles a GPIO pin's output.
- *  A pin which is currently high is set low
- *  and a pin which is currently low is set high.
+ *  A pin which is currently driven high is set low
+ *  and a pin which is currently driven low is set high.
  *  \param pin   Pin to toggle.
  */
 void gpio_toggle(Pin pin);
@@ -68,6 +75,76 @@ void gpio_set_range(Pin pin_base, int count, int value);
  */
 unsigned int gpio_get_range(Pin pin_base, int count);
 
+/*! \brief Sets the pins of \a mask on a port high.
+ *  One store to BSRR: the other pins are not touched, so an interrupt
+ *  that drives them in between loses nothing.
+ *  \param port  Any pin of the port.
+ *  \param mask  Pins to set, bit n for pin n.
+ */
+void gpio_port_set(Pin port, uint32_t mask);
+
+/*! \brief Sets the pins of \a mask on a port low, as gpio_port_set().
+ *  \param port  Any pin of the port.
+ *  \param mask  Pins to clear, bit n for pin n.
+ */
+void gpio_port_clear(Pin port, uint32_t mask);
+
+/*! \brief Sets the pins of \a mask on a port to their bits in \a value,
+ *         in one store as gpio_port_set().
+ *  \param port   Any pin of the port.
+ *  \param mask   Pins to write, bit n for pin n.
+ *  \param value  Their new levels.
+ */
+void gpio_port_write(Pin port, uint32_t mask, uint32_t value);
+
+/*! \brief Reads the pins of \a mask on a port.
+ *  \param port  Any pin of the port.
+ *  \param mask  Pins to read, bit n for pin n.
+ *  \return Their levels, in place; the other bits are 0.
+ */
+uint32_t gpio_port_read(Pin port, uint32_t mask);
+
+/*! A pin as its port's registers and its mask, for the gpio_pin_
+ *  functions below. Made with GPIO_PIN() from a constant Pin it is a
+ *  constant too, and each of them compiles to a single load or store.
+ */
+typedef struct {
+	GPIO_TypeDef *port;
+	uint32_t mask;
+} GpioPin;
+
+/*! The GpioPin of \a pin. */
+#define GPIO_PIN(pin) ((GpioPin){GET_PORT(pin), 1UL << GET_PIN_INDEX(pin)})
+
+/*! \brief Sets a pin high, in one store to BSRR. */
+__STATIC_INLINE void gpio_pin_high(GpioPin pin) {
+	pin.port->BSRR = pin.mask;
+}
+
+/*! \brief Sets a pin low, in one store to BSRR. */
+__STATIC_INLINE void gpio_pin_low(GpioPin pin) {
+	pin.port->BSRR = pin.mask << 16;
+}
+
+/*! \brief Sets a pin to \a value (0 is low, otherwise high). */
+__STATIC_INLINE void gpio_pin_write(GpioPin pin, int value) {
+	pin.port->BSRR = value ? pin.mask : pin.mask << 16;
+}
+
+/*! \brief Reads a pin's input: 0 if low, 1 if high. */
+__STATIC_INLINE int gpio_pin_read(GpioPin pin) {
+	return (pin.port->IDR & pin.mask) != 0;
+}
+
+/*! \brief Toggles a pin's output, as ODR holds it.
+ *  The store is atomic against the other pins of the port, not against
+ *  an interrupt that writes this one between the load and the store.
+ */
+__STATIC_INLINE void gpio_pin_toggle(GpioPin pin) {
+	uint32_t odr = pin.port->ODR;
+	pin.port->BSRR = ((odr & pin.mask) << 16) | (~odr & pin.mask);
+}
+
 /*! \brief Configures the output mode of a GPIO pin.
  *
  *  Used to set the GPIO as an input, output, and configure the
@@ -86,17 +163,34 @@ void gpio_set_mode(Pin pin, PinMode mode);
  */
 void gpio_set_trigger(Pin pin, TriggerMode trig);
 
+/*! \brief Sets the handler of a pin's interrupt.
+ *
+ *  Each of the 16 EXTI lines has its own handler, so pins with
+ *  different numbers can be used at once; a line belongs to one
+ *  port at a time, so PA_1 and PB_1 cannot. The line is connected
+ *  to the pin's port and its NVIC vector enabled. Lines 5 to 9 and
+ *  10 to 15 share a vector, which calls the handler of every line
+ *  that is pending, highest first.
+ *
+ *  \sa gpio_set_trigger to configure and enable the interrupt.
+ *
+ *  \param pin      Pin to handle.
+ *  \param handler  Called in the interrupt, or 0 to ignore it.
+ *  \param context  Passed to the handler.
+ */
+void gpio_set_handler(Pin pin, GpioHandler handler, void *context);
+
 /*! \brief Passes a callback function to the api which is called
- *         during the port's relevant interrupt.
+ *         during the pin's interrupt.
  *
- *  \warning The pin argument specifies the port which will be
- *           interrupted on, not an individual pin. It is advised
- *           check the \a status variable to determine which pin
- *           caused the interrupt.
+ *  As gpio_set_handler(), but the callback is only called when the
+ *  pin reads at the level the edge left it at (high for a Rising
+ *  trigger, low for Falling), which drops most glitches. \a status
+ *  is the mask of the pin, 1 << GET_PIN_INDEX(pin).
  *
  *  \sa gpio_set_trigger to configure and enable the interrupt.
  *
- *  \param pin       Pin which specifies the port to use.
+ *  \param pin       Pin to handle.
  *  \param callback  Callback function.
  */
 void gpio_set_callback(Pin pin, void (*callback)(int status));
@@ -0,0 +1,233 @@
+#include "history.h"
+
+/*
+ * Records, after the oldest sample which is kept decoded:
+ *
+ *   00nnnnnn                n samples, each the last one again after
+ *                           the current interval
+ *   01aaabbb                one sample, the current interval later,
+ *                           values changed by zigzag a and b (-4..3)
+ *   10000000 A.. B..        one sample, the current interval later,
+ *                           values changed by varints A and B
+ *   11000000 tl th A.. B..  one sample, tl + 256 th seconds later,
+ *                           which becomes the current interval
+ *
+ * Varints are zigzag coded, 7 bits a byte, low bits first. Records may
+ * wrap around the end of the buffer.
+ */
+
+#define RECORD_KIND    0xC0
+#define RECORD_REPEAT  0x00
+#define RECORD_SMALL   0x40
+#define RECORD_DELTA   0x80
+#define RECORD_TIME    0xC0
+#define MAX_REPEAT     0x3F
+#define MAX_RECORD     (1 + 2 + 3 * HISTORY_CHANNELS)
+
+#if HISTORY_CHANNELS != 2
+#error "The one byte record holds two values"
+#endif
+
+typedef struct {
+	uint32_t samples;
+	uint16_t period;
+	int32_t step[HISTORY_CHANNELS];
+} Record;
+
+static uint32_t zigzag(int32_t value) {
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint32_t put_varint(uint8_t *out, uint32_t value) {
+	uint32_t length = 0;
+
+	while (value >= 0x80) {
+		out[length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	out[length++] = (uint8_t)value;
+	return length;
+}
+
+static uint8_t get_byte(const History *history, uint32_t *position) {
+	return history->data[(*position)++ & history->mask];
+}
+
+static uint32_t get_varint(const History *history, uint32_t *position) {
+	uint32_t value = 0;
+	uint32_t shift = 0;
+	uint8_t byte;
+
+	do {
+		byte = get_byte(history, position);
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+	return value;
+}
+
+// Decodes the record at *position and moves past it. period is the
+// interval in effect before it.
+static void get_record(const History *history, uint32_t *position, uint16_t period, Record *record) {
+	uint8_t header = get_byte(history, position);
+
+	record->samples = 1;
+	record->period = period;
+	for (int i = 0; i < HISTORY_CHANNELS; i++) {
+		record->step[i] = 0;
+	}
+	switch (header & RECORD_KIND) {
+		case RECORD_REPEAT:
+			record->samples = header & MAX_REPEAT;
+			break;
+		case RECORD_SMALL:
+			record->step[0] = unzigzag((header >> 3) & 7);
+			record->step[1] = unzigzag(header & 7);
+			break;
+		case RECORD_TIME:
+			record->period = get_byte(history, position);
+			record->period |= (uint16_t)(get_byte(history, position) << 8);
+			// fall through
+		case RECORD_DELTA:
+			for (int i = 0; i < HISTORY_CHANNELS; i++) {
+				record->step[i] = unzigzag(get_varint(history, position));
+			}
+			break;
+	}
+}
+
+// Folds the oldest record into the oldest sample.
+static void history_drop(History *history) {
+	Record record;
+
+	get_record(history, &history->head, history->oldest_period, &record);
+	history->oldest.time += record.samples * record.period;
+	for (int i = 0; i < HISTORY_CHANNELS; i++) {
+		history->oldest.value[i] = (int16_t)(history->oldest.value[i] + record.step[i]);
+	}
+	history->oldest_period = record.period;
+	history->count -= record.samples;
+}
+
+int history_init(History *history, uint8_t *storage, uint32_t size) {
+	if (size < 16 || (size & (size - 1))) {
+		return 0;
+	}
+	history->data = storage;
+	history->mask = size - 1;
+	history->head = history->tail = history->last = 0;
+	history->count = 0;
+	history->period = history->oldest_period = 0;
+	return 1;
+}
+
+void history_append(History *history, uint32_t time, const int16_t *value) {
+	HistorySample sample;
+	uint8_t record[MAX_RECORD];
+	uint32_t length = 0;
+	uint32_t interval;
+	int32_t step[HISTORY_CHANNELS];
+	int same = 1, small = 1;
+
+	sample.time = time;
+	for (int i = 0; i < HISTORY_CHANNELS; i++) {
+		sample.value[i] = value[i];
+	}
+	if (history->count == 0) {
+		history->oldest = history->newest = sample;
+		history->oldest_period = history->period = 0;
+		history->count = 1;
+		return;
+	}
+
+	interval = time - history->newest.time;
+	if (interval > 0xFFFF) {
+		interval = 0xFFFF;
+		sample.time = history->newest.time + interval; // As it decodes
+	}
+	for (int i = 0; i < HISTORY_CHANNELS; i++) {
+		step[i] = (int32_t)value[i] - history->newest.value[i];
+		same &= step[i] == 0;
+		small &= zigzag(step[i]) < 8;
+	}
+
+	if (interval == history->period && same && history->tail != history->head &&
+	    (history->data[history->last & history->mask] & RECORD_KIND) == RECORD_REPEAT &&
+	    (history->data[history->last & history->mask] & MAX_REPEAT) < MAX_REPEAT) {
+		history->data[history->last & history->mask]++; // One more of the same
+	} else {
+		if (interval == history->period && same) {
+			record[length++] = RECORD_REPEAT | 1;
+		} else if (interval == history->period && small) {
+			record[length++] = (uint8_t)(RECORD_SMALL | zigzag(step[0]) << 3 | zigzag(step[1]));
+		} else {
+			if (interval == history->period) {
+				record[length++] = RECORD_DELTA;
+			} else {
+				record[length++] = RECORD_TIME;
+				record[length++] = (uint8_t)interval;
+				record[length++] = (uint8_t)(interval >> 8);
+			}
+			for (int i = 0; i < HISTORY_CHANNELS; i++) {
+				length += put_varint(&record[length], zigzag(step[i]));
+			}
+		}
+
+		// Make room, a record at most MAX_RECORD bytes at a time
+		while (history->mask + 1 - (history->tail - history->head) < length) {
+			history_drop(history);
+		}
+		history->last = history->tail;
+		for (uint32_t i = 0; i < length; i++) {
+			history->data[history->tail++ & history->mask] = record[i];
+		}
+	}
+
+	history->newest = sample;
+	history->period = (uint16_t)interval;
+	history->count++;
+}
+
+uint32_t history_bytes(const History *history) {
+	return history->tail - history->head;
+}
+
+void history_iterate(const History *history, HistoryIterator *iterator, uint32_t skip) {
+	iterator->position = history->head;
+	iterator->remaining = history->count;
+	iterator->run = 0;
+	iterator->period = history->oldest_period;
+	while (skip-- > 0 && history_next(history, iterator)) {
+	}
+}
+
+int history_next(const History *history, HistoryIterator *iterator) {
+	if (iterator->remaining == 0) {
+		return 0;
+	}
+	if (iterator->remaining == history->count) {
+		iterator->sample = history->oldest;
+	} else {
+		if (iterator->run == 0) {
+			Record record;
+
+			get_record(history, &iterator->position, iterator->period, &record);
+			iterator->run = record.samples;
+			iterator->period = record.period;
+			for (int i = 0; i < HISTORY_CHANNELS; i++) {
+				iterator->step[i] = (int16_t)record.step[i];
+			}
+		}
+		iterator->sample.time += iterator->period;
+		for (int i = 0; i < HISTORY_CHANNELS; i++) {
+			iterator->sample.value[i] = (int16_t)(iterator->sample.value[i] + iterator->step[i]);
+		}
+		iterator->run--;
+	}
+	iterator->remaining--;
+	return 1;
+}
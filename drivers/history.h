@@ -0,0 +1,94 @@
+/*!
+ * \file      history.h
+ * \brief     Compressed store of past sensor readings.
+ *
+ * A sample is a time in seconds and two values, such as a temperature
+ * in tenths of a degree and a humidity. Each sample is stored as the
+ * difference from the one before, in a circular byte buffer supplied by
+ * the user. When the buffer is full, the oldest samples are dropped.
+ *
+ * A sample that repeats the last one, after the same interval, usually
+ * costs nothing: it adds to the count of a repeat record, up to 63
+ * samples per byte. A change of -4..+3 in both values costs one byte,
+ * any other change three to seven, and a new interval two more.
+ * Samples are read back oldest first with an iterator, which decodes
+ * them one at a time.
+ */
+#ifndef HISTORY_H
+#define HISTORY_H
+#include <stdint.h>
+
+/*! Values recorded per sample. */
+#define HISTORY_CHANNELS 2
+
+/*! One reading. */
+typedef struct {
+	uint32_t time;                    //!< Seconds, from any origin.
+	int16_t value[HISTORY_CHANNELS];  //!< The recorded values.
+} HistorySample;
+
+/*! The store. It should not be modified directly, only through the
+ *  functions below. The counters may be read at any time.
+ */
+typedef struct {
+	uint8_t *data;         //!< Encoded samples, supplied by the user.
+	uint32_t mask;         //!< Size of the data array minus one.
+	uint32_t head;         //!< Free running index of the oldest record.
+	uint32_t tail;         //!< Free running index after the newest record.
+	uint32_t last;         //!< Index of the newest record.
+	uint32_t count;        //!< Samples held.
+	HistorySample oldest;  //!< The oldest sample, the records follow it.
+	uint16_t oldest_period; //!< Interval in effect at the oldest record.
+	HistorySample newest;  //!< The newest sample.
+	uint16_t period;       //!< Interval between the two newest samples.
+} History;
+
+/*! Reads the samples of a History, oldest first. */
+typedef struct {
+	HistorySample sample;  //!< The sample history_next() moved to.
+	uint32_t position;     //!< Next record to decode.
+	uint32_t remaining;    //!< Samples not yet visited.
+	uint32_t run;          //!< Samples left in the current record.
+	uint16_t period;       //!< Interval of the current record.
+	int16_t step[HISTORY_CHANNELS]; //!< Change per sample of the current record.
+} HistoryIterator;
+
+/*! \brief Initialises the store to use the supplied storage.
+ *  \param history  Store to operate on.
+ *  \param storage  Array holding the encoded samples, usually static.
+ *  \param size     Size of the array, a power of two, at least 16.
+ *  \return True (1) if successful, false (0) otherwise (bad size).
+ */
+int history_init(History *history, uint8_t *storage, uint32_t size);
+
+/*! \brief Adds a sample, dropping the oldest ones if needed. Takes
+ *         constant time.
+ *  \param history  Store to operate on.
+ *  \param time     Time of the sample, in seconds. Intervals over 18
+ *                  hours are recorded as 18 hours.
+ *  \param value    HISTORY_CHANNELS values.
+ */
+void history_append(History *history, uint32_t time, const int16_t *value);
+
+/*! \brief Bytes of storage in use.
+ *  \param history  Store to operate on.
+ */
+uint32_t history_bytes(const History *history);
+
+/*! \brief Positions an iterator before the oldest sample.
+ *  \param history   Store to read.
+ *  \param iterator  Iterator to position.
+ *  \param skip      Samples to pass over first, so that history_next()
+ *                   starts further on.
+ */
+void history_iterate(const History *history, HistoryIterator *iterator, uint32_t skip);
+
+/*! \brief Moves an iterator to the next sample, in iterator->sample.
+ *  The store must not be appended to while it is read.
+ *  \param history   Store being read.
+ *  \param iterator  Iterator to move.
+ *  \return True (1) if there was a sample, false (0) at the end.
+ */
+int history_next(const History *history, HistoryIterator *iterator);
+
+#endif // HISTORY_H
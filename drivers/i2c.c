@@ -1,91 +1,377 @@
 #include "platform.h"
+#include "i2c.h"
+#include "delay.h"
+#include "timer.h"
 #include "stm32f4xx_i2c.h"
 #include "STM32F4xx_RCC.h"
 #include "STM32F4xx_I2C.h"
 #include "STM32F4xx_GPIO.h"
 
-void i2c_init() {
+/*
+ * The transfer at the head of the queue is on the bus; the others wait.
+ * The event and error interrupts and the DMA interrupt share a priority,
+ * so they never preempt each other and own the engine. They are above
+ * SysTick and preempt it, timeout callback included: that only pends the
+ * error interrupt, which ends the transfer. The timeout they start and
+ * stop may be due in the tick they interrupted; timer.c detaches due
+ * timers with interrupts masked, so that is safe.
+ *
+ * Sequences of RM0383 section 18.3.3: after the address, a write sends a
+ * byte on each TXE and ends on BTF with a stop or a repeated start; a
+ * read of one byte clears ACK and sets STOP as it clears ADDR; a longer
+ * read sets LAST so the hardware NACKs the byte the DMA ends on, and
+ * stops from the DMA interrupt.
+ */
+
+#define SCL GPIO_Pin_8
+#define SDA GPIO_Pin_9
+
+#define DMA_FLAGS (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+
+typedef enum {
+	PhaseIdle,
+	PhaseStart,     // waiting for SB
+	PhaseAddress,   // waiting for ADDR
+	PhaseWrite,
+	PhaseRead
+} I2cPhase;
+
+static I2cTransfer *head; // on the bus
+static I2cTransfer *tail;
+static I2cPhase phase;
+static int reading;       // the address goes out with the read bit
+static uint32_t sent;     // bytes of the write phase in DR so far
+static uint32_t speed;
+static uint32_t recoveries;
+static SoftTimer timeout;
+static I2cTransfer *volatile expired;
+
+static void i2c_pins(GPIOMode_TypeDef mode) {
 	GPIO_InitTypeDef GPIO_InitStructure;
+
+	GPIO_InitStructure.GPIO_Pin = SCL | SDA;
+	GPIO_InitStructure.GPIO_Mode = mode;
+	GPIO_InitStructure.GPIO_OType = GPIO_OType_OD;
+	GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
+	GPIO_Init(GPIOB, &GPIO_InitStructure);
+}
+
+static void i2c_configure(void) {
 	I2C_InitTypeDef I2C_InitStructure;
-	
-	RCC_APB1PeriphClockCmd(RCC_APB1Periph_I2C1, ENABLE);
-	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOB, ENABLE);
-	
-	GPIO_InitStructure.GPIO_Pin = GPIO_Pin_8 | GPIO_Pin_9;
-  GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF;
-  GPIO_InitStructure.GPIO_OType = GPIO_OType_OD;
-  GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
-  GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
-  GPIO_Init(GPIOB, &GPIO_InitStructure);
-  
-	GPIO_PinAFConfig(GPIOB, GPIO_PinSource8, GPIO_AF_I2C1);
-  GPIO_PinAFConfig(GPIOB, GPIO_PinSource9, GPIO_AF_I2C1);
-	
+
+	I2C1->CR1 = I2C_CR1_SWRST;
+	I2C1->CR1 = 0;
+
 	I2C_InitStructure.I2C_Mode = I2C_Mode_I2C;
 	I2C_InitStructure.I2C_DutyCycle = I2C_DutyCycle_2;
 	I2C_InitStructure.I2C_OwnAddress1 = 0x00;
 	I2C_InitStructure.I2C_Ack = I2C_Ack_Enable;
-	I2C_InitStructure.I2C_ClockSpeed = 10000;
+	I2C_InitStructure.I2C_ClockSpeed = speed;
 	I2C_InitStructure.I2C_AcknowledgedAddress = I2C_AcknowledgedAddress_7bit;
-	
+
 	I2C_Init(I2C1, &I2C_InitStructure);
+	I2C1->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
 	I2C_Cmd(I2C1, ENABLE);
 }
 
-void i2c_write(uint8_t address, uint8_t *buffer, int buff_len) {
-	int i=0;
-	// Send the following sequence:
-	//  - Start bit
-	//  - Contents of buffer, from 0..buff_len
-	//  - Stop bit
-	
-	// wait until I2C1 is not busy anymore
-  while(((I2C1->SR2>>1)&1));
-  // Send I2C1 START condition
-  I2C_GenerateSTART(I2C1, ENABLE);
-  // wait for I2C1 EV5 --> Slave has acknowledged start condition
-  while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT));
-	
-	// Send slave Address for write
-	I2C_Send7bitAddress(I2C1, address, I2C_Direction_Transmitter);
-	//I2C1->DR = address;
-	while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED));
-	
-	while(i<buff_len){
-		I2C_SendData(I2C1, buffer[i]);
-	  //I2C1->DR = buffer[i];
-		while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED));
-		i++;
-	}
-	
-	I2C_GenerateSTOP(I2C1, ENABLE);	
-}
-
-void i2c_read(uint8_t address, uint8_t *buffer, int buff_len) {
-	int i=0;
-	// Read with the following sequence:
-	//  - Start bit
-	//  - Contents of buffer, from 0..buff_len, sending a NACK
-	//    for the last item and an ACK otherwise.
-	//  - Stop bit
-	
-	I2C_GenerateSTART(I2C1, ENABLE);
-	while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT));
-	// Send slave Address for write
-	I2C_Send7bitAddress(I2C1, address, I2C_Direction_Receiver);
-	
-	I2C_AcknowledgeConfig(I2C1, ENABLE);
-	while(i<buff_len-1){
-		while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_RECEIVED));
-		buffer[i] = I2C_ReceiveData(I2C1);
-		i++;
-	}
-	
-	I2C_AcknowledgeConfig(I2C1, DISABLE);
-	//while( !I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_RECEIVED) );
-	//buffer[i]=I2C1->DR;
-	
-	I2C_GenerateSTOP(I2C1, ENABLE);
+// A slave stopped in the middle of a byte holds SDA low: clock it until
+// it lets go, then send a stop, with the pins as plain outputs.
+static void i2c_recover(void) {
+	I2C1->CR1 = 0;
+	GPIO_SetBits(GPIOB, SCL | SDA);
+	i2c_pins(GPIO_Mode_OUT);
+	for (int i = 0; i < 9 && !GPIO_ReadInputDataBit(GPIOB, SDA); i++) {
+		GPIO_ResetBits(GPIOB, SCL);
+		delay_us(5);
+		GPIO_SetBits(GPIOB, SCL);
+		delay_us(5);
+	}
+	GPIO_ResetBits(GPIOB, SDA);
+	delay_us(5);
+	GPIO_SetBits(GPIOB, SDA);
+	delay_us(5);
+	i2c_pins(GPIO_Mode_AF);
+	i2c_configure();
+	recoveries++;
+}
+
+static void i2c_expire(void *context) {
+	expired = context;
+	NVIC_SetPendingIRQ(I2C1_ER_IRQn);
+}
+
+static void i2c_begin(void) {
+	I2cTransfer *transfer = head;
+
+	reading = transfer->write_length == 0 && transfer->read_length > 0;
+	sent = 0;
+	phase = PhaseStart;
+	expired = 0;
+	soft_timer_init(&timeout, i2c_expire, transfer, 0);
+	soft_timer_start(&timeout, transfer->timeout_ms ? transfer->timeout_ms : I2C_TIMEOUT_MS, 0);
+	I2C1->CR1 |= I2C_CR1_START;
+}
+
+// Ends the transfer on the bus and starts the next. A stop, if any, is
+// already on its way.
+static void i2c_finish(I2cStatus status) {
+	I2cTransfer *transfer = head;
+	uint32_t primask = __get_PRIMASK();
+
+	soft_timer_stop(&timeout);
+	I2C1->CR2 &= ~(I2C_CR2_ITBUFEN | I2C_CR2_DMAEN | I2C_CR2_LAST);
+	DMA1_Stream0->CR &= ~DMA_SxCR_EN;
+	while (DMA1_Stream0->CR & DMA_SxCR_EN) {
+	}
+	DMA1->LIFCR = DMA_FLAGS;
+	NVIC_ClearPendingIRQ(DMA1_Stream0_IRQn);
+	phase = PhaseIdle;
+
+	__disable_irq();
+	head = transfer->next;
+	if (!head) {
+		tail = 0;
+	}
+	__set_PRIMASK(primask);
+	if (head) {
+		i2c_begin();
+	}
+	transfer->status = status;
+	if (transfer->callback) {
+		transfer->callback(transfer);
+	}
+}
+
+// Reading SR2 after SR1 clears ADDR.
+static void i2c_clear_address(void) {
+	(void)I2C1->SR1;
+	(void)I2C1->SR2;
+}
+
+static void i2c_address_read(I2cTransfer *transfer) {
+	phase = PhaseRead;
+	if (transfer->read_length == 1) {
+		I2C1->CR1 &= ~I2C_CR1_ACK;
+		i2c_clear_address();
+		I2C1->CR1 |= I2C_CR1_STOP;
+		I2C1->CR2 |= I2C_CR2_ITBUFEN;
+		return;
+	}
+	DMA1_Stream0->M0AR = (uint32_t)(uintptr_t)transfer->read;
+	DMA1_Stream0->NDTR = transfer->read_length;
+	DMA1_Stream0->CR |= DMA_SxCR_EN;
+	I2C1->CR1 |= I2C_CR1_ACK;
+	I2C1->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
+	i2c_clear_address();
+}
+
+void i2c_init(uint32_t speed_hz) {
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_I2C1, ENABLE);
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOB, ENABLE);
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+
+	NVIC_DisableIRQ(I2C1_EV_IRQn);
+	NVIC_DisableIRQ(I2C1_ER_IRQn);
+	NVIC_DisableIRQ(DMA1_Stream0_IRQn);
+	if (head) {
+		soft_timer_stop(&timeout);
+	}
+	head = tail = 0;
+	phase = PhaseIdle;
+	speed = speed_hz;
+	recoveries = 0;
+
+	i2c_pins(GPIO_Mode_AF);
+	GPIO_PinAFConfig(GPIOB, GPIO_PinSource8, GPIO_AF_I2C1);
+	GPIO_PinAFConfig(GPIOB, GPIO_PinSource9, GPIO_AF_I2C1);
+	i2c_configure();
+	if (I2C1->SR2 & I2C_SR2_BUSY) {
+		i2c_recover();
+	}
+
+	// DMA1 Stream0 channel 1 (I2C1 RX): DR into the read buffer
+	DMA1_Stream0->CR = 0;
+	while (DMA1_Stream0->CR & DMA_SxCR_EN) {
+	}
+	DMA1->LIFCR = DMA_FLAGS;
+	DMA1_Stream0->PAR = (uint32_t)(uintptr_t)&I2C1->DR;
+	DMA1_Stream0->FCR = 0; // Direct mode
+	DMA1_Stream0->CR = DMA_SxCR_CHSEL_0 | DMA_SxCR_PL_0 | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+
+	NVIC_SetPriority(I2C1_EV_IRQn, 1);
+	NVIC_SetPriority(I2C1_ER_IRQn, 1);
+	NVIC_SetPriority(DMA1_Stream0_IRQn, 1);
+	NVIC_ClearPendingIRQ(I2C1_EV_IRQn);
+	NVIC_ClearPendingIRQ(I2C1_ER_IRQn);
+	NVIC_ClearPendingIRQ(DMA1_Stream0_IRQn);
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+	NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+}
+
+void i2c_transfer_init(I2cTransfer *transfer, uint8_t address, const uint8_t *write, uint16_t write_length,
+                       uint8_t *read, uint16_t read_length) {
+	transfer->next = 0;
+	transfer->address = address;
+	transfer->write = write;
+	transfer->write_length = write_length;
+	transfer->read = read;
+	transfer->read_length = read_length;
+	transfer->timeout_ms = 0;
+	transfer->callback = 0;
+	transfer->context = 0;
+	transfer->status = I2cDone;
+}
+
+int i2c_submit(I2cTransfer *transfer) {
+	uint32_t primask = __get_PRIMASK();
+	int idle;
+
+	__disable_irq();
+	if (transfer->status == I2cQueued) {
+		__set_PRIMASK(primask);
+		return 0;
+	}
+	transfer->status = I2cQueued;
+	transfer->next = 0;
+	idle = head == 0;
+	if (tail) {
+		tail->next = transfer;
+	} else {
+		head = transfer;
+	}
+	tail = transfer;
+	if (idle) {
+		i2c_begin();
+	}
+	__set_PRIMASK(primask);
+	return 1;
+}
+
+I2cStatus i2c_wait(I2cTransfer *transfer) {
+	uint32_t primask = __get_PRIMASK();
+
+	while (transfer->status == I2cQueued) {
+		// Checked masked, or the last interrupt could end it before the WFI
+		__disable_irq();
+		if (transfer->status == I2cQueued) {
+			__WFI();
+		}
+		__set_PRIMASK(primask);
+	}
+	return transfer->status;
+}
+
+int i2c_busy(void) {
+	return head != 0;
+}
+
+uint32_t i2c_recoveries(void) {
+	return recoveries;
+}
+
+I2cStatus i2c_write(uint8_t address, const uint8_t *buffer, int buff_len) {
+	I2cTransfer transfer;
+
+	i2c_transfer_init(&transfer, address, buffer, (uint16_t)buff_len, 0, 0);
+	i2c_submit(&transfer);
+	return i2c_wait(&transfer);
+}
+
+I2cStatus i2c_read(uint8_t address, uint8_t *buffer, int buff_len) {
+	I2cTransfer transfer;
+
+	i2c_transfer_init(&transfer, address, 0, 0, buffer, (uint16_t)buff_len);
+	i2c_submit(&transfer);
+	return i2c_wait(&transfer);
+}
+
+void I2C1_EV_IRQHandler(void) {
+	uint32_t sr1 = I2C1->SR1;
+	I2cTransfer *transfer = head;
+
+	if (!transfer) {
+		return;
+	}
+	if (sr1 & I2C_SR1_SB) {
+		I2C1->DR = (uint8_t)(transfer->address << 1 | reading);
+		phase = PhaseAddress;
+	} else if (sr1 & I2C_SR1_ADDR) {
+		if (reading) {
+			i2c_address_read(transfer);
+		} else {
+			i2c_clear_address();
+			phase = PhaseWrite;
+			if (transfer->write_length) {
+				I2C1->CR2 |= I2C_CR2_ITBUFEN;
+			} else {
+				// Nothing to write: only checks the slave is there
+				I2C1->CR1 |= I2C_CR1_STOP;
+				i2c_finish(I2cDone);
+			}
+		}
+	} else if (phase == PhaseWrite) {
+		if ((sr1 & I2C_SR1_TXE) && sent < transfer->write_length) {
+			I2C1->DR = transfer->write[sent++];
+			if (sent == transfer->write_length) {
+				I2C1->CR2 &= ~I2C_CR2_ITBUFEN; // BTF ends it
+			}
+		} else if (sr1 & I2C_SR1_BTF) {
+			(void)I2C1->DR; // Clears BTF, or it fires until the condition
+			if (transfer->read_length) {
+				reading = 1;
+				phase = PhaseStart;
+				I2C1->CR1 |= I2C_CR1_START;
+			} else {
+				I2C1->CR1 |= I2C_CR1_STOP;
+				i2c_finish(I2cDone);
+			}
+		}
+	} else if (phase == PhaseRead && (sr1 & I2C_SR1_RXNE)) {
+		// The single byte; STOP is set already
+		transfer->read[0] = (uint8_t)I2C1->DR;
+		i2c_finish(I2cDone);
+	}
+}
+
+void I2C1_ER_IRQHandler(void) {
+	uint32_t sr1 = I2C1->SR1;
+
+	if (!head) {
+		I2C1->SR1 = 0;
+		return;
+	}
+	if (sr1 & I2C_SR1_AF) {
+		I2C1->SR1 = ~I2C_SR1_AF;
+		I2C1->CR1 |= I2C_CR1_STOP;
+		i2c_finish(I2cNack);
+	} else if (sr1 & (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR)) {
+		I2C1->SR1 = 0;
+		i2c_recover();
+		i2c_finish(I2cBusError);
+	} else if (expired == head) {
+		i2c_recover();
+		i2c_finish(I2cTimeout);
+	}
+}
+
+void DMA1_Stream0_IRQHandler(void) {
+	uint32_t flags = DMA1->LISR;
+
+	DMA1->LIFCR = flags & DMA_FLAGS;
+	NVIC_ClearPendingIRQ(DMA1_Stream0_IRQn);
+	if (!head || phase != PhaseRead) {
+		return;
+	}
+	if (flags & DMA_LISR_TEIF0) {
+		i2c_recover();
+		i2c_finish(I2cBusError);
+	} else if (flags & DMA_LISR_TCIF0) {
+		// The last byte is in and NACKed
+		I2C1->CR1 |= I2C_CR1_STOP;
+		i2c_finish(I2cDone);
+	}
 }
 
 // *******************************ARM University Program Copyright  ARM Ltd 2016*************************************   
@@ -3,29 +3,100 @@
  * \brief     Controller for hardware I2C module, configured
  *            as a master.
  * \copyright ARM University Program &copy; ARM Ltd 2014.
+ *
+ * I2C1 on PB8 (SCL) and PB9 (SDA) runs a queue of transfers from its
+ * interrupts: each writes some bytes, reads some, or writes then reads
+ * after a repeated start, and ends with a status and an optional
+ * callback. Reads of two bytes or more go to memory by DMA1 Stream0
+ * (channel 1); writes are a byte an interrupt, as the I2C1 TX streams
+ * are taken by USART2 and the DHT11 capture. Each transfer has a
+ * timeout, run by a software timer; a transfer that times out or meets
+ * a bus error resets I2C1 and clocks a stuck slave free before the next
+ * one starts.
+ *
+ * i2c_write() and i2c_read() queue a transfer and sleep until it ends.
  */
 #ifndef I2C_H
 #define I2C_H
 #include <stdint.h>
 
+/*! Standard mode clock. */
+#define I2C_STANDARD_HZ 100000
+
+/*! Fast mode clock. */
+#define I2C_FAST_HZ     400000
+
+/*! Timeout of a transfer that sets none, rounded up to the timer tick. */
+#define I2C_TIMEOUT_MS  20
+
+/*! How a transfer went. */
+typedef enum {
+	I2cDone,     //!< Completed, or never queued.
+	I2cQueued,   //!< Waiting, or on the bus.
+	I2cNack,     //!< The slave did not acknowledge its address or a byte.
+	I2cTimeout,  //!< Not done in time; the bus was recovered.
+	I2cBusError  //!< Bus error or arbitration lost; the bus was recovered.
+} I2cStatus;
+
+/*! A transfer. Allocated by the user and left alone while queued. */
+typedef struct I2cTransfer {
+	struct I2cTransfer *next;       //!< Next in the queue.
+	uint8_t address;                //!< 7-bit address of the slave.
+	const uint8_t *write;           //!< Bytes written first.
+	uint16_t write_length;          //!< 0 for a read alone.
+	uint8_t *read;                  //!< Where the bytes read go.
+	uint16_t read_length;           //!< 0 for a write alone.
+	uint16_t timeout_ms;            //!< 0 for I2C_TIMEOUT_MS.
+	void (*callback)(struct I2cTransfer *transfer); //!< Called from the interrupt at the end, or 0.
+	void *context;                  //!< For the callback.
+	volatile I2cStatus status;      //!< I2cQueued until the end.
+} I2cTransfer;
+
 /*! \brief Initialises the hardware I2C module, any
  *         relevant pins and enables the module.
+ *  \param speed_hz  SCL clock, I2C_STANDARD_HZ or I2C_FAST_HZ.
+ */
+void i2c_init(uint32_t speed_hz);
+
+/*! \brief Prepares a transfer: writes \a write_length bytes, then reads
+ *         \a read_length after a repeated start. No callback, the
+ *         default timeout.
  */
-void i2c_init(void);
+void i2c_transfer_init(I2cTransfer *transfer, uint8_t address, const uint8_t *write, uint16_t write_length,
+                       uint8_t *read, uint16_t read_length);
+
+/*! \brief Queues a transfer. May be called from interrupts, and from the
+ *         callback of another transfer.
+ *  \return True (1), or false (0) if it is queued already.
+ */
+int i2c_submit(I2cTransfer *transfer);
+
+/*! \brief Sleeps until a transfer ends. Not from an interrupt.
+ *  \return Its status.
+ */
+I2cStatus i2c_wait(I2cTransfer *transfer);
+
+/*! \brief Checks if transfers are queued. */
+int i2c_busy(void);
+
+/*! \brief Times the bus was recovered since i2c_init(). */
+uint32_t i2c_recoveries(void);
 
 /*! \brief Writes data to an I2C module.
- *  \param address  I2C address of the slave.
+ *  \param address  7-bit I2C address of the slave.
  *  \param buffer   Data to be sent.
  *  \param buff_len Number of bytes to send.
+ *  \return How the transfer went.
  */
-void i2c_write(uint8_t address, uint8_t *buffer, int buff_len);
+I2cStatus i2c_write(uint8_t address, const uint8_t *buffer, int buff_len);
 
 /*! \brief Reads data from an I2C module.
- *  \param address  I2C address of the slave.
+ *  \param address  7-bit I2C address of the slave.
  *  \param buffer   Data to be read.
  *  \param buff_len Number of bytes to read.
+ *  \return How the transfer went.
  */
-void i2c_read(uint8_t address, uint8_t *buffer, int buff_len);
+I2cStatus i2c_read(uint8_t address, uint8_t *buffer, int buff_len);
 
 #endif //I2C_H
 
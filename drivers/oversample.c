@@ -0,0 +1,115 @@
+#include <string.h>
+#include "oversample.h"
+
+/*
+ * A sum of 2^r 12-bit samples has 12 + r bits, of which 12 + r / 2 are
+ * kept. The CIC has a gain of 2^3r, 12 + 3r bits: with r at most 6 that
+ * fits 32 bits, so its integrators may wrap, as the combs undo it.
+ */
+
+int oversample_init(Oversampler *filter, OversampleMode mode, uint32_t ratio_log2) {
+	uint32_t gain_log2 = mode == OversampleCic ? 3 * ratio_log2 : ratio_log2;
+
+	if (ratio_log2 > (mode == OversampleAverage ? 16 : OVERSAMPLE_MAX_LOG2)) {
+		return 0;
+	}
+	memset(filter, 0, sizeof(*filter));
+	filter->mode = mode;
+	filter->ratio_log2 = ratio_log2;
+	filter->shift = gain_log2 - ratio_log2 / 2;
+	return 1;
+}
+
+static void average_feed(Oversampler *filter, const uint16_t *samples, uint32_t count, uint32_t stride) {
+	uint32_t ratio = 1UL << filter->ratio_log2;
+	uint32_t sum = filter->sum;
+	uint32_t n = filter->count;
+
+	while (count-- > 0) {
+		sum += *samples;
+		samples += stride;
+		if (++n == ratio) {
+			filter->value = sum >> filter->shift;
+			filter->outputs++;
+			sum = 0;
+			n = 0;
+		}
+	}
+	filter->sum = sum;
+	filter->count = n;
+}
+
+static void cic_feed(Oversampler *filter, const uint16_t *samples, uint32_t count, uint32_t stride) {
+	uint32_t ratio = 1UL << filter->ratio_log2;
+	uint32_t i0 = filter->integrator[0], i1 = filter->integrator[1], i2 = filter->integrator[2];
+	uint32_t n = filter->count;
+
+	while (count-- > 0) {
+		i0 += *samples;
+		i1 += i0;
+		i2 += i1;
+		samples += stride;
+		if (++n == ratio) {
+			uint32_t c0 = i2 - filter->comb[0];
+			uint32_t c1 = c0 - filter->comb[1];
+			uint32_t c2 = c1 - filter->comb[2];
+
+			filter->comb[0] = i2;
+			filter->comb[1] = c0;
+			filter->comb[2] = c1;
+			filter->value = c2 >> filter->shift;
+			filter->outputs++;
+			n = 0;
+		}
+	}
+	filter->integrator[0] = i0;
+	filter->integrator[1] = i1;
+	filter->integrator[2] = i2;
+	filter->count = n;
+}
+
+static void moving_average_feed(Oversampler *filter, const uint16_t *samples, uint32_t count, uint32_t stride) {
+	uint32_t mask = (1UL << filter->ratio_log2) - 1;
+	uint32_t sum = filter->sum;
+	uint32_t n = filter->count;
+	uint32_t fed = count;
+
+	while (count-- > 0) {
+		sum += *samples - filter->window[n];
+		filter->window[n] = *samples;
+		samples += stride;
+		n = (n + 1) & mask;
+	}
+	filter->sum = sum;
+	filter->count = n;
+	filter->value = sum >> filter->shift;
+	filter->outputs += fed;
+}
+
+void oversample_feed(Oversampler *filter, const uint16_t *samples, uint32_t count, uint32_t stride) {
+	switch (filter->mode) {
+		case OversampleAverage:
+			average_feed(filter, samples, count, stride);
+			break;
+		case OversampleCic:
+			cic_feed(filter, samples, count, stride);
+			break;
+		case OversampleMovingAverage:
+			moving_average_feed(filter, samples, count, stride);
+			break;
+	}
+}
+
+void oversample_scans(Oversampler *filters, uint32_t pins, const uint16_t *scans, uint32_t count) {
+	for (uint32_t i = 0; i < pins; i++) {
+		oversample_feed(&filters[i], scans + i, count, pins);
+	}
+}
+
+uint32_t oversample_value(const Oversampler *filter) {
+	return filter->value;
+}
+
+uint32_t oversample_bits(const Oversampler *filter) {
+	return 12 + filter->ratio_log2 / 2;
+}
@@ -0,0 +1,88 @@
+/*!
+ * \file      oversample.h
+ * \brief     Oversampling and decimation of ADC samples.
+ *
+ * A filter takes 12-bit samples of one channel and keeps its latest
+ * output, which has 12 + ratio_log2 / 2 bits: averaging 4 samples of a
+ * noisy input gains one bit. Three kinds:
+ *
+ * - Average: the sum of 2^ratio_log2 samples, then a new sum; one output
+ *   every 2^ratio_log2 samples. The cheapest.
+ * - CIC: a third order cascaded integrator-comb decimator by
+ *   2^ratio_log2 (sinc^3): the same output rate, but it rejects noise
+ *   above the output Nyquist frequency much better. Its first three
+ *   outputs are a transient.
+ * - Moving average: the mean of the last 2^ratio_log2 samples, an output
+ *   for every sample. Starts from zero.
+ *
+ * The filters know nothing of the ADC: oversample_scans() feeds one per
+ * pin from the interleaved samples of adc_scan.h, usually from the scan
+ * callback, so they run in the DMA half and full transfer interrupts.
+ * The outputs may be read from any context. make bench checks them on
+ * synthetic inputs and prints their cost and noise.
+ */
+#ifndef OVERSAMPLE_H
+#define OVERSAMPLE_H
+#include <stdint.h>
+
+/*! Largest ratio_log2 of the CIC and the moving average; the average
+ *  takes up to 16. */
+#define OVERSAMPLE_MAX_LOG2 6
+
+/*! The kinds of filter. */
+typedef enum {
+	OversampleAverage,
+	OversampleCic,
+	OversampleMovingAverage
+} OversampleMode;
+
+/*! A filter. Allocated by the user; it should only be changed through
+ *  the functions below. */
+typedef struct {
+	OversampleMode mode;
+	uint32_t ratio_log2;
+	uint32_t shift;                 //!< From the sum to the output.
+	uint32_t count;                 //!< Samples into the output or the window.
+	uint32_t sum;                   //!< Average, moving average.
+	uint32_t integrator[3];         //!< CIC, modulo 2^32.
+	uint32_t comb[3];               //!< CIC, the integrator at the last output.
+	uint16_t window[1 << OVERSAMPLE_MAX_LOG2]; //!< Moving average.
+	volatile uint32_t value;        //!< The latest output.
+	volatile uint32_t outputs;      //!< Outputs so far.
+} Oversampler;
+
+/*! \brief Sets up a filter, with no samples.
+ *  \param filter      The filter.
+ *  \param mode        Its kind.
+ *  \param ratio_log2  Samples per output (or in the window) as a power of
+ *                     two, 0 to 16 for the average and to
+ *                     OVERSAMPLE_MAX_LOG2 for the others.
+ *  \return True (1), or false (0) if the ratio is out of range.
+ */
+int oversample_init(Oversampler *filter, OversampleMode mode, uint32_t ratio_log2);
+
+/*! \brief Feeds samples to a filter.
+ *  \param filter   The filter.
+ *  \param samples  The first sample.
+ *  \param count    Number of samples.
+ *  \param stride   Distance between two samples, 1 if they are together.
+ */
+void oversample_feed(Oversampler *filter, const uint16_t *samples, uint32_t count, uint32_t stride);
+
+/*! \brief Feeds scans of several pins, filter i taking pin i.
+ *  \param filters  One filter per pin.
+ *  \param pins     Samples in a scan.
+ *  \param scans    The scans, as adc_scan.h lays them out.
+ *  \param count    Number of scans.
+ */
+void oversample_scans(Oversampler *filters, uint32_t pins, const uint16_t *scans, uint32_t count);
+
+/*! \brief Latest output of a filter, of oversample_bits() bits; 0 before
+ *         the first.
+ */
+uint32_t oversample_value(const Oversampler *filter);
+
+/*! \brief Bits of the outputs of a filter, 12 + ratio_log2 / 2. */
+uint32_t oversample_bits(const Oversampler *filter);
+
+#endif // OVERSAMPLE_H
@@ -1,42 +1,126 @@
+#include "platform.h"
 #include "queue.h"
-#include <stdlib.h>
+#include <string.h>
 
-int queue_init(Queue *queue, uint32_t size) {
-	queue->data = (uint8_t*)malloc(sizeof(uint8_t) * size);
+/*
+ * The producer only writes tail and the consumer only writes head, so
+ * neither needs a lock. The barriers order the element accesses against
+ * the index update that publishes them to the other side.
+ */
+
+static void queue_note_fill(Queue *queue, uint32_t count) {
+	if (count > queue->high_watermark) {
+		queue->high_watermark = count;
+	}
+}
+
+int queue_init(Queue *queue, uint8_t *storage, uint32_t size) {
+	queue->data = storage;
+	queue->mask = size - 1;
 	queue->head = 0;
 	queue->tail = 0;
-	queue->size = size;
-	
-	// If malloc returns NULL (0) the allocation has failed.
-	return queue->data != 0;
+	queue->high_watermark = 0;
+	queue->drops = 0;
+
+	// The size must be a non-zero power of two.
+	return size && !(size & (size - 1));
 }
 
 int queue_enqueue(Queue *queue, uint8_t item) {
-	if (!queue_is_full(queue)) {
-		queue->data[queue->tail++] = item;
-		queue->tail %= queue->size;
-		return 1;
-	} else {
+	uint32_t tail = queue->tail;
+	uint32_t count = tail - queue->head;
+
+	if (count > queue->mask) {
+		queue->drops++;
 		return 0;
 	}
+	queue->data[tail & queue->mask] = item;
+	__DMB(); // The item is stored before it is published
+	queue->tail = tail + 1;
+	queue_note_fill(queue, count + 1);
+	return 1;
 }
 
 int queue_dequeue(Queue *queue, uint8_t *item) {
-	if (!queue_is_empty(queue)) {
-		*item = queue->data[queue->head++];
-		queue->head %= queue->size;
-		return 1;
-	} else {
+	uint32_t head = queue->head;
+
+	if (queue->tail == head) {
 		return 0;
 	}
+	__DMB(); // The item is read after its publication is seen
+	*item = queue->data[head & queue->mask];
+	__DMB(); // and before its slot is handed back
+	queue->head = head + 1;
+	return 1;
+}
+
+uint32_t queue_enqueue_bulk(Queue *queue, const uint8_t *items, uint32_t count) {
+	uint32_t tail = queue->tail;
+	uint32_t used = tail - queue->head;
+	uint32_t space = queue->mask + 1 - used;
+	uint32_t index = tail & queue->mask;
+	uint32_t first;
+
+	if (count > space) {
+		queue->drops += count - space;
+		count = space;
+	}
+	// Up to the end of the array, then the rest from the start.
+	first = queue->mask + 1 - index;
+	if (first > count) first = count;
+	memcpy(&queue->data[index], items, first);
+	memcpy(queue->data, items + first, count - first);
+	__DMB();
+	queue->tail = tail + count;
+	queue_note_fill(queue, used + count);
+	return count;
+}
+
+uint32_t queue_dequeue_bulk(Queue *queue, uint8_t *items, uint32_t count) {
+	uint32_t head = queue->head;
+	uint32_t available = queue->tail - head;
+	uint32_t index = head & queue->mask;
+	uint32_t first;
+
+	if (count > available) count = available;
+	__DMB();
+	first = queue->mask + 1 - index;
+	if (first > count) first = count;
+	memcpy(items, &queue->data[index], first);
+	memcpy(items + first, queue->data, count - first);
+	__DMB();
+	queue->head = head + count;
+	return count;
+}
+
+uint32_t queue_peek(Queue *queue, uint8_t **items) {
+	uint32_t head = queue->head;
+	uint32_t count = queue->tail - head;
+	uint32_t index = head & queue->mask;
+
+	if (count > queue->mask + 1 - index) {
+		count = queue->mask + 1 - index;
+	}
+	__DMB();
+	*items = &queue->data[index];
+	return count;
+}
+
+void queue_commit(Queue *queue, uint32_t count) {
+	__DMB();
+	queue->head += count;
+}
+
+uint32_t queue_count(Queue *queue) {
+	return queue->tail - queue->head;
 }
 
 int queue_is_full(Queue *queue) {
-	return ((queue->tail + 1) % queue->size) == queue->head;
+	return queue->tail - queue->head > queue->mask;
 }
 
 int queue_is_empty(Queue *queue) {
 	return queue->tail == queue->head;
 }
 
-// *******************************ARM University Program Copyright © ARM Ltd 2016*************************************   
+// *******************************ARM University Program Copyright © ARM Ltd 2016*************************************
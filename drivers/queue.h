@@ -2,6 +2,12 @@
  * \file      queue.h
  * \brief     Implements a queue (FIFO) data structure.
  * \copyright ARM University Program &copy; ARM Ltd 2014.
+ *
+ * The queue is a single-producer, single-consumer ring buffer: one
+ * context (for example an interrupt handler) may add items while another
+ * (for example the main loop) removes them, without disabling
+ * interrupts. Several producers or consumers must serialise themselves.
+ * The size is a power of two, so indexing is a mask and not a division.
  */
 #ifndef QUEUE_H
 #define QUEUE_H
@@ -10,23 +16,28 @@
 /*! This structure encapsulates the queue data structure.
  *  It should not be modified directly. Any modifications should
  *  be carried out by the functions provided by queue.h.
+ *  The statistics may be read at any time.
  */
 typedef struct {
-	uint8_t* data; //!< Array of data, stored on the heap.
-	uint32_t head; //!< Index in the array of the oldest element.
-	uint32_t tail; //!< Index in the array of the youngest element.
-	uint32_t size; //!< Size of the data array.
+	uint8_t* data;               //!< Array of data, supplied by the user.
+	uint32_t mask;               //!< Size of the data array minus one.
+	volatile uint32_t head;      //!< Free running index of the oldest element, written by the consumer.
+	volatile uint32_t tail;      //!< Free running index after the youngest element, written by the producer.
+	uint32_t high_watermark;     //!< Most elements ever held at once.
+	uint32_t drops;              //!< Elements refused because the queue was full.
 } Queue;
 
-/*! \brief Initialises the supplied queue structure to the
- *         parameterised size.
+/*! \brief Initialises the supplied queue structure to use the
+ *         supplied storage.
  *  This must be called before any use of the data-structure.
- *  \param queue Queue structure to operate on.
- *  \param size  Amount of elements the queue can hold.
+ *  \param queue   Queue structure to operate on.
+ *  \param storage Array holding the elements, usually static.
+ *  \param size    Size of the array, a power of two. The queue can
+ *                 hold this many elements.
  *  \return True (1) if the operation is successful, false (0)
- *          otherwise.
+ *          otherwise (size not a power of two).
  */
-int queue_init(Queue *queue, uint32_t size);
+int queue_init(Queue *queue, uint8_t *storage, uint32_t size);
 
 /*! \brief Adds an item to the back of the queue.
  *  \param queue Queue structure to operate on.
@@ -45,6 +56,43 @@ int queue_enqueue(Queue *queue, uint8_t item);
  */
 int queue_dequeue(Queue *queue, uint8_t *item);
 
+/*! \brief Adds as many of the supplied items as fit to the back
+ *         of the queue. Items that do not fit are counted as drops.
+ *  \param queue  Queue structure to operate on.
+ *  \param items  Items to add.
+ *  \param count  Number of items.
+ *  \return Number of items added.
+ */
+uint32_t queue_enqueue_bulk(Queue *queue, const uint8_t *items, uint32_t count);
+
+/*! \brief Removes up to \a count items from the front of the queue.
+ *  \param queue  Queue structure to operate on.
+ *  \param items  Array the items are copied to.
+ *  \param count  Maximum number of items to remove.
+ *  \return Number of items removed.
+ */
+uint32_t queue_dequeue_bulk(Queue *queue, uint8_t *items, uint32_t count);
+
+/*! \brief Gives direct access to the items at the front of the queue,
+ *         without removing them. Used by the consumer, for example to
+ *         hand them to a DMA transfer.
+ *  \param queue  Queue structure to operate on.
+ *  \param items  Set to the first item.
+ *  \return Number of items stored contiguously from \a items on.
+ */
+uint32_t queue_peek(Queue *queue, uint8_t **items);
+
+/*! \brief Removes items previously obtained with queue_peek().
+ *  \param queue  Queue structure to operate on.
+ *  \param count  Number of items consumed.
+ */
+void queue_commit(Queue *queue, uint32_t count);
+
+/*! \brief Number of items in the queue.
+ *  \param queue Queue structure to operate on.
+ */
+uint32_t queue_count(Queue *queue);
+
 /*! \brief Checks if the supplied queue is full.
  *  \param queue Queue structure to operate on.
  *  \return True (1) if the queue is full, false (0) otherwise.
@@ -59,5 +107,4 @@ int queue_is_empty(Queue *queue);
 
 #endif // QUEUE_H
 
-// *******************************ARM University Program Copyright © ARM Ltd 2016*************************************   
-
+// *******************************ARM University Program Copyright © ARM Ltd 2016*************************************
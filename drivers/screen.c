@@ -0,0 +1,155 @@
+#include <string.h>
+#include "screen.h"
+#include "format.h"
+#include "uart.h"
+
+/*
+ * Two copies of the screen: wanted is the frame being described, shown
+ * what the terminal displays. A changed line is sent as one span, from
+ * its first changed column to its last, so rewriting a line with the
+ * same text costs nothing and a reading that moved one digit costs the
+ * cursor move and that digit.
+ */
+
+#define HIGHLIGHT_ON  "\033[43;30m"
+#define HIGHLIGHT_OFF "\033[0m"
+#define NOWHERE       0xFFFFFFFFUL // cursor in the log
+
+typedef struct {
+	char text[SCREEN_COLS];
+	uint8_t length;
+	uint8_t highlight;
+} ScreenLine;
+
+static ScreenLine wanted[SCREEN_ROWS];
+static ScreenLine shown[SCREEN_ROWS];
+static uint32_t cursor_row, cursor_col; // where the terminal's cursor is, or NOWHERE
+static uint32_t target_row, target_col; // where it is left by screen_render()
+static uint32_t sent;
+
+static void screen_write(const char *text, uint32_t length) {
+	uart_write(text, length);
+	sent += length;
+}
+
+static void screen_print(const char *text) {
+	screen_write(text, strlen(text));
+}
+
+// Picks the shortest of a carriage return, a counted move along the
+// line and an absolute position.
+static void screen_move(uint32_t row, uint32_t col) {
+	char sequence[16];
+
+	if (row == cursor_row && col == cursor_col) {
+		return;
+	}
+	if (row == cursor_row && col == 0) {
+		strcpy(sequence, "\r");
+	} else if (row == cursor_row && col == cursor_col + 1) {
+		strcpy(sequence, "\033[C");
+	} else if (row == cursor_row && col == cursor_col - 1) {
+		strcpy(sequence, "\b");
+	} else if (row == cursor_row && col > cursor_col) {
+		format_string(sequence, sizeof(sequence), "\033[%uC", (unsigned int)(col - cursor_col));
+	} else if (row == cursor_row) {
+		format_string(sequence, sizeof(sequence), "\033[%uD", (unsigned int)(cursor_col - col));
+	} else {
+		format_string(sequence, sizeof(sequence), "\033[%u;%uH", (unsigned int)row + 1, (unsigned int)col + 1);
+	}
+	screen_print(sequence);
+	cursor_row = row;
+	cursor_col = col;
+}
+
+static void screen_render_line(uint32_t row) {
+	ScreenLine *want = &wanted[row];
+	ScreenLine *show = &shown[row];
+	uint32_t first = 0;
+	uint32_t end = want->length > show->length ? want->length : show->length;
+
+	if (want->highlight == show->highlight) {
+		while (first < want->length && first < show->length && want->text[first] == show->text[first]) {
+			first++;
+		}
+		if (first == end) {
+			return; // Unchanged
+		}
+		if (want->length == show->length) {
+			while (want->text[end - 1] == show->text[end - 1]) {
+				end--;
+			}
+		}
+	}
+	if (end > want->length) {
+		end = want->length;
+	}
+
+	screen_move(row, first);
+	if (want->highlight) {
+		screen_print(HIGHLIGHT_ON);
+	}
+	screen_write(&want->text[first], end - first);
+	cursor_col = end;
+	if (want->highlight) {
+		screen_print(HIGHLIGHT_OFF);
+	}
+	if (show->length > want->length) {
+		screen_print("\033[K"); // Erase the rest of the old line
+	}
+	*show = *want;
+}
+
+void screen_init(void) {
+	memset(wanted, 0, sizeof(wanted));
+	target_row = target_col = 0;
+	screen_redraw();
+}
+
+void screen_redraw(void) {
+	char sequence[24];
+
+	memset(shown, 0, sizeof(shown));
+	cursor_row = cursor_col = 0;
+	// The log scrolls from the line after the blank one below the screen
+	format_string(sequence, sizeof(sequence), "\033[%ur\033[2J\033[H", (unsigned int)SCREEN_ROWS + 2);
+	screen_print(sequence);
+}
+
+void screen_log_start(void) {
+	screen_print("\033[999;1H"); // The bottom line, wherever that is
+	cursor_row = cursor_col = NOWHERE;
+}
+
+void screen_set_line(uint32_t row, const char *text, int highlight) {
+	ScreenLine *line;
+	uint32_t length = 0;
+
+	if (row >= SCREEN_ROWS) {
+		return;
+	}
+	line = &wanted[row];
+	while (length < SCREEN_COLS && text[length]) {
+		line->text[length] = text[length];
+		length++;
+	}
+	line->length = (uint8_t)length;
+	line->highlight = (uint8_t)(highlight != 0);
+}
+
+void screen_set_cursor(uint32_t row, uint32_t col) {
+	target_row = row < SCREEN_ROWS ? row : SCREEN_ROWS - 1;
+	target_col = col < SCREEN_COLS ? col : SCREEN_COLS - 1;
+}
+
+uint32_t screen_render(void) {
+	uint32_t count;
+
+	for (uint32_t row = 0; row < SCREEN_ROWS; row++) {
+		screen_render_line(row);
+	}
+	screen_move(target_row, target_col);
+	count = sent;
+	sent = 0;
+	return count;
+}
@@ -0,0 +1,60 @@
+/*!
+ * \file      screen.h
+ * \brief     Terminal screen model, sent over the UART as differences.
+ *
+ * The screen is a grid of SCREEN_ROWS lines. Callers describe the frame
+ * they want line by line, then screen_render() compares it with the
+ * frame the terminal shows and sends only the columns that changed,
+ * placing the cursor with absolute (CUP) or counted moves. A frame equal
+ * to the last one sends nothing. All output to the screen must go
+ * through these functions, or the model no longer matches the terminal.
+ *
+ * The terminal lines below the screen, after one blank line, are a log
+ * that scrolls on its own and leaves the screen where it is.
+ */
+#ifndef SCREEN_H
+#define SCREEN_H
+#include <stdint.h>
+
+/*! Lines of the screen. */
+#define SCREEN_ROWS 10
+
+/*! Longest line; longer text is cut. */
+#define SCREEN_COLS 100
+
+/*! \brief Clears the terminal and both frames, and homes the cursor. */
+void screen_init(void);
+
+/*! \brief Clears the terminal, so that the next screen_render() sends
+ *         the whole frame. For when the terminal may not show the
+ *         screen any more.
+ */
+void screen_redraw(void);
+
+/*! \brief Sets a line of the next frame.
+ *  \param row        Line, 0 is the top of the screen.
+ *  \param text       Null terminated text, without control characters.
+ *  \param highlight  True (1) to show the text highlighted.
+ */
+void screen_set_line(uint32_t row, const char *text, int highlight);
+
+/*! \brief Sets where the cursor is left after the next frame.
+ *  \param row  Line, 0 is the top of the screen.
+ *  \param col  Column, 0 is the left edge.
+ */
+void screen_set_cursor(uint32_t row, uint32_t col);
+
+/*! \brief Moves the cursor to the last line of the log, so that what
+ *         is printed next is logged. Start each line with "\r\n" to
+ *         scroll the log up. The next screen_render() moves the cursor
+ *         back.
+ */
+void screen_log_start(void);
+
+/*! \brief Sends what differs between the next frame and the shown one.
+ *  \return Bytes queued for transmission since the last call: the frame,
+ *          and any screen_redraw() or screen_log_start() before it.
+ */
+uint32_t screen_render(void);
+
+#endif // SCREEN_H
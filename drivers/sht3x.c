@@ -0,0 +1,262 @@
+#include "platform.h"
+#include <string.h>
+#include "sht3x.h"
+#include "i2c.h"
+#include "timer.h"
+#include "delay.h"
+
+/*
+ * A single shot is two transfers with the conversion between them: the
+ * command, a software timer, then the read. The clock stretching
+ * commands would hold the bus for the whole conversion, so the ones
+ * without are used: the sensor NACKs a read that comes too early, and it
+ * is tried again on the next tick.
+ *
+ * In the periodic mode a timer fetches once a period, SHT3X_MEASURE_MS
+ * after each measurement began. The sensor's clock drifts against ours:
+ * when a fetch comes before the next measurement is over it is NACKed
+ * and skipped, and the one after gets it.
+ *
+ * The transfer callbacks run in the I2C1 interrupts, which preempt
+ * SysTick, where the timer ones run. They may restart the conversion
+ * timer during a tick; timer.c detaches due timers with interrupts
+ * masked, so that is safe. Fetches are queued with interrupts masked,
+ * since both kinds of callback may do it.
+ */
+
+#define CMD_SINGLE_SHOT 0x2400 // high repeatability, no clock stretching
+#define CMD_FETCH       0xE000
+#define CMD_BREAK       0x3093
+#define CMD_SOFT_RESET  0x30A2
+#define RESET_US        1500   // soft reset, and a break, to the next command
+
+// Nibble at a time, like checksum_crc8()
+static const uint8_t crc_table[16] = {
+	0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E
+};
+
+// Periodic commands at high repeatability, by measurements a second
+static const struct {
+	uint8_t per_second;
+	uint16_t command;
+} rates[] = {
+	{ 1, 0x2130 }, { 2, 0x2236 }, { 4, 0x2334 }, { 10, 0x2737 }
+};
+
+static I2cTransfer command;     // single shot: the command
+static I2cTransfer measurement; // single shot: the 6 bytes
+static I2cTransfer fetch;       // periodic: fetch command, then the 6 bytes
+static uint8_t command_bytes[2];
+static uint8_t fetch_bytes[2];
+static uint8_t single_data[6];  // DMA destinations, never on the stack
+static uint8_t fetch_data[6];
+static SoftTimer conversion;
+static SoftTimer poll;
+static void (*single_callback)(const DHT11_Reading *);
+static void (*periodic_callback)(const DHT11_Reading *);
+static void (*fetch_callback)(const DHT11_Reading *);
+static volatile int busy;
+static volatile int periodic;
+static int fetch_quiet;         // a NACK is not reported
+static uint32_t retries;        // reads of the single shot left
+static DHT11_Reading result;
+
+static void sht3x_command_bytes(uint8_t *bytes, uint16_t command) {
+	bytes[0] = (uint8_t)(command >> 8);
+	bytes[1] = (uint8_t)command;
+}
+
+uint8_t sht3x_crc(const uint8_t *data, uint32_t length) {
+	uint32_t crc = 0xFF;
+
+	while (length-- > 0) {
+		crc ^= *data++;
+		crc = ((crc << 4) & 0xFF) ^ crc_table[crc >> 4];
+		crc = ((crc << 4) & 0xFF) ^ crc_table[crc >> 4];
+	}
+	return (uint8_t)crc;
+}
+
+// The reading from how the transfer went and, if it did, its 6 bytes.
+static void sht3x_decode(I2cStatus status, const uint8_t *bytes) {
+	uint32_t raw_t, raw_rh, rh_tenths, t_size;
+	int32_t t_tenths;
+
+	memset(&result, 0, sizeof(result));
+	if (status != I2cDone) {
+		// No answer, or not yet; a bus error
+		result.status = status == I2cBusError ? DHT11_ERROR : DHT11_TIMEOUT;
+		return;
+	}
+	if (sht3x_crc(bytes, 2) != bytes[2] || sht3x_crc(bytes + 3, 2) != bytes[5]) {
+		result.status = DHT11_CHECKSUM_MISMATCH;
+		return;
+	}
+
+	raw_t = (uint32_t)bytes[0] << 8 | bytes[1];
+	raw_rh = (uint32_t)bytes[3] << 8 | bytes[4];
+	result.temperature = -45.0f + 175.0f * (float)raw_t / 65535.0f;
+	result.humidity = 100.0f * (float)raw_rh / 65535.0f;
+
+	// Rounded to tenths for the DHT11 bytes
+	t_tenths = (int32_t)((1750 * raw_t + 32767) / 65535) - 450;
+	rh_tenths = (1000 * raw_rh + 32767) / 65535;
+	t_size = t_tenths < 0 ? (uint32_t)-t_tenths : (uint32_t)t_tenths;
+	result.data[0] = (uint8_t)(rh_tenths / 10);
+	result.data[1] = (uint8_t)(rh_tenths % 10);
+	result.data[2] = (uint8_t)(t_size / 10);
+	result.data[3] = (uint8_t)(t_size % 10 | (t_tenths < 0 ? 0x80 : 0));
+	result.data[4] = (uint8_t)(result.data[0] + result.data[1] + result.data[2] + result.data[3]);
+	result.status = DHT11_OK;
+}
+
+static void sht3x_single_finish(I2cStatus status) {
+	void (*callback)(const DHT11_Reading *) = single_callback;
+
+	sht3x_decode(status, single_data);
+	busy = 0;
+	if (callback) {
+		callback(&result);
+	}
+}
+
+static void sht3x_measurement_done(I2cTransfer *transfer) {
+	if (transfer->status == I2cNack && retries > 0) {
+		retries--;
+		soft_timer_start(&conversion, 1000 / TIMER_TICK_HZ, 0);
+		return;
+	}
+	sht3x_single_finish(transfer->status);
+}
+
+static void sht3x_converted(void *context) {
+	i2c_submit(&measurement);
+}
+
+static void sht3x_command_done(I2cTransfer *transfer) {
+	if (transfer->status != I2cDone) {
+		sht3x_single_finish(transfer->status);
+		return;
+	}
+	retries = SHT3X_RETRIES;
+	soft_timer_start(&conversion, SHT3X_MEASURE_MS, 0);
+}
+
+static void sht3x_fetch_done(I2cTransfer *transfer) {
+	if (transfer->status == I2cNack && fetch_quiet) {
+		return;
+	}
+	sht3x_decode(transfer->status, fetch_data);
+	if (fetch_callback) {
+		fetch_callback(&result);
+	}
+}
+
+static int sht3x_fetch_submit(void (*callback)(const DHT11_Reading *), int quiet) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (!periodic || fetch.status == I2cQueued) {
+		__set_PRIMASK(primask);
+		return 0;
+	}
+	fetch_callback = callback;
+	fetch_quiet = quiet;
+	i2c_submit(&fetch);
+	__set_PRIMASK(primask);
+	return 1;
+}
+
+static void sht3x_poll(void *context) {
+	sht3x_fetch_submit(periodic_callback, 1);
+}
+
+int sht3x_init(void) {
+	static const uint8_t reset[2] = { CMD_SOFT_RESET >> 8, CMD_SOFT_RESET & 0xFF };
+	I2cStatus status;
+
+	i2c_init(I2C_FAST_HZ);
+	sht3x_command_bytes(command_bytes, CMD_SINGLE_SHOT);
+	sht3x_command_bytes(fetch_bytes, CMD_FETCH);
+	i2c_transfer_init(&command, SHT3X_ADDRESS, command_bytes, 2, 0, 0);
+	command.callback = sht3x_command_done;
+	i2c_transfer_init(&measurement, SHT3X_ADDRESS, 0, 0, single_data, 6);
+	measurement.callback = sht3x_measurement_done;
+	i2c_transfer_init(&fetch, SHT3X_ADDRESS, fetch_bytes, 2, fetch_data, 6);
+	fetch.callback = sht3x_fetch_done;
+	soft_timer_init(&conversion, sht3x_converted, 0, 0);
+	soft_timer_init(&poll, sht3x_poll, 0, 0);
+	busy = 0;
+	periodic = 0;
+
+	// Also ends a periodic mode left running by the last boot
+	status = i2c_write(SHT3X_ADDRESS, reset, 2);
+	delay_us(RESET_US);
+	return status == I2cDone;
+}
+
+int sht3x_start(void (*callback)(const DHT11_Reading *reading)) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (busy || periodic) {
+		__set_PRIMASK(primask);
+		return 0;
+	}
+	busy = 1;
+	__set_PRIMASK(primask);
+
+	single_callback = callback;
+	i2c_submit(&command);
+	return 1;
+}
+
+int sht3x_busy(void) {
+	return busy;
+}
+
+int sht3x_periodic_start(uint32_t per_second, void (*callback)(const DHT11_Reading *reading)) {
+	static uint8_t bytes[2];
+	uint32_t period_ms;
+	uint32_t i = 0;
+
+	while (i < sizeof(rates) / sizeof(rates[0]) && rates[i].per_second != per_second) {
+		i++;
+	}
+	if (i == sizeof(rates) / sizeof(rates[0]) || busy) {
+		return 0;
+	}
+	if (periodic) {
+		sht3x_periodic_stop(); // The sensor takes a new rate after a break
+	}
+
+	sht3x_command_bytes(bytes, rates[i].command);
+	if (i2c_write(SHT3X_ADDRESS, bytes, 2) != I2cDone) {
+		return 0;
+	}
+	period_ms = 1000 / per_second;
+	periodic_callback = callback;
+	periodic = 1;
+	// The first measurement ends about SHT3X_MEASURE_MS in
+	if (callback) {
+		soft_timer_start(&poll, SHT3X_MEASURE_MS, period_ms);
+	}
+	return 1;
+}
+
+void sht3x_periodic_stop(void) {
+	static const uint8_t stop[2] = { CMD_BREAK >> 8, CMD_BREAK & 0xFF };
+
+	if (!periodic) {
+		return;
+	}
+	soft_timer_stop(&poll);
+	periodic = 0;
+	i2c_wait(&fetch);
+	i2c_write(SHT3X_ADDRESS, stop, 2);
+	delay_us(RESET_US);
+}
+
+int sht3x_fetch(void (*callback)(const DHT11_Reading *reading)) {
+	return sht3x_fetch_submit(callback, 0);
+}
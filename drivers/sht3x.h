@@ -0,0 +1,83 @@
+/*!
+ * \file      sht3x.h
+ * \brief     SHT3x temperature/humidity sensor on the I2C1 transfer queue.
+ *
+ * The sensor sits at address 0x44 on PB8 (SCL) and PB9 (SDA). A
+ * measurement is two words, temperature then humidity, each followed by
+ * its CRC-8 (polynomial 0x31, start 0xFF), and every transfer runs from
+ * the I2C1 interrupts and a software timer, so the CPU is free while the
+ * sensor converts:
+ *
+ * - single shot: the command, then the 6 bytes once the conversion is
+ *   over, about 15 ms later at high repeatability;
+ * - periodic: the sensor measures by itself, 1 to 10 times a second, and
+ *   the result is fetched after each measurement;
+ * - fetch: the latest periodic result at once, without waiting for a
+ *   conversion.
+ *
+ * Results come as a DHT11_Reading, like those of dht11_capture.h, so the
+ * same callback serves both sensors. \a data holds the DHT11 layout:
+ * humidity, its tenths, temperature, its tenths with bit 7 set below
+ * 0 C, and their sum. The capture fields are zero.
+ */
+#ifndef SHT3X_H
+#define SHT3X_H
+#include <stdint.h>
+#include "dht11_capture.h"
+
+/*! 7-bit address, ADDR pin low. */
+#define SHT3X_ADDRESS    0x44
+
+/*! Wait for a single shot at high repeatability, 15.5 ms at most. On the
+ *  timer wheel it is 10 to 20 ms: a read the sensor refuses as too early
+ *  is tried again a tick later, up to SHT3X_RETRIES times. */
+#define SHT3X_MEASURE_MS 20
+
+/*! Reads of a single shot after the first. */
+#define SHT3X_RETRIES    3
+
+/*! \brief Starts I2C1 at 400 kHz and resets the sensor.
+ *  \return True (1) if the sensor answered, false (0) if not.
+ */
+int sht3x_init(void);
+
+/*! \brief Starts a single shot and returns immediately.
+ *  \param callback  Called from an interrupt once the reading is complete,
+ *                   or has failed. The reading is only valid during the
+ *                   call.
+ *  \return True (1) if it started, false (0) if a single shot is in
+ *          progress or the periodic mode runs.
+ */
+int sht3x_start(void (*callback)(const DHT11_Reading *reading));
+
+/*! \brief Checks if a single shot is in progress.
+ *  \return True (1) from sht3x_start() until the callback is called.
+ */
+int sht3x_busy(void);
+
+/*! \brief Starts the periodic mode at high repeatability.
+ *  \param per_second  Measurements a second: 1, 2, 4 or 10.
+ *  \param callback    Called from an interrupt with every new reading,
+ *                     or 0 to leave them to sht3x_fetch(). A fetch the
+ *                     sensor refuses, as it has no new measurement, is
+ *                     not reported.
+ *  \return True (1) if it started, false (0) if the rate is not one of
+ *          these or a single shot is in progress.
+ */
+int sht3x_periodic_start(uint32_t per_second, void (*callback)(const DHT11_Reading *reading));
+
+/*! \brief Stops the periodic mode. Not from an interrupt. */
+void sht3x_periodic_stop(void);
+
+/*! \brief Fetches the latest periodic measurement and returns immediately.
+ *  \param callback  Called from an interrupt with the reading; its status
+ *                   is DHT11_TIMEOUT if there was no new measurement.
+ *  \return True (1) if the fetch was queued, false (0) if the periodic
+ *          mode does not run or a fetch is queued already.
+ */
+int sht3x_fetch(void (*callback)(const DHT11_Reading *reading));
+
+/*! \brief CRC-8 of the sensor: polynomial 0x31, start 0xFF. */
+uint8_t sht3x_crc(const uint8_t *data, uint32_t length);
+
+#endif // SHT3X_H
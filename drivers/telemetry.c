@@ -0,0 +1,64 @@
+#include "checksum.h"
+#include "telemetry.h"
+#include "uart.h"
+
+/*
+ * COBS replaces every zero with the distance to the next one: the coded
+ * data is a run of blocks, each a length byte n followed by n - 1 bytes
+ * that are not zero, and the end of every block but the last (or one of
+ * 255) stands for a zero.
+ */
+
+static uint16_t sequence;
+
+uint32_t telemetry_encode(uint8_t *frame, const uint8_t *payload, uint32_t length) {
+	uint16_t crc = checksum_crc16(payload, length);
+	uint8_t last[2] = {(uint8_t)crc, (uint8_t)(crc >> 8)};
+	uint32_t block = 1; // where the length of the block goes
+	uint32_t out = 2;
+	uint8_t code = 1;
+
+	frame[0] = 0;
+	for (uint32_t i = 0; i < length + 2; i++) {
+		uint8_t byte = i < length ? payload[i] : last[i - length];
+
+		if (byte == 0) {
+			frame[block] = code;
+			block = out++;
+			code = 1;
+		} else {
+			frame[out++] = byte;
+			if (++code == 0xFF) { // A full block, no zero follows it
+				frame[block] = code;
+				block = out++;
+				code = 1;
+			}
+		}
+	}
+	frame[block] = code;
+	frame[out++] = 0;
+	return out;
+}
+
+void telemetry_send_reading(const TelemetryReading *reading) {
+	uint8_t payload[TELEMETRY_READING_SIZE];
+	uint8_t frame[TELEMETRY_FRAME_SIZE(TELEMETRY_READING_SIZE)];
+	uint32_t length;
+
+	payload[0] = TELEMETRY_READING;
+	payload[TELEMETRY_READING_SEQUENCE] = (uint8_t)sequence;
+	payload[TELEMETRY_READING_SEQUENCE + 1] = (uint8_t)(sequence >> 8);
+	for (int i = 0; i < 4; i++) {
+		payload[TELEMETRY_READING_TIME + i] = (uint8_t)(reading->time_ms >> (8 * i));
+		payload[TELEMETRY_READING_CLICKS + i] = (uint8_t)(reading->clicks >> (8 * i));
+	}
+	for (int i = 0; i < 5; i++) {
+		payload[TELEMETRY_READING_DATA + i] = reading->data[i];
+	}
+	payload[TELEMETRY_READING_STATUS] = reading->status;
+	payload[TELEMETRY_READING_MODE] = reading->mode;
+	sequence++;
+
+	length = telemetry_encode(frame, payload, sizeof(payload));
+	uart_write(frame, length);
+}
@@ -0,0 +1,69 @@
+/*!
+ * \file      telemetry.h
+ * \brief     Binary records on the UART, for a program at the other end.
+ *
+ * A record is a few bytes of payload followed by a CRC-16, sent as one
+ * COBS frame: the bytes are coded so that none of them is zero, and a
+ * zero is sent before and after the frame. A reader finds the frames
+ * between the zeros, so it can start anywhere in the stream, and text
+ * sent between frames (the terminal screen) is told apart by its CRC.
+ *
+ * Payloads start with the record type. Numbers are little endian. A
+ * reading (TELEMETRY_READING) is 18 bytes:
+ *
+ *   0  type          1  sequence (16 bits, counts every record sent)
+ *   3  time (ms, 32 bits)
+ *   7  the 5 bytes of the DHT11 frame
+ *   12 status (DHT11_StatusTypeDef)
+ *   13 mode ('A' or 'B')
+ *   14 touch sensor presses (32 bits)
+ *
+ * The CRC is the CRC-16/CCITT-FALSE of the payload (checksum_crc16()),
+ * sent low byte first.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include <stdint.h>
+
+/*! Record types, the first byte of a payload. */
+#define TELEMETRY_READING 1
+
+/*! Offsets in a reading. */
+#define TELEMETRY_READING_SEQUENCE 1
+#define TELEMETRY_READING_TIME     3
+#define TELEMETRY_READING_DATA     7
+#define TELEMETRY_READING_STATUS   12
+#define TELEMETRY_READING_MODE     13
+#define TELEMETRY_READING_CLICKS   14
+#define TELEMETRY_READING_SIZE     18
+
+/*! Longest payload. */
+#define TELEMETRY_MAX_PAYLOAD 64
+
+/*! Bytes sent for a payload of \a length bytes, at most. */
+#define TELEMETRY_FRAME_SIZE(length) ((length) + 2 + 1 + ((length) + 2) / 254 + 2)
+
+/*! A DHT11 reading, as it is sent. */
+typedef struct {
+	uint32_t time_ms;   //!< Time of the reading, since the boot.
+	uint8_t data[5];    //!< Humidity, its tenths, temperature, its tenths, checksum.
+	uint8_t status;     //!< DHT11_OK, or why the frame was rejected.
+	uint8_t mode;       //!< Mode of the system, 'A' or 'B'.
+	uint32_t clicks;    //!< Touch sensor presses since the boot.
+} TelemetryReading;
+
+/*! \brief Builds the frame of a payload: COBS coded with its CRC,
+ *         between zeros.
+ *  \param frame    Where the frame is stored, TELEMETRY_FRAME_SIZE(length) bytes.
+ *  \param payload  The record.
+ *  \param length   Its size, at most TELEMETRY_MAX_PAYLOAD.
+ *  \return Bytes of the frame.
+ */
+uint32_t telemetry_encode(uint8_t *frame, const uint8_t *payload, uint32_t length);
+
+/*! \brief Sends a reading, with the next sequence number.
+ *  \param reading  The reading.
+ */
+void telemetry_send_reading(const TelemetryReading *reading);
+
+#endif // TELEMETRY_H
@@ -1,10 +1,209 @@
 #include "platform.h"
 #include "timer.h"
 
+/*
+ * A timer due at tick t waits in slot t % TIMER_WHEEL_SLOTS. Every tick
+ * visits one slot and runs the timers in it whose tick has come; the
+ * others are at least one turn of the wheel away. Starting and stopping
+ * link and unlink a list node, so neither depends on the number of timers.
+ *
+ * The I2C and DMA handlers preempt SysTick and start and stop timers, and
+ * so may the callbacks. The tick therefore detaches the due timers from
+ * the slot with interrupts masked and runs them afterwards; a timer
+ * stopped or restarted in between loses its due mark and is not run.
+ */
+
+#define WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
 uint32_t timer_period;
 
 static void (*timer_callback)(void) = 0;
 
+static SoftTimer *wheel[TIMER_WHEEL_SLOTS];
+static volatile uint32_t ticks;
+static SoftTimer *pending_head; // deferred runs, oldest first
+static SoftTimer *pending_tail;
+static int wheel_running;
+static SoftTimer legacy_timer; // the timer of timer_init() and timer_enable()
+
+static uint32_t ms_to_ticks(uint32_t ms) {
+	return (uint32_t)(((uint64_t)ms * TIMER_TICK_HZ + 999) / 1000);
+}
+
+// The callers mask interrupts around the list operations.
+static void wheel_insert(SoftTimer *timer) {
+	SoftTimer **slot = &wheel[timer->expires & WHEEL_MASK];
+
+	timer->prev = 0;
+	timer->next = *slot;
+	if (*slot) {
+		(*slot)->prev = timer;
+	}
+	*slot = timer;
+	timer->armed = 1;
+}
+
+static void wheel_remove(SoftTimer *timer) {
+	if (timer->prev) {
+		timer->prev->next = timer->next;
+	} else {
+		wheel[timer->expires & WHEEL_MASK] = timer->next;
+	}
+	if (timer->next) {
+		timer->next->prev = timer->prev;
+	}
+	timer->next = timer->prev = 0;
+	timer->armed = 0;
+}
+
+static void pending_append(SoftTimer *timer) {
+	timer->pending_next = 0;
+	if (pending_tail) {
+		pending_tail->pending_next = timer;
+	} else {
+		pending_head = timer;
+	}
+	pending_tail = timer;
+	timer->queued = 1;
+}
+
+// Walks the pending list, which holds at most the timers that came due
+// since the main loop last ran.
+static void pending_remove(SoftTimer *timer) {
+	SoftTimer **link = &pending_head;
+	SoftTimer *previous = 0;
+
+	while (*link != timer) {
+		previous = *link;
+		link = &(*link)->pending_next;
+	}
+	*link = timer->pending_next;
+	if (pending_tail == timer) {
+		pending_tail = previous;
+	}
+	timer->pending_next = 0;
+	timer->queued = 0;
+}
+
+static void legacy_run(void *context) {
+	(void)context;
+	if (timer_callback) {
+		timer_callback();
+	}
+}
+
+void timer_wheel_init(void) {
+	if (wheel_running) {
+		return;
+	}
+	wheel_running = 1;
+	SysTick_Config(SystemCoreClock / TIMER_TICK_HZ);
+	NVIC_SetPriority(SysTick_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 2));
+}
+
+void soft_timer_init(SoftTimer *timer, void (*callback)(void *context), void *context, int deferred) {
+	// Not due_next: a handler may re-initialise a timer that the tick it
+	// preempted has detached, and the tick still follows the link
+	timer->next = timer->prev = timer->pending_next = 0;
+	timer->expires = 0;
+	timer->period = 0;
+	timer->callback = callback;
+	timer->context = context;
+	timer->deferred = (uint8_t)(deferred != 0);
+	timer->armed = 0;
+	timer->queued = 0;
+	timer->due = 0;
+}
+
+void soft_timer_start(SoftTimer *timer, uint32_t delay_ms, uint32_t period_ms) {
+	uint32_t primask = __get_PRIMASK();
+	uint32_t delay = ms_to_ticks(delay_ms);
+
+	timer_wheel_init();
+	__disable_irq();
+	soft_timer_stop(timer);
+	// A timer is due no earlier than the tick after the next one, so it
+	// never runs short by the part of the current tick already gone.
+	timer->expires = ticks + (delay ? delay : 1);
+	timer->period = ms_to_ticks(period_ms);
+	wheel_insert(timer);
+	__set_PRIMASK(primask);
+}
+
+void soft_timer_stop(SoftTimer *timer) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (timer->armed) {
+		wheel_remove(timer);
+	}
+	if (timer->queued) {
+		pending_remove(timer);
+	}
+	timer->due = 0;
+	__set_PRIMASK(primask);
+}
+
+int soft_timer_active(SoftTimer *timer) {
+	return timer->armed || timer->queued || timer->due;
+}
+
+uint32_t timer_run_deferred(void) {
+	uint32_t primask = __get_PRIMASK();
+	uint32_t count = 0;
+
+	for (;;) {
+		SoftTimer *timer;
+
+		__disable_irq();
+		timer = pending_head;
+		if (timer) {
+			pending_head = timer->pending_next;
+			if (!pending_head) {
+				pending_tail = 0;
+			}
+			timer->pending_next = 0;
+			timer->queued = 0;
+		}
+		__set_PRIMASK(primask);
+		if (!timer) {
+			return count;
+		}
+		timer->callback(timer->context);
+		count++;
+	}
+}
+
+int timer_deferred_pending(void) {
+	return pending_head != 0;
+}
+
+uint32_t timer_ticks(void) {
+	return ticks;
+}
+
+// Takes a due timer off the wheel, with interrupts masked. A periodic
+// one goes back for its next run, and a deferred one to the main loop.
+// Returns true (1) if the tick is to call it.
+static int timer_expire(SoftTimer *timer, uint32_t now) {
+	wheel_remove(timer);
+	if (timer->period) {
+		timer->expires += timer->period;
+		if ((int32_t)(timer->expires - now) <= 0) {
+			timer->expires = now + timer->period; // late, the missed runs are merged
+		}
+		wheel_insert(timer);
+	}
+	if (!timer->deferred) {
+		return 1;
+	}
+	if (!timer->queued) {
+		// Runs missed while the main loop was busy are merged into one.
+		pending_append(timer);
+	}
+	return 0;
+}
+
 void timer_init(uint32_t timestamp) {
 
 	// The timer should be able to tick anywhere from every
@@ -12,21 +211,18 @@ void timer_init(uint32_t timestamp) {
 	// the hardware is unable to divide down to a second, a
 	// software divider should be implemented.
 
-		uint32_t tick_us = (SystemCoreClock)/1e6;
-		tick_us = tick_us*timestamp;
-		SysTick_Config(tick_us);
-		NVIC_SetPriority(SysTick_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 2));
-
-	}
+	// Runs on the wheel, so the period is rounded up to whole ticks.
+	soft_timer_stop(&legacy_timer);
+	timer_period = timestamp;
+	soft_timer_init(&legacy_timer, legacy_run, 0, 0);
+}
 
 void timer_enable(void) {
-	 SysTick->CTRL  = SysTick_CTRL_CLKSOURCE_Msk |
-                   SysTick_CTRL_TICKINT_Msk   |
-                   SysTick_CTRL_ENABLE_Msk;
+	soft_timer_start(&legacy_timer, timer_period / 1000, timer_period / 1000);
 }
 
 void timer_disable(void) {
-	SysTick->CTRL  &= ~SysTick_CTRL_ENABLE_Msk;
+	soft_timer_stop(&legacy_timer);
 }
 
 void timer_set_callback(void (*callback)(void)) {
@@ -39,12 +235,45 @@ void timer_set_callback(void (*callback)(void)) {
 	// according to the period specified by the previous call
 	// of timer_init.
 	timer_callback = callback;
-
 }
 
 void SysTick_Handler(void)
 {
-	timer_callback();
+	uint32_t primask = __get_PRIMASK();
+	SoftTimer *due = 0;
+	SoftTimer **due_tail = &due;
+	SoftTimer *timer;
+	uint32_t now;
+
+	__disable_irq();
+	now = ++ticks;
+	timer = wheel[now & WHEEL_MASK];
+	while (timer) {
+		SoftTimer *next = timer->next;
+		// A late timer still runs
+		if ((int32_t)(now - timer->expires) >= 0 && timer_expire(timer, now)) {
+			timer->due = 1;
+			timer->due_next = 0;
+			*due_tail = timer;
+			due_tail = &timer->due_next;
+		}
+		timer = next;
+	}
+	__set_PRIMASK(primask);
+
+	while (due) {
+		int run;
+
+		__disable_irq();
+		timer = due;
+		due = timer->due_next;
+		run = timer->due;
+		timer->due = 0;
+		__set_PRIMASK(primask);
+		if (run) {
+			timer->callback(timer->context);
+		}
+	}
 }
 
 // *******************************ARM University Program Copyright � ARM Ltd 2016*************************************
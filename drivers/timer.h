@@ -2,16 +2,47 @@
  * \file      timer.h
  * \brief     Controller for a hardware timer module.
  * \copyright ARM University Program &copy; ARM Ltd 2014.
+ *
+ * SysTick ticks a hashed timer wheel, which runs any number of software
+ * timers: one-shot or periodic, started and stopped in constant time.
+ * A timer's callback runs in the SysTick handler, or is deferred to the
+ * main loop: event_loop() calls timer_run_deferred().
+ * The original single periodic callback (timer_init(), timer_enable(),
+ * timer_set_callback()) is one such timer.
  */
 #ifndef TIMER_H
 #define TIMER_H
 #include <stdint.h>
 
+/*! Tick rate of the wheel; timer periods are rounded up to whole ticks. */
+#define TIMER_TICK_HZ 100
+
+/*! Slots of the wheel, a power of two. A timer due further away than
+ *  this many ticks waits in its slot for the extra turns. */
+#define TIMER_WHEEL_SLOTS 64
+
+/*! A software timer. Allocated by the user, usually static, and only
+ *  modified through the functions below. */
+typedef struct SoftTimer {
+	struct SoftTimer *next;         //!< Next timer in the same slot.
+	struct SoftTimer *prev;         //!< Previous timer in the same slot.
+	struct SoftTimer *pending_next; //!< Next timer waiting for timer_run_deferred().
+	struct SoftTimer *due_next;     //!< Next timer the current tick runs.
+	uint32_t expires;               //!< Tick the timer is due at.
+	uint32_t period;                //!< Ticks between runs, 0 for a one-shot.
+	void (*callback)(void *context); //!< Called when the timer is due.
+	void *context;                  //!< Passed to the callback.
+	uint8_t deferred;               //!< Callback runs in timer_run_deferred().
+	volatile uint8_t armed;         //!< In a slot of the wheel.
+	volatile uint8_t queued;        //!< Due, waiting for timer_run_deferred().
+	volatile uint8_t due;           //!< Detached by the current tick, not yet run.
+} SoftTimer;
+
 /*! \brief Initialises the timer with a specified period.
- *  \param period  Period of the timer tick (in cpu \a cycles). 
+ *  \param period  Period of the timer tick (in cpu \a cycles).
  */
- 
-void timer_irq_handler(void); 
+
+void timer_irq_handler(void);
 void timer_init(uint32_t timestamp);
 
 /*! \brief Pass a callback to the API, which is executed during the
@@ -26,6 +57,49 @@ void timer_enable(void);
 /*! \brief Disables the timer. */
 void timer_disable(void);
 
+/*! \brief Starts the SysTick at TIMER_TICK_HZ. Called by the functions
+ *         below when needed; calling it again has no effect.
+ */
+void timer_wheel_init(void);
+
+/*! \brief Prepares a software timer. Must be called before any other use.
+ *  \param timer     Timer to prepare.
+ *  \param callback  Function called when the timer is due.
+ *  \param context   Passed to the callback.
+ *  \param deferred  False (0) to call the callback from the SysTick
+ *                   handler, true (1) to leave it to timer_run_deferred().
+ */
+void soft_timer_init(SoftTimer *timer, void (*callback)(void *context), void *context, int deferred);
+
+/*! \brief Starts, or restarts, a software timer.
+ *  \param timer      Timer to start.
+ *  \param delay_ms   Time to the first run.
+ *  \param period_ms  Time between the following runs, 0 for a one-shot.
+ */
+void soft_timer_start(SoftTimer *timer, uint32_t delay_ms, uint32_t period_ms);
+
+/*! \brief Stops a software timer, including a deferred run not yet made.
+ *  \param timer  Timer to stop.
+ */
+void soft_timer_stop(SoftTimer *timer);
+
+/*! \brief Checks if a software timer is started or has a run pending.
+ *  \param timer  Timer to check.
+ */
+int soft_timer_active(SoftTimer *timer);
+
+/*! \brief Runs the deferred callbacks that are due, in the order they
+ *         became due. Called from the main loop.
+ *  \return Number of callbacks run.
+ */
+uint32_t timer_run_deferred(void);
+
+/*! \brief Checks if deferred callbacks are waiting for timer_run_deferred(). */
+int timer_deferred_pending(void);
+
+/*! \brief Ticks since the wheel started, at TIMER_TICK_HZ. */
+uint32_t timer_ticks(void);
+
 #endif // TIMER_H
 
 // *******************************ARM University Program Copyright  ARM Ltd 2016*************************************   
\ No newline at end of file
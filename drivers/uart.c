@@ -3,8 +3,29 @@
 #include "STM32F4xx_RCC.h"
 #include "STM32F4xx_USART.h"
 #include "STM32F4xx_GPIO.h"
+#include "queue.h"
+#include <string.h>
+
+#define TX_FLAGS (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6)
+#define RX_FLAGS (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
 
 static void (*UART_callback)(uint8_t);
+static void (*RX_callback)(const uint8_t *, uint32_t);
+static void (*TX_callback)(UartTxEvent);
+
+// Receive buffer, filled in circles by the DMA. rx_read is where the
+// characters not yet handed to the callback start.
+static uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static uint32_t rx_read;
+static UartRxStats rx_stats;
+
+// Transmit buffer. The DMA reads straight out of it and the characters
+// are committed once the transfer is complete.
+static uint8_t tx_storage[UART_TX_BUFFER_SIZE];
+static Queue tx_queue;
+static volatile uint32_t tx_chunk;  // characters in the running DMA transfer
+static uint32_t tx_high_watermark = UART_TX_BUFFER_SIZE;
+static int tx_above_watermark;
 
 void uart_init(uint32_t baud) {
 	GPIO_InitTypeDef GPIO_InitStructure;
@@ -43,16 +64,219 @@ void uart_init(uint32_t baud) {
   USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
   USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
   USART_Init(USART2, &USART_InitStructure);
+	
+  /*-------------------------- DMA Configuration -----------------------------*/
+  /* DMA1 Stream6 channel 4 (USART2_TX) drains the transmit buffer, one
+     contiguous span of it per transfer */
+  queue_init(&tx_queue, tx_storage, UART_TX_BUFFER_SIZE);
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+  DMA1_Stream6->CR = 0;
+  while (DMA1_Stream6->CR & DMA_SxCR_EN) {
+  }
+  DMA1->HIFCR = TX_FLAGS;
+  DMA1_Stream6->PAR = (uint32_t)(uintptr_t)&USART2->DR;
+  DMA1_Stream6->FCR = 0; // Direct mode, byte by byte
+  DMA1_Stream6->CR = DMA_SxCR_CHSEL_2 |  // Channel 4
+                     DMA_SxCR_DIR_0 |    // Memory to peripheral
+                     DMA_SxCR_MINC |
+                     DMA_SxCR_PL_0 |
+                     DMA_SxCR_TCIE;
+  USART2->CR3 |= USART_CR3_DMAT;
+	
+  NVIC_SetPriority(DMA1_Stream6_IRQn, 1);
+  NVIC_ClearPendingIRQ(DMA1_Stream6_IRQn);
+  NVIC_EnableIRQ(DMA1_Stream6_IRQn);
 }
 
 void uart_enable(void) {
 	USART_Cmd(USART2, ENABLE);
 }
 
+// Starts a transfer of the queued characters if none is running.
+// Called with interrupts disabled.
+static void uart_tx_start(void) {
+	uint8_t *span;
+	uint32_t count;
+	
+	if (tx_chunk) {
+		return;
+	}
+	count = queue_peek(&tx_queue, &span); // Up to the end of the buffer, the rest follows
+	if (!count) {
+		return;
+	}
+	tx_chunk = count;
+	
+	USART2->SR = (uint16_t)~USART_SR_TC; // TC is set again after the last character
+	DMA1->HIFCR = TX_FLAGS;
+	DMA1_Stream6->M0AR = (uint32_t)(uintptr_t)span;
+	DMA1_Stream6->NDTR = count;
+	DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+// Retires a finished transfer and starts the next one.
+// Called from the interrupt handler, or with interrupts disabled.
+static void uart_tx_service(void) {
+	if (!READ_BIT(DMA1->HISR, DMA_HISR_TCIF6)) {
+		return;
+	}
+	DMA1->HIFCR = TX_FLAGS;
+	NVIC_ClearPendingIRQ(DMA1_Stream6_IRQn);
+	
+	queue_commit(&tx_queue, tx_chunk);
+	tx_chunk = 0;
+	uart_tx_start();
+	
+	if (queue_count(&tx_queue) <= tx_high_watermark) {
+		tx_above_watermark = 0;
+	}
+	if (!tx_chunk && TX_callback) {
+		TX_callback(TxDrained);
+	}
+}
+
+// Waits for the running transfer with interrupts disabled. WFI still
+// wakes on the pending DMA interrupt, which is then served here.
+static void uart_tx_wait(uint32_t primask) {
+	__WFI();
+	uart_tx_service();
+	__set_PRIMASK(primask); // Let the other pending handlers run
+	__disable_irq();
+}
+
+static void uart_tx_write(const uint8_t *data, uint32_t length) {
+	uint32_t primask = __get_PRIMASK();
+	int high_water = 0;
+	
+	__disable_irq();
+	while (length) {
+		uint32_t count;
+		
+		if (queue_is_full(&tx_queue)) {
+			// Buffer full, wait for the DMA to make room
+			uart_tx_start();
+			uart_tx_wait(primask);
+			continue;
+		}
+		count = UART_TX_BUFFER_SIZE - queue_count(&tx_queue);
+		if (count > length) count = length;
+		queue_enqueue_bulk(&tx_queue, data, count);
+		data += count;
+		length -= count;
+	}
+	uart_tx_start();
+	
+	if (!tx_above_watermark && queue_count(&tx_queue) > tx_high_watermark) {
+		tx_above_watermark = 1;
+		high_water = 1;
+	}
+	__set_PRIMASK(primask);
+	
+	if (high_water && TX_callback) {
+		TX_callback(TxHighWater);
+	}
+}
+
 void uart_print(char *string) {
-	while(*string) {
-    uart_tx(*string++);
-  }
+	uart_tx_write((const uint8_t *)string, strlen(string));
+}
+
+void uart_write(const void *data, uint32_t length) {
+	uart_tx_write((const uint8_t *)data, length);
+}
+
+void uart_flush(void) {
+	uint32_t primask = __get_PRIMASK();
+	
+	__disable_irq();
+	while (!queue_is_empty(&tx_queue)) {
+		uart_tx_start();
+		uart_tx_wait(primask);
+	}
+	__set_PRIMASK(primask);
+	
+	while(USART_GetFlagStatus(USART2, USART_FLAG_TC) == RESET) {
+	}		// Wait for the last character to leave the shift register
+}
+
+uint32_t uart_tx_pending(void) {
+	return queue_count(&tx_queue);
+}
+
+void uart_set_tx_callback(void (*callback)(UartTxEvent event), uint32_t high_watermark) {
+	TX_callback = callback;
+	tx_high_watermark = high_watermark;
+}
+
+static void uart_rx_deliver(const uint8_t *data, uint32_t length) {
+	rx_stats.received += length;
+	if (RX_callback) {
+		RX_callback(data, length);
+	} else if (UART_callback) {
+		while (length--) {
+			UART_callback(*data++);
+		}
+	}
+}
+
+// Starts reception into rx_buffer through DMA1 Stream5 channel 4
+// (USART2_RX). The buffer is refilled in circles; the characters are
+// handed over when it is half full, full, or the line goes idle.
+static void uart_rx_start(void) {
+	DMA1_Stream5->CR = 0;
+	while (DMA1_Stream5->CR & DMA_SxCR_EN) {
+	}
+	DMA1->HIFCR = RX_FLAGS;
+	rx_read = 0;
+	DMA1_Stream5->PAR = (uint32_t)(uintptr_t)&USART2->DR;
+	DMA1_Stream5->M0AR = (uint32_t)(uintptr_t)rx_buffer;
+	DMA1_Stream5->NDTR = UART_RX_BUFFER_SIZE;
+	DMA1_Stream5->FCR = 0; // Direct mode
+	DMA1_Stream5->CR = DMA_SxCR_CHSEL_2 |  // Channel 4
+	                   DMA_SxCR_MINC |
+	                   DMA_SxCR_CIRC |
+	                   DMA_SxCR_PL_1 |     // Ahead of the transmit stream
+	                   DMA_SxCR_HTIE |
+	                   DMA_SxCR_TCIE;
+	DMA1_Stream5->CR |= DMA_SxCR_EN;
+	
+	USART2->CR3 |= USART_CR3_DMAR;
+	USART2->CR1 = (USART2->CR1 & ~USART_CR1_RXNEIE) | USART_CR1_IDLEIE;
+	
+	NVIC_SetPriority(DMA1_Stream5_IRQn, 1);
+	NVIC_ClearPendingIRQ(DMA1_Stream5_IRQn);
+	NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+}
+
+// Hands the characters received since the last call to the callback.
+// Runs in the USART2 and DMA1 Stream5 handlers, which share a priority.
+static void uart_rx_service(void) {
+	uint32_t flags = DMA1->HISR & (DMA_HISR_HTIF5 | DMA_HISR_TCIF5);
+	uint32_t position;
+	
+	// Clear the flags before sampling the position, so that a half or
+	// full mark passed afterwards shows up on the next call.
+	DMA1->HIFCR = RX_FLAGS;
+	NVIC_ClearPendingIRQ(DMA1_Stream5_IRQn);
+	position = (UART_RX_BUFFER_SIZE - DMA1_Stream5->NDTR) & (UART_RX_BUFFER_SIZE - 1);
+	
+	// Both marks passed and the DMA is ahead of rx_read again: it went
+	// round the whole buffer and wrote over characters never handed over.
+	if (flags == (DMA_HISR_HTIF5 | DMA_HISR_TCIF5) && position > rx_read) {
+		rx_stats.overflows++;
+	}
+	if (position == rx_read) {
+		return;
+	}
+	if (position > rx_read) {
+		uart_rx_deliver(&rx_buffer[rx_read], position - rx_read);
+	} else {
+		uart_rx_deliver(&rx_buffer[rx_read], UART_RX_BUFFER_SIZE - rx_read);
+		if (position) {
+			uart_rx_deliver(rx_buffer, position);
+		}
+	}
+	rx_read = position;
 }
 
 void uart_set_rx_callback(void (*callback)(uint8_t)) {
@@ -66,7 +290,8 @@ void uart_set_rx_callback(void (*callback)(uint8_t)) {
 	// parameter equalling the received character.
 	
 	UART_callback = callback;
-	USART2->CR1|=USART_CR1_RXNEIE;
+	RX_callback = 0;
+	uart_rx_start();
 	
 	//Enable the USART interrupt
 	__enable_irq();
@@ -75,10 +300,22 @@ void uart_set_rx_callback(void (*callback)(uint8_t)) {
 	NVIC_EnableIRQ(USART2_IRQn);
 }
 
+void uart_set_rx_span_callback(void (*callback)(const uint8_t *data, uint32_t length)) {
+	RX_callback = callback;
+	UART_callback = 0;
+	uart_rx_start();
+	
+	NVIC_SetPriority(USART2_IRQn,1);
+	NVIC_ClearPendingIRQ(USART2_IRQn);
+	NVIC_EnableIRQ(USART2_IRQn);
+}
+
+void uart_get_rx_stats(UartRxStats *stats) {
+	*stats = rx_stats;
+}
+
 void uart_tx(uint8_t c) {
-	while(USART_GetFlagStatus(USART2, USART_FLAG_TXE) == RESET) {
-	}		// Wait for Empty
-  USART_SendData(USART2, c); // Echo Char
+	uart_tx_write(&c, 1);
 }
 
 uint8_t uart_rx(void) {
@@ -90,11 +327,25 @@ uint8_t uart_rx(void) {
 }
 
 void USART2_IRQHandler(void){
+	uint32_t status = USART2->SR;
+	
 	NVIC_ClearPendingIRQ(USART2_IRQn);
-	if (READ_BIT(USART2->SR, USART_SR_RXNE)) {
-		// received a character
-		UART_callback(uart_rx());
+	if (status & (USART_SR_IDLE | USART_SR_ORE)) {
+		// Reading DR after SR clears both; the DMA has already taken the character
+		(void)USART2->DR;
+		if (status & USART_SR_ORE) {
+			rx_stats.overruns++;
+		}
+		uart_rx_service();
 	}
 }
 
+void DMA1_Stream5_IRQHandler(void) {
+	uart_rx_service();
+}
+
+void DMA1_Stream6_IRQHandler(void) {
+	uart_tx_service();
+}
+
 // *******************************ARM University Program Copyright © ARM Ltd 2016*************************************   
@@ -7,6 +7,26 @@
 #define UART_H
 #include <stdint.h>
 
+/*! Size of the transmit buffer in bytes, a power of two. */
+#define UART_TX_BUFFER_SIZE 1024
+
+/*! Size of the receive buffer in bytes, a power of two. The callback
+ *  must run at least once per half of it: 11 ms at 115200 baud. */
+#define UART_RX_BUFFER_SIZE 256
+
+/*! Receive counters, see uart_get_rx_stats(). */
+typedef struct {
+	uint32_t received;  //!< Characters handed to the receive callback.
+	uint32_t overruns;  //!< Characters lost in the UART (overrun error).
+	uint32_t overflows; //!< Times the receive buffer was overwritten before it was handed over.
+} UartRxStats;
+
+/*! Events reported by the transmit callback. */
+typedef enum {
+	TxHighWater, //!< The buffered output rose above the high watermark.
+	TxDrained    //!< The buffer is empty, every byte was handed to the UART.
+} UartTxEvent;
+
 /*! \brief Initialises the UART controller.
  *  \param baud  Baud rate to be used (symbols per second).
  */
@@ -16,7 +36,9 @@ void uart_init(uint32_t baud);
  */
 void uart_enable(void);
 
-/*! \brief Transmit a single character.
+/*! \brief Queues a single character for transmission.
+ *  Returns immediately unless the transmit buffer is full, in which
+ *  case it waits for the DMA to make room.
  *  \param c  Character to be sent.
  */
 void uart_tx(uint8_t c);
@@ -24,22 +46,67 @@ void uart_tx(uint8_t c);
 /*! \brief Receive a single character.
  *  \warning This function blocks until a character is
  *           available. For a non-blocking receive, see
- *           uart_set_rx_callback().
+ *           uart_set_rx_callback(). It must not be used once
+ *           a receive callback is set.
  *  \return Received character.
  */
 uint8_t uart_rx(void);
 
-/*! \brief Transmit a null terminated string.
+/*! \brief Queues a null terminated string for transmission.
+ *  The string is copied into the transmit buffer, which DMA1 Stream6
+ *  drains in the background. Like uart_tx() it only waits when the
+ *  buffer is full, and may be called with interrupts disabled.
  *  \param str  String to be sent.
  */
 void uart_print(char *str);
 
+/*! \brief Queues \a length bytes for transmission, like uart_print().
+ *  They are copied into the transmit buffer together, not one
+ *  uart_tx() at a time.
+ *  \param data    Bytes to be sent.
+ *  \param length  Number of bytes.
+ */
+void uart_write(const void *data, uint32_t length);
+
+/*! \brief Waits until every queued character has left the transmitter.
+ */
+void uart_flush(void);
+
+/*! \brief Number of characters queued and not yet handed to the UART.
+ */
+uint32_t uart_tx_pending(void);
+
+/*! \brief Passes a callback function to the API which is executed when
+ *         the queued output rises above \a high_watermark characters
+ *         (TxHighWater) and when the transmit buffer runs empty (TxDrained).
+ *  \note  TxDrained is reported from the DMA interrupt handler.
+ *  \param callback        Callback function.
+ *  \param high_watermark  Fill level reported as TxHighWater.
+ */
+void uart_set_tx_callback(void (*callback)(UartTxEvent event), uint32_t high_watermark);
+
 /*! \brief Passes a callback function to the API which is executed during
- *         the receive interrupt handler.
+ *         the receive interrupt handler, once per received character.
  *  \param callback  Callback function.
  */
 void uart_set_rx_callback(void (*callback)(uint8_t c));
 
+/*! \brief Passes a callback function to the API which is executed during
+ *         the receive interrupt handlers with every run of received
+ *         characters. Reception runs through DMA into a circular buffer;
+ *         the callback is called when the line goes idle after a burst
+ *         and when the buffer is half or completely full, so a burst of
+ *         any length costs a few interrupts instead of one per character.
+ *         The data is only valid during the call.
+ *  \param callback  Callback function.
+ */
+void uart_set_rx_span_callback(void (*callback)(const uint8_t *data, uint32_t length));
+
+/*! \brief Copies the receive counters.
+ *  \param stats  Where the counters are stored.
+ */
+void uart_get_rx_stats(UartRxStats *stats);
+
 #endif // UART_H
 
 // *******************************ARM University Program Copyright © ARM Ltd 2016*************************************   
@@ -0,0 +1,41 @@
+#include "hasher.h"
+
+static const uint8_t digit_values[10] = {5, 12, 7, 6, 4, 11, 6, 3, 10, 23};
+
+uint32_t map_reference(const char *string) {
+	const uint8_t *c = (const uint8_t *)string;
+	uint32_t result = 0;
+
+	for (; *c != '\0'; c++) {
+		if (*c >= 'A' && *c <= 'Z') {
+			result += 2u * *c;
+		} else if (*c >= 'a' && *c <= 'z') {
+			result += (uint32_t)(*c - 'a') * (uint32_t)(*c - 'a');
+		} else if (*c >= '0' && *c <= '9') {
+			result += digit_values[*c - '0'];
+		}
+		result++; // Every character counts for the length
+	}
+	return result;
+}
+
+uint32_t reduce_reference(uint32_t number) {
+	uint32_t sum = 0;
+
+	do {
+		sum += number % 10;
+		number /= 10;
+	} while (number > 0);
+	return sum > 9 ? sum % 7 : sum;
+}
+
+uint64_t fibonacci_reference(uint32_t n) {
+	uint64_t a = 0, b = 1;
+
+	while (n-- > 0) {
+		uint64_t next = a + b;
+		a = b;
+		b = next;
+	}
+	return a;
+}
@@ -0,0 +1,86 @@
+/*!
+ * \file      hasher.h
+ * \brief     Hashing and arithmetic routines of hasher.s.
+ *
+ * map() gives every character of a string a value and adds them up:
+ * twice its code for a capital letter, the square of its place in the
+ * alphabet for a small letter ('a' is 0), a value from the table
+ * 5, 12, 7, 6, 4, 11, 6, 3, 10, 23 for a digit and nothing for anything
+ * else, plus 1 for each character, so that the length is counted too.
+ *
+ * hasher.s takes four characters a word and looks them up in a table of
+ * 256 entries; map_reference() is the same function a character at a
+ * time in C, to check it against.
+ *
+ * reduce() adds up the decimal digits of a number, and takes a sum of
+ * two digits modulo 7. The fibonacci functions give F(n), with F(0) = 0
+ * and F(1) = 1, by fast doubling: a few multiplications per bit of n.
+ * The *_reference() functions compute the same in plain C.
+ *
+ * reduce_sdiv() and fibonacci_recursive() are the versions these
+ * replaced, a division per digit and a call per Fibonacci number below
+ * n, kept for the benchmarks to compare.
+ */
+#ifndef HASHER_H
+#define HASHER_H
+#include <stdint.h>
+
+/*! \brief Hash of a string, in assembly.
+ *  \param string  Null terminated string, at any alignment.
+ *  \return The sum described above, modulo 2^32.
+ */
+uint32_t map(const char *string);
+
+/*! \brief map() in C, a character at a time.
+ *  \param string  Null terminated string.
+ *  \return Same as map().
+ */
+uint32_t map_reference(const char *string);
+
+/*! \brief Sum of the decimal digits of a number, modulo 7 if it has two
+ *         digits itself.
+ *  \param number  Any number.
+ *  \return The sum, from 0 to 9.
+ */
+uint32_t reduce(uint32_t number);
+
+/*! \brief reduce() in C, with divisions.
+ *  \param number  Any number.
+ *  \return Same as reduce().
+ */
+uint32_t reduce_reference(uint32_t number);
+
+/*! \brief Fibonacci number, modulo 2^32: exact up to n = 47.
+ *  \param n  Index of the number.
+ */
+uint32_t fibonacci(uint32_t n);
+
+/*! \brief Fibonacci number, modulo 2^64: exact up to n = 93.
+ *  \param n  Index of the number.
+ */
+uint64_t fibonacci64(uint32_t n);
+
+/*! \brief Fibonacci number modulo m.
+ *  \param n  Index of the number.
+ *  \param m  Modulus, from 1 to 65536.
+ */
+uint32_t fibonacci_mod(uint32_t n, uint32_t m);
+
+/*! \brief fibonacci64() in C, a number at a time.
+ *  \param n  Index of the number.
+ */
+uint64_t fibonacci_reference(uint32_t n);
+
+/*! \brief The former reduce(), with SDIV.
+ *  \param number  Below 2^31.
+ *  \return Same as reduce().
+ */
+uint32_t reduce_sdiv(uint32_t number);
+
+/*! \brief The former fibonacci(), recursive: takes 2F(n + 1) - 1 calls.
+ *  \param n  Index of the number, 30 at most for the time it takes.
+ *  \return Same as fibonacci().
+ */
+uint32_t fibonacci_recursive(uint32_t n);
+
+#endif // HASHER_H
@@ -1,140 +1,358 @@
-	.data
-table:
-    .word 5, 12, 7, 6, 4, 11, 6, 3, 10, 23	// Define the table of values
+	.section .rodata
+	.p2align	1
+// What each character adds to the result of map(): 1 for its length, plus
+// twice a capital letter, the square of the place of a small letter in the
+// alphabet ('a' is 0), or the value of a digit in 5, 12, 7, 6, 4, 11, 6, 3, 10, 23
+map_table:
+	.set	c, 0
+	.rept	256
+	.if (c >= 65) && (c <= 90)		// 'A' to 'Z'
+	.hword	2 * c + 1
+	.elseif (c >= 97) && (c <= 122)	// 'a' to 'z'
+	.hword	(c - 97) * (c - 97) + 1
+	.elseif c == 48
+	.hword	5 + 1
+	.elseif c == 49
+	.hword	12 + 1
+	.elseif c == 50
+	.hword	7 + 1
+	.elseif c == 51
+	.hword	6 + 1
+	.elseif c == 52
+	.hword	4 + 1
+	.elseif c == 53
+	.hword	11 + 1
+	.elseif c == 54
+	.hword	6 + 1
+	.elseif c == 55
+	.hword	3 + 1
+	.elseif c == 56
+	.hword	10 + 1
+	.elseif c == 57
+	.hword	23 + 1
+	.else
+	.hword	1
+	.endif
+	.set	c, c + 1
+	.endr
 
 	.text
 	.global		map
 	.global		reduce
 	.global     fibonacci
+	.global     fibonacci64
+	.global     fibonacci_mod
+	.global     reduce_sdiv
+	.global     fibonacci_recursive
 	.global     crc_like_checksum
 	.p2align	2
 	.type		map, %function
 	.type		reduce, %function
 	.type       fibonacci, %function
+	.type       fibonacci64, %function
+	.type       fibonacci_mod, %function
+	.type       reduce_sdiv, %function
+	.type       fibonacci_recursive, %function
 	.type       crc_like_checksum, %function
 		
 
+// Same result as map_reference() in hasher.c, four characters a word: the
+// characters are looked up in map_table instead of compared, and a word is
+// checked for the terminating zero with (word - 0x01010101) & ~word & 0x80808080,
+// which is not zero only if one of its bytes is
 map:
 	.fnstart
-	mov		R1, R0		// R0 by convention holds the return value, therefore its current value (first argument) is transfered to R1
-	mov		R0, #0
-	ldr     R4, =table	// Load the address of 'table' into R4
-
-loop:
-	ldrb	R2, [R1], #1	// Load byte from R1, which is the currect character of the string and increament R1 by 1
-	cmp		R2, #0			// If it is the null character ('\0')
-	beq		done			// exit the function and return the result
-
-capital:
-	cmp		R2, #65			// If it is lower than 65 ('A')
-	blt		number			// it could only be a number
-	cmp		R2, #90			// If it is higher than 90 ('Z')
-	bgt		small			// it could only be a small letter
-	lsl		R3, R2, #1		// Bitwise sift to the left for a fast multiplication with 2
-	add		R0, R0, R3		// Accumulate the result
-	b		increament
-
-small:
-	cmp		R2, #97
-	blt		increament
-	cmp		R2, #122
-	bgt		increament
-	sub		R3, R2, #97				// Subtract 'a' (97) from the value of R2
-	mla		R0, R3, R3, R0			// Multiply and accumulate the result
-	b		increament
-
-number:
-	cmp		R2, #48
-	blt		increament
-	cmp		R2, #57
-	bgt		increament
-	sub		R2, R2, #48				// Standarize for index use
-	lsl		R2, R2, #2				// word = 4 bytes
-	ldr		R3, [R4, R2]	// Load the value for the number of the corresponding index (scale the index by the WORD size)
-	add		R0, R0, R3				// Accumulate the result
-	b		increament
-
-increament:
-	add		R0, R0, #1				// Add 1 for each character accessed to compute the length
-	b		loop
-	
-done:
-	bx		LR
+	push	{r4-r6, lr}
+	mov		r1, r0				// r1 walks the string, r0 holds the result
+	mov		r0, #0
+	ldr		r2, =map_table
+
+map_align:
+	tst		r1, #3				// Up to a word boundary a byte at a time, so that a word
+	beq		map_words			// never reads past the page of the terminator
+	ldrb	r3, [r1], #1
+	cbz		r3, map_done
+	ldrh	r3, [r2, r3, lsl #1]
+	add		r0, r0, r3
+	b		map_align
+
+map_words:
+	mov		r12, #0x01010101
+
+map_word:
+	ldr		r3, [r1], #4
+	sub		r4, r3, r12
+	bic		r4, r4, r3
+	tst		r4, r12, lsl #7		// 0x80808080: is one of the bytes zero?
+	bne		map_last
+	uxtb	r4, r3				// Four characters, least significant first
+	ubfx	r5, r3, #8, #8
+	ubfx	r6, r3, #16, #8
+	lsr		r3, r3, #24
+	ldrh	r4, [r2, r4, lsl #1]	// Loads in a row take a cycle each
+	ldrh	r5, [r2, r5, lsl #1]
+	ldrh	r6, [r2, r6, lsl #1]
+	ldrh	r3, [r2, r3, lsl #1]
+	add		r0, r0, r4
+	add		r5, r5, r6
+	add		r0, r0, r3
+	add		r0, r0, r5
+	b		map_word
+
+map_last:
+	sub		r1, r1, #4			// The word with the terminator, a byte at a time
+map_byte:
+	ldrb	r3, [r1], #1
+	cbz		r3, map_done
+	ldrh	r3, [r2, r3, lsl #1]
+	add		r0, r0, r3
+	b		map_byte
+
+map_done:
+	pop		{r4-r6, pc}
 	.fnend
 	
+// Same result as reduce_reference() in hasher.c. A quotient by 10 is the high
+// word of x * 0xCCCCCCCD (2^35 / 10, rounded up) shifted right by 3, exact for
+// any 32-bit x, so the digits take no division
 reduce:
 	.fnstart
+	cmp		r0, #10					// The number is unsigned
+	blo		reduce_done				// A single digit is returned as it is
+	mov		r1, r0
+	mov		r0, #0
+	ldr		r12, =0xCCCCCCCD
+
+reduce_digit:
+	umull	r3, r2, r1, r12
+	lsr		r2, r2, #3				// r2 = r1 / 10
+	add		r3, r2, r2, lsl #2
+	sub		r3, r1, r3, lsl #1		// r3 = r1 - 10 * r2, the last digit
+	add		r0, r0, r3
+	mov		r1, r2					// Keep only the quotient and repeat
+	cmp		r1, #10					// while it has more than one digit
+	bhs		reduce_digit
+	add		r0, r0, r1				// The first digit
+
+	cmp		r0, #9					// A sum of two digits is taken modulo 7; the high word
+	ble		reduce_done				// of x * 0x24924925 (2^32 / 7, rounded up) is x / 7
+	ldr		r12, =0x24924925		// for any x below 2^30, and digit sums are below 100
+	umull	r3, r2, r0, r12
+	rsb		r2, r2, r2, lsl #3
+	sub		r0, r0, r2
+
+reduce_done:
+	bx		lr
+	.fnend
+	
+
+// fibonacci(n) by fast doubling, from the top bit of n down: with a = F(k) and
+// b = F(k + 1),
+//     F(2k) = a * (2b - a)        F(2k + 1) = a^2 + b^2
+// so one step per bit of n instead of a call per Fibonacci number below it.
+// The result is F(n) modulo 2^32 (as the recursive version gave), which is
+// exact up to n = 47; fibonacci64() is exact up to n = 93
+fibonacci:
+	.fnstart
+	mov		r1, #0					// a = F(0)
+	mov		r2, #1					// b = F(1)
+	clz		r3, r0
+	lsl		r0, r0, r3				// The top bit of n in bit 31
+	rsb		r3, r3, #32				// and the number of bits in r3
+	cbz		r3, fib_done			// n = 0
+
+fib_bit:
+	rsb		r12, r1, r2, lsl #1
+	mul		r12, r12, r1			// r12 = F(2k)
+	mul		r1, r1, r1
+	mla		r2, r2, r2, r1			// r2 = F(2k + 1)
+	lsls	r0, r0, #1				// The next bit of n in the carry
+	ite		cs
+	movcs	r1, r2					// 1: k = 2k + 1, a = F(2k + 1), b = F(2k) + F(2k + 1)
+	movcc	r1, r12					// 0: k = 2k, a = F(2k), b = F(2k + 1)
+	it		cs
+	addcs	r2, r2, r12
+	subs	r3, r3, #1
+	bne		fib_bit
+
+fib_done:
+	mov		r0, r1
+	bx		lr
+	.fnend
+
+
+// fibonacci() with 64-bit numbers: a in r2:r3, b in r4:r5, F(2k) in r8:r9,
+// low word first. Products keep their low 64 bits: the low words by umull,
+// plus the two cross products in the high word
+fibonacci64:
+	.fnstart
+	push	{r4-r11, lr}
+	mov		r2, #0					// a = F(0)
+	mov		r3, #0
+	mov		r4, #1					// b = F(1)
+	mov		r5, #0
+	clz		r7, r0
+	lsl		r6, r0, r7				// The top bit of n in bit 31
+	rsb		r7, r7, #32				// and the number of bits in r7
+	cbz		r7, fib64_done
+
+fib64_bit:
+	adds	r10, r4, r4				// r10:r11 = 2b - a
+	adc		r11, r5, r5
+	subs	r10, r10, r2
+	sbc		r11, r11, r3
+	umull	r8, r9, r2, r10			// r8:r9 = F(2k) = a * (2b - a)
+	mla		r9, r2, r11, r9
+	mla		r9, r3, r10, r9
+	umull	r10, r11, r2, r2		// r10:r11 = a^2
+	mul		r12, r2, r3
+	add		r11, r11, r12, lsl #1
+	umull	r12, lr, r4, r4			// r12:lr = b^2
+	mul		r5, r4, r5
+	add		lr, lr, r5, lsl #1
+	adds	r4, r10, r12			// b = F(2k + 1)
+	adc		r5, r11, lr
+	lsls	r6, r6, #1				// The next bit of n in the carry
+	bcs		fib64_one
+	mov		r2, r8					// 0: a = F(2k), b = F(2k + 1)
+	mov		r3, r9
+	b		fib64_next
+fib64_one:
+	mov		r2, r4					// 1: a = F(2k + 1), b = F(2k) + F(2k + 1)
+	mov		r3, r5
+	adds	r4, r4, r8
+	adc		r5, r5, r9
+fib64_next:
+	subs	r7, r7, #1
+	bne		fib64_bit
+
+fib64_done:
+	mov		r0, r2
+	mov		r1, r3
+	pop		{r4-r11, pc}
+	.fnend
+
+
+// fibonacci() modulo m, for m from 1 to 65536, so that the products of two
+// numbers below m fit in 32 bits; x mod m is x - (x / m) * m with udiv
+fibonacci_mod:
+	.fnstart
+	push	{r4-r6, lr}
+	mov		r2, #0					// a = F(0) mod m
+	mov		r3, #1					// b = F(1) mod m
+	cmp		r1, #1
+	it		eq
+	moveq	r3, #0					// Everything is 0 modulo 1
+	clz		r12, r0
+	lsl		r0, r0, r12				// The top bit of n in bit 31
+	rsb		r12, r12, #32			// and the number of bits in r12
+	cmp		r12, #0
+	beq		fibm_done
+
+fibm_bit:
+	add		r4, r1, r3, lsl #1		// r4 = (2b - a) mod m, from 2b + m - a below 3m
+	sub		r4, r4, r2
+	udiv	r5, r4, r1
+	mls		r4, r5, r1, r4
+	mul		r4, r4, r2				// r4 = F(2k) = a * (2b - a) mod m
+	udiv	r5, r4, r1
+	mls		r4, r5, r1, r4
+	mul		r2, r2, r2				// r2 = a^2 mod m
+	udiv	r5, r2, r1
+	mls		r2, r5, r1, r2
+	mul		r3, r3, r3				// r3 = b^2 mod m
+	udiv	r5, r3, r1
+	mls		r3, r5, r1, r3
+	add		r3, r3, r2				// b = F(2k + 1) = a^2 + b^2 mod m
+	cmp		r3, r1
+	it		hs
+	subhs	r3, r3, r1
+	lsls	r0, r0, #1				// The next bit of n in the carry
+	ite		cs
+	movcs	r2, r3					// 1: a = F(2k + 1), b = F(2k) + F(2k + 1)
+	movcc	r2, r4					// 0: a = F(2k), b = F(2k + 1)
+	bcc		fibm_next
+	add		r3, r3, r4
+	cmp		r3, r1
+	it		hs
+	subhs	r3, r3, r1
+fibm_next:
+	subs	r12, r12, #1
+	bne		fibm_bit
+
+fibm_done:
+	mov		r0, r2
+	pop		{r4-r6, pc}
+	.fnend
+
+
+// The reduce() and fibonacci() these replaced, kept for the benchmarks to
+// time and check them against. reduce_sdiv() divides with SDIV, so it is
+// right for numbers below 2^31 only; it now saves the r4 it uses
+reduce_sdiv:
+	.fnstart
+	push	{r4, lr}
 	mov		R1, R0
 	mov		R0, #0
 	mov		R2, #10					// Base 10
 
-adder:
+sdiv_adder:
 	sdiv	R3, R1, R2				// Integer division to find the quotient (R3)
 	mul		R4, R3, R2				// Multiply the divisor (R2) with the quotient (R3)
 	sub		R4, R1, R4				// and subtract from the dividend
 	add		R0, R0, R4				// This way the module is calculated and added to the result
-	mov		R1, R3					// Keep only the quotient and repeat	
+	mov		R1, R3					// Keep only the quotient and repeat
 	cmp		R1, R2					// if it is greater than 10
-	bge		adder
+	bge		sdiv_adder
 	add		R0, R0, R1				// If R1 is less than 10 this is the last digit to add
 
-mod7:
 	cmp		R0, #9
-	ble		done2
+	ble		sdiv_done
 	mov		R2, #7
 	sdiv	R3, R0, R2
 	mul		R4, R3, R2
 	sub		R0, R0, R4
-	
-done2:
-	bx		lr
+
+sdiv_done:
+	pop		{r4, pc}
 	.fnend
-	
 
-	
-	
-fibonacci:
+
+// One call per Fibonacci number below n: 2F(n + 1) - 1 calls in all
+fibonacci_recursive:
 	.fnstart
 	mov     r1, r0         // move input to r1
-	cmp     r1, #0         // if input == 0 
-	beq     fib_zero       // go to case zero
+	cmp     r1, #0         // if input == 0
+	beq     fibr_zero      // go to case zero
 	cmp     r1, #1         // if input == 1
-	beq     fib_one        // go to case 1
-	                       // call fibonacci(n-1)
-	push    {r1, lr}       // push input to stack 
+	beq     fibr_one       // go to case 1
+	                       // call fibonacci_recursive(n-1)
+	push    {r1, lr}       // push input to stack
 	sub     r0, r1, #1     // make r0 (function input) be n - 1
-	bl      fibonacci      // call fibonacci(n-1)
+	bl      fibonacci_recursive
 	pop     {r1, lr}       // pop from stack the original input of this call of the function
-	mov     r2, r0         // move the output of fibonacci(n-1) to r2
+	mov     r2, r0         // move the output of fibonacci_recursive(n-1) to r2
 	sub     r0, r1, #2     // make r0 be input - 2
 	push    {r1, r2, lr}
-	bl      fibonacci
+	bl      fibonacci_recursive
 	pop     {r1, r2, lr}
-	mov     r3, r0         // r3 is the output of fibonacci(n-2)
+	mov     r3, r0         // r3 is the output of fibonacci_recursive(n-2)
 	add     r0, r2, r3     // add them together and return the result
-	b       fib_done
-	
-	
-	
-	
-fib_zero:
-	mov     r0, #0          // return zero 
-	b       fib_done
-
-	
-fib_one:
-	mov     r0, #1           // return one
-	b       fib_done
+	bx      lr
 
+fibr_zero:
+	mov     r0, #0          // return zero
+	bx      lr
 
-fib_done:
+fibr_one:
+	mov     r0, #1           // return one
 	bx      lr
 	.fnend
-	
-	
+
 
 crc_like_checksum:
 // takes a string and performs the bitwise xor of all characters with eachother, returns the result
+// (drivers/checksum.c has a word at a time version, checksum_xor(), and the CRCs used by the firmware)
 	.fnstart
 	mov     r1, r0           // move the string address to r1
 	ldrb    r0, [r1], #1     // load on r0 (output) the first character, and increment the address to show the next character
@@ -0,0 +1,152 @@
+/*!
+ * \file      checksum_bench.c
+ * \brief     Cost of the checks in checksum.c, against a byte and a bit
+ *            at a time.
+ *
+ * Checks the check values of the standard "123456789" string, then times
+ * each way over a record of the flash log, a telemetry frame and a 1 KB
+ * buffer, natively on the host. The byte-wise XOR is crc_like_checksum()
+ * of hasher.s in C. checksum_crc32() needs the CRC unit and is only timed
+ * on the board; here it is checked against its bit-wise reference.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <x86intrin.h>
+#include "checksum.h"
+
+#define BENCH_BYTES  (1 << 20)
+#define BENCH_RUNS   5
+
+static uint8_t buffer[1024];
+static volatile uint32_t sink;
+
+static uint32_t xor_bytes(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	uint8_t fold = 0;
+
+	while (length-- > 0) {
+		fold ^= *bytes++;
+	}
+	return fold;
+}
+
+static uint32_t crc8_bits(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	uint8_t crc = 0;
+
+	while (length-- > 0) {
+		crc ^= *bytes++;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32_t crc16_bits(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	uint16_t crc = 0xFFFF;
+
+	while (length-- > 0) {
+		crc ^= (uint16_t)(*bytes++ << 8);
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32_t crc32_bits(const void *data, uint32_t length) {
+	const uint8_t *bytes = data;
+	uint32_t crc = 0xFFFFFFFFUL;
+
+	while (length-- > 0) {
+		crc ^= (uint32_t)*bytes++ << 24;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = crc & 0x80000000UL ? (crc << 1) ^ 0x04C11DB7UL : crc << 1;
+		}
+	}
+	return crc;
+}
+
+static uint32_t xor_words(const void *data, uint32_t length) {
+	return checksum_xor(data, length);
+}
+
+static uint32_t crc8_nibbles(const void *data, uint32_t length) {
+	return checksum_crc8(data, length);
+}
+
+static uint32_t crc16_nibbles(const void *data, uint32_t length) {
+	return checksum_crc16(data, length);
+}
+
+static const struct {
+	const char *name;
+	uint32_t (*check)(const void *data, uint32_t length);
+	uint32_t expected; // of "123456789"
+} checks[] = {
+	{ "XOR, a byte at a time",     xor_bytes,     0x31 },
+	{ "checksum_xor",              xor_words,     0x31 },
+	{ "CRC-8, a bit at a time",    crc8_bits,     0xF4 },
+	{ "checksum_crc8",             crc8_nibbles,  0xF4 },
+	{ "CRC-16, a bit at a time",   crc16_bits,    0x29B1 },
+	{ "checksum_crc16",            crc16_nibbles, 0x29B1 },
+	{ "CRC-32, a bit at a time",   crc32_bits,    0x0376E6E7 },
+};
+
+#define CHECKS (sizeof(checks) / sizeof(checks[0]))
+
+static double cycles_per_byte(uint32_t (*check)(const void *, uint32_t), uint32_t length) {
+	uint64_t best = UINT64_MAX;
+	uint32_t rounds = BENCH_BYTES / length;
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		uint32_t sum = 0;
+		uint64_t start = __rdtsc();
+
+		for (uint32_t i = 0; i < rounds; i++) {
+			sum += check(buffer + (i & 3), length);
+		}
+		uint64_t cycles = __rdtsc() - start;
+		sink = sum;
+		if (cycles < best) best = cycles;
+	}
+	return (double)best / ((double)rounds * length);
+}
+
+int main(void) {
+	static const uint32_t lengths[] = { 12, 20, 1000 };
+	int failed = 0;
+
+	for (uint32_t i = 0; i < sizeof(buffer); i++) {
+		buffer[i] = (uint8_t)(i * 7 + 3);
+	}
+	for (uint32_t i = 0; i < CHECKS; i++) {
+		uint32_t value = checks[i].check("123456789", 9);
+		if (value != checks[i].expected) {
+			printf("checksum: %s gives 0x%X for \"123456789\", not 0x%X\n", checks[i].name, value, checks[i].expected);
+			failed = 1;
+		}
+	}
+	for (uint32_t length = 0; length < 40; length++) {
+		for (uint32_t offset = 0; offset < 4; offset++) {
+			if (checksum_xor(buffer + offset, length) != xor_bytes(buffer + offset, length)) {
+				printf("checksum: checksum_xor wrong for %u bytes at offset %u\n", length, offset);
+				failed = 1;
+			}
+		}
+	}
+
+	printf("checksum: %u bytes a run, best of %u runs, host TSC cycles per byte\n", BENCH_BYTES, BENCH_RUNS);
+	printf("  %-26s %10s %10s %10s\n", "", "12 bytes", "20 bytes", "1000 bytes");
+	for (uint32_t i = 0; i < CHECKS; i++) {
+		printf("  %-26s", checks[i].name);
+		for (uint32_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+			printf(" %10.2f", cycles_per_byte(checks[i].check, lengths[l]));
+		}
+		printf("\n");
+	}
+	return failed;
+}
@@ -0,0 +1,198 @@
+/*!
+ * \file      flash_bench.c
+ * \brief     Cost of appending to the flash log and of finding its end.
+ *
+ * Runs drivers/flash_log.c natively on a RAM model of the three 128 KB
+ * sectors the firmware gives it. The model keeps the rules of the part
+ * (erase to ones, programming only clears bits) and counts the time the
+ * real flash would be busy, from the typical figures of the datasheet,
+ * so the results show both the CPU side in host cycles and the flash
+ * time per record on the target.
+ *
+ * Recovery compares flash_log_init(), which reads the sector headers and
+ * binary searches the newest sector, with a scan of every slot, at a
+ * few fill levels. A last pass cuts records short at every word, as a
+ * power failure would, and checks that no complete record is lost.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <x86intrin.h>
+#include "flash.h"
+#include "flash_log.h"
+
+#define FIRST_SECTOR  5
+#define SECTORS       3
+#define SECTOR_SIZE   (128 * 1024)
+#define SLOTS         ((SECTOR_SIZE / 4 - 4) / 3)
+#define PROGRAM_US    16
+#define ERASE_US      1000000
+#define BENCH_RECORDS (4 * SLOTS) // Goes round the sectors once and more
+#define BENCH_RUNS    5
+
+static uint32_t memory[SECTORS][SECTOR_SIZE / 4];
+static uint64_t busy_us;   // time the flash would have been busy
+static uint32_t programmed, erased;
+static int32_t fail_after = -1; // words programmed before a power failure
+
+/* ---------------- RAM model of the flash, as in flash.h ---------------- */
+
+const uint32_t *flash_sector_start(uint32_t sector) {
+	return memory[sector - FIRST_SECTOR];
+}
+
+uint32_t flash_sector_size(uint32_t sector) {
+	return sector >= FIRST_SECTOR && sector < FIRST_SECTOR + SECTORS ? SECTOR_SIZE : 0;
+}
+
+int flash_erase_sector(uint32_t sector) {
+	memset(memory[sector - FIRST_SECTOR], 0xFF, SECTOR_SIZE);
+	busy_us += ERASE_US;
+	erased++;
+	return 1;
+}
+
+int flash_program(const uint32_t *address, const uint32_t *words, uint32_t count) {
+	uint32_t *word = (uint32_t *)(uintptr_t)address;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (fail_after == 0) {
+			return 0; // The power is gone, nothing more is written
+		}
+		if (fail_after > 0) {
+			fail_after--;
+		}
+		word[i] &= words[i];
+		busy_us += PROGRAM_US;
+		programmed++;
+	}
+	return 1;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static volatile uint32_t checksum;
+
+static void blank(void) {
+	memset(memory, 0xFF, sizeof(memory));
+	busy_us = 0;
+	programmed = erased = 0;
+}
+
+static void fill(uint32_t records) {
+	int16_t value[FLASH_LOG_VALUES] = {234, 41};
+
+	for (uint32_t i = 0; i < records; i++) {
+		value[0] = (int16_t)(200 + i % 100);
+		flash_log_append(2, 0, i * 6, value);
+	}
+	flash_log_flush();
+}
+
+// The slots in use, found the slow way.
+static uint32_t full_scan(void) {
+	uint32_t used = 0;
+
+	for (uint32_t sector = 0; sector < SECTORS; sector++) {
+		if (memory[sector][0] != 0x32474C46UL) { // MAGIC in flash_log.c
+			continue;
+		}
+		for (uint32_t slot = 0; slot < SLOTS; slot++) {
+			const uint32_t *words = &memory[sector][4 + slot * 3];
+			used += words[0] != FLASH_ERASED || words[1] != FLASH_ERASED || words[2] != FLASH_ERASED;
+		}
+	}
+	return used;
+}
+
+static uint64_t best_of(uint64_t (*run)(void)) {
+	uint64_t best = UINT64_MAX;
+	for (int i = 0; i < BENCH_RUNS; i++) {
+		uint64_t cycles = run();
+		if (cycles < best) best = cycles;
+	}
+	return best;
+}
+
+static uint64_t run_init(void) {
+	uint64_t start = __rdtsc();
+	flash_log_init(FIRST_SECTOR, SECTORS);
+	return __rdtsc() - start;
+}
+
+static uint64_t run_scan(void) {
+	uint64_t start = __rdtsc();
+	checksum = full_scan();
+	return __rdtsc() - start;
+}
+
+static void bench_append(void) {
+	uint64_t start, cycles;
+
+	blank();
+	flash_log_init(FIRST_SECTOR, SECTORS);
+	start = __rdtsc();
+	fill(BENCH_RECORDS);
+	cycles = __rdtsc() - start;
+
+	printf("  append %u records, %u a batch: %6.1f cycles/record on the host\n",
+	       BENCH_RECORDS, FLASH_LOG_BATCH, (double)cycles / BENCH_RECORDS);
+	printf("  flash busy on the target: %6.1f us/record (%u words, %u sector erases)\n",
+	       (double)busy_us / BENCH_RECORDS, programmed, erased);
+}
+
+static void bench_recovery(void) {
+	static const uint32_t levels[] = {1, SLOTS / 2, SLOTS + SLOTS / 2, 3 * SLOTS - 1};
+
+	for (unsigned int i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+		FlashLogStats stats;
+		uint64_t init, scan;
+
+		blank();
+		flash_log_init(FIRST_SECTOR, SECTORS);
+		fill(levels[i]);
+		init = best_of(run_init);
+		scan = best_of(run_scan);
+		flash_log_get_stats(&stats);
+		printf("  %5u records: init %7llu cycles, full scan %9llu cycles  %6.0fx%s\n",
+		       levels[i], (unsigned long long)init, (unsigned long long)scan, (double)scan / init,
+		       stats.records == checksum ? "" : "  COUNT MISMATCH");
+	}
+}
+
+// Cuts the flush short after every number of words and boots again.
+static int check_power_failure(void) {
+	const uint32_t records = 20;
+	int bad = 0;
+
+	for (int32_t words = 0; words <= (int32_t)(records * 3); words++) {
+		FlashLogIterator iterator;
+		FlashLogRecord record;
+		uint32_t seen = 0, expected = (uint32_t)words / 3;
+
+		blank();
+		flash_log_init(FIRST_SECTOR, SECTORS);
+		fill(1); // A sector with a record, so the cut falls in the records
+		fail_after = words;
+		fill(records);
+		fail_after = -1;
+
+		flash_log_init(FIRST_SECTOR, SECTORS);
+		fill(1); // The log must carry on after the cut
+		flash_log_iterate(&iterator, 0);
+		while (flash_log_next(&iterator, &record)) {
+			seen++;
+		}
+		bad |= seen != 1 + expected + 1;
+	}
+	return bad;
+}
+
+int main(void) {
+	printf("flash log: %u sectors of %u records, RAM model of the flash\n", SECTORS, SLOTS);
+	bench_append();
+	printf("  recovery at boot, best of %u runs, host TSC cycles\n", BENCH_RUNS);
+	bench_recovery();
+	printf("  power failure at every word of a flush: %s\n", check_power_failure() ? "RECORDS LOST" : "no complete record lost");
+	return 0;
+}
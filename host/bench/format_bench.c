@@ -0,0 +1,72 @@
+/*!
+ * \file      format_bench.c
+ * \brief     Cost of the data line with format_string(), against sprintf().
+ *
+ * Formats the line DHT11_data_handler() shows, as it was (sprintf with
+ * %f of a float) and as it is (format_string with a fixed-point %.1d),
+ * natively on the host. The figures are host TSC cycles against glibc;
+ * on the target the gap is wider, since newlib's %f goes through soft
+ * double arithmetic.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <x86intrin.h>
+#include "format.h"
+#include "uart.h"
+
+#define BENCH_LINES  100000
+#define BENCH_RUNS   5
+
+static char line[128];
+
+// format_uart() is linked in but not measured; it sends nowhere here.
+void uart_tx(uint8_t c) {
+	(void)c;
+}
+
+static volatile uint32_t checksum;
+
+static uint64_t run_sprintf(void) {
+	uint32_t sum = 0;
+	uint64_t start = __rdtsc();
+
+	for (int i = 0; i < BENCH_LINES; i++) {
+		float temperature = 20.0f + (i % 100) * 0.1f;
+		sum += sprintf(line, "Humidity: %d, Temperature: %f, reading with period = %d sec ", 40 + i % 20, temperature, 6);
+	}
+	checksum = sum;
+	return __rdtsc() - start;
+}
+
+static uint64_t run_format(void) {
+	uint32_t sum = 0;
+	uint64_t start = __rdtsc();
+
+	for (int i = 0; i < BENCH_LINES; i++) {
+		int temperature = 200 + i % 100;
+		sum += format_string(line, sizeof(line), "Humidity: %d, Temperature: %.1d, reading with period = %d sec ", 40 + i % 20, temperature, 6);
+	}
+	checksum = sum;
+	return __rdtsc() - start;
+}
+
+static double best_per_line(uint64_t (*run)(void)) {
+	uint64_t best = UINT64_MAX;
+	for (int i = 0; i < BENCH_RUNS; i++) {
+		uint64_t cycles = run();
+		if (cycles < best) best = cycles;
+	}
+	return (double)best / BENCH_LINES;
+}
+
+int main(void) {
+	double original, fixed;
+
+	original = best_per_line(run_sprintf);
+	fixed = best_per_line(run_format);
+
+	printf("format: data line, %u lines, best of %u runs, host TSC cycles\n", BENCH_LINES, BENCH_RUNS);
+	printf("  %-28s %7.1f cycles/line\n", "sprintf, %f", original);
+	printf("  %-28s %7.1f cycles/line  %.1fx\n", "format_string, %.1d", fixed, original / fixed);
+	return 0;
+}
@@ -0,0 +1,265 @@
+/*!
+ * \file      history_bench.c
+ * \brief     Checks the delta coding of history.c, and prints its cost and
+ *            the bytes a reading takes.
+ *
+ * Every series is appended and read back with the iterator against a
+ * plain array of what went in: negative temperatures, the largest changes
+ * a one byte record holds and the smallest that do not, changes and
+ * intervals that need the full records, and a buffer small enough that
+ * the ring wraps around many times. The cost is in host cycles per
+ * sample, on readings like the DHT11's every 6 s.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <x86intrin.h>
+#include "history.h"
+
+#define SERIES       20000
+#define WRAP_SIZE    64
+#define BENCH_SIZE   4096
+#define BENCH_RUNS   5
+
+static HistorySample series[SERIES];
+static uint8_t storage[BENCH_SIZE];
+static volatile uint32_t sink;
+
+// Park-Miller numbers.
+static uint32_t seed = 1;
+
+static uint32_t random_below(uint32_t limit) {
+	seed = (uint32_t)((uint64_t)seed * 48271 % 0x7FFFFFFF);
+	return seed % limit;
+}
+
+static int16_t clamp(int32_t value) {
+	return (int16_t)(value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+}
+
+// Appends series[count] and records the time it decodes to.
+static void append(History *history, uint32_t count) {
+	HistorySample *sample = &series[count];
+
+	history_append(history, sample->time, sample->value);
+	if (count > 0 && sample->time - series[count - 1].time > 0xFFFF) {
+		sample->time = series[count - 1].time + 0xFFFF;
+	}
+}
+
+// The samples held must be the last of the count appended, oldest first.
+static int check(const char *name, const History *history, uint32_t count) {
+	HistoryIterator iterator;
+	uint32_t first = count - history->count;
+	uint32_t read = 0;
+
+	if (history->count > count || history->count == 0) {
+		printf("history: %s holds %u of %u samples\n", name, history->count, count);
+		return 1;
+	}
+	history_iterate(history, &iterator, 0);
+	while (history_next(history, &iterator)) {
+		const HistorySample *expected = &series[first + read];
+
+		if (iterator.sample.time != expected->time || iterator.sample.value[0] != expected->value[0] ||
+		    iterator.sample.value[1] != expected->value[1]) {
+			printf("history: %s sample %u of %u reads %u s %d %d, not %u s %d %d\n", name, first + read, count,
+			       iterator.sample.time, iterator.sample.value[0], iterator.sample.value[1],
+			       expected->time, expected->value[0], expected->value[1]);
+			return 1;
+		}
+		read++;
+	}
+	if (read != history->count) {
+		printf("history: %s reads %u samples, holds %u\n", name, read, history->count);
+		return 1;
+	}
+	return 0;
+}
+
+// Changes in tenths of a degree and in %, around level.
+static void random_walk(uint32_t count, int32_t level, uint32_t period) {
+	series[0].time = 1000;
+	series[0].value[0] = (int16_t)level;
+	series[0].value[1] = 50;
+	for (uint32_t i = 1; i < count; i++) {
+		series[i].time = series[i - 1].time + period;
+		series[i].value[0] = clamp(series[i - 1].value[0] + (int32_t)random_below(9) - 4);
+		series[i].value[1] = clamp(series[i - 1].value[1] + (int32_t)random_below(3) - 1);
+	}
+}
+
+static int check_negative(void) {
+	History history;
+	int failed = 0;
+
+	history_init(&history, storage, BENCH_SIZE);
+	random_walk(2000, -400, 6);
+	for (uint32_t i = 0; i < 2000; i++) {
+		append(&history, i);
+	}
+	failed |= check("negative temperatures", &history, 2000);
+	return failed;
+}
+
+// The one byte record holds -4..3 in both values, 4 and -5 need three.
+static int check_short_records(void) {
+	static const struct {
+		int16_t step[HISTORY_CHANNELS];
+		uint32_t bytes;
+	} steps[] = {
+		{ { -4, 3 }, 1 }, { { 3, -4 }, 1 }, { { -4, -4 }, 1 }, { { 3, 3 }, 1 }, { { 0, -1 }, 1 },
+		{ { 4, 0 }, 3 }, { { 0, 4 }, 3 }, { { -5, 0 }, 3 }, { { 0, -5 }, 3 }, { { -4, 4 }, 3 },
+	};
+	History history;
+	uint32_t count = 0;
+	int failed = 0;
+
+	history_init(&history, storage, BENCH_SIZE);
+	series[0].time = 0;
+	series[0].value[0] = -12;
+	series[0].value[1] = 40;
+	append(&history, count++);
+	// The interval is set by the first record
+	series[1] = series[0];
+	series[1].time = 6;
+	append(&history, count++);
+	for (uint32_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+		uint32_t bytes = history_bytes(&history);
+
+		series[count].time = series[count - 1].time + 6;
+		for (int c = 0; c < HISTORY_CHANNELS; c++) {
+			series[count].value[c] = (int16_t)(series[count - 1].value[c] + steps[i].step[c]);
+		}
+		append(&history, count++);
+		if (history_bytes(&history) - bytes != steps[i].bytes) {
+			printf("history: a change of %d %d takes %u bytes, not %u\n", steps[i].step[0], steps[i].step[1],
+			       history_bytes(&history) - bytes, steps[i].bytes);
+			failed = 1;
+		}
+	}
+	failed |= check("short records", &history, count);
+	return failed;
+}
+
+// Changes across the whole range, new intervals, and one over 18 hours.
+static int check_full_records(void) {
+	static const struct {
+		uint32_t interval;
+		int16_t value[HISTORY_CHANNELS];
+	} samples[] = {
+		{ 6, { 32767, -32768 } }, { 6, { -32768, 32767 } }, { 6, { 0, 0 } }, { 7, { 0, 0 } },
+		{ 300, { 1, -1 } }, { 0xFFFF, { 100, 100 } }, { 100000, { -100, 100 } }, { 6, { -100, 100 } },
+		{ 0, { 5, 5 } }, { 6, { 5, 5 } },
+	};
+	History history;
+	uint32_t count = 0;
+
+	history_init(&history, storage, BENCH_SIZE);
+	series[0].time = 50;
+	series[0].value[0] = 200;
+	series[0].value[1] = 30;
+	append(&history, count++);
+	for (uint32_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+		series[count].time = series[count - 1].time + samples[i].interval;
+		series[count].value[0] = samples[i].value[0];
+		series[count].value[1] = samples[i].value[1];
+		append(&history, count++);
+	}
+	return check("full records", &history, count);
+}
+
+// Every kind of record in a ring of WRAP_SIZE bytes, checked after each.
+static int check_wrap(void) {
+	History history;
+	uint32_t wraps;
+
+	history_init(&history, storage, WRAP_SIZE);
+	series[0].time = 0;
+	series[0].value[0] = -50;
+	series[0].value[1] = 60;
+	append(&history, 0);
+	for (uint32_t i = 1; i < SERIES; i++) {
+		uint32_t kind = random_below(8);
+		int32_t spread = kind < 3 ? 0 : kind < 6 ? 4 : 3000;
+
+		series[i].time = series[i - 1].time + (kind == 7 ? 1 + random_below(600) : 6);
+		series[i].value[0] = clamp(series[i - 1].value[0] + (spread ? (int32_t)random_below(2 * spread) - spread : 0));
+		series[i].value[1] = clamp(series[i - 1].value[1] + (spread ? (int32_t)random_below(2 * spread) - spread : 0));
+		append(&history, i);
+		if (history_bytes(&history) > WRAP_SIZE) {
+			printf("history: %u bytes in a ring of %u\n", history_bytes(&history), WRAP_SIZE);
+			return 1;
+		}
+		if (check("wrap-around", &history, i + 1)) {
+			return 1;
+		}
+	}
+	wraps = history.tail / WRAP_SIZE;
+	if (wraps < 2) {
+		printf("history: the ring wrapped %u times only\n", wraps);
+		return 1;
+	}
+	return 0;
+}
+
+static double cycles_per_append(History *history, uint32_t count) {
+	uint64_t best = UINT64_MAX;
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		history_init(history, storage, BENCH_SIZE);
+		uint64_t start = __rdtsc();
+
+		for (uint32_t i = 0; i < count; i++) {
+			history_append(history, series[i].time, series[i].value);
+		}
+		uint64_t cycles = __rdtsc() - start;
+		if (cycles < best) best = cycles;
+	}
+	return (double)best / count;
+}
+
+static double cycles_per_next(const History *history) {
+	uint64_t best = UINT64_MAX;
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		HistoryIterator iterator;
+		uint32_t sum = 0;
+		uint64_t start = __rdtsc();
+
+		history_iterate(history, &iterator, 0);
+		while (history_next(history, &iterator)) {
+			sum += (uint16_t)iterator.sample.value[0];
+		}
+		uint64_t cycles = __rdtsc() - start;
+		sink = sum;
+		if (cycles < best) best = cycles;
+	}
+	return (double)best / history->count;
+}
+
+int main(void) {
+	History history;
+	int failed = 0;
+
+	failed |= check_negative();
+	failed |= check_short_records();
+	failed |= check_full_records();
+	failed |= check_wrap();
+
+	// Readings every 6 s that change by a tenth now and then
+	series[0].time = 0;
+	series[0].value[0] = 240;
+	series[0].value[1] = 45;
+	for (uint32_t i = 1; i < SERIES; i++) {
+		uint32_t change = random_below(16);
+
+		series[i].time = series[i - 1].time + 6;
+		series[i].value[0] = (int16_t)(series[i - 1].value[0] + (change == 0) - (change == 1));
+		series[i].value[1] = (int16_t)(series[i - 1].value[1] + (change == 2) - (change == 3));
+	}
+	printf("history: readings every 6 s, %u bytes of storage, host TSC cycles per sample\n", BENCH_SIZE);
+	printf("  %-10s %8.2f\n", "append", cycles_per_append(&history, SERIES));
+	printf("  %-10s %8.2f\n", "next", cycles_per_next(&history));
+	printf("  %u samples held, %.2f bytes a sample\n", history.count, (double)history_bytes(&history) / history.count);
+	return failed;
+}
@@ -0,0 +1,194 @@
+/*!
+ * \file      oversample_bench.c
+ * \brief     Checks the filters of oversample.c on synthetic inputs, and
+ *            prints their cost and the noise they leave.
+ *
+ * A constant must come out exact, the CIC must match a direct sinc^3
+ * filter and the moving average a direct mean, however the samples are
+ * split between calls. The noise is that of a steady level plus Gaussian
+ * noise of 2 LSB, rounded to 12 bits like the ADC would; the cost is in
+ * host cycles per sample, fed as scans of 4 pins like the DMA buffer.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <x86intrin.h>
+#include "oversample.h"
+
+#define PINS         4
+#define SCANS        64
+#define NOISE_LSB    2.0
+#define NOISE_SAMPLES (1 << 16)
+#define BENCH_SAMPLES (1 << 20)
+#define BENCH_RUNS   5
+
+static uint16_t samples[NOISE_SAMPLES];
+static uint16_t scans[PINS * SCANS];
+static volatile uint32_t sink;
+
+static const struct {
+	const char *name;
+	OversampleMode mode;
+} modes[] = {
+	{ "average",        OversampleAverage },
+	{ "CIC",            OversampleCic },
+	{ "moving average", OversampleMovingAverage },
+};
+
+#define MODES (sizeof(modes) / sizeof(modes[0]))
+
+// Park-Miller numbers, to Gaussian ones by Box-Muller.
+static uint32_t seed = 1;
+
+static double uniform(void) {
+	seed = (uint32_t)((uint64_t)seed * 48271 % 0x7FFFFFFF);
+	return (double)seed / 0x7FFFFFFF;
+}
+
+static double gaussian(void) {
+	return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+}
+
+static void noisy(uint16_t *out, uint32_t count, double level) {
+	for (uint32_t i = 0; i < count; i++) {
+		long value = lround(level + NOISE_LSB * gaussian());
+		out[i] = (uint16_t)(value < 0 ? 0 : value > 4095 ? 4095 : value);
+	}
+}
+
+// The output after sample end - 1, straight from its definition.
+static uint32_t reference(OversampleMode mode, uint32_t r, const uint16_t *x, uint32_t end) {
+	uint32_t ratio = 1UL << r;
+	uint64_t sum = 0;
+
+	if (mode != OversampleCic) {
+		for (uint32_t k = 0; k < ratio && k < end; k++) {
+			sum += x[end - 1 - k];
+		}
+		return (uint32_t)(sum >> (r - r / 2));
+	}
+	// sinc^3: three boxes of the ratio, weights 1 2 3 .. up and back down
+	for (uint32_t a = 0; a < ratio; a++) {
+		for (uint32_t b = 0; b < ratio; b++) {
+			for (uint32_t c = 0; c < ratio; c++) {
+				if (a + b + c < end) {
+					sum += x[end - 1 - a - b - c];
+				}
+			}
+		}
+	}
+	return (uint32_t)(sum >> (3 * r - r / 2));
+}
+
+static int check(OversampleMode mode, const char *name, uint32_t r) {
+	static const uint32_t splits[] = { 1, 3, 64, 1000 };
+	Oversampler f;
+	uint32_t ratio = 1UL << r;
+	uint32_t length = 8 * ratio + 5;
+
+	// A constant, once the filter has filled
+	oversample_init(&f, mode, r);
+	for (uint32_t i = 0; i < 4 * ratio; i++) {
+		uint16_t level = 2048;
+		oversample_feed(&f, &level, 1, 1);
+	}
+	if (oversample_value(&f) != 2048UL << (r / 2)) {
+		printf("oversample: %s by 2^%u gives %u for 2048, not %u\n", name, r, oversample_value(&f), 2048U << (r / 2));
+		return 1;
+	}
+
+	// Noise, fed in pieces of several sizes
+	noisy(samples, length, 1000.3);
+	for (uint32_t s = 0; s < sizeof(splits) / sizeof(splits[0]); s++) {
+		uint32_t fed = 0;
+
+		oversample_init(&f, mode, r);
+		while (fed < length) {
+			uint32_t count = length - fed < splits[s] ? length - fed : splits[s];
+			uint32_t outputs = f.outputs;
+
+			oversample_feed(&f, samples + fed, count, 1);
+			fed += count;
+			if (f.outputs != outputs && (mode == OversampleMovingAverage || fed % ratio == 0) &&
+			    oversample_value(&f) != reference(mode, r, samples, fed)) {
+				printf("oversample: %s by 2^%u gives %u after %u samples, not %u\n", name, r,
+				       oversample_value(&f), fed, reference(mode, r, samples, fed));
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+// Standard deviation of the outputs, in input LSB.
+static double noise(OversampleMode mode, uint32_t r) {
+	Oversampler f;
+	double sum = 0, squares = 0;
+	uint32_t n = 0, skip = 3 << r;
+
+	oversample_init(&f, mode, r);
+	noisy(samples, NOISE_SAMPLES, 1000.3);
+	for (uint32_t i = 0; i < NOISE_SAMPLES; i++) {
+		uint32_t outputs = f.outputs;
+
+		oversample_feed(&f, samples + i, 1, 1);
+		if (f.outputs != outputs && i >= skip) {
+			double value = (double)oversample_value(&f) / (1 << (r / 2));
+			sum += value;
+			squares += value * value;
+			n++;
+		}
+	}
+	sum /= n;
+	return sqrt(squares / n - sum * sum);
+}
+
+static double cycles_per_sample(OversampleMode mode, uint32_t r) {
+	Oversampler filters[PINS];
+	uint64_t best = UINT64_MAX;
+	uint32_t rounds = BENCH_SAMPLES / (PINS * SCANS);
+
+	for (int pin = 0; pin < PINS; pin++) {
+		oversample_init(&filters[pin], mode, r);
+	}
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		uint64_t start = __rdtsc();
+
+		for (uint32_t i = 0; i < rounds; i++) {
+			oversample_scans(filters, PINS, scans, SCANS);
+		}
+		uint64_t cycles = __rdtsc() - start;
+		sink = oversample_value(&filters[0]);
+		if (cycles < best) best = cycles;
+	}
+	return (double)best / ((double)rounds * PINS * SCANS);
+}
+
+int main(void) {
+	static const uint32_t ratios[] = { 2, 4, 6 };
+	int failed = 0;
+
+	for (uint32_t m = 0; m < MODES; m++) {
+		for (uint32_t r = 0; r <= OVERSAMPLE_MAX_LOG2; r++) {
+			failed |= check(modes[m].mode, modes[m].name, r);
+		}
+	}
+	noisy(scans, PINS * SCANS, 2000.5);
+
+	printf("oversample: noise of %.0f LSB, output noise in LSB (bits gained); host TSC cycles per sample of 16, %u pins\n",
+	       NOISE_LSB, PINS);
+	printf("  %-16s", "");
+	for (uint32_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++) {
+		printf("   %2u samples", 1U << ratios[i]);
+	}
+	printf(" %8s\n", "cycles");
+	for (uint32_t m = 0; m < MODES; m++) {
+		printf("  %-16s", modes[m].name);
+		for (uint32_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++) {
+			double sigma = noise(modes[m].mode, ratios[i]);
+			printf(" %5.3f (%4.1f)", sigma, log2(NOISE_LSB / sigma));
+		}
+		printf(" %8.2f\n", cycles_per_sample(modes[m].mode, 4));
+	}
+	return failed;
+}
@@ -0,0 +1,2 @@
+/* Keil resolves includes case-insensitively; the sources use both spellings. */
+#include "stm32f4xx_usart.h"
@@ -0,0 +1,286 @@
+/*!
+ * \file      core_cm4.h
+ * \brief     Host build stand-in for the CMSIS Cortex-M4 core header.
+ *
+ * The register layouts and base addresses match the real core, so
+ * drivers that poke NVIC, SCB, SysTick or DWT compile unchanged. The
+ * blocks are mapped by the simulator (host/sim) and every access is
+ * trapped, so the CMSIS inline helpers below behave like on target.
+ * Only the intrinsics that have no memory-mapped equivalent
+ * (__enable_irq, __WFI, ...) are implemented as simulator calls.
+ */
+#ifndef CORE_CM4_H
+#define CORE_CM4_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __CM4_REV                 0x0001U
+#define __CORTEX_M                4U
+
+#ifndef __IO
+#define __I     volatile const
+#define __O     volatile
+#define __IO    volatile
+#endif
+
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+
+/* ------------------------------------------------------------------ */
+/*                          Core registers                            */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+	__IO uint32_t ISER[8U];
+	uint32_t RESERVED0[24U];
+	__IO uint32_t ICER[8U];
+	uint32_t RSERVED1[24U];
+	__IO uint32_t ISPR[8U];
+	uint32_t RESERVED2[24U];
+	__IO uint32_t ICPR[8U];
+	uint32_t RESERVED3[24U];
+	__IO uint32_t IABR[8U];
+	uint32_t RESERVED4[56U];
+	__IO uint8_t  IP[240U];
+	uint32_t RESERVED5[644U];
+	__O  uint32_t STIR;
+} NVIC_Type;
+
+typedef struct {
+	__I  uint32_t CPUID;
+	__IO uint32_t ICSR;
+	__IO uint32_t VTOR;
+	__IO uint32_t AIRCR;
+	__IO uint32_t SCR;
+	__IO uint32_t CCR;
+	__IO uint8_t  SHP[12U];
+	__IO uint32_t SHCSR;
+	__IO uint32_t CFSR;
+	__IO uint32_t HFSR;
+	__IO uint32_t DFSR;
+	__IO uint32_t MMFAR;
+	__IO uint32_t BFAR;
+	__IO uint32_t AFSR;
+	__I  uint32_t PFR[2U];
+	__I  uint32_t DFR;
+	__I  uint32_t ADR;
+	__I  uint32_t MMFR[4U];
+	__I  uint32_t ISAR[5U];
+	uint32_t RESERVED0[5U];
+	__IO uint32_t CPACR;
+} SCB_Type;
+
+typedef struct {
+	__IO uint32_t CTRL;
+	__IO uint32_t LOAD;
+	__IO uint32_t VAL;
+	__I  uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+	__IO uint32_t CTRL;
+	__IO uint32_t CYCCNT;
+	__IO uint32_t CPICNT;
+	__IO uint32_t EXCCNT;
+	__IO uint32_t SLEEPCNT;
+	__IO uint32_t LSUCNT;
+	__IO uint32_t FOLDCNT;
+	__I  uint32_t PCSR;
+} DWT_Type;
+
+typedef struct {
+	__IO uint32_t DHCSR;
+	__O  uint32_t DCRSR;
+	__IO uint32_t DCRDR;
+	__IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define SCS_BASE            (0xE000E000UL)
+#define DWT_BASE            (0xE0001000UL)
+#define CoreDebug_BASE      (0xE000EDF0UL)
+#define SysTick_BASE        (SCS_BASE +  0x0010UL)
+#define NVIC_BASE           (SCS_BASE +  0x0100UL)
+#define SCB_BASE            (SCS_BASE +  0x0D00UL)
+
+#define SCB                 ((SCB_Type       *)     SCB_BASE      )
+#define SysTick             ((SysTick_Type   *)     SysTick_BASE  )
+#define NVIC                ((NVIC_Type      *)     NVIC_BASE     )
+#define DWT                 ((DWT_Type       *)     DWT_BASE      )
+#define CoreDebug           ((CoreDebug_Type *)     CoreDebug_BASE)
+
+#define SCB_AIRCR_VECTKEY_Pos              16U
+#define SCB_AIRCR_VECTKEY_Msk              (0xFFFFUL << SCB_AIRCR_VECTKEY_Pos)
+#define SCB_AIRCR_PRIGROUP_Pos              8U
+#define SCB_AIRCR_PRIGROUP_Msk             (7UL << SCB_AIRCR_PRIGROUP_Pos)
+#define SCB_AIRCR_SYSRESETREQ_Pos           2U
+#define SCB_AIRCR_SYSRESETREQ_Msk          (1UL << SCB_AIRCR_SYSRESETREQ_Pos)
+
+#define SCB_SCR_SLEEPDEEP_Pos               2U
+#define SCB_SCR_SLEEPDEEP_Msk              (1UL << SCB_SCR_SLEEPDEEP_Pos)
+
+#define SysTick_CTRL_COUNTFLAG_Pos         16U
+#define SysTick_CTRL_COUNTFLAG_Msk         (1UL << SysTick_CTRL_COUNTFLAG_Pos)
+#define SysTick_CTRL_CLKSOURCE_Pos          2U
+#define SysTick_CTRL_CLKSOURCE_Msk         (1UL << SysTick_CTRL_CLKSOURCE_Pos)
+#define SysTick_CTRL_TICKINT_Pos            1U
+#define SysTick_CTRL_TICKINT_Msk           (1UL << SysTick_CTRL_TICKINT_Pos)
+#define SysTick_CTRL_ENABLE_Pos             0U
+#define SysTick_CTRL_ENABLE_Msk            (1UL)
+#define SysTick_LOAD_RELOAD_Pos             0U
+#define SysTick_LOAD_RELOAD_Msk            (0xFFFFFFUL)
+#define SysTick_VAL_CURRENT_Pos             0U
+#define SysTick_VAL_CURRENT_Msk            (0xFFFFFFUL)
+
+#define DWT_CTRL_CYCCNTENA_Pos              0U
+#define DWT_CTRL_CYCCNTENA_Msk             (1UL)
+
+#define CoreDebug_DEMCR_TRCENA_Pos         24U
+#define CoreDebug_DEMCR_TRCENA_Msk         (1UL << CoreDebug_DEMCR_TRCENA_Pos)
+
+/* ------------------------------------------------------------------ */
+/*          Intrinsics (implemented by the simulator core)            */
+/* ------------------------------------------------------------------ */
+
+void __enable_irq(void);
+void __disable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __WFI(void);
+void __WFE(void);
+void __SEV(void);
+
+#define __NOP()   __asm__ volatile ("nop")
+/* Interrupt handlers run on the same host thread as the firmware, so
+ * ordering against them only needs the compiler to keep its order. */
+#define __DSB()   __asm__ volatile ("" ::: "memory")
+#define __DMB()   __asm__ volatile ("" ::: "memory")
+#define __ISB()   __asm__ volatile ("" ::: "memory")
+
+__STATIC_INLINE uint8_t __CLZ(uint32_t value) {
+	return value ? (uint8_t)__builtin_clz(value) : 32U;
+}
+
+__STATIC_INLINE uint32_t __RBIT(uint32_t value) {
+	uint32_t result = 0U;
+	for (int i = 0; i < 32; i++) {
+		result = (result << 1) | (value & 1U);
+		value >>= 1;
+	}
+	return result;
+}
+
+__STATIC_INLINE uint32_t __REV(uint32_t value) {
+	return __builtin_bswap32(value);
+}
+
+/* ------------------------------------------------------------------ */
+/*                     NVIC / SysTick functions                       */
+/* ------------------------------------------------------------------ */
+
+__STATIC_INLINE void NVIC_SetPriorityGrouping(uint32_t PriorityGroup) {
+	uint32_t reg_value;
+	uint32_t PriorityGroupTmp = (PriorityGroup & (uint32_t)0x07UL);
+
+	reg_value  =  SCB->AIRCR;
+	reg_value &= ~((uint32_t)(SCB_AIRCR_VECTKEY_Msk | SCB_AIRCR_PRIGROUP_Msk));
+	reg_value  =  (reg_value                                   |
+	              ((uint32_t)0x5FAUL << SCB_AIRCR_VECTKEY_Pos) |
+	              (PriorityGroupTmp << 8U));
+	SCB->AIRCR =  reg_value;
+}
+
+__STATIC_INLINE uint32_t NVIC_GetPriorityGrouping(void) {
+	return ((uint32_t)((SCB->AIRCR & SCB_AIRCR_PRIGROUP_Msk) >> SCB_AIRCR_PRIGROUP_Pos));
+}
+
+__STATIC_INLINE void NVIC_EnableIRQ(IRQn_Type IRQn) {
+	NVIC->ISER[(((uint32_t)(int32_t)IRQn) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)IRQn) & 0x1FUL));
+}
+
+__STATIC_INLINE void NVIC_DisableIRQ(IRQn_Type IRQn) {
+	NVIC->ICER[(((uint32_t)(int32_t)IRQn) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)IRQn) & 0x1FUL));
+	__DSB();
+	__ISB();
+}
+
+__STATIC_INLINE uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn) {
+	return ((uint32_t)(((NVIC->ISPR[(((uint32_t)(int32_t)IRQn) >> 5UL)] & (1UL << (((uint32_t)(int32_t)IRQn) & 0x1FUL))) != 0UL) ? 1UL : 0UL));
+}
+
+__STATIC_INLINE void NVIC_SetPendingIRQ(IRQn_Type IRQn) {
+	NVIC->ISPR[(((uint32_t)(int32_t)IRQn) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)IRQn) & 0x1FUL));
+}
+
+__STATIC_INLINE void NVIC_ClearPendingIRQ(IRQn_Type IRQn) {
+	NVIC->ICPR[(((uint32_t)(int32_t)IRQn) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)IRQn) & 0x1FUL));
+}
+
+__STATIC_INLINE uint32_t NVIC_GetActive(IRQn_Type IRQn) {
+	return ((uint32_t)(((NVIC->IABR[(((uint32_t)(int32_t)IRQn) >> 5UL)] & (1UL << (((uint32_t)(int32_t)IRQn) & 0x1FUL))) != 0UL) ? 1UL : 0UL));
+}
+
+__STATIC_INLINE void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) {
+	if ((int32_t)(IRQn) < 0) {
+		SCB->SHP[(((uint32_t)(int32_t)IRQn) & 0xFUL)-4UL] = (uint8_t)((priority << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL);
+	} else {
+		NVIC->IP[((uint32_t)(int32_t)IRQn)]               = (uint8_t)((priority << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL);
+	}
+}
+
+__STATIC_INLINE uint32_t NVIC_GetPriority(IRQn_Type IRQn) {
+	if ((int32_t)(IRQn) < 0) {
+		return (((uint32_t)SCB->SHP[(((uint32_t)(int32_t)IRQn) & 0xFUL)-4UL] >> (8U - __NVIC_PRIO_BITS)));
+	} else {
+		return (((uint32_t)NVIC->IP[((uint32_t)(int32_t)IRQn)]               >> (8U - __NVIC_PRIO_BITS)));
+	}
+}
+
+__STATIC_INLINE uint32_t NVIC_EncodePriority(uint32_t PriorityGroup, uint32_t PreemptPriority, uint32_t SubPriority) {
+	uint32_t PriorityGroupTmp = (PriorityGroup & (uint32_t)0x07UL);
+	uint32_t PreemptPriorityBits;
+	uint32_t SubPriorityBits;
+
+	PreemptPriorityBits = ((7UL - PriorityGroupTmp) > (uint32_t)(__NVIC_PRIO_BITS)) ? (uint32_t)(__NVIC_PRIO_BITS) : (uint32_t)(7UL - PriorityGroupTmp);
+	SubPriorityBits     = ((PriorityGroupTmp + (uint32_t)(__NVIC_PRIO_BITS)) < (uint32_t)7UL) ? (uint32_t)0UL : (uint32_t)((PriorityGroupTmp - 7UL) + (uint32_t)(__NVIC_PRIO_BITS));
+
+	return (
+	         ((PreemptPriority & (uint32_t)((1UL << (PreemptPriorityBits)) - 1UL)) << SubPriorityBits) |
+	         ((SubPriority     & (uint32_t)((1UL << (SubPriorityBits    )) - 1UL)))
+	       );
+}
+
+__STATIC_INLINE void NVIC_SystemReset(void) {
+	__DSB();
+	SCB->AIRCR  = (uint32_t)((0x5FAUL << SCB_AIRCR_VECTKEY_Pos)    |
+	                         (SCB->AIRCR & SCB_AIRCR_PRIGROUP_Msk) |
+	                          SCB_AIRCR_SYSRESETREQ_Msk    );
+	__DSB();
+	for(;;) {
+		__NOP();
+	}
+}
+
+__STATIC_INLINE uint32_t SysTick_Config(uint32_t ticks) {
+	if ((ticks - 1UL) > SysTick_LOAD_RELOAD_Msk) {
+		return (1UL);
+	}
+
+	SysTick->LOAD  = (uint32_t)(ticks - 1UL);
+	NVIC_SetPriority (SysTick_IRQn, (1UL << __NVIC_PRIO_BITS) - 1UL);
+	SysTick->VAL   = 0UL;
+	SysTick->CTRL  = SysTick_CTRL_CLKSOURCE_Msk |
+	                 SysTick_CTRL_TICKINT_Msk   |
+	                 SysTick_CTRL_ENABLE_Msk;
+	return (0UL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CORE_CM4_H
@@ -0,0 +1,958 @@
+/*!
+ * \file      stm32f4xx.h
+ * \brief     Host build stand-in for the STM32F411xE device header.
+ *
+ * Only the peripherals the drivers in this project touch are described
+ * (RCC, FLASH, PWR, GPIO, EXTI, SYSCFG, TIM, USART, I2C, ADC, DMA, CRC,
+ * DBGMCU). Structure layouts, base addresses and bit definitions follow
+ * the device reference manual (RM0383) so the drivers and the Standard
+ * Peripheral Library build unchanged against it. The address ranges are
+ * backed by the peripheral models in host/sim.
+ */
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef STM32F411xE
+#define STM32F411xE
+#endif
+
+#define __MPU_PRESENT             1U
+#define __NVIC_PRIO_BITS          4U
+#define __Vendor_SysTickConfig    0U
+#define __FPU_PRESENT             1U
+
+#if !defined  (HSE_VALUE)
+#define HSE_VALUE    ((uint32_t)8000000)
+#endif
+
+#if !defined  (HSE_STARTUP_TIMEOUT)
+#define HSE_STARTUP_TIMEOUT    ((uint16_t)0x0500)
+#endif
+
+#if !defined  (HSI_VALUE)
+#define HSI_VALUE    ((uint32_t)16000000)
+#endif
+
+typedef enum {
+	NonMaskableInt_IRQn         = -14,
+	MemoryManagement_IRQn       = -12,
+	BusFault_IRQn               = -11,
+	UsageFault_IRQn             = -10,
+	SVCall_IRQn                 = -5,
+	DebugMonitor_IRQn           = -4,
+	PendSV_IRQn                 = -2,
+	SysTick_IRQn                = -1,
+	WWDG_IRQn                   = 0,
+	PVD_IRQn                    = 1,
+	TAMP_STAMP_IRQn             = 2,
+	RTC_WKUP_IRQn               = 3,
+	FLASH_IRQn                  = 4,
+	RCC_IRQn                    = 5,
+	EXTI0_IRQn                  = 6,
+	EXTI1_IRQn                  = 7,
+	EXTI2_IRQn                  = 8,
+	EXTI3_IRQn                  = 9,
+	EXTI4_IRQn                  = 10,
+	DMA1_Stream0_IRQn           = 11,
+	DMA1_Stream1_IRQn           = 12,
+	DMA1_Stream2_IRQn           = 13,
+	DMA1_Stream3_IRQn           = 14,
+	DMA1_Stream4_IRQn           = 15,
+	DMA1_Stream5_IRQn           = 16,
+	DMA1_Stream6_IRQn           = 17,
+	ADC_IRQn                    = 18,
+	EXTI9_5_IRQn                = 23,
+	TIM1_BRK_TIM9_IRQn          = 24,
+	TIM1_UP_TIM10_IRQn          = 25,
+	TIM1_TRG_COM_TIM11_IRQn     = 26,
+	TIM1_CC_IRQn                = 27,
+	TIM2_IRQn                   = 28,
+	TIM3_IRQn                   = 29,
+	TIM4_IRQn                   = 30,
+	I2C1_EV_IRQn                = 31,
+	I2C1_ER_IRQn                = 32,
+	I2C2_EV_IRQn                = 33,
+	I2C2_ER_IRQn                = 34,
+	SPI1_IRQn                   = 35,
+	SPI2_IRQn                   = 36,
+	USART1_IRQn                 = 37,
+	USART2_IRQn                 = 38,
+	EXTI15_10_IRQn              = 40,
+	RTC_Alarm_IRQn              = 41,
+	OTG_FS_WKUP_IRQn            = 42,
+	DMA1_Stream7_IRQn           = 47,
+	SDIO_IRQn                   = 49,
+	TIM5_IRQn                   = 50,
+	SPI3_IRQn                   = 51,
+	DMA2_Stream0_IRQn           = 56,
+	DMA2_Stream1_IRQn           = 57,
+	DMA2_Stream2_IRQn           = 58,
+	DMA2_Stream3_IRQn           = 59,
+	DMA2_Stream4_IRQn           = 60,
+	OTG_FS_IRQn                 = 67,
+	DMA2_Stream5_IRQn           = 68,
+	DMA2_Stream6_IRQn           = 69,
+	DMA2_Stream7_IRQn           = 70,
+	USART6_IRQn                 = 71,
+	I2C3_EV_IRQn                = 72,
+	I2C3_ER_IRQn                = 73,
+	FPU_IRQn                    = 81,
+	SPI4_IRQn                   = 84,
+	SPI5_IRQn                   = 85
+} IRQn_Type;
+
+#include "core_cm4.h"
+
+extern uint32_t SystemCoreClock;
+extern void SystemInit(void);
+extern void SystemCoreClockUpdate(void);
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+#define IS_FUNCTIONAL_STATE(STATE) (((STATE) == DISABLE) || ((STATE) == ENABLE))
+typedef enum {ERROR = 0, SUCCESS = !ERROR} ErrorStatus;
+
+#ifndef assert_param
+#define assert_param(expr) ((void)0)
+#endif
+
+/* ------------------------------------------------------------------ */
+/*                     Peripheral register blocks                     */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+	__IO uint32_t SR;
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t SMPR1;
+	__IO uint32_t SMPR2;
+	__IO uint32_t JOFR1;
+	__IO uint32_t JOFR2;
+	__IO uint32_t JOFR3;
+	__IO uint32_t JOFR4;
+	__IO uint32_t HTR;
+	__IO uint32_t LTR;
+	__IO uint32_t SQR1;
+	__IO uint32_t SQR2;
+	__IO uint32_t SQR3;
+	__IO uint32_t JSQR;
+	__IO uint32_t JDR1;
+	__IO uint32_t JDR2;
+	__IO uint32_t JDR3;
+	__IO uint32_t JDR4;
+	__IO uint32_t DR;
+} ADC_TypeDef;
+
+typedef struct {
+	__IO uint32_t CSR;
+	__IO uint32_t CCR;
+	__IO uint32_t CDR;
+} ADC_Common_TypeDef;
+
+typedef struct {
+	__IO uint32_t DR;
+	__IO uint8_t  IDR;
+	uint8_t       RESERVED0;
+	uint16_t      RESERVED1;
+	__IO uint32_t CR;
+} CRC_TypeDef;
+
+typedef struct {
+	__IO uint32_t IDCODE;
+	__IO uint32_t CR;
+	__IO uint32_t APB1FZ;
+	__IO uint32_t APB2FZ;
+} DBGMCU_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR;
+	__IO uint32_t NDTR;
+	__IO uint32_t PAR;
+	__IO uint32_t M0AR;
+	__IO uint32_t M1AR;
+	__IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+	__IO uint32_t LISR;
+	__IO uint32_t HISR;
+	__IO uint32_t LIFCR;
+	__IO uint32_t HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+	__IO uint32_t IMR;
+	__IO uint32_t EMR;
+	__IO uint32_t RTSR;
+	__IO uint32_t FTSR;
+	__IO uint32_t SWIER;
+	__IO uint32_t PR;
+} EXTI_TypeDef;
+
+typedef struct {
+	__IO uint32_t ACR;
+	__IO uint32_t KEYR;
+	__IO uint32_t OPTKEYR;
+	__IO uint32_t SR;
+	__IO uint32_t CR;
+	__IO uint32_t OPTCR;
+	__IO uint32_t OPTCR1;
+} FLASH_TypeDef;
+
+typedef struct {
+	__IO uint32_t MODER;
+	__IO uint32_t OTYPER;
+	__IO uint32_t OSPEEDR;
+	__IO uint32_t PUPDR;
+	__IO uint32_t IDR;
+	__IO uint32_t ODR;
+	__IO uint32_t BSRR;
+	__IO uint32_t LCKR;
+	__IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+	__IO uint32_t MEMRMP;
+	__IO uint32_t PMC;
+	__IO uint32_t EXTICR[4];
+	uint32_t      RESERVED[2];
+	__IO uint32_t CMPCR;
+} SYSCFG_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t OAR1;
+	__IO uint32_t OAR2;
+	__IO uint32_t DR;
+	__IO uint32_t SR1;
+	__IO uint32_t SR2;
+	__IO uint32_t CCR;
+	__IO uint32_t TRISE;
+	__IO uint32_t FLTR;
+} I2C_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR;
+	__IO uint32_t CSR;
+} PWR_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR;
+	__IO uint32_t PLLCFGR;
+	__IO uint32_t CFGR;
+	__IO uint32_t CIR;
+	__IO uint32_t AHB1RSTR;
+	__IO uint32_t AHB2RSTR;
+	__IO uint32_t AHB3RSTR;
+	uint32_t      RESERVED0;
+	__IO uint32_t APB1RSTR;
+	__IO uint32_t APB2RSTR;
+	uint32_t      RESERVED1[2];
+	__IO uint32_t AHB1ENR;
+	__IO uint32_t AHB2ENR;
+	__IO uint32_t AHB3ENR;
+	uint32_t      RESERVED2;
+	__IO uint32_t APB1ENR;
+	__IO uint32_t APB2ENR;
+	uint32_t      RESERVED3[2];
+	__IO uint32_t AHB1LPENR;
+	__IO uint32_t AHB2LPENR;
+	__IO uint32_t AHB3LPENR;
+	uint32_t      RESERVED4;
+	__IO uint32_t APB1LPENR;
+	__IO uint32_t APB2LPENR;
+	uint32_t      RESERVED5[2];
+	__IO uint32_t BDCR;
+	__IO uint32_t CSR;
+	uint32_t      RESERVED6[2];
+	__IO uint32_t SSCGR;
+	__IO uint32_t PLLI2SCFGR;
+	uint32_t      RESERVED7;
+	__IO uint32_t DCKCFGR;
+} RCC_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t SMCR;
+	__IO uint32_t DIER;
+	__IO uint32_t SR;
+	__IO uint32_t EGR;
+	__IO uint32_t CCMR1;
+	__IO uint32_t CCMR2;
+	__IO uint32_t CCER;
+	__IO uint32_t CNT;
+	__IO uint32_t PSC;
+	__IO uint32_t ARR;
+	__IO uint32_t RCR;
+	__IO uint32_t CCR1;
+	__IO uint32_t CCR2;
+	__IO uint32_t CCR3;
+	__IO uint32_t CCR4;
+	__IO uint32_t BDTR;
+	__IO uint32_t DCR;
+	__IO uint32_t DMAR;
+	__IO uint32_t OR;
+} TIM_TypeDef;
+
+typedef struct {
+	__IO uint32_t SR;
+	__IO uint32_t DR;
+	__IO uint32_t BRR;
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t CR3;
+	__IO uint32_t GTPR;
+} USART_TypeDef;
+
+/* ------------------------------------------------------------------ */
+/*                           Memory map                               */
+/* ------------------------------------------------------------------ */
+
+#define FLASH_BASE            0x08000000UL
+#define SRAM1_BASE            0x20000000UL
+#define PERIPH_BASE           0x40000000UL
+#define SRAM1_BB_BASE         0x22000000UL
+#define PERIPH_BB_BASE        0x42000000UL
+#define FLASH_END             0x0807FFFFUL
+
+#define APB1PERIPH_BASE       PERIPH_BASE
+#define APB2PERIPH_BASE       (PERIPH_BASE + 0x00010000)
+#define AHB1PERIPH_BASE       (PERIPH_BASE + 0x00020000)
+#define AHB2PERIPH_BASE       (PERIPH_BASE + 0x10000000)
+
+#define TIM2_BASE             (APB1PERIPH_BASE + 0x0000)
+#define TIM3_BASE             (APB1PERIPH_BASE + 0x0400)
+#define TIM4_BASE             (APB1PERIPH_BASE + 0x0800)
+#define TIM5_BASE             (APB1PERIPH_BASE + 0x0C00)
+#define RTC_BASE              (APB1PERIPH_BASE + 0x2800)
+#define WWDG_BASE             (APB1PERIPH_BASE + 0x2C00)
+#define IWDG_BASE             (APB1PERIPH_BASE + 0x3000)
+#define SPI2_BASE             (APB1PERIPH_BASE + 0x3800)
+#define SPI3_BASE             (APB1PERIPH_BASE + 0x3C00)
+#define USART2_BASE           (APB1PERIPH_BASE + 0x4400)
+#define I2C1_BASE             (APB1PERIPH_BASE + 0x5400)
+#define I2C2_BASE             (APB1PERIPH_BASE + 0x5800)
+#define I2C3_BASE             (APB1PERIPH_BASE + 0x5C00)
+#define PWR_BASE              (APB1PERIPH_BASE + 0x7000)
+
+#define TIM1_BASE             (APB2PERIPH_BASE + 0x0000)
+#define USART1_BASE           (APB2PERIPH_BASE + 0x1000)
+#define USART6_BASE           (APB2PERIPH_BASE + 0x1400)
+#define ADC1_BASE             (APB2PERIPH_BASE + 0x2000)
+#define ADC_BASE              (APB2PERIPH_BASE + 0x2300)
+#define SDIO_BASE             (APB2PERIPH_BASE + 0x2C00)
+#define SPI1_BASE             (APB2PERIPH_BASE + 0x3000)
+#define SPI4_BASE             (APB2PERIPH_BASE + 0x3400)
+#define SYSCFG_BASE           (APB2PERIPH_BASE + 0x3800)
+#define EXTI_BASE             (APB2PERIPH_BASE + 0x3C00)
+#define TIM9_BASE             (APB2PERIPH_BASE + 0x4000)
+#define TIM10_BASE            (APB2PERIPH_BASE + 0x4400)
+#define TIM11_BASE            (APB2PERIPH_BASE + 0x4800)
+#define SPI5_BASE             (APB2PERIPH_BASE + 0x5000)
+
+#define GPIOA_BASE            (AHB1PERIPH_BASE + 0x0000)
+#define GPIOB_BASE            (AHB1PERIPH_BASE + 0x0400)
+#define GPIOC_BASE            (AHB1PERIPH_BASE + 0x0800)
+#define GPIOD_BASE            (AHB1PERIPH_BASE + 0x0C00)
+#define GPIOE_BASE            (AHB1PERIPH_BASE + 0x1000)
+#define GPIOH_BASE            (AHB1PERIPH_BASE + 0x1C00)
+#define CRC_BASE              (AHB1PERIPH_BASE + 0x3000)
+#define RCC_BASE              (AHB1PERIPH_BASE + 0x3800)
+#define FLASH_R_BASE          (AHB1PERIPH_BASE + 0x3C00)
+#define DMA1_BASE             (AHB1PERIPH_BASE + 0x6000)
+#define DMA1_Stream0_BASE     (DMA1_BASE + 0x010)
+#define DMA1_Stream1_BASE     (DMA1_BASE + 0x028)
+#define DMA1_Stream2_BASE     (DMA1_BASE + 0x040)
+#define DMA1_Stream3_BASE     (DMA1_BASE + 0x058)
+#define DMA1_Stream4_BASE     (DMA1_BASE + 0x070)
+#define DMA1_Stream5_BASE     (DMA1_BASE + 0x088)
+#define DMA1_Stream6_BASE     (DMA1_BASE + 0x0A0)
+#define DMA1_Stream7_BASE     (DMA1_BASE + 0x0B8)
+#define DMA2_BASE             (AHB1PERIPH_BASE + 0x6400)
+#define DMA2_Stream0_BASE     (DMA2_BASE + 0x010)
+#define DMA2_Stream1_BASE     (DMA2_BASE + 0x028)
+#define DMA2_Stream2_BASE     (DMA2_BASE + 0x040)
+#define DMA2_Stream3_BASE     (DMA2_BASE + 0x058)
+#define DMA2_Stream4_BASE     (DMA2_BASE + 0x070)
+#define DMA2_Stream5_BASE     (DMA2_BASE + 0x088)
+#define DMA2_Stream6_BASE     (DMA2_BASE + 0x0A0)
+#define DMA2_Stream7_BASE     (DMA2_BASE + 0x0B8)
+
+#define DBGMCU_BASE           0xE0042000UL
+
+#define TIM2                ((TIM_TypeDef *) TIM2_BASE)
+#define TIM3                ((TIM_TypeDef *) TIM3_BASE)
+#define TIM4                ((TIM_TypeDef *) TIM4_BASE)
+#define TIM5                ((TIM_TypeDef *) TIM5_BASE)
+#define USART2              ((USART_TypeDef *) USART2_BASE)
+#define I2C1                ((I2C_TypeDef *) I2C1_BASE)
+#define I2C2                ((I2C_TypeDef *) I2C2_BASE)
+#define I2C3                ((I2C_TypeDef *) I2C3_BASE)
+#define PWR                 ((PWR_TypeDef *) PWR_BASE)
+#define TIM1                ((TIM_TypeDef *) TIM1_BASE)
+#define USART1              ((USART_TypeDef *) USART1_BASE)
+#define USART6              ((USART_TypeDef *) USART6_BASE)
+#define ADC1                ((ADC_TypeDef *) ADC1_BASE)
+#define ADC                 ((ADC_Common_TypeDef *) ADC_BASE)
+#define SYSCFG              ((SYSCFG_TypeDef *) SYSCFG_BASE)
+#define EXTI                ((EXTI_TypeDef *) EXTI_BASE)
+#define TIM9                ((TIM_TypeDef *) TIM9_BASE)
+#define TIM10               ((TIM_TypeDef *) TIM10_BASE)
+#define TIM11               ((TIM_TypeDef *) TIM11_BASE)
+#define GPIOA               ((GPIO_TypeDef *) GPIOA_BASE)
+#define GPIOB               ((GPIO_TypeDef *) GPIOB_BASE)
+#define GPIOC               ((GPIO_TypeDef *) GPIOC_BASE)
+#define GPIOD               ((GPIO_TypeDef *) GPIOD_BASE)
+#define GPIOE               ((GPIO_TypeDef *) GPIOE_BASE)
+#define GPIOH               ((GPIO_TypeDef *) GPIOH_BASE)
+#define CRC                 ((CRC_TypeDef *) CRC_BASE)
+#define RCC                 ((RCC_TypeDef *) RCC_BASE)
+#define FLASH               ((FLASH_TypeDef *) FLASH_R_BASE)
+#define DMA1                ((DMA_TypeDef *) DMA1_BASE)
+#define DMA1_Stream0        ((DMA_Stream_TypeDef *) DMA1_Stream0_BASE)
+#define DMA1_Stream1        ((DMA_Stream_TypeDef *) DMA1_Stream1_BASE)
+#define DMA1_Stream2        ((DMA_Stream_TypeDef *) DMA1_Stream2_BASE)
+#define DMA1_Stream3        ((DMA_Stream_TypeDef *) DMA1_Stream3_BASE)
+#define DMA1_Stream4        ((DMA_Stream_TypeDef *) DMA1_Stream4_BASE)
+#define DMA1_Stream5        ((DMA_Stream_TypeDef *) DMA1_Stream5_BASE)
+#define DMA1_Stream6        ((DMA_Stream_TypeDef *) DMA1_Stream6_BASE)
+#define DMA1_Stream7        ((DMA_Stream_TypeDef *) DMA1_Stream7_BASE)
+#define DMA2                ((DMA_TypeDef *) DMA2_BASE)
+#define DMA2_Stream0        ((DMA_Stream_TypeDef *) DMA2_Stream0_BASE)
+#define DMA2_Stream1        ((DMA_Stream_TypeDef *) DMA2_Stream1_BASE)
+#define DMA2_Stream2        ((DMA_Stream_TypeDef *) DMA2_Stream2_BASE)
+#define DMA2_Stream3        ((DMA_Stream_TypeDef *) DMA2_Stream3_BASE)
+#define DMA2_Stream4        ((DMA_Stream_TypeDef *) DMA2_Stream4_BASE)
+#define DMA2_Stream5        ((DMA_Stream_TypeDef *) DMA2_Stream5_BASE)
+#define DMA2_Stream6        ((DMA_Stream_TypeDef *) DMA2_Stream6_BASE)
+#define DMA2_Stream7        ((DMA_Stream_TypeDef *) DMA2_Stream7_BASE)
+#define DBGMCU              ((DBGMCU_TypeDef *) DBGMCU_BASE)
+
+/* ------------------------------------------------------------------ */
+/*                  Peripheral registers bit definitions              */
+/* ------------------------------------------------------------------ */
+
+/******************  Analog to Digital Converter (ADC)  ******************/
+#define  ADC_SR_AWD                          ((uint32_t)0x00000001)
+#define  ADC_SR_EOC                          ((uint32_t)0x00000002)
+#define  ADC_SR_JEOC                         ((uint32_t)0x00000004)
+#define  ADC_SR_JSTRT                        ((uint32_t)0x00000008)
+#define  ADC_SR_STRT                         ((uint32_t)0x00000010)
+#define  ADC_SR_OVR                          ((uint32_t)0x00000020)
+
+#define  ADC_CR1_AWDCH                       ((uint32_t)0x0000001F)
+#define  ADC_CR1_AWDCH_0                     ((uint32_t)0x00000001)
+#define  ADC_CR1_AWDCH_1                     ((uint32_t)0x00000002)
+#define  ADC_CR1_AWDCH_2                     ((uint32_t)0x00000004)
+#define  ADC_CR1_AWDCH_3                     ((uint32_t)0x00000008)
+#define  ADC_CR1_AWDCH_4                     ((uint32_t)0x00000010)
+#define  ADC_CR1_EOCIE                       ((uint32_t)0x00000020)
+#define  ADC_CR1_AWDIE                       ((uint32_t)0x00000040)
+#define  ADC_CR1_JEOCIE                      ((uint32_t)0x00000080)
+#define  ADC_CR1_SCAN                        ((uint32_t)0x00000100)
+#define  ADC_CR1_AWDSGL                      ((uint32_t)0x00000200)
+#define  ADC_CR1_JAUTO                       ((uint32_t)0x00000400)
+#define  ADC_CR1_DISCEN                      ((uint32_t)0x00000800)
+#define  ADC_CR1_JDISCEN                     ((uint32_t)0x00001000)
+#define  ADC_CR1_DISCNUM                     ((uint32_t)0x0000E000)
+#define  ADC_CR1_JAWDEN                      ((uint32_t)0x00400000)
+#define  ADC_CR1_AWDEN                       ((uint32_t)0x00800000)
+#define  ADC_CR1_RES                         ((uint32_t)0x03000000)
+#define  ADC_CR1_RES_0                       ((uint32_t)0x01000000)
+#define  ADC_CR1_RES_1                       ((uint32_t)0x02000000)
+#define  ADC_CR1_OVRIE                       ((uint32_t)0x04000000)
+
+#define  ADC_CR2_ADON                        ((uint32_t)0x00000001)
+#define  ADC_CR2_CONT                        ((uint32_t)0x00000002)
+#define  ADC_CR2_DMA                         ((uint32_t)0x00000100)
+#define  ADC_CR2_DDS                         ((uint32_t)0x00000200)
+#define  ADC_CR2_EOCS                        ((uint32_t)0x00000400)
+#define  ADC_CR2_ALIGN                       ((uint32_t)0x00000800)
+#define  ADC_CR2_JEXTSEL                     ((uint32_t)0x000F0000)
+#define  ADC_CR2_JEXTEN                      ((uint32_t)0x00300000)
+#define  ADC_CR2_JSWSTART                    ((uint32_t)0x00400000)
+#define  ADC_CR2_EXTSEL                      ((uint32_t)0x0F000000)
+#define  ADC_CR2_EXTSEL_0                    ((uint32_t)0x01000000)
+#define  ADC_CR2_EXTSEL_1                    ((uint32_t)0x02000000)
+#define  ADC_CR2_EXTSEL_2                    ((uint32_t)0x04000000)
+#define  ADC_CR2_EXTSEL_3                    ((uint32_t)0x08000000)
+#define  ADC_CR2_EXTEN                       ((uint32_t)0x30000000)
+#define  ADC_CR2_EXTEN_0                     ((uint32_t)0x10000000)
+#define  ADC_CR2_EXTEN_1                     ((uint32_t)0x20000000)
+#define  ADC_CR2_SWSTART                     ((uint32_t)0x40000000)
+
+#define  ADC_SMPR1_SMP10                     ((uint32_t)0x00000007)
+#define  ADC_SMPR2_SMP0                      ((uint32_t)0x00000007)
+
+#define  ADC_HTR_HT                          ((uint32_t)0x00000FFF)
+#define  ADC_LTR_LT                          ((uint32_t)0x00000FFF)
+
+#define  ADC_SQR1_SQ13                       ((uint32_t)0x0000001F)
+#define  ADC_SQR1_L                          ((uint32_t)0x00F00000)
+#define  ADC_SQR2_SQ7                        ((uint32_t)0x0000001F)
+#define  ADC_SQR3_SQ1                        ((uint32_t)0x0000001F)
+
+#define  ADC_CCR_MULTI                       ((uint32_t)0x0000001F)
+#define  ADC_CCR_DELAY                       ((uint32_t)0x00000F00)
+#define  ADC_CCR_DDS                         ((uint32_t)0x00002000)
+#define  ADC_CCR_DMA                         ((uint32_t)0x0000C000)
+#define  ADC_CCR_ADCPRE                      ((uint32_t)0x00030000)
+#define  ADC_CCR_ADCPRE_0                    ((uint32_t)0x00010000)
+#define  ADC_CCR_ADCPRE_1                    ((uint32_t)0x00020000)
+#define  ADC_CCR_VBATE                       ((uint32_t)0x00400000)
+#define  ADC_CCR_TSVREFE                     ((uint32_t)0x00800000)
+
+/******************************  CRC calculation unit  *******************/
+#define  CRC_DR_DR                           ((uint32_t)0xFFFFFFFF)
+#define  CRC_IDR_IDR                         ((uint8_t)0xFF)
+#define  CRC_CR_RESET                        ((uint8_t)0x01)
+
+/********************************  DMA controller  ************************/
+#define DMA_SxCR_CHSEL                       ((uint32_t)0x0E000000)
+#define DMA_SxCR_CHSEL_0                     ((uint32_t)0x02000000)
+#define DMA_SxCR_CHSEL_1                     ((uint32_t)0x04000000)
+#define DMA_SxCR_CHSEL_2                     ((uint32_t)0x08000000)
+#define DMA_SxCR_MBURST                      ((uint32_t)0x01800000)
+#define DMA_SxCR_PBURST                      ((uint32_t)0x00600000)
+#define DMA_SxCR_CT                          ((uint32_t)0x00080000)
+#define DMA_SxCR_DBM                         ((uint32_t)0x00040000)
+#define DMA_SxCR_PL                          ((uint32_t)0x00030000)
+#define DMA_SxCR_PL_0                        ((uint32_t)0x00010000)
+#define DMA_SxCR_PL_1                        ((uint32_t)0x00020000)
+#define DMA_SxCR_PINCOS                      ((uint32_t)0x00008000)
+#define DMA_SxCR_MSIZE                       ((uint32_t)0x00006000)
+#define DMA_SxCR_MSIZE_0                     ((uint32_t)0x00002000)
+#define DMA_SxCR_MSIZE_1                     ((uint32_t)0x00004000)
+#define DMA_SxCR_PSIZE                       ((uint32_t)0x00001800)
+#define DMA_SxCR_PSIZE_0                     ((uint32_t)0x00000800)
+#define DMA_SxCR_PSIZE_1                     ((uint32_t)0x00001000)
+#define DMA_SxCR_MINC                        ((uint32_t)0x00000400)
+#define DMA_SxCR_PINC                        ((uint32_t)0x00000200)
+#define DMA_SxCR_CIRC                        ((uint32_t)0x00000100)
+#define DMA_SxCR_DIR                         ((uint32_t)0x000000C0)
+#define DMA_SxCR_DIR_0                       ((uint32_t)0x00000040)
+#define DMA_SxCR_DIR_1                       ((uint32_t)0x00000080)
+#define DMA_SxCR_PFCTRL                      ((uint32_t)0x00000020)
+#define DMA_SxCR_TCIE                        ((uint32_t)0x00000010)
+#define DMA_SxCR_HTIE                        ((uint32_t)0x00000008)
+#define DMA_SxCR_TEIE                        ((uint32_t)0x00000004)
+#define DMA_SxCR_DMEIE                       ((uint32_t)0x00000002)
+#define DMA_SxCR_EN                          ((uint32_t)0x00000001)
+
+#define DMA_SxFCR_FEIE                       ((uint32_t)0x00000080)
+#define DMA_SxFCR_DMDIS                      ((uint32_t)0x00000004)
+#define DMA_SxFCR_FTH                        ((uint32_t)0x00000003)
+
+#define DMA_LISR_TCIF3                       ((uint32_t)0x08000000)
+#define DMA_LISR_HTIF3                       ((uint32_t)0x04000000)
+#define DMA_LISR_TEIF3                       ((uint32_t)0x02000000)
+#define DMA_LISR_DMEIF3                      ((uint32_t)0x01000000)
+#define DMA_LISR_FEIF3                       ((uint32_t)0x00400000)
+#define DMA_LISR_TCIF2                       ((uint32_t)0x00200000)
+#define DMA_LISR_HTIF2                       ((uint32_t)0x00100000)
+#define DMA_LISR_TEIF2                       ((uint32_t)0x00080000)
+#define DMA_LISR_DMEIF2                      ((uint32_t)0x00040000)
+#define DMA_LISR_FEIF2                       ((uint32_t)0x00010000)
+#define DMA_LISR_TCIF1                       ((uint32_t)0x00000800)
+#define DMA_LISR_HTIF1                       ((uint32_t)0x00000400)
+#define DMA_LISR_TEIF1                       ((uint32_t)0x00000200)
+#define DMA_LISR_DMEIF1                      ((uint32_t)0x00000100)
+#define DMA_LISR_FEIF1                       ((uint32_t)0x00000040)
+#define DMA_LISR_TCIF0                       ((uint32_t)0x00000020)
+#define DMA_LISR_HTIF0                       ((uint32_t)0x00000010)
+#define DMA_LISR_TEIF0                       ((uint32_t)0x00000008)
+#define DMA_LISR_DMEIF0                      ((uint32_t)0x00000004)
+#define DMA_LISR_FEIF0                       ((uint32_t)0x00000001)
+
+#define DMA_HISR_TCIF7                       ((uint32_t)0x08000000)
+#define DMA_HISR_HTIF7                       ((uint32_t)0x04000000)
+#define DMA_HISR_TEIF7                       ((uint32_t)0x02000000)
+#define DMA_HISR_DMEIF7                      ((uint32_t)0x01000000)
+#define DMA_HISR_FEIF7                       ((uint32_t)0x00400000)
+#define DMA_HISR_TCIF6                       ((uint32_t)0x00200000)
+#define DMA_HISR_HTIF6                       ((uint32_t)0x00100000)
+#define DMA_HISR_TEIF6                       ((uint32_t)0x00080000)
+#define DMA_HISR_DMEIF6                      ((uint32_t)0x00040000)
+#define DMA_HISR_FEIF6                       ((uint32_t)0x00010000)
+#define DMA_HISR_TCIF5                       ((uint32_t)0x00000800)
+#define DMA_HISR_HTIF5                       ((uint32_t)0x00000400)
+#define DMA_HISR_TEIF5                       ((uint32_t)0x00000200)
+#define DMA_HISR_DMEIF5                      ((uint32_t)0x00000100)
+#define DMA_HISR_FEIF5                       ((uint32_t)0x00000040)
+#define DMA_HISR_TCIF4                       ((uint32_t)0x00000020)
+#define DMA_HISR_HTIF4                       ((uint32_t)0x00000010)
+#define DMA_HISR_TEIF4                       ((uint32_t)0x00000008)
+#define DMA_HISR_DMEIF4                      ((uint32_t)0x00000004)
+#define DMA_HISR_FEIF4                       ((uint32_t)0x00000001)
+
+#define DMA_LIFCR_CTCIF3                     ((uint32_t)0x08000000)
+#define DMA_LIFCR_CHTIF3                     ((uint32_t)0x04000000)
+#define DMA_LIFCR_CTEIF3                     ((uint32_t)0x02000000)
+#define DMA_LIFCR_CDMEIF3                    ((uint32_t)0x01000000)
+#define DMA_LIFCR_CFEIF3                     ((uint32_t)0x00400000)
+#define DMA_LIFCR_CTCIF2                     ((uint32_t)0x00200000)
+#define DMA_LIFCR_CHTIF2                     ((uint32_t)0x00100000)
+#define DMA_LIFCR_CTEIF2                     ((uint32_t)0x00080000)
+#define DMA_LIFCR_CDMEIF2                    ((uint32_t)0x00040000)
+#define DMA_LIFCR_CFEIF2                     ((uint32_t)0x00010000)
+#define DMA_LIFCR_CTCIF1                     ((uint32_t)0x00000800)
+#define DMA_LIFCR_CHTIF1                     ((uint32_t)0x00000400)
+#define DMA_LIFCR_CTEIF1                     ((uint32_t)0x00000200)
+#define DMA_LIFCR_CDMEIF1                    ((uint32_t)0x00000100)
+#define DMA_LIFCR_CFEIF1                     ((uint32_t)0x00000040)
+#define DMA_LIFCR_CTCIF0                     ((uint32_t)0x00000020)
+#define DMA_LIFCR_CHTIF0                     ((uint32_t)0x00000010)
+#define DMA_LIFCR_CTEIF0                     ((uint32_t)0x00000008)
+#define DMA_LIFCR_CDMEIF0                    ((uint32_t)0x00000004)
+#define DMA_LIFCR_CFEIF0                     ((uint32_t)0x00000001)
+
+#define DMA_HIFCR_CTCIF7                     ((uint32_t)0x08000000)
+#define DMA_HIFCR_CHTIF7                     ((uint32_t)0x04000000)
+#define DMA_HIFCR_CTEIF7                     ((uint32_t)0x02000000)
+#define DMA_HIFCR_CDMEIF7                    ((uint32_t)0x01000000)
+#define DMA_HIFCR_CFEIF7                     ((uint32_t)0x00400000)
+#define DMA_HIFCR_CTCIF6                     ((uint32_t)0x00200000)
+#define DMA_HIFCR_CHTIF6                     ((uint32_t)0x00100000)
+#define DMA_HIFCR_CTEIF6                     ((uint32_t)0x00080000)
+#define DMA_HIFCR_CDMEIF6                    ((uint32_t)0x00040000)
+#define DMA_HIFCR_CFEIF6                     ((uint32_t)0x00010000)
+#define DMA_HIFCR_CTCIF5                     ((uint32_t)0x00000800)
+#define DMA_HIFCR_CHTIF5                     ((uint32_t)0x00000400)
+#define DMA_HIFCR_CTEIF5                     ((uint32_t)0x00000200)
+#define DMA_HIFCR_CDMEIF5                    ((uint32_t)0x00000100)
+#define DMA_HIFCR_CFEIF5                     ((uint32_t)0x00000040)
+#define DMA_HIFCR_CTCIF4                     ((uint32_t)0x00000020)
+#define DMA_HIFCR_CHTIF4                     ((uint32_t)0x00000010)
+#define DMA_HIFCR_CTEIF4                     ((uint32_t)0x00000008)
+#define DMA_HIFCR_CDMEIF4                    ((uint32_t)0x00000004)
+#define DMA_HIFCR_CFEIF4                     ((uint32_t)0x00000001)
+
+/******************  External Interrupt/Event Controller  ****************/
+#define  EXTI_IMR_MR0                        ((uint32_t)0x00000001)
+#define  EXTI_PR_PR0                         ((uint32_t)0x00000001)
+#define  EXTI_PR_PR1                         ((uint32_t)0x00000002)
+#define  EXTI_PR_PR2                         ((uint32_t)0x00000004)
+#define  EXTI_PR_PR3                         ((uint32_t)0x00000008)
+#define  EXTI_PR_PR4                         ((uint32_t)0x00000010)
+
+/********************************  FLASH  *********************************/
+#define FLASH_ACR_LATENCY                    ((uint32_t)0x0000000F)
+#define FLASH_ACR_PRFTEN                     ((uint32_t)0x00000100)
+#define FLASH_ACR_ICEN                       ((uint32_t)0x00000200)
+#define FLASH_ACR_DCEN                       ((uint32_t)0x00000400)
+#define FLASH_ACR_ICRST                      ((uint32_t)0x00000800)
+#define FLASH_ACR_DCRST                      ((uint32_t)0x00001000)
+
+#define FLASH_SR_EOP                         ((uint32_t)0x00000001)
+#define FLASH_SR_SOP                         ((uint32_t)0x00000002)
+#define FLASH_SR_WRPERR                      ((uint32_t)0x00000010)
+#define FLASH_SR_PGAERR                      ((uint32_t)0x00000020)
+#define FLASH_SR_PGPERR                      ((uint32_t)0x00000040)
+#define FLASH_SR_PGSERR                      ((uint32_t)0x00000080)
+#define FLASH_SR_BSY                         ((uint32_t)0x00010000)
+
+#define FLASH_CR_PG                          ((uint32_t)0x00000001)
+#define FLASH_CR_SER                         ((uint32_t)0x00000002)
+#define FLASH_CR_MER                         ((uint32_t)0x00000004)
+#define FLASH_CR_SNB                         ((uint32_t)0x000000F8)
+#define FLASH_CR_SNB_Pos                     3U
+#define FLASH_CR_PSIZE                       ((uint32_t)0x00000300)
+#define FLASH_CR_PSIZE_0                     ((uint32_t)0x00000100)
+#define FLASH_CR_PSIZE_1                     ((uint32_t)0x00000200)
+#define FLASH_CR_STRT                        ((uint32_t)0x00010000)
+#define FLASH_CR_EOPIE                       ((uint32_t)0x01000000)
+#define FLASH_CR_LOCK                        ((uint32_t)0x80000000)
+
+/******************  General Purpose and Alternate Function I/O  **********/
+#define GPIO_MODER_MODER0                    ((uint32_t)0x00000003)
+#define GPIO_OTYPER_OT_0                     ((uint32_t)0x00000001)
+#define GPIO_OSPEEDER_OSPEEDR0               ((uint32_t)0x00000003)
+#define GPIO_PUPDR_PUPDR0                    ((uint32_t)0x00000003)
+
+/*********************************  I2C  *********************************/
+#define  I2C_CR1_PE                          ((uint32_t)0x00000001)
+#define  I2C_CR1_SMBUS                       ((uint32_t)0x00000002)
+#define  I2C_CR1_SMBTYPE                     ((uint32_t)0x00000008)
+#define  I2C_CR1_ENARP                       ((uint32_t)0x00000010)
+#define  I2C_CR1_ENPEC                       ((uint32_t)0x00000020)
+#define  I2C_CR1_ENGC                        ((uint32_t)0x00000040)
+#define  I2C_CR1_NOSTRETCH                   ((uint32_t)0x00000080)
+#define  I2C_CR1_START                       ((uint32_t)0x00000100)
+#define  I2C_CR1_STOP                        ((uint32_t)0x00000200)
+#define  I2C_CR1_ACK                         ((uint32_t)0x00000400)
+#define  I2C_CR1_POS                         ((uint32_t)0x00000800)
+#define  I2C_CR1_PEC                         ((uint32_t)0x00001000)
+#define  I2C_CR1_ALERT                       ((uint32_t)0x00002000)
+#define  I2C_CR1_SWRST                       ((uint32_t)0x00008000)
+
+#define  I2C_CR2_FREQ                        ((uint32_t)0x0000003F)
+#define  I2C_CR2_ITERREN                     ((uint32_t)0x00000100)
+#define  I2C_CR2_ITEVTEN                     ((uint32_t)0x00000200)
+#define  I2C_CR2_ITBUFEN                     ((uint32_t)0x00000400)
+#define  I2C_CR2_DMAEN                       ((uint32_t)0x00000800)
+#define  I2C_CR2_LAST                        ((uint32_t)0x00001000)
+
+#define  I2C_OAR1_ADD0                       ((uint32_t)0x00000001)
+#define  I2C_OAR2_ENDUAL                     ((uint32_t)0x00000001)
+#define  I2C_OAR2_ADD2                       ((uint32_t)0x000000FE)
+
+#define  I2C_SR1_SB                          ((uint32_t)0x00000001)
+#define  I2C_SR1_ADDR                        ((uint32_t)0x00000002)
+#define  I2C_SR1_BTF                         ((uint32_t)0x00000004)
+#define  I2C_SR1_ADD10                       ((uint32_t)0x00000008)
+#define  I2C_SR1_STOPF                       ((uint32_t)0x00000010)
+#define  I2C_SR1_RXNE                        ((uint32_t)0x00000040)
+#define  I2C_SR1_TXE                         ((uint32_t)0x00000080)
+#define  I2C_SR1_BERR                        ((uint32_t)0x00000100)
+#define  I2C_SR1_ARLO                        ((uint32_t)0x00000200)
+#define  I2C_SR1_AF                          ((uint32_t)0x00000400)
+#define  I2C_SR1_OVR                         ((uint32_t)0x00000800)
+#define  I2C_SR1_PECERR                      ((uint32_t)0x00001000)
+#define  I2C_SR1_TIMEOUT                     ((uint32_t)0x00004000)
+#define  I2C_SR1_SMBALERT                    ((uint32_t)0x00008000)
+
+#define  I2C_SR2_MSL                         ((uint32_t)0x00000001)
+#define  I2C_SR2_BUSY                        ((uint32_t)0x00000002)
+#define  I2C_SR2_TRA                         ((uint32_t)0x00000004)
+#define  I2C_SR2_GENCALL                     ((uint32_t)0x00000010)
+#define  I2C_SR2_DUALF                       ((uint32_t)0x00000080)
+
+#define  I2C_CCR_CCR                         ((uint32_t)0x00000FFF)
+#define  I2C_CCR_DUTY                        ((uint32_t)0x00004000)
+#define  I2C_CCR_FS                          ((uint32_t)0x00008000)
+
+#define  I2C_TRISE_TRISE                     ((uint32_t)0x0000003F)
+
+/*****************************  Reset and Clock Control  *****************/
+#define  RCC_CR_HSION                        ((uint32_t)0x00000001)
+#define  RCC_CR_HSIRDY                       ((uint32_t)0x00000002)
+#define  RCC_CR_HSITRIM                      ((uint32_t)0x000000F8)
+#define  RCC_CR_HSEON                        ((uint32_t)0x00010000)
+#define  RCC_CR_HSERDY                       ((uint32_t)0x00020000)
+#define  RCC_CR_HSEBYP                       ((uint32_t)0x00040000)
+#define  RCC_CR_CSSON                        ((uint32_t)0x00080000)
+#define  RCC_CR_PLLON                        ((uint32_t)0x01000000)
+#define  RCC_CR_PLLRDY                       ((uint32_t)0x02000000)
+
+#define  RCC_PLLCFGR_PLLM                    ((uint32_t)0x0000003F)
+#define  RCC_PLLCFGR_PLLN                    ((uint32_t)0x00007FC0)
+#define  RCC_PLLCFGR_PLLP                    ((uint32_t)0x00030000)
+#define  RCC_PLLCFGR_PLLSRC                  ((uint32_t)0x00400000)
+#define  RCC_PLLCFGR_PLLQ                    ((uint32_t)0x0F000000)
+
+#define  RCC_CFGR_SW                         ((uint32_t)0x00000003)
+#define  RCC_CFGR_SWS                        ((uint32_t)0x0000000C)
+#define  RCC_CFGR_HPRE                       ((uint32_t)0x000000F0)
+#define  RCC_CFGR_PPRE1                      ((uint32_t)0x00001C00)
+#define  RCC_CFGR_PPRE2                      ((uint32_t)0x0000E000)
+#define  RCC_CFGR_RTCPRE                     ((uint32_t)0x001F0000)
+
+#define  RCC_AHB1ENR_GPIOAEN                 ((uint32_t)0x00000001)
+#define  RCC_AHB1ENR_GPIOBEN                 ((uint32_t)0x00000002)
+#define  RCC_AHB1ENR_GPIOCEN                 ((uint32_t)0x00000004)
+#define  RCC_AHB1ENR_GPIODEN                 ((uint32_t)0x00000008)
+#define  RCC_AHB1ENR_GPIOEEN                 ((uint32_t)0x00000010)
+#define  RCC_AHB1ENR_GPIOHEN                 ((uint32_t)0x00000080)
+#define  RCC_AHB1ENR_CRCEN                   ((uint32_t)0x00001000)
+#define  RCC_AHB1ENR_DMA1EN                  ((uint32_t)0x00200000)
+#define  RCC_AHB1ENR_DMA2EN                  ((uint32_t)0x00400000)
+
+#define  RCC_APB1ENR_TIM2EN                  ((uint32_t)0x00000001)
+#define  RCC_APB1ENR_TIM3EN                  ((uint32_t)0x00000002)
+#define  RCC_APB1ENR_TIM4EN                  ((uint32_t)0x00000004)
+#define  RCC_APB1ENR_TIM5EN                  ((uint32_t)0x00000008)
+#define  RCC_APB1ENR_WWDGEN                  ((uint32_t)0x00000800)
+#define  RCC_APB1ENR_SPI2EN                  ((uint32_t)0x00004000)
+#define  RCC_APB1ENR_SPI3EN                  ((uint32_t)0x00008000)
+#define  RCC_APB1ENR_USART2EN                ((uint32_t)0x00020000)
+#define  RCC_APB1ENR_I2C1EN                  ((uint32_t)0x00200000)
+#define  RCC_APB1ENR_I2C2EN                  ((uint32_t)0x00400000)
+#define  RCC_APB1ENR_I2C3EN                  ((uint32_t)0x00800000)
+#define  RCC_APB1ENR_PWREN                   ((uint32_t)0x10000000)
+
+#define  RCC_APB2ENR_TIM1EN                  ((uint32_t)0x00000001)
+#define  RCC_APB2ENR_USART1EN                ((uint32_t)0x00000010)
+#define  RCC_APB2ENR_USART6EN                ((uint32_t)0x00000020)
+#define  RCC_APB2ENR_ADC1EN                  ((uint32_t)0x00000100)
+#define  RCC_APB2ENR_SDIOEN                  ((uint32_t)0x00000800)
+#define  RCC_APB2ENR_SPI1EN                  ((uint32_t)0x00001000)
+#define  RCC_APB2ENR_SPI4EN                  ((uint32_t)0x00002000)
+#define  RCC_APB2ENR_SYSCFGEN                ((uint32_t)0x00004000)
+#define  RCC_APB2ENR_TIM9EN                  ((uint32_t)0x00010000)
+#define  RCC_APB2ENR_TIM10EN                 ((uint32_t)0x00020000)
+#define  RCC_APB2ENR_TIM11EN                 ((uint32_t)0x00040000)
+#define  RCC_APB2ENR_SPI5EN                  ((uint32_t)0x00100000)
+
+#define  RCC_CSR_RMVF                        ((uint32_t)0x01000000)
+#define  RCC_CSR_BORRSTF                     ((uint32_t)0x02000000)
+#define  RCC_CSR_PINRSTF                     ((uint32_t)0x04000000)
+#define  RCC_CSR_PORRSTF                     ((uint32_t)0x08000000)
+#define  RCC_CSR_SFTRSTF                     ((uint32_t)0x10000000)
+#define  RCC_CSR_IWDGRSTF                    ((uint32_t)0x20000000)
+#define  RCC_CSR_WWDGRSTF                    ((uint32_t)0x40000000)
+#define  RCC_CSR_LPWRRSTF                    ((uint32_t)0x80000000)
+
+/*********************************  TIM  *********************************/
+#define  TIM_CR1_CEN                         ((uint32_t)0x00000001)
+#define  TIM_CR1_UDIS                        ((uint32_t)0x00000002)
+#define  TIM_CR1_URS                         ((uint32_t)0x00000004)
+#define  TIM_CR1_OPM                         ((uint32_t)0x00000008)
+#define  TIM_CR1_DIR                         ((uint32_t)0x00000010)
+#define  TIM_CR1_ARPE                        ((uint32_t)0x00000080)
+
+#define  TIM_CR2_CCDS                        ((uint32_t)0x00000008)
+#define  TIM_CR2_MMS                         ((uint32_t)0x00000070)
+#define  TIM_CR2_MMS_0                       ((uint32_t)0x00000010)
+#define  TIM_CR2_MMS_1                       ((uint32_t)0x00000020)
+#define  TIM_CR2_MMS_2                       ((uint32_t)0x00000040)
+
+#define  TIM_DIER_UIE                        ((uint32_t)0x00000001)
+#define  TIM_DIER_CC1IE                      ((uint32_t)0x00000002)
+#define  TIM_DIER_CC2IE                      ((uint32_t)0x00000004)
+#define  TIM_DIER_CC3IE                      ((uint32_t)0x00000008)
+#define  TIM_DIER_CC4IE                      ((uint32_t)0x00000010)
+#define  TIM_DIER_UDE                        ((uint32_t)0x00000100)
+#define  TIM_DIER_CC1DE                      ((uint32_t)0x00000200)
+#define  TIM_DIER_CC2DE                      ((uint32_t)0x00000400)
+#define  TIM_DIER_CC3DE                      ((uint32_t)0x00000800)
+#define  TIM_DIER_CC4DE                      ((uint32_t)0x00001000)
+
+#define  TIM_SR_UIF                          ((uint32_t)0x00000001)
+#define  TIM_SR_CC1IF                        ((uint32_t)0x00000002)
+#define  TIM_SR_CC2IF                        ((uint32_t)0x00000004)
+#define  TIM_SR_CC3IF                        ((uint32_t)0x00000008)
+#define  TIM_SR_CC4IF                        ((uint32_t)0x00000010)
+#define  TIM_SR_CC1OF                        ((uint32_t)0x00000200)
+#define  TIM_SR_CC2OF                        ((uint32_t)0x00000400)
+#define  TIM_SR_CC3OF                        ((uint32_t)0x00000800)
+#define  TIM_SR_CC4OF                        ((uint32_t)0x00001000)
+
+#define  TIM_EGR_UG                          ((uint32_t)0x00000001)
+#define  TIM_EGR_CC1G                        ((uint32_t)0x00000002)
+#define  TIM_EGR_CC2G                        ((uint32_t)0x00000004)
+#define  TIM_EGR_CC3G                        ((uint32_t)0x00000008)
+#define  TIM_EGR_CC4G                        ((uint32_t)0x00000010)
+
+#define  TIM_CCMR1_CC1S                      ((uint32_t)0x00000003)
+#define  TIM_CCMR1_CC1S_0                    ((uint32_t)0x00000001)
+#define  TIM_CCMR1_CC1S_1                    ((uint32_t)0x00000002)
+#define  TIM_CCMR1_IC1F                      ((uint32_t)0x000000F0)
+#define  TIM_CCMR1_CC2S                      ((uint32_t)0x00000300)
+#define  TIM_CCMR1_CC2S_0                    ((uint32_t)0x00000100)
+#define  TIM_CCMR1_IC2F                      ((uint32_t)0x0000F000)
+#define  TIM_CCMR2_CC3S                      ((uint32_t)0x00000003)
+#define  TIM_CCMR2_CC3S_0                    ((uint32_t)0x00000001)
+#define  TIM_CCMR2_CC3S_1                    ((uint32_t)0x00000002)
+#define  TIM_CCMR2_IC3PSC                    ((uint32_t)0x0000000C)
+#define  TIM_CCMR2_IC3F                      ((uint32_t)0x000000F0)
+#define  TIM_CCMR2_IC3F_0                    ((uint32_t)0x00000010)
+#define  TIM_CCMR2_IC3F_1                    ((uint32_t)0x00000020)
+#define  TIM_CCMR2_CC4S                      ((uint32_t)0x00000300)
+#define  TIM_CCMR2_CC4S_0                    ((uint32_t)0x00000100)
+#define  TIM_CCMR2_IC4F                      ((uint32_t)0x0000F000)
+
+#define  TIM_CCER_CC1E                       ((uint32_t)0x00000001)
+#define  TIM_CCER_CC1P                       ((uint32_t)0x00000002)
+#define  TIM_CCER_CC1NP                      ((uint32_t)0x00000008)
+#define  TIM_CCER_CC2E                       ((uint32_t)0x00000010)
+#define  TIM_CCER_CC2P                       ((uint32_t)0x00000020)
+#define  TIM_CCER_CC2NP                      ((uint32_t)0x00000080)
+#define  TIM_CCER_CC3E                       ((uint32_t)0x00000100)
+#define  TIM_CCER_CC3P                       ((uint32_t)0x00000200)
+#define  TIM_CCER_CC3NP                      ((uint32_t)0x00000800)
+#define  TIM_CCER_CC4E                       ((uint32_t)0x00001000)
+#define  TIM_CCER_CC4P                       ((uint32_t)0x00002000)
+#define  TIM_CCER_CC4NP                      ((uint32_t)0x00008000)
+
+/******************  Universal Synchronous Asynchronous Receiver Transmitter  ***/
+#define  USART_SR_PE                         ((uint32_t)0x00000001)
+#define  USART_SR_FE                         ((uint32_t)0x00000002)
+#define  USART_SR_NE                         ((uint32_t)0x00000004)
+#define  USART_SR_ORE                        ((uint32_t)0x00000008)
+#define  USART_SR_IDLE                       ((uint32_t)0x00000010)
+#define  USART_SR_RXNE                       ((uint32_t)0x00000020)
+#define  USART_SR_TC                         ((uint32_t)0x00000040)
+#define  USART_SR_TXE                        ((uint32_t)0x00000080)
+#define  USART_SR_LBD                        ((uint32_t)0x00000100)
+#define  USART_SR_CTS                        ((uint32_t)0x00000200)
+
+#define  USART_DR_DR                         ((uint32_t)0x000001FF)
+
+#define  USART_BRR_DIV_Fraction              ((uint32_t)0x0000000F)
+#define  USART_BRR_DIV_Mantissa              ((uint32_t)0x0000FFF0)
+
+#define  USART_CR1_SBK                       ((uint32_t)0x00000001)
+#define  USART_CR1_RWU                       ((uint32_t)0x00000002)
+#define  USART_CR1_RE                        ((uint32_t)0x00000004)
+#define  USART_CR1_TE                        ((uint32_t)0x00000008)
+#define  USART_CR1_IDLEIE                    ((uint32_t)0x00000010)
+#define  USART_CR1_RXNEIE                    ((uint32_t)0x00000020)
+#define  USART_CR1_TCIE                      ((uint32_t)0x00000040)
+#define  USART_CR1_TXEIE                     ((uint32_t)0x00000080)
+#define  USART_CR1_PEIE                      ((uint32_t)0x00000100)
+#define  USART_CR1_PS                        ((uint32_t)0x00000200)
+#define  USART_CR1_PCE                       ((uint32_t)0x00000400)
+#define  USART_CR1_WAKE                      ((uint32_t)0x00000800)
+#define  USART_CR1_M                         ((uint32_t)0x00001000)
+#define  USART_CR1_UE                        ((uint32_t)0x00002000)
+#define  USART_CR1_OVER8                     ((uint32_t)0x00008000)
+
+#define  USART_CR2_ADD                       ((uint32_t)0x0000000F)
+#define  USART_CR2_LBDL                      ((uint32_t)0x00000020)
+#define  USART_CR2_LBDIE                     ((uint32_t)0x00000040)
+#define  USART_CR2_LBCL                      ((uint32_t)0x00000100)
+#define  USART_CR2_CPHA                      ((uint32_t)0x00000200)
+#define  USART_CR2_CPOL                      ((uint32_t)0x00000400)
+#define  USART_CR2_CLKEN                     ((uint32_t)0x00000800)
+#define  USART_CR2_STOP                      ((uint32_t)0x00003000)
+#define  USART_CR2_STOP_0                    ((uint32_t)0x00001000)
+#define  USART_CR2_STOP_1                    ((uint32_t)0x00002000)
+#define  USART_CR2_LINEN                     ((uint32_t)0x00004000)
+
+#define  USART_CR3_EIE                       ((uint32_t)0x00000001)
+#define  USART_CR3_IREN                      ((uint32_t)0x00000002)
+#define  USART_CR3_IRLP                      ((uint32_t)0x00000004)
+#define  USART_CR3_HDSEL                     ((uint32_t)0x00000008)
+#define  USART_CR3_NACK                      ((uint32_t)0x00000010)
+#define  USART_CR3_SCEN                      ((uint32_t)0x00000020)
+#define  USART_CR3_DMAR                      ((uint32_t)0x00000040)
+#define  USART_CR3_DMAT                      ((uint32_t)0x00000080)
+#define  USART_CR3_RTSE                      ((uint32_t)0x00000100)
+#define  USART_CR3_CTSE                      ((uint32_t)0x00000200)
+#define  USART_CR3_CTSIE                     ((uint32_t)0x00000400)
+#define  USART_CR3_ONEBIT                    ((uint32_t)0x00000800)
+
+#define  USART_GTPR_PSC                      ((uint32_t)0x000000FF)
+#define  USART_GTPR_GT                       ((uint32_t)0x0000FF00)
+
+/******************************  Debug MCU  ******************************/
+#define  DBGMCU_CR_DBG_SLEEP                 ((uint32_t)0x00000001)
+#define  DBGMCU_CR_DBG_STOP                  ((uint32_t)0x00000002)
+#define  DBGMCU_CR_DBG_STANDBY               ((uint32_t)0x00000004)
+
+/* ------------------------------------------------------------------ */
+/*                            Exported macros                         */
+/* ------------------------------------------------------------------ */
+
+#define SET_BIT(REG, BIT)     ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)   ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)    ((REG) & (BIT))
+#define CLEAR_REG(REG)        ((REG) = (0x0))
+#define WRITE_REG(REG, VAL)   ((REG) = (VAL))
+#define READ_REG(REG)         ((REG))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)  WRITE_REG((REG), (((READ_REG(REG)) & (~(CLEARMASK))) | (SETMASK)))
+#define POSITION_VAL(VAL)     (__CLZ(__RBIT(VAL)))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STM32F4XX_H
@@ -0,0 +1,248 @@
+/*!
+ * \file      sim.h
+ * \brief     Internal interface of the host peripheral simulator.
+ *
+ * The simulator maps the STM32F411 peripheral and core register windows
+ * at their real addresses with no access rights. Every load or store
+ * the firmware performs on them faults; the access is then single
+ * stepped against a shadow copy of the registers and handed to the
+ * owning peripheral model, which applies the hardware side effects
+ * (write-one-to-clear flags, read-to-clear data registers, counters that
+ * move with time, ...).
+ *
+ * Time is virtual and measured in core clock cycles. It only moves when
+ * the firmware touches a register, spins in delay_cycles() or sleeps in
+ * __WFI(); plain computation between register accesses is free. A loop
+ * that spins on RAM alone for a slice of CPU time is skipped forward to
+ * the next event, as the register polling loops are. All
+ * peripheral clocks are assumed equal to the core clock, which holds for
+ * the reset clock tree this project runs on (HSI, no bus prescalers).
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+/*! Cycles charged for every trapped register access. */
+#define SIM_ACCESS_CYCLES   4U
+/*! Cycles charged for exception entry and for exception return. */
+#define SIM_EXC_CYCLES      12U
+/*! Consecutive identical reads of one register before the simulator
+ *  treats the code as a polling loop and skips to the next event. */
+#define SIM_POLL_STREAK     8U
+/*! Sentinel for "no event scheduled". */
+#define SIM_NEVER           UINT64_MAX
+
+/*! Number of external interrupt lines on the STM32F411. */
+#define SIM_IRQ_COUNT       86
+/*! Number of exceptions (system exceptions followed by the IRQs). */
+#define SIM_EXC_COUNT       (16 + SIM_IRQ_COUNT)
+
+/*! A peripheral model. Every hook is optional. Register values live in
+ *  the shadow memory returned by sim_alias(), so models normally cast it
+ *  to the CMSIS structure of their peripheral and use the fields.
+ */
+typedef struct {
+	const char *name;
+	uint32_t base;      //!< First register address covered.
+	uint32_t size;      //!< Size of the register window in bytes.
+
+	/*! Load the reset values of the registers. */
+	void (*reset)(void);
+	/*! Bring the register at \a addr up to date before it is accessed. */
+	void (*refresh)(uint32_t addr);
+	/*! Apply the side effects of a write. \a old is the value before the
+	 *  store, the stored value can be read back from the shadow copy. */
+	void (*write)(uint32_t addr, uint32_t old);
+	/*! Apply the side effects of a read (clear-on-read flags, ...). */
+	void (*read)(uint32_t addr);
+	/*! Time of the next internal event, or SIM_NEVER. */
+	uint64_t (*next_event)(void);
+	/*! Process every internal event due at or before \a now. */
+	void (*update)(uint64_t now);
+} sim_model;
+
+/* ---------------------------- sim_mmio.c ---------------------------- */
+
+/*! Maps the register windows and installs the access trap handlers. */
+void sim_mmio_init(void);
+
+/*! Returns the shadow copy of the register at the target address \a addr. */
+void *sim_alias(uint32_t addr);
+
+/*! Non-zero while an access is being single stepped. */
+int sim_mmio_busy(void);
+
+/*! Shorthand for a 32-bit shadow register. */
+#define SIM_REG(addr) (*(volatile uint32_t *)sim_alias(addr))
+
+/* ---------------------------- sim_core.c ---------------------------- */
+
+/*! Current virtual time in core cycles. */
+extern uint64_t sim_now;
+
+/*! Core clock frequency the virtual time is measured in. */
+uint32_t sim_core_hz(void);
+
+/*! Converts microseconds to core cycles. */
+uint64_t sim_us(uint64_t us);
+
+/*! Registers a peripheral model; called once at start-up. */
+void sim_register(const sim_model *model);
+
+/*! Runs every model up to \a target, processing events in order. */
+void sim_advance(uint64_t target);
+
+/*! Earliest event scheduled by any model. */
+uint64_t sim_next_event(void);
+
+/*! Called around every trapped access by sim_mmio.c. */
+void sim_access_begin(uint32_t addr, int write);
+void sim_access_end(uint32_t addr, int write, uint32_t old);
+
+/*! Reads \a size bytes at \a addr as a bus master other than the core.
+ *  Registers go through their model, anything else is host memory. */
+uint32_t sim_bus_read(uint32_t addr, uint32_t size);
+
+/*! Writes \a size bytes at \a addr as a bus master other than the core. */
+void sim_bus_write(uint32_t addr, uint32_t value, uint32_t size);
+
+/*! Drives the interrupt request line of \a irq. A high level makes the
+ *  interrupt pending; the level is sampled again on exception return. */
+void sim_irq_level(IRQn_Type irq, int level);
+
+/*! Makes a system exception or interrupt pending (edge). */
+void sim_pend(IRQn_Type irq);
+
+/*! Takes every pending interrupt the current priority allows. */
+void sim_dispatch(void);
+
+/*! Requests a system reset (SCB AIRCR.SYSRESETREQ). Does not return. */
+void sim_reset(void);
+
+/*! Prints the run statistics and exits with \a code. */
+void sim_exit(int code);
+
+/*! Run statistics shared between the models. */
+typedef struct {
+	uint64_t idle_cycles;
+	uint64_t mmio_reads;
+	uint64_t mmio_writes;
+	uint64_t fast_forwards;
+	uint64_t irq_count[SIM_EXC_COUNT];
+	uint64_t uart_tx_bytes;
+	uint64_t uart_rx_bytes;
+	uint64_t uart_overruns;
+	uint32_t resets;
+} sim_stats_t;
+
+extern sim_stats_t sim_stats;
+
+/*! Command line options. */
+typedef struct {
+	int stdio;              //!< USART2 on stdin/stdout instead of a pty.
+	int fast;               //!< Do not pace virtual time against the wall clock.
+	double seconds;         //!< Stop after this much virtual time (0 = run forever).
+	const char *input;      //!< Bytes typed into USART2 at start-up.
+	float temperature;      //!< Temperature reported by the DHT11 and the SHT3x.
+	float humidity;         //!< Humidity reported by the DHT11 and the SHT3x.
+	int dht11_only;         //!< No SHT3x on I2C1.
+	uint32_t touch_ms[16];  //!< Virtual times of touch sensor presses.
+	int touch_count;
+	const char *flash;      //!< File holding the flash contents, or 0.
+} sim_options_t;
+
+extern sim_options_t sim_options;
+
+/* --------------------------- sim_periph.c --------------------------- */
+
+/*! Registers the on-chip peripheral models. */
+void sim_periph_init(void);
+
+/*! Pin level driven by an external device: -1 released, 0 low, 1 high. */
+void sim_gpio_drive(uint32_t pin, int level);
+
+/*! Level the line settles to when nothing drives it (external resistor). */
+void sim_gpio_external_pull(uint32_t pin, int level);
+
+/*! Current level of a pin as seen on the board. */
+int sim_gpio_level(uint32_t pin);
+
+/*! Level the MCU drives onto a pin: -1 when it is an input. */
+int sim_gpio_mcu_drive(uint32_t pin);
+
+/*! Registers a callback run whenever the MCU drive of \a pin changes. */
+void sim_gpio_watch(uint32_t pin, void (*callback)(uint32_t pin, int drive));
+
+/*! Queues bytes for reception on USART2. */
+void sim_uart_input(const uint8_t *data, uint32_t length);
+
+/*! Number of bytes waiting to be clocked into USART2. */
+uint32_t sim_uart_input_pending(void);
+
+/*! Sink for bytes transmitted on USART2. */
+void sim_uart_output(uint8_t byte);
+
+/*! Drives the DMA request of a peripheral: \a controller 1 or 2, the
+ *  stream and channel the request is routed to in RM0383 table 27/28. */
+void sim_dma_request(int controller, int stream, int channel, int level);
+
+/*! Sets the voltage seen by ADC channel \a channel, as a raw 12-bit value. */
+void sim_adc_set_channel(uint32_t channel, uint16_t value);
+
+/*! An I2C slave attached to I2C1. */
+typedef struct {
+	uint8_t address;                 //!< 7-bit address.
+	/*! Start of a transfer addressed to the slave; returns 1 to ACK. */
+	int (*start)(int read);
+	/*! Byte written by the master; returns 1 to ACK. */
+	int (*write)(uint8_t byte);
+	/*! Byte requested by the master. */
+	uint8_t (*read)(void);
+	/*! Stop condition. */
+	void (*stop)(void);
+} sim_i2c_slave;
+
+/*! Attaches a slave to the I2C1 bus. */
+void sim_i2c_attach(const sim_i2c_slave *slave);
+
+/* ---------------------------- sim_flash.c --------------------------- */
+
+/*! Size of the flash memory at FLASH_BASE. */
+#define SIM_FLASH_SIZE      0x00080000U
+
+/*! Registers the flash interface and flash memory models. */
+void sim_flash_init(void);
+
+/*! Descriptor of the flash contents, erased when new. It stays open
+ *  across a reset. */
+int sim_flash_storage(void);
+
+/* --------------------------- sim_console.c -------------------------- */
+
+/*! Opens the pseudo terminal (or stdio) backing USART2. */
+void sim_console_init(void);
+
+/*! Reads any pending terminal input into USART2. */
+void sim_console_poll(void);
+
+/*! Waits on the terminal until wall clock time catches up with \a target
+ *  virtual time or input arrives. Returns the virtual time reached. */
+uint64_t sim_console_idle(uint64_t target);
+
+/*! Restores the terminal settings. */
+void sim_console_restore(void);
+
+/*! Descriptor handed over to the next image on a reset, or -1. */
+int sim_console_fd(void);
+
+/* --------------------------- sim_devices.c -------------------------- */
+
+/*! Registers the off-chip device models (DHT11, touch sensor). */
+void sim_devices_init(void);
+
+/*! Presses the touch sensor now. */
+void sim_touch_press(void);
+
+#endif // SIM_H
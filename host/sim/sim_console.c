@@ -0,0 +1,177 @@
+/*!
+ * \file      sim_console.c
+ * \brief     Terminal backing the simulated USART2.
+ *
+ * By default USART2 is wired to a pseudo terminal, so any terminal
+ * program (screen, picocom, minicom) can be attached to it exactly as to
+ * the ST-Link virtual COM port. With --stdio the simulator's own terminal
+ * is used instead. The terminal is polled every millisecond of virtual
+ * time, and __WFI() sleeps on it so that virtual time follows the wall
+ * clock while the firmware is idle.
+ */
+#define _GNU_SOURCE
+// Before <termios.h>, whose CR1..CR3 macros clash with register names.
+#include "sim.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define POLL_INTERVAL_US 1000U
+
+static int fd_in = -1;
+static int fd_out = -1;
+static int pty_fd = -1;
+static int slave_fd = -1;
+static int input_closed;
+static int restore_stdin;
+static struct termios saved_termios;
+static uint64_t next_poll;
+static double wall_origin;      // wall clock time of virtual time zero
+
+static const sim_model console_model;
+
+static double wall_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void make_raw(int fd, int keep_signals) {
+	struct termios t;
+	if (tcgetattr(fd, &t) < 0) return;
+	cfmakeraw(&t);
+	if (keep_signals) t.c_lflag |= ISIG;
+	tcsetattr(fd, TCSANOW, &t);
+}
+
+static void open_pty(void) {
+	const char *env = getenv("SIM_PTY_FD");
+
+	if (env) {
+		// Same terminal as before the reset, the client stays attached.
+		pty_fd = atoi(env);
+	} else {
+		pty_fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (pty_fd < 0 || grantpt(pty_fd) < 0 || unlockpt(pty_fd) < 0) {
+			perror("sim: pty");
+			exit(1);
+		}
+		// Holding the slave open keeps the pty alive between clients.
+		slave_fd = open(ptsname(pty_fd), O_RDWR | O_NOCTTY);
+		if (slave_fd >= 0) make_raw(slave_fd, 0);
+	}
+	fcntl(pty_fd, F_SETFL, fcntl(pty_fd, F_GETFL) | O_NONBLOCK);
+	fcntl(pty_fd, F_SETFD, 0);  // survives the exec of a reset
+	fprintf(stderr, "sim: USART2 on %s\n", ptsname(pty_fd));
+	fd_in = fd_out = pty_fd;
+}
+
+void sim_console_init(void) {
+	if (sim_options.stdio) {
+		fd_in = STDIN_FILENO;
+		fd_out = STDOUT_FILENO;
+		if (isatty(fd_in) && tcgetattr(fd_in, &saved_termios) == 0) {
+			restore_stdin = 1;
+			make_raw(fd_in, 1);
+		}
+	} else {
+		open_pty();
+	}
+	wall_origin = wall_now() - (double)sim_now / sim_core_hz();
+	sim_register(&console_model);
+}
+
+void sim_console_restore(void) {
+	if (restore_stdin) {
+		tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+		restore_stdin = 0;
+	}
+}
+
+int sim_console_fd(void) {
+	return pty_fd;
+}
+
+void sim_uart_output(uint8_t byte) {
+	// A pty without a client fills up; the byte is lost as on a real line.
+	while (write(fd_out, &byte, 1) < 0 && errno == EINTR) {
+	}
+}
+
+void sim_console_poll(void) {
+	struct pollfd p = { .fd = fd_in, .events = POLLIN };
+	uint8_t data[256];
+	ssize_t n;
+
+	if (input_closed) return;
+	// Only as much as the receiver holds, the rest stays in the terminal.
+	if (sim_uart_input_pending() > 64) return;
+	if (poll(&p, 1, 0) <= 0) return;
+	n = read(fd_in, data, sizeof(data));
+	if (n > 0) {
+		sim_uart_input(data, (uint32_t)n);
+	} else if (n == 0 && fd_in == STDIN_FILENO) {
+		input_closed = 1;
+	}
+}
+
+uint64_t sim_console_idle(uint64_t target) {
+	struct pollfd p = { .fd = fd_in, .events = POLLIN };
+	int pacing = !sim_options.fast && target != SIM_NEVER;
+	double hz = sim_core_hz();
+
+	if (input_closed || sim_uart_input_pending()) {
+		return target;
+	}
+
+	for (;;) {
+		int timeout = -1;
+		if (pacing) {
+			double left = wall_origin + target / hz - wall_now();
+			if (left <= 0) return target;
+			timeout = (int)(left * 1000.0) + 1;
+		} else if (target != SIM_NEVER) {
+			return target;
+		}
+
+		if (poll(&p, 1, timeout) <= 0) continue;
+		if (p.revents & POLLIN) {
+			uint64_t reached = pacing ? (uint64_t)((wall_now() - wall_origin) * hz) : sim_now;
+			if (reached < sim_now) reached = sim_now;
+			if (reached > target) reached = target;
+			return reached;
+		}
+		if (fd_in == STDIN_FILENO) {
+			input_closed = 1;
+			return target;
+		}
+		// pty without a client reports a hang-up; wait for one to attach.
+		struct timespec ts = { 0, 10000000 };
+		nanosleep(&ts, 0);
+	}
+}
+
+static uint64_t console_next_event(void) {
+	return input_closed ? SIM_NEVER : next_poll;
+}
+
+static void console_update(uint64_t now) {
+	if (next_poll <= now) {
+		sim_console_poll();
+		next_poll = now + sim_us(POLL_INTERVAL_US);
+	}
+}
+
+static void console_reset(void) {
+	next_poll = sim_now + sim_us(POLL_INTERVAL_US);
+}
+
+static const sim_model console_model = {
+	.name = "console",
+	.reset = console_reset, .next_event = console_next_event, .update = console_update,
+};
@@ -0,0 +1,871 @@
+/*!
+ * \file      sim_core.c
+ * \brief     Virtual clock, Cortex-M4 core peripherals and the run loop.
+ *
+ * Models NVIC, SCB, SysTick and DWT, takes interrupts with Cortex-M
+ * priority rules (PRIMASK, group priority, tail chaining on return) and
+ * provides the intrinsics the firmware calls (__WFI, __enable_irq, ...).
+ * The firmware's main() is renamed to app_main() by the build and is
+ * called from here after SystemInit(), as the reset handler does.
+ */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "sim.h"
+
+extern int app_main();
+extern void (*const sim_vectors[SIM_EXC_COUNT])(void);
+extern const char *const sim_vector_names[SIM_EXC_COUNT];
+
+uint64_t sim_now;
+sim_stats_t sim_stats;
+sim_options_t sim_options = { .temperature = 24.0f, .humidity = 45.0f };
+
+static const sim_model *models[32];
+static int model_count;
+
+static uint64_t end_cycles;
+static char **saved_argv;
+static volatile sig_atomic_t touch_request;
+static uint64_t idle_since = SIM_NEVER;  // start of the WFI in progress
+
+// Polling loop detection.
+static uint32_t poll_addr;
+static uint32_t poll_value;
+static uint32_t poll_streak;
+
+uint32_t sim_core_hz(void) {
+	return HSI_VALUE;
+}
+
+uint64_t sim_us(uint64_t us) {
+	return us * (sim_core_hz() / 1000000U);
+}
+
+void sim_register(const sim_model *model) {
+	models[model_count++] = model;
+}
+
+static const sim_model *find_model(uint32_t addr) {
+	for (int i = 0; i < model_count; i++) {
+		const sim_model *m = models[i];
+		if (m->size && addr >= m->base && addr - m->base < m->size) {
+			return m;
+		}
+	}
+	return 0;
+}
+
+uint64_t sim_next_event(void) {
+	uint64_t next = SIM_NEVER;
+	for (int i = 0; i < model_count; i++) {
+		if (models[i]->next_event) {
+			uint64_t t = models[i]->next_event();
+			if (t < next) next = t;
+		}
+	}
+	return next;
+}
+
+void sim_advance(uint64_t target) {
+	for (;;) {
+		uint64_t t = sim_next_event();
+		if (t > target) break;
+		if (t > sim_now) sim_now = t;
+		for (int i = 0; i < model_count; i++) {
+			if (models[i]->update) models[i]->update(sim_now);
+		}
+	}
+	if (target > sim_now) sim_now = target;
+
+	if (touch_request) {
+		touch_request = 0;
+		sim_touch_press();
+	}
+	if (end_cycles && sim_now >= end_cycles) {
+		sim_exit(0);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*                              NVIC                                  */
+/* ------------------------------------------------------------------ */
+
+static uint8_t irq_enabled[SIM_IRQ_COUNT];
+static uint8_t irq_level[SIM_IRQ_COUNT];
+static uint8_t exc_pending[SIM_EXC_COUNT];
+static uint8_t exc_active[SIM_EXC_COUNT];
+static int exc_stack[SIM_EXC_COUNT];
+static int exc_depth;
+static uint32_t primask;
+
+int sim_current_exception(void) {
+	return exc_depth ? exc_stack[exc_depth - 1] : 0;
+}
+
+static void nvic_mirror(void) {
+	for (int word = 0; word < 3; word++) {
+		uint32_t en = 0, pend = 0, act = 0;
+		for (int bit = 0; bit < 32; bit++) {
+			int irq = word * 32 + bit;
+			if (irq >= SIM_IRQ_COUNT) break;
+			en |= (uint32_t)irq_enabled[irq] << bit;
+			pend |= (uint32_t)exc_pending[irq + 16] << bit;
+			act |= (uint32_t)exc_active[irq + 16] << bit;
+		}
+		SIM_REG((uint32_t)(uintptr_t)&NVIC->ISER[word]) = en;
+		SIM_REG((uint32_t)(uintptr_t)&NVIC->ICER[word]) = en;
+		SIM_REG((uint32_t)(uintptr_t)&NVIC->ISPR[word]) = pend;
+		SIM_REG((uint32_t)(uintptr_t)&NVIC->ICPR[word]) = pend;
+		SIM_REG((uint32_t)(uintptr_t)&NVIC->IABR[word]) = act;
+	}
+}
+
+static void sample_level(int irq) {
+	if (irq_level[irq] && !exc_active[irq + 16]) {
+		exc_pending[irq + 16] = 1;
+	}
+}
+
+void sim_irq_level(IRQn_Type irq, int level) {
+	irq_level[irq] = level != 0;
+	sample_level(irq);
+	nvic_mirror();
+}
+
+void sim_pend(IRQn_Type irq) {
+	exc_pending[irq + 16] = 1;
+	nvic_mirror();
+}
+
+static uint32_t exc_priority(int exc) {
+	if (exc >= 16) {
+		return *(volatile uint8_t *)sim_alias((uint32_t)(uintptr_t)&NVIC->IP[exc - 16]);
+	} else if (exc >= 4) {
+		return *(volatile uint8_t *)sim_alias((uint32_t)(uintptr_t)&SCB->SHP[exc - 4]);
+	}
+	return 0;
+}
+
+static uint32_t group_priority(uint32_t priority) {
+	uint32_t prigroup = (SIM_REG(SCB_BASE + 0x0C) & SCB_AIRCR_PRIGROUP_Msk) >> SCB_AIRCR_PRIGROUP_Pos;
+	return priority & ~((2U << prigroup) - 1U);
+}
+
+static uint32_t execution_priority(int use_primask) {
+	uint32_t level = 256;
+	for (int i = 0; i < exc_depth; i++) {
+		uint32_t p = group_priority(exc_priority(exc_stack[i]));
+		if (p < level) level = p;
+	}
+	if (use_primask && primask) level = 0;
+	return level;
+}
+
+static int highest_pending(int use_primask) {
+	uint32_t limit = execution_priority(use_primask);
+	int best = -1;
+	uint32_t best_priority = 0;
+
+	for (int exc = 2; exc < SIM_EXC_COUNT; exc++) {
+		if (!exc_pending[exc]) continue;
+		if (exc >= 16 && !irq_enabled[exc - 16]) continue;
+		uint32_t p = exc_priority(exc);
+		if (group_priority(p) >= limit) continue;
+		if (best < 0 || p < best_priority) {
+			best = exc;
+			best_priority = p;
+		}
+	}
+	return best;
+}
+
+static void take_exception(int exc) {
+	exc_pending[exc] = 0;
+	exc_active[exc] = 1;
+	exc_stack[exc_depth++] = exc;
+	nvic_mirror();
+	sim_stats.irq_count[exc]++;
+	sim_advance(sim_now + SIM_EXC_CYCLES);
+
+	sim_vectors[exc]();
+
+	sim_advance(sim_now + SIM_EXC_CYCLES);
+	exc_depth--;
+	exc_active[exc] = 0;
+	for (int irq = 0; irq < SIM_IRQ_COUNT; irq++) {
+		sample_level(irq);
+	}
+	nvic_mirror();
+}
+
+void sim_dispatch(void) {
+	int exc;
+	while ((exc = highest_pending(1)) >= 0) {
+		take_exception(exc);
+	}
+}
+
+static void nvic_write(uint32_t addr, uint32_t old) {
+	uint32_t offset = addr - NVIC_BASE;
+	uint32_t value = SIM_REG(addr);
+	int word = (offset & 0x7F) >> 2;
+	(void)old;
+
+	if (offset >= 0x300) {
+		return; // IP: plain storage
+	}
+	for (int bit = 0; bit < 32; bit++) {
+		int irq = word * 32 + bit;
+		if (!(value & (1U << bit)) || irq >= SIM_IRQ_COUNT) continue;
+		switch (offset >> 7) {
+			case 0: irq_enabled[irq] = 1; break;                      // ISER
+			case 1: irq_enabled[irq] = 0; break;                      // ICER
+			case 2: exc_pending[irq + 16] = 1; break;                 // ISPR
+			case 3: exc_pending[irq + 16] = 0; sample_level(irq); break; // ICPR
+		}
+	}
+	nvic_mirror();
+}
+
+static void nvic_reset(void) {
+	memset(irq_enabled, 0, sizeof(irq_enabled));
+	memset(exc_pending, 0, sizeof(exc_pending));
+	nvic_mirror();
+}
+
+static const sim_model nvic_model = {
+	.name = "NVIC", .base = NVIC_BASE, .size = 0x3F0,
+	.reset = nvic_reset, .write = nvic_write,
+};
+
+/* ------------------------------------------------------------------ */
+/*                     SCB, CoreDebug and STIR                        */
+/* ------------------------------------------------------------------ */
+
+#define SCB_ICSR_PENDSVSET   (1UL << 28)
+#define SCB_ICSR_PENDSVCLR   (1UL << 27)
+#define SCB_ICSR_PENDSTSET   (1UL << 26)
+#define SCB_ICSR_PENDSTCLR   (1UL << 25)
+#define SCB_ICSR_ISRPENDING  (1UL << 22)
+#define NVIC_STIR_ADDR       0xE000EF00UL
+
+static void scb_reset(void) {
+	SCB_Type *scb = sim_alias(SCB_BASE);
+	memset((void *)scb, 0, sizeof(*scb));
+	SIM_REG(SCB_BASE) = 0x410FC241; // CPUID, read-only in the CMSIS type
+	scb->AIRCR = 0xFA050000;
+	scb->CCR = 0x00000200;
+}
+
+static void scb_refresh(uint32_t addr) {
+	if (addr == SCB_BASE + 0x04) {
+		int pending = highest_pending(0);
+		uint32_t icsr = (uint32_t)sim_current_exception();
+		if (pending > 0) icsr |= ((uint32_t)pending << 12) | SCB_ICSR_ISRPENDING;
+		if (exc_pending[15]) icsr |= SCB_ICSR_PENDSTSET;
+		if (exc_pending[14]) icsr |= SCB_ICSR_PENDSVSET;
+		SIM_REG(addr) = icsr;
+	}
+}
+
+static void scb_write(uint32_t addr, uint32_t old) {
+	uint32_t value = SIM_REG(addr);
+
+	switch (addr - SCB_BASE) {
+		case 0x00: // CPUID is read-only
+			SIM_REG(addr) = old;
+			break;
+		case 0x04: // ICSR
+			if (value & SCB_ICSR_PENDSTSET) exc_pending[15] = 1;
+			if (value & SCB_ICSR_PENDSTCLR) exc_pending[15] = 0;
+			if (value & SCB_ICSR_PENDSVSET) exc_pending[14] = 1;
+			if (value & SCB_ICSR_PENDSVCLR) exc_pending[14] = 0;
+			scb_refresh(addr);
+			break;
+		case 0x0C: // AIRCR, needs the VECTKEY
+			if ((value >> 16) != 0x05FA) {
+				SIM_REG(addr) = old;
+				break;
+			}
+			SIM_REG(addr) = 0xFA050000 | (value & SCB_AIRCR_PRIGROUP_Msk);
+			if (value & SCB_AIRCR_SYSRESETREQ_Msk) {
+				sim_reset();
+			}
+			break;
+		default:
+			if (addr == NVIC_STIR_ADDR && (value & 0x1FF) < SIM_IRQ_COUNT) {
+				exc_pending[(value & 0x1FF) + 16] = 1;
+				nvic_mirror();
+			}
+			break;
+	}
+}
+
+static const sim_model scb_model = {
+	.name = "SCB", .base = SCB_BASE, .size = 0x204,
+	.reset = scb_reset, .refresh = scb_refresh, .write = scb_write,
+};
+
+/* ------------------------------------------------------------------ */
+/*                              SysTick                               */
+/* ------------------------------------------------------------------ */
+
+static uint64_t systick_zero;   // time the counter next reaches zero
+
+static uint64_t systick_period(void) {
+	SysTick_Type *st = sim_alias(SysTick_BASE);
+	uint64_t period = (st->LOAD & SysTick_LOAD_RELOAD_Msk) + 1ULL;
+	// CLKSOURCE = 0 selects the external reference, HCLK / 8.
+	return (st->CTRL & SysTick_CTRL_CLKSOURCE_Msk) ? period : period * 8;
+}
+
+static int systick_running(void) {
+	SysTick_Type *st = sim_alias(SysTick_BASE);
+	return (st->CTRL & SysTick_CTRL_ENABLE_Msk) && (st->LOAD & SysTick_LOAD_RELOAD_Msk);
+}
+
+static void systick_reset(void) {
+	SysTick_Type *st = sim_alias(SysTick_BASE);
+	st->CTRL = 0;
+	st->LOAD = 0;
+	st->VAL = 0;
+	SIM_REG(SysTick_BASE + 0x0C) = 0xC0000000 | (HSI_VALUE / 8 / 100); // CALIB: no reference, 10 ms
+	systick_zero = SIM_NEVER;
+}
+
+static void systick_refresh(uint32_t addr) {
+	SysTick_Type *st = sim_alias(SysTick_BASE);
+	if (addr == SysTick_BASE + 0x08 && systick_running()) {
+		uint64_t left = systick_zero - sim_now;
+		uint64_t div = (st->CTRL & SysTick_CTRL_CLKSOURCE_Msk) ? 1 : 8;
+		st->VAL = (uint32_t)((left + div - 1) / div) % ((st->LOAD & SysTick_LOAD_RELOAD_Msk) + 1);
+	}
+}
+
+static void systick_read(uint32_t addr) {
+	if (addr == SysTick_BASE) {
+		SIM_REG(addr) &= ~SysTick_CTRL_COUNTFLAG_Msk;
+	}
+}
+
+static void systick_write(uint32_t addr, uint32_t old) {
+	SysTick_Type *st = sim_alias(SysTick_BASE);
+
+	switch (addr - SysTick_BASE) {
+		case 0x00: // CTRL, COUNTFLAG is read-only
+			st->CTRL = (st->CTRL & 0x7) | (old & SysTick_CTRL_COUNTFLAG_Msk);
+			if (!(old & SysTick_CTRL_ENABLE_Msk) && (st->CTRL & SysTick_CTRL_ENABLE_Msk)) {
+				// Counting resumes from VAL, or reloads first when VAL is zero.
+				uint32_t val = st->VAL & SysTick_VAL_CURRENT_Msk;
+				uint64_t div = (st->CTRL & SysTick_CTRL_CLKSOURCE_Msk) ? 1 : 8;
+				systick_zero = sim_now + (val ? val * div : systick_period());
+			}
+			break;
+		case 0x04: // LOAD
+			st->LOAD &= SysTick_LOAD_RELOAD_Msk;
+			break;
+		case 0x08: // VAL, any write clears it and COUNTFLAG
+			st->VAL = 0;
+			st->CTRL &= ~SysTick_CTRL_COUNTFLAG_Msk;
+			systick_zero = sim_now + systick_period();
+			break;
+		case 0x0C: // CALIB is read-only
+			SIM_REG(addr) = old;
+			break;
+	}
+}
+
+static uint64_t systick_next_event(void) {
+	return systick_running() ? systick_zero : SIM_NEVER;
+}
+
+static void systick_update(uint64_t now) {
+	SysTick_Type *st = sim_alias(SysTick_BASE);
+	while (systick_running() && systick_zero <= now) {
+		st->CTRL |= SysTick_CTRL_COUNTFLAG_Msk;
+		if (st->CTRL & SysTick_CTRL_TICKINT_Msk) {
+			sim_pend(SysTick_IRQn);
+		}
+		systick_zero += systick_period();
+	}
+}
+
+static const sim_model systick_model = {
+	.name = "SysTick", .base = SysTick_BASE, .size = 0x10,
+	.reset = systick_reset, .refresh = systick_refresh, .read = systick_read,
+	.write = systick_write, .next_event = systick_next_event, .update = systick_update,
+};
+
+/* ------------------------------------------------------------------ */
+/*                                DWT                                 */
+/* ------------------------------------------------------------------ */
+
+static uint64_t dwt_origin;     // time CYCCNT was zero
+
+static int dwt_counting(void) {
+	DWT_Type *dwt = sim_alias(DWT_BASE);
+	CoreDebug_Type *dbg = sim_alias(CoreDebug_BASE);
+	return (dwt->CTRL & DWT_CTRL_CYCCNTENA_Msk) && (dbg->DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+}
+
+static void dwt_reset(void) {
+	DWT_Type *dwt = sim_alias(DWT_BASE);
+	memset((void *)dwt, 0, sizeof(*dwt));
+	dwt->CTRL = 0x40000000; // NUMCOMP = 4
+	dwt_origin = sim_now;
+}
+
+static void dwt_refresh(uint32_t addr) {
+	if (addr == DWT_BASE + 0x04 && dwt_counting()) {
+		SIM_REG(addr) = (uint32_t)(sim_now - dwt_origin);
+	}
+}
+
+static void dwt_write(uint32_t addr, uint32_t old) {
+	DWT_Type *dwt = sim_alias(DWT_BASE);
+	if (addr == DWT_BASE && (old & DWT_CTRL_CYCCNTENA_Msk) && !(dwt->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+		// Stopping freezes the count where it is.
+		dwt->CYCCNT = (uint32_t)(sim_now - dwt_origin);
+	}
+	if (addr == DWT_BASE + 0x04 || (addr == DWT_BASE && !(old & DWT_CTRL_CYCCNTENA_Msk))) {
+		dwt_origin = sim_now - dwt->CYCCNT;
+	}
+}
+
+static const sim_model dwt_model = {
+	.name = "DWT", .base = DWT_BASE, .size = 0x20,
+	.reset = dwt_reset, .refresh = dwt_refresh, .write = dwt_write,
+};
+
+/* ------------------------------------------------------------------ */
+/*                     Register access bookkeeping                    */
+/* ------------------------------------------------------------------ */
+
+void sim_access_begin(uint32_t addr, int write) {
+	const sim_model *m = find_model(addr);
+
+	sim_advance(sim_now + SIM_ACCESS_CYCLES);
+	if (m && m->refresh) m->refresh(addr);
+
+	if (write) {
+		sim_stats.mmio_writes++;
+		poll_streak = 0;
+		return;
+	}
+
+	sim_stats.mmio_reads++;
+	if (addr == poll_addr && SIM_REG(addr) == poll_value) {
+		if (++poll_streak >= SIM_POLL_STREAK) {
+			// The code is spinning on a register; nothing changes before
+			// the next event, so jump straight to it.
+			uint64_t next = sim_next_event();
+			if (next != SIM_NEVER && next > sim_now) {
+				sim_stats.fast_forwards++;
+				sim_advance(next);
+				if (m && m->refresh) m->refresh(addr);
+			}
+			poll_streak = 0;
+		}
+	} else {
+		poll_addr = addr;
+		poll_value = SIM_REG(addr);
+		poll_streak = 0;
+	}
+}
+
+void sim_access_end(uint32_t addr, int write, uint32_t old) {
+	const sim_model *m = find_model(addr);
+
+	if (m) {
+		if (write && m->write) m->write(addr, old);
+		if (!write && m->read) m->read(addr);
+	}
+	sim_dispatch();
+}
+
+/* Accesses made by a bus master other than the core (DMA). They hit the
+ * models the same way firmware accesses do, without being counted. */
+
+static int is_register(uint32_t addr) {
+	return addr >= PERIPH_BASE;
+}
+
+uint32_t sim_bus_read(uint32_t addr, uint32_t size) {
+	const sim_model *m;
+	uint32_t value = 0;
+
+	if (!is_register(addr)) {
+		memcpy(&value, (void *)(uintptr_t)addr, size);
+		return value;
+	}
+	m = find_model(addr);
+	if (m && m->refresh) m->refresh(addr & ~3U);
+	memcpy(&value, sim_alias(addr), size);
+	if (m && m->read) m->read(addr & ~3U);
+	return value;
+}
+
+void sim_bus_write(uint32_t addr, uint32_t value, uint32_t size) {
+	const sim_model *m;
+	uint32_t old;
+
+	if (!is_register(addr)) {
+		memcpy((void *)(uintptr_t)addr, &value, size);
+		return;
+	}
+	m = find_model(addr);
+	if (m && m->refresh) m->refresh(addr & ~3U);
+	old = SIM_REG(addr & ~3U);
+	memcpy(sim_alias(addr), &value, size);
+	if (m && m->write) m->write(addr & ~3U, old);
+}
+
+/* Busy loop detection. A loop waiting on a flag in RAM, set by an
+ * interrupt handler, touches no register and so never moves time. When
+ * a whole slice of CPU time passes without any register access the
+ * firmware is treated as spinning and time jumps to the next event. */
+
+#define SPIN_SLICE_US 5000
+
+static uint64_t spin_now;
+static uint64_t spin_accesses;
+
+static void on_spin(int sig) {
+	uint64_t accesses = sim_stats.mmio_reads + sim_stats.mmio_writes;
+	int saved_errno = errno;
+	(void)sig;
+
+	if (sim_now == spin_now && accesses == spin_accesses && !sim_mmio_busy()) {
+		uint64_t next = sim_next_event();
+		if (end_cycles && next > end_cycles) next = end_cycles;
+		if (!sim_options.fast || next == SIM_NEVER) {
+			next = sim_console_idle(next);
+		}
+		if (next == SIM_NEVER) {
+			fprintf(stderr, "sim: firmware spins with no further events, stopping\n");
+			sim_exit(0);
+		}
+		sim_stats.fast_forwards++;
+		sim_advance(next);
+		sim_dispatch();
+	}
+	spin_now = sim_now;
+	spin_accesses = sim_stats.mmio_reads + sim_stats.mmio_writes;
+	errno = saved_errno;
+}
+
+static void spin_init(void) {
+	struct sigaction sa;
+	struct itimerval slice = { { 0, SPIN_SLICE_US }, { 0, SPIN_SLICE_US } };
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_spin;
+	sa.sa_flags = SA_RESTART | SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGVTALRM, &sa, 0);
+	setitimer(ITIMER_VIRTUAL, &slice, 0);
+}
+
+/* ------------------------------------------------------------------ */
+/*                            Intrinsics                              */
+/* ------------------------------------------------------------------ */
+
+void __enable_irq(void) {
+	primask = 0;
+	sim_dispatch();
+}
+
+void __disable_irq(void) {
+	primask = 1;
+}
+
+uint32_t __get_PRIMASK(void) {
+	return primask;
+}
+
+void __set_PRIMASK(uint32_t value) {
+	primask = value & 1;
+	sim_dispatch();
+}
+
+void __WFI(void) {
+	idle_since = sim_now;
+
+	// WFI wakes on any interrupt that could preempt, even with PRIMASK set.
+	while (highest_pending(0) < 0) {
+		uint64_t next = sim_next_event();
+		if (end_cycles && next > end_cycles) next = end_cycles;
+
+		if (!sim_options.fast || next == SIM_NEVER) {
+			next = sim_console_idle(next);
+		}
+		if (next == SIM_NEVER) {
+			fprintf(stderr, "sim: no further events, stopping\n");
+			sim_exit(0);
+		}
+		sim_advance(next);
+	}
+	sim_stats.idle_cycles += sim_now - idle_since;
+	idle_since = SIM_NEVER;
+	sim_dispatch();
+}
+
+void __WFE(void) {
+	__WFI();
+}
+
+void __SEV(void) {
+}
+
+/*! Host replacement for delay_as.s: burns the cycles in virtual time,
+ *  taking interrupts as they become due. */
+void delay_cycles(unsigned int cycles) {
+	uint64_t target = sim_now + cycles;
+
+	poll_streak = 0;
+	while (sim_now < target) {
+		uint64_t next = sim_next_event();
+		sim_advance(next < target ? next : target);
+		sim_dispatch();
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*                        Stimulus and options                        */
+/* ------------------------------------------------------------------ */
+
+static uint8_t input_bytes[1024];
+static uint32_t input_length;
+static uint32_t input_sent;
+static uint32_t input_pauses[64];  // a second's pause before these offsets
+static uint32_t input_pause_count;
+static uint32_t input_pause;       // next of input_pauses
+static uint64_t input_time = SIM_NEVER;
+
+static uint64_t stimulus_next_event(void) {
+	return input_time;
+}
+
+static void stimulus_update(uint64_t now) {
+	uint32_t end = input_length;
+
+	if (input_time > now) {
+		return;
+	}
+	if (input_pause < input_pause_count) {
+		end = input_pauses[input_pause++];
+	}
+	sim_uart_input(input_bytes + input_sent, end - input_sent);
+	input_sent = end;
+	input_time = input_sent < input_length || input_pause < input_pause_count ? now + sim_us(1000000) : SIM_NEVER;
+}
+
+static const sim_model stimulus_model = {
+	.name = "stimulus",
+	.next_event = stimulus_next_event, .update = stimulus_update,
+};
+
+static uint32_t unescape(const char *s, uint8_t *out, uint32_t max) {
+	uint32_t n = 0;
+	while (*s && n < max) {
+		char c = *s++;
+		if (c == '\\' && *s) {
+			c = *s++;
+			switch (c) {
+				case 'r': c = '\r'; break;
+				case 'n': c = '\n'; break;
+				case 't': c = '\t'; break;
+				case 'e': c = 0x1B; break;
+				case 'b': c = 0x7F; break;
+				case 'x': c = (char)strtol(s, (char **)&s, 16); break;
+				case 'p':
+					if (input_pause_count < sizeof(input_pauses) / sizeof(input_pauses[0])) {
+						input_pauses[input_pause_count++] = n;
+					}
+					continue;
+				default: break;
+			}
+		}
+		out[n++] = (uint8_t)c;
+	}
+	return n;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr,
+	        "usage: %s [options]\n"
+	        "  --stdio        USART2 on stdin/stdout instead of a pseudo terminal\n"
+	        "  --fast         run as fast as possible instead of in real time\n"
+	        "  --seconds N    stop after N seconds of virtual time\n"
+	        "  --input STR    type STR into USART2 at start-up (C escapes, \\b is DEL,\n"
+	        "                 \\p pauses for a second)\n"
+	        "  --touch MS     press the touch sensor MS milliseconds into the run\n"
+	        "  --temp X       temperature reported by the sensors (default 24.0)\n"
+	        "  --hum Y        humidity reported by the sensors (default 45)\n"
+	        "  --dht11-only   leave the SHT3x off I2C1, so the DHT11 is read\n"
+	        "  --flash FILE   keep the flash contents in FILE (default: erased each run)\n"
+	        "Send SIGUSR1 to press the touch sensor at any time.\n",
+	        name);
+}
+
+static void parse_options(int argc, char **argv) {
+	static const struct option long_options[] = {
+		{ "stdio",   no_argument,       0, 's' },
+		{ "fast",    no_argument,       0, 'f' },
+		{ "seconds", required_argument, 0, 'n' },
+		{ "input",   required_argument, 0, 'i' },
+		{ "touch",   required_argument, 0, 't' },
+		{ "temp",    required_argument, 0, 'T' },
+		{ "hum",     required_argument, 0, 'H' },
+		{ "dht11-only", no_argument,    0, 'D' },
+		{ "flash",   required_argument, 0, 'F' },
+		{ "help",    no_argument,       0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", long_options, 0)) != -1) {
+		switch (c) {
+			case 's': sim_options.stdio = 1; break;
+			case 'f': sim_options.fast = 1; break;
+			case 'n': sim_options.seconds = atof(optarg); break;
+			case 'i': sim_options.input = optarg; break;
+			case 'T': sim_options.temperature = (float)atof(optarg); break;
+			case 'H': sim_options.humidity = (float)atof(optarg); break;
+			case 'D': sim_options.dht11_only = 1; break;
+			case 'F': sim_options.flash = optarg; break;
+			case 't':
+				if (sim_options.touch_count < 16) {
+					sim_options.touch_ms[sim_options.touch_count++] = (uint32_t)atol(optarg);
+				}
+				break;
+			default:
+				usage(argv[0]);
+				exit(c == 'h' ? 0 : 2);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/*                     Reset, statistics and entry                    */
+/* ------------------------------------------------------------------ */
+
+void sim_exit(int code) {
+	double hz = sim_core_hz();
+	int first = 1;
+
+	if (idle_since != SIM_NEVER) {
+		sim_stats.idle_cycles += sim_now - idle_since;
+	}
+	sim_console_restore();
+	fprintf(stderr, "\nsim: %.6f s virtual (%llu cycles), %.1f%% idle in WFI\n",
+	        sim_now / hz, (unsigned long long)sim_now,
+	        sim_now ? 100.0 * sim_stats.idle_cycles / sim_now : 0.0);
+	fprintf(stderr, "sim: %llu register accesses (%llu reads, %llu writes), %llu polling loops skipped\n",
+	        (unsigned long long)(sim_stats.mmio_reads + sim_stats.mmio_writes),
+	        (unsigned long long)sim_stats.mmio_reads, (unsigned long long)sim_stats.mmio_writes,
+	        (unsigned long long)sim_stats.fast_forwards);
+	fprintf(stderr, "sim: interrupts:");
+	for (int exc = 0; exc < SIM_EXC_COUNT; exc++) {
+		if (sim_stats.irq_count[exc]) {
+			fprintf(stderr, "%s %s %llu", first ? "" : ",", sim_vector_names[exc],
+			        (unsigned long long)sim_stats.irq_count[exc]);
+			first = 0;
+		}
+	}
+	fprintf(stderr, "%s\n", first ? " none" : "");
+	fprintf(stderr, "sim: USART2 tx %llu bytes, rx %llu bytes, %llu overruns; %u resets\n",
+	        (unsigned long long)sim_stats.uart_tx_bytes, (unsigned long long)sim_stats.uart_rx_bytes,
+	        (unsigned long long)sim_stats.uart_overruns, sim_stats.resets);
+	_exit(code);
+}
+
+void sim_reset(void) {
+	char value[32];
+	int fd = sim_console_fd();
+
+	// A reset restarts the image; hand over what must survive it.
+	sim_console_restore();
+	fprintf(stderr, "\nsim: system reset at %.6f s\n", sim_now / (double)sim_core_hz());
+	snprintf(value, sizeof(value), "%llu", (unsigned long long)sim_now);
+	setenv("SIM_CYCLES", value, 1);
+	snprintf(value, sizeof(value), "%llu", (unsigned long long)sim_stats.idle_cycles);
+	setenv("SIM_IDLE", value, 1);
+	snprintf(value, sizeof(value), "%u", sim_stats.resets + 1);
+	setenv("SIM_RESETS", value, 1);
+	setenv("SIM_INPUT_DONE", "1", 1);
+	// NRST is pulled low by the reset, so PINRSTF is set with SFTRSTF
+	snprintf(value, sizeof(value), "%u", SIM_REG((uint32_t)(uintptr_t)&RCC->CSR) |
+	         RCC_CSR_SFTRSTF | RCC_CSR_PINRSTF);
+	setenv("SIM_RCC_CSR", value, 1);
+	if (fd >= 0) {
+		snprintf(value, sizeof(value), "%d", fd);
+		setenv("SIM_PTY_FD", value, 1);
+	}
+	// Interval timers survive exec, the SIGVTALRM handler does not
+	setitimer(ITIMER_VIRTUAL, &(struct itimerval){ { 0, 0 }, { 0, 0 } }, 0);
+	execv("/proc/self/exe", saved_argv);
+	perror("sim: reset");
+	_exit(1);
+}
+
+static void on_interrupt(int sig) {
+	(void)sig;
+	sim_exit(130);
+}
+
+static void on_touch(int sig) {
+	(void)sig;
+	touch_request = 1;
+}
+
+int main(int argc, char **argv) {
+	const char *env;
+
+	saved_argv = argv;
+	parse_options(argc, argv);
+
+	if ((env = getenv("SIM_CYCLES")) != 0) sim_now = strtoull(env, 0, 10);
+	if ((env = getenv("SIM_IDLE")) != 0) sim_stats.idle_cycles = strtoull(env, 0, 10);
+	if ((env = getenv("SIM_RESETS")) != 0) sim_stats.resets = (uint32_t)atoi(env);
+	if (sim_options.seconds > 0) {
+		end_cycles = (uint64_t)(sim_options.seconds * sim_core_hz());
+	}
+
+	signal(SIGINT, on_interrupt);
+	signal(SIGTERM, on_interrupt);
+	signal(SIGUSR1, on_touch);
+	spin_init();
+
+	sim_mmio_init();
+	sim_register(&nvic_model);
+	sim_register(&scb_model);
+	sim_register(&systick_model);
+	sim_register(&dwt_model);
+	sim_register(&stimulus_model);
+	sim_periph_init();
+	sim_flash_init();
+	sim_devices_init();
+	sim_console_init();
+
+	for (int i = 0; i < model_count; i++) {
+		if (models[i]->reset) models[i]->reset();
+	}
+
+	if (sim_options.input && !getenv("SIM_INPUT_DONE")) {
+		input_length = unescape(sim_options.input, input_bytes, sizeof(input_bytes));
+		input_time = sim_now + sim_us(10000);
+	}
+
+	SystemInit();
+	app_main();
+	sim_exit(0);
+	return 0;
+}
@@ -0,0 +1,311 @@
+/*!
+ * \file      sim_devices.c
+ * \brief     Off-chip devices wired to the simulated board.
+ *
+ * DHT11 temperature/humidity sensor on PC_8 (single wire, external
+ * pull-up), an SHT3x temperature/humidity sensor at 0x44 on I2C1 and the
+ * touch sensor module on PC_6 (push-pull output, high while touched).
+ * Timings follow the DHT11 and SHT3x datasheets; both sensors report
+ * --temp and --hum.
+ */
+#include <string.h>
+#include "platform.h"
+#include "sim.h"
+
+#define DHT11_PIN          PC_8
+#define TOUCH_PIN          PC_6
+
+#define DHT11_START_US     18000U  // host start signal, minimum low time
+#define DHT11_WAIT_US      30U     // sensor delay after the host releases
+#define DHT11_RESPONSE_US  80U     // response, low and then high
+#define DHT11_BIT_LOW_US   50U     // low preamble of every bit
+#define DHT11_ZERO_US      27U     // high time of a 0
+#define DHT11_ONE_US       70U     // high time of a 1
+#define TOUCH_HOLD_US      100000U // length of a press
+
+#define SHT3X_ADDRESS      0x44
+#define SHT3X_MEASURE_US   12500U  // high repeatability conversion, typical
+
+/* ------------------------------------------------------------------ */
+/*                               DHT11                                */
+/* ------------------------------------------------------------------ */
+
+#define DHT11_EDGES (2 + 2 * 40 + 2)
+
+static struct {
+	uint64_t low_since;                 // MCU started the start signal
+	uint64_t edge_time[DHT11_EDGES];
+	int8_t edge_level[DHT11_EDGES];
+	int edges;
+	int next;
+} dht;
+
+static void dht11_push(uint64_t *when, uint32_t us, int level) {
+	dht.edge_time[dht.edges] = *when;
+	dht.edge_level[dht.edges] = (int8_t)level;
+	dht.edges++;
+	*when += sim_us(us);
+}
+
+static void dht11_respond(void) {
+	uint8_t data[5];
+	float humidity = sim_options.humidity;
+	float temperature = sim_options.temperature;
+	uint64_t when = sim_now + sim_us(DHT11_WAIT_US);
+
+	data[0] = (uint8_t)humidity;
+	data[1] = (uint8_t)((humidity - data[0]) * 10.0f + 0.5f);
+	data[2] = (uint8_t)temperature;
+	data[3] = (uint8_t)((temperature - data[2]) * 10.0f + 0.5f);
+	data[4] = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+
+	dht.edges = 0;
+	dht.next = 0;
+	dht11_push(&when, DHT11_RESPONSE_US, 0);
+	dht11_push(&when, DHT11_RESPONSE_US, 1);
+	for (int bit = 0; bit < 40; bit++) {
+		int one = (data[bit / 8] >> (7 - bit % 8)) & 1;
+		dht11_push(&when, DHT11_BIT_LOW_US, 0);
+		dht11_push(&when, one ? DHT11_ONE_US : DHT11_ZERO_US, 1);
+	}
+	dht11_push(&when, DHT11_BIT_LOW_US, 0);
+	dht11_push(&when, 0, -1);
+}
+
+static void dht11_watch(uint32_t pin, int drive) {
+	(void)pin;
+	if (drive == 0) {
+		// A new start signal aborts any transmission in progress.
+		dht.low_since = sim_now;
+		dht.edges = dht.next = 0;
+		sim_gpio_drive(DHT11_PIN, -1);
+	} else if (dht.low_since != SIM_NEVER) {
+		if (sim_now - dht.low_since >= sim_us(DHT11_START_US)) {
+			dht11_respond();
+		}
+		dht.low_since = SIM_NEVER;
+	}
+}
+
+static void dht11_reset(void) {
+	dht.low_since = SIM_NEVER;
+	dht.edges = dht.next = 0;
+	sim_gpio_drive(DHT11_PIN, -1);
+}
+
+static uint64_t dht11_next_event(void) {
+	return dht.next < dht.edges ? dht.edge_time[dht.next] : SIM_NEVER;
+}
+
+static void dht11_update(uint64_t now) {
+	while (dht.next < dht.edges && dht.edge_time[dht.next] <= now) {
+		sim_gpio_drive(DHT11_PIN, dht.edge_level[dht.next]);
+		dht.next++;
+	}
+}
+
+static const sim_model dht11_model = {
+	.name = "DHT11",
+	.reset = dht11_reset, .next_event = dht11_next_event, .update = dht11_update,
+};
+
+/* ------------------------------------------------------------------ */
+/*                               SHT3x                                */
+/* ------------------------------------------------------------------ */
+
+/* Commands without clock stretching only: while it converts a single
+ * shot the sensor NACKs its address, and in the periodic mode it NACKs
+ * a read that has no new measurement to give. A command is run when its
+ * second byte arrives. */
+
+static struct {
+	uint16_t command;
+	int written;            // command bytes of this transfer
+	int reading;
+	uint8_t data[6];
+	int sent;
+	uint64_t ready;         // single shot under way: when it ends
+	int single_done;        // a single shot waits to be read
+	uint64_t period;        // periodic mode, 0 when off
+	uint64_t first;         // end of its first measurement
+	uint64_t fetched;       // measurements fetched so far
+	int fetch;              // the fetch command came
+} sht;
+
+static uint8_t sht3x_crc(const uint8_t *data, int length) {
+	uint8_t crc = 0xFF;
+
+	while (length-- > 0) {
+		crc ^= *data++;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint16_t sht3x_raw(double value, double offset, double span) {
+	double raw = (value + offset) * 65535.0 / span + 0.5;
+	return (uint16_t)(raw < 0 ? 0 : raw > 65535 ? 65535 : raw);
+}
+
+static void sht3x_measure(void) {
+	uint16_t t = sht3x_raw(sim_options.temperature, 45.0, 175.0);
+	uint16_t rh = sht3x_raw(sim_options.humidity, 0.0, 100.0);
+
+	sht.data[0] = (uint8_t)(t >> 8);
+	sht.data[1] = (uint8_t)t;
+	sht.data[2] = sht3x_crc(sht.data, 2);
+	sht.data[3] = (uint8_t)(rh >> 8);
+	sht.data[4] = (uint8_t)rh;
+	sht.data[5] = sht3x_crc(sht.data + 3, 2);
+	sht.sent = 0;
+}
+
+// Measurements the periodic mode has completed by now.
+static uint64_t sht3x_measured(void) {
+	return sim_now < sht.first ? 0 : (sim_now - sht.first) / sht.period + 1;
+}
+
+static void sht3x_run(uint16_t command) {
+	static const struct { uint8_t msb; uint32_t period_us; } rates[] = {
+		{ 0x20, 2000000 }, { 0x21, 1000000 }, { 0x22, 500000 }, { 0x23, 250000 }, { 0x27, 100000 }
+	};
+
+	if (command == 0x30A2 || command == 0x3093) { // soft reset, break
+		sht.period = 0;
+		sht.single_done = 0;
+		sht.fetch = 0;
+		return;
+	}
+	if (sht.period) {
+		sht.fetch = command == 0xE000;
+		return;
+	}
+	if ((command >> 8) == 0x24) {
+		sht.ready = sim_now + sim_us(SHT3X_MEASURE_US);
+		sht.single_done = 1;
+		return;
+	}
+	for (int i = 0; i < (int)(sizeof(rates) / sizeof(rates[0])); i++) {
+		if ((command >> 8) == rates[i].msb) {
+			sht.period = sim_us(rates[i].period_us);
+			sht.first = sim_now + sim_us(SHT3X_MEASURE_US);
+			sht.fetched = 0;
+		}
+	}
+}
+
+static int sht3x_start(int read) {
+	if (sht.single_done && sim_now < sht.ready) return 0; // converting
+	sht.reading = read;
+	sht.written = 0;
+	if (!read) return 1;
+	if (sht.period) {
+		uint64_t measured = sht3x_measured();
+		if (!sht.fetch || measured == sht.fetched) return 0;
+		sht.fetch = 0;
+		sht.fetched = measured;
+	} else if (sht.single_done) {
+		sht.single_done = 0;
+	} else {
+		return 0;
+	}
+	sht3x_measure();
+	return 1;
+}
+
+static int sht3x_write(uint8_t byte) {
+	if (sht.written >= 2) return 0;
+	sht.command = (uint16_t)(sht.command << 8 | byte);
+	if (++sht.written == 2) {
+		// Only fetch, break and reset are taken in the periodic mode
+		if (sht.period && sht.command != 0xE000 && sht.command != 0x3093 && sht.command != 0x30A2) return 0;
+		sht3x_run(sht.command);
+	}
+	return 1;
+}
+
+static uint8_t sht3x_read(void) {
+	return sht.sent < 6 ? sht.data[sht.sent++] : 0xFF;
+}
+
+static const sim_i2c_slave sht3x_slave = {
+	.address = SHT3X_ADDRESS,
+	.start = sht3x_start, .write = sht3x_write, .read = sht3x_read,
+};
+
+static void sht3x_reset(void) {
+	memset(&sht, 0, sizeof(sht));
+}
+
+static const sim_model sht3x_model = {
+	.name = "SHT3x",
+	.reset = sht3x_reset,
+};
+
+/* ------------------------------------------------------------------ */
+/*                           Touch sensor                             */
+/* ------------------------------------------------------------------ */
+
+static struct {
+	uint64_t press[16];
+	int count;
+	uint64_t release;
+} touch;
+
+void sim_touch_press(void) {
+	sim_gpio_drive(TOUCH_PIN, 1);
+	touch.release = sim_now + sim_us(TOUCH_HOLD_US);
+}
+
+static void touch_reset(void) {
+	touch.count = 0;
+	for (int i = 0; i < sim_options.touch_count; i++) {
+		uint64_t when = sim_us(sim_options.touch_ms[i] * 1000ULL);
+		// After a reset the presses already done are not repeated.
+		if (when >= sim_now) touch.press[touch.count++] = when;
+	}
+	touch.release = SIM_NEVER;
+	sim_gpio_drive(TOUCH_PIN, 0);
+}
+
+static uint64_t touch_next_event(void) {
+	uint64_t next = touch.release;
+	for (int i = 0; i < touch.count; i++) {
+		if (touch.press[i] < next) next = touch.press[i];
+	}
+	return next;
+}
+
+static void touch_update(uint64_t now) {
+	if (touch.release <= now) {
+		sim_gpio_drive(TOUCH_PIN, 0);
+		touch.release = SIM_NEVER;
+	}
+	for (int i = 0; i < touch.count; i++) {
+		if (touch.press[i] <= now) {
+			touch.press[i] = touch.press[--touch.count];
+			i--;
+			sim_touch_press();
+		}
+	}
+}
+
+static const sim_model touch_model = {
+	.name = "touch",
+	.reset = touch_reset, .next_event = touch_next_event, .update = touch_update,
+};
+
+/* ------------------------------------------------------------------ */
+
+void sim_devices_init(void) {
+	sim_gpio_external_pull(DHT11_PIN, 1);
+	sim_gpio_watch(DHT11_PIN, dht11_watch);
+	sim_register(&dht11_model);
+	if (!sim_options.dht11_only) {
+		sim_i2c_attach(&sht3x_slave);
+		sim_register(&sht3x_model);
+	}
+	sim_register(&touch_model);
+}
@@ -0,0 +1,201 @@
+/*!
+ * \file      sim_flash.c
+ * \brief     Model of the flash memory and its interface.
+ *
+ * The 512 KB of flash are mapped at 0x08000000 for reading, so the
+ * firmware reads them natively and only its stores trap into this
+ * model (see sim_mmio.c). A store programs the word when the interface
+ * is unlocked with PG set and, as on the real part, can only clear bits;
+ * otherwise PGSERR is set and the memory is left as it was. Sector
+ * erases and programs keep BSY set for their typical duration in the
+ * datasheet. Mass erase, the option bytes and the flash interrupt are
+ * not modelled.
+ *
+ * The contents are in the file given with --flash, kept between runs,
+ * or else in memory for the run. Either way they survive a system reset:
+ * the descriptor is handed to the next image in SIM_FLASH_FD.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sim.h"
+
+#define FLASH_KEY1      0x45670123U
+#define FLASH_KEY2      0xCDEF89ABU
+#define PROGRAM_US      16U  // a word, 32-bit parallelism
+#define SECTORS         8
+#define SR_FLAGS        (FLASH_SR_EOP | FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | \
+                         FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+
+static const uint32_t sector_kb[SECTORS] = {16, 16, 16, 16, 64, 128, 128, 128};
+static const uint32_t erase_ms[SECTORS] = {250, 250, 250, 250, 550, 1000, 1000, 1000};
+
+static int storage = -1;
+static int keys;                 // unlock keys written, -1 after a wrong one
+static int erasing;              // sector being erased, or -1
+static uint64_t busy_until = SIM_NEVER;
+
+int sim_flash_storage(void) {
+	const char *env = getenv("SIM_FLASH_FD");
+	char value[16];
+	struct stat st;
+
+	if (storage >= 0) {
+		return storage;
+	}
+	if (env) {
+		storage = atoi(env);
+	} else if (sim_options.flash) {
+		storage = open(sim_options.flash, O_RDWR | O_CREAT, 0644);
+	} else {
+		storage = memfd_create("sim-flash", 0); // Kept open across exec
+	}
+	if (storage < 0 || fstat(storage, &st) < 0) {
+		perror("sim: flash");
+		exit(1);
+	}
+	if (st.st_size == 0) {
+		// New flash comes erased
+		uint8_t erased[4096];
+		memset(erased, 0xFF, sizeof(erased));
+		for (uint32_t offset = 0; offset < SIM_FLASH_SIZE; offset += sizeof(erased)) {
+			if (pwrite(storage, erased, sizeof(erased), offset) != (ssize_t)sizeof(erased)) {
+				perror("sim: flash");
+				exit(1);
+			}
+		}
+	} else if (st.st_size != SIM_FLASH_SIZE) {
+		fprintf(stderr, "sim: %s is not a %u KB flash image\n", sim_options.flash, SIM_FLASH_SIZE / 1024);
+		exit(1);
+	}
+	snprintf(value, sizeof(value), "%d", storage);
+	setenv("SIM_FLASH_FD", value, 1);
+	return storage;
+}
+
+static uint32_t sector_offset(int sector) {
+	uint32_t offset = 0;
+	for (int i = 0; i < sector; i++) {
+		offset += sector_kb[i] * 1024;
+	}
+	return offset;
+}
+
+static void flash_busy(uint64_t us) {
+	FLASH_TypeDef *flash = sim_alias(FLASH_R_BASE);
+
+	// An operation started while busy waits for the one in progress
+	if (!(flash->SR & FLASH_SR_BSY)) {
+		busy_until = sim_now;
+	}
+	busy_until += sim_us(us);
+	flash->SR |= FLASH_SR_BSY;
+}
+
+static void flash_reset(void) {
+	FLASH_TypeDef *flash = sim_alias(FLASH_R_BASE);
+	memset(flash, 0, sizeof(FLASH_TypeDef));
+	flash->CR = FLASH_CR_LOCK;
+	flash->OPTCR = 0x0FFFAAED;
+	keys = 0;
+	erasing = -1;
+	busy_until = SIM_NEVER;
+}
+
+static void flash_write(uint32_t addr, uint32_t old) {
+	FLASH_TypeDef *flash = sim_alias(FLASH_R_BASE);
+
+	if (addr == (uint32_t)(uintptr_t)&FLASH->KEYR) {
+		uint32_t key = flash->KEYR;
+
+		flash->KEYR = 0; // Write only
+		if (!(flash->CR & FLASH_CR_LOCK)) {
+			return;
+		}
+		if (keys == 0 && key == FLASH_KEY1) {
+			keys = 1;
+		} else if (keys == 1 && key == FLASH_KEY2) {
+			keys = 0;
+			flash->CR &= ~FLASH_CR_LOCK;
+		} else {
+			keys = -1; // Locked until the next reset
+		}
+	} else if (addr == (uint32_t)(uintptr_t)&FLASH->SR) {
+		flash->SR = old & ~(flash->SR & SR_FLAGS);
+	} else if (addr == (uint32_t)(uintptr_t)&FLASH->CR) {
+		uint32_t cr = flash->CR;
+
+		if (old & FLASH_CR_LOCK) {
+			flash->CR = old; // Ignored while locked
+			return;
+		}
+		if ((cr & FLASH_CR_STRT) && !(old & FLASH_CR_STRT)) {
+			int sector = (int)((cr & FLASH_CR_SNB) >> FLASH_CR_SNB_Pos);
+
+			if (!(cr & FLASH_CR_SER) || (cr & FLASH_CR_PG) || sector >= SECTORS) {
+				flash->SR |= FLASH_SR_PGSERR;
+				flash->CR &= ~FLASH_CR_STRT;
+			} else {
+				erasing = sector;
+				flash_busy(erase_ms[sector] * 1000ULL);
+			}
+		}
+	}
+}
+
+static uint64_t flash_next_event(void) {
+	return busy_until;
+}
+
+static void flash_update(uint64_t now) {
+	FLASH_TypeDef *flash = sim_alias(FLASH_R_BASE);
+
+	if (now < busy_until) {
+		return;
+	}
+	if (erasing >= 0) {
+		memset(sim_alias(FLASH_BASE + sector_offset(erasing)), 0xFF, sector_kb[erasing] * 1024);
+		flash->CR &= ~FLASH_CR_STRT;
+		erasing = -1;
+	}
+	flash->SR &= ~FLASH_SR_BSY;
+	if (flash->CR & FLASH_CR_EOPIE) {
+		flash->SR |= FLASH_SR_EOP;
+	}
+	busy_until = SIM_NEVER;
+}
+
+static const sim_model flash_model = {
+	.name = "FLASH", .base = FLASH_R_BASE, .size = sizeof(FLASH_TypeDef),
+	.reset = flash_reset, .write = flash_write,
+	.next_event = flash_next_event, .update = flash_update,
+};
+
+// A store to the flash memory.
+static void memory_write(uint32_t addr, uint32_t old) {
+	FLASH_TypeDef *flash = sim_alias(FLASH_R_BASE);
+	uint32_t word = SIM_REG(addr);
+
+	if ((flash->CR & (FLASH_CR_LOCK | FLASH_CR_PG | FLASH_CR_SER)) != FLASH_CR_PG || erasing >= 0) {
+		SIM_REG(addr) = old;
+		flash->SR |= FLASH_SR_PGSERR;
+		return;
+	}
+	SIM_REG(addr) = old & word;
+	flash_busy(PROGRAM_US);
+}
+
+static const sim_model memory_model = {
+	.name = "FLASH memory", .base = FLASH_BASE, .size = SIM_FLASH_SIZE,
+	.write = memory_write,
+};
+
+void sim_flash_init(void) {
+	sim_register(&flash_model);
+	sim_register(&memory_model);
+}
@@ -0,0 +1,41 @@
+/*!
+ * \file      sim_hasher.c
+ * \brief     Host replacements for hasher.s, which is Cortex-M4 assembly:
+ *            the C references of hasher.c.
+ */
+#include "hasher.h"
+
+uint32_t map(const char *string) {
+	return map_reference(string);
+}
+
+uint32_t reduce(uint32_t number) {
+	return reduce_reference(number);
+}
+
+uint32_t fibonacci(uint32_t n) {
+	return (uint32_t)fibonacci_reference(n);
+}
+
+uint64_t fibonacci64(uint32_t n) {
+	return fibonacci_reference(n);
+}
+
+uint32_t reduce_sdiv(uint32_t number) {
+	return reduce_reference(number);
+}
+
+uint32_t fibonacci_recursive(uint32_t n) {
+	return n < 2 ? n : fibonacci_recursive(n - 1) + fibonacci_recursive(n - 2);
+}
+
+uint32_t fibonacci_mod(uint32_t n, uint32_t m) {
+	uint32_t a = 0, b = 1 % m;
+
+	while (n-- > 0) {
+		uint32_t next = (a + b) % m;
+		a = b;
+		b = next;
+	}
+	return a;
+}
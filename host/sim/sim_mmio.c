@@ -0,0 +1,155 @@
+/*!
+ * \file      sim_mmio.c
+ * \brief     Traps firmware accesses to the register windows.
+ *
+ * Each window is a memfd mapped twice: once at the real target address
+ * with PROT_NONE, once anywhere with read/write access (the shadow the
+ * models work on). A firmware access raises SIGSEGV; the handler brings
+ * the register up to date, opens the page and sets the x86 trap flag so
+ * that exactly one instruction runs. The following SIGTRAP closes the
+ * page again and lets the model apply the side effects of the access.
+ *
+ * The flash memory is mapped the same way, but readable: only stores
+ * trap, and the firmware reads its contents natively.
+ */
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "sim.h"
+
+#define PAGE_SIZE   4096U
+#define TRAP_FLAG   0x100
+
+typedef struct {
+	uint32_t base;
+	uint32_t size;
+	int prot;           // Accesses that do not trap
+	uint8_t *shadow;
+} region;
+
+static region regions[] = {
+	{ PERIPH_BASE, 0x00080000U, PROT_NONE, 0 },     // APB1, APB2, AHB1
+	{ 0xE0000000U, 0x00100000U, PROT_NONE, 0 },     // Private peripheral bus
+	{ FLASH_BASE, SIM_FLASH_SIZE, PROT_READ, 0 },   // Flash memory, stores trap
+};
+
+#define REGION_COUNT (sizeof(regions) / sizeof(regions[0]))
+
+static struct {
+	int active;
+	uint32_t addr;
+	uint32_t old;
+	int write;
+	void *page;
+	int prot;
+} pending;
+
+static region *find_region(uintptr_t addr) {
+	for (unsigned int i = 0; i < REGION_COUNT; i++) {
+		if (addr >= regions[i].base && addr - regions[i].base < regions[i].size) {
+			return &regions[i];
+		}
+	}
+	return 0;
+}
+
+void *sim_alias(uint32_t addr) {
+	region *r = find_region(addr);
+	if (!r) {
+		fprintf(stderr, "sim: no register window at 0x%08x\n", addr);
+		abort();
+	}
+	return r->shadow + (addr - r->base);
+}
+
+int sim_mmio_busy(void) {
+	return pending.active;
+}
+
+static void fatal_fault(int sig) {
+	signal(sig, SIG_DFL);
+	sim_console_restore();
+	// Returning re-executes the instruction with the default action.
+}
+
+static void on_segv(int sig, siginfo_t *info, void *context) {
+	ucontext_t *uc = (ucontext_t *)context;
+	uintptr_t addr = (uintptr_t)info->si_addr;
+	region *r = find_region(addr);
+
+	if (pending.active || !r) {
+		fatal_fault(sig);
+		return;
+	}
+
+	pending.addr = (uint32_t)addr & ~3U;
+	pending.write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+	pending.page = (void *)(addr & ~(uintptr_t)(PAGE_SIZE - 1));
+	pending.prot = r->prot;
+
+	sim_access_begin(pending.addr, pending.write);
+
+	pending.old = SIM_REG(pending.addr);
+	pending.active = 1;
+	mprotect(pending.page, PAGE_SIZE, PROT_READ | PROT_WRITE);
+	uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+static void on_trap(int sig, siginfo_t *info, void *context) {
+	ucontext_t *uc = (ucontext_t *)context;
+	(void)info;
+
+	if (!pending.active) {
+		fatal_fault(sig);
+		return;
+	}
+
+	mprotect(pending.page, PAGE_SIZE, pending.prot);
+	uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+	pending.active = 0;
+
+	// Interrupt handlers may run from here and trap again.
+	sim_access_end(pending.addr, pending.write, pending.old);
+}
+
+void sim_mmio_init(void) {
+	struct sigaction sa;
+
+	for (unsigned int i = 0; i < REGION_COUNT; i++) {
+		region *r = &regions[i];
+		int fd;
+		if (r->base == FLASH_BASE) {
+			fd = sim_flash_storage(); // Outlives the process, the registers do not
+		} else {
+			fd = memfd_create("sim-mmio", MFD_CLOEXEC);
+			if (fd < 0 || ftruncate(fd, r->size) < 0) {
+				perror("sim: memfd");
+				exit(1);
+			}
+		}
+		r->shadow = mmap(0, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		void *target = mmap((void *)(uintptr_t)r->base, r->size, r->prot,
+		                    MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+		if (r->shadow == MAP_FAILED || target != (void *)(uintptr_t)r->base) {
+			fprintf(stderr, "sim: cannot map registers at 0x%08x\n", r->base);
+			exit(1);
+		}
+		if (r->base != FLASH_BASE) {
+			close(fd);
+		}
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = on_segv;
+	sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGSEGV, &sa, 0);
+	sigaction(SIGBUS, &sa, 0);
+	sa.sa_sigaction = on_trap;
+	sigaction(SIGTRAP, &sa, 0);
+}
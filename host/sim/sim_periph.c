@@ -0,0 +1,1468 @@
+/*!
+ * \file      sim_periph.c
+ * \brief     Models of the STM32F411 on-chip peripherals.
+ *
+ * RCC, PWR and DBGMCU only hold their reset values and the RCC reset
+ * flags; the flash interface is modelled in sim_flash.c. CRC, GPIO, EXTI,
+ * SYSCFG, the general purpose timers, USART2, ADC1 and I2C1 model the
+ * behaviour the drivers rely on, following RM0383. Registers are kept in
+ * the shadow memory so every model works on the CMSIS structures.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+#define BIT(n) (1UL << (n))
+
+static void plain_reset_zero(uint32_t base, uint32_t size) {
+	memset(sim_alias(base), 0, size);
+}
+
+/* ------------------------------------------------------------------ */
+/*                          RCC, PWR, DBGMCU                          */
+/* ------------------------------------------------------------------ */
+
+static void rcc_reset(void) {
+	RCC_TypeDef *rcc = sim_alias(RCC_BASE);
+	const char *env;
+
+	plain_reset_zero(RCC_BASE, sizeof(RCC_TypeDef));
+	rcc->CR = 0x00000083;
+	rcc->PLLCFGR = 0x24003010;
+	rcc->AHB1LPENR = 0x0061900F;
+	rcc->AHB2LPENR = 0x00000080;
+	rcc->APB1LPENR = 0x10E2C80F;
+	rcc->APB2LPENR = 0x00077930;
+	rcc->CSR = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF | RCC_CSR_BORRSTF;
+	if ((env = getenv("SIM_RCC_CSR")) != 0) {
+		rcc->CSR = (uint32_t)strtoul(env, 0, 10); // Flags left by sim_reset()
+	}
+	rcc->PLLI2SCFGR = 0x24003000;
+}
+
+static void rcc_write(uint32_t addr, uint32_t old) {
+	RCC_TypeDef *rcc = sim_alias(RCC_BASE);
+	(void)old;
+
+	if (addr == RCC_BASE) {
+		// Oscillators and the PLL lock instantly.
+		uint32_t cr = rcc->CR & ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY);
+		if (cr & RCC_CR_HSION) cr |= RCC_CR_HSIRDY;
+		if (cr & RCC_CR_HSEON) cr |= RCC_CR_HSERDY;
+		if (cr & RCC_CR_PLLON) cr |= RCC_CR_PLLRDY;
+		rcc->CR = cr;
+	} else if (addr == (uint32_t)(uintptr_t)&RCC->CFGR) {
+		rcc->CFGR = (rcc->CFGR & ~RCC_CFGR_SWS) | ((rcc->CFGR & RCC_CFGR_SW) << 2);
+	} else if (addr == (uint32_t)(uintptr_t)&RCC->CSR && (rcc->CSR & RCC_CSR_RMVF)) {
+		rcc->CSR &= 0x00FFFFFF; // RMVF clears the reset flags and reads 0
+	}
+}
+
+static const sim_model rcc_model = {
+	.name = "RCC", .base = RCC_BASE, .size = sizeof(RCC_TypeDef),
+	.reset = rcc_reset, .write = rcc_write,
+};
+
+static void dbgmcu_reset(void) {
+	DBGMCU_TypeDef *dbg = sim_alias(DBGMCU_BASE);
+	plain_reset_zero(DBGMCU_BASE, sizeof(DBGMCU_TypeDef));
+	dbg->IDCODE = 0x10006431;
+}
+
+static const sim_model dbgmcu_model = {
+	.name = "DBGMCU", .base = DBGMCU_BASE, .size = sizeof(DBGMCU_TypeDef),
+	.reset = dbgmcu_reset,
+};
+
+/* ------------------------------------------------------------------ */
+/*                                CRC                                 */
+/* ------------------------------------------------------------------ */
+
+static void crc_reset(void) {
+	CRC_TypeDef *crc = sim_alias(CRC_BASE);
+	plain_reset_zero(CRC_BASE, sizeof(CRC_TypeDef));
+	crc->DR = 0xFFFFFFFF;
+}
+
+static void crc_write(uint32_t addr, uint32_t old) {
+	CRC_TypeDef *crc = sim_alias(CRC_BASE);
+
+	if (addr == CRC_BASE) {
+		// A written word goes through the polynomial, top bit first
+		uint32_t value = old ^ crc->DR;
+		for (int bit = 0; bit < 32; bit++) {
+			value = value & 0x80000000U ? (value << 1) ^ 0x04C11DB7U : value << 1;
+		}
+		crc->DR = value;
+	} else if (addr == (uint32_t)(uintptr_t)&CRC->CR) {
+		if (crc->CR & CRC_CR_RESET) {
+			crc->DR = 0xFFFFFFFF;
+		}
+		crc->CR = 0;
+	}
+}
+
+static const sim_model crc_model = {
+	.name = "CRC", .base = CRC_BASE, .size = sizeof(CRC_TypeDef),
+	.reset = crc_reset, .write = crc_write,
+};
+
+/* ------------------------------------------------------------------ */
+/*                         SYSCFG and EXTI                            */
+/* ------------------------------------------------------------------ */
+
+static void syscfg_reset(void) {
+	plain_reset_zero(SYSCFG_BASE, sizeof(SYSCFG_TypeDef));
+}
+
+static const sim_model syscfg_model = {
+	.name = "SYSCFG", .base = SYSCFG_BASE, .size = sizeof(SYSCFG_TypeDef),
+	.reset = syscfg_reset,
+};
+
+static uint32_t exti_port(uint32_t line) {
+	SYSCFG_TypeDef *syscfg = sim_alias(SYSCFG_BASE);
+	return (syscfg->EXTICR[line >> 2] >> ((line & 3) * 4)) & 0xF;
+}
+
+static void exti_irq_update(void) {
+	EXTI_TypeDef *exti = sim_alias(EXTI_BASE);
+	uint32_t active = exti->PR & exti->IMR;
+
+	sim_irq_level(EXTI0_IRQn, active & BIT(0));
+	sim_irq_level(EXTI1_IRQn, active & BIT(1));
+	sim_irq_level(EXTI2_IRQn, active & BIT(2));
+	sim_irq_level(EXTI3_IRQn, active & BIT(3));
+	sim_irq_level(EXTI4_IRQn, active & BIT(4));
+	sim_irq_level(EXTI9_5_IRQn, active & 0x03E0);
+	sim_irq_level(EXTI15_10_IRQn, active & 0xFC00);
+}
+
+static void exti_edge(uint32_t line, int rising) {
+	EXTI_TypeDef *exti = sim_alias(EXTI_BASE);
+	uint32_t mask = BIT(line);
+
+	if (((rising && (exti->RTSR & mask)) || (!rising && (exti->FTSR & mask))) && (exti->IMR & mask)) {
+		exti->PR |= mask;
+		exti_irq_update();
+	}
+}
+
+static void exti_reset(void) {
+	plain_reset_zero(EXTI_BASE, sizeof(EXTI_TypeDef));
+	exti_irq_update();
+}
+
+static void exti_write(uint32_t addr, uint32_t old) {
+	EXTI_TypeDef *exti = sim_alias(EXTI_BASE);
+
+	switch (addr - EXTI_BASE) {
+		case 0x10: // SWIER
+			exti->PR |= exti->SWIER & ~old & exti->IMR;
+			break;
+		case 0x14: // PR, write one to clear
+			exti->PR = old & ~exti->PR;
+			exti->SWIER &= exti->PR;
+			break;
+	}
+	exti->IMR &= 0x007FFFFF;
+	exti_irq_update();
+}
+
+static const sim_model exti_model = {
+	.name = "EXTI", .base = EXTI_BASE, .size = sizeof(EXTI_TypeDef),
+	.reset = exti_reset, .write = exti_write,
+};
+
+/* ------------------------------------------------------------------ */
+/*                               GPIO                                 */
+/* ------------------------------------------------------------------ */
+
+#define GPIO_PORTS 8
+
+typedef struct {
+	int8_t drive[16];       // external device: -1 released, 0 low, 1 high
+	int8_t pull[16];        // external resistor: -1 none
+	int8_t mcu[16];         // MCU drive last reported to the watchers
+	uint16_t level;         // pin levels
+	void (*watch[16])(uint32_t pin, int drive);
+} gpio_port;
+
+static gpio_port ports[GPIO_PORTS];
+
+static void tim_input_edge(uint32_t port, uint32_t pin, int rising);
+
+static uint32_t gpio_base(uint32_t port) {
+	return AHB1PERIPH_BASE + 0x0400 * port;
+}
+
+static int mcu_drive(uint32_t port, uint32_t pin) {
+	GPIO_TypeDef *gpio = sim_alias(gpio_base(port));
+	uint32_t mode = (gpio->MODER >> (pin * 2)) & 3;
+	uint32_t out = (gpio->ODR >> pin) & 1;
+
+	if (mode != 1) return -1;
+	if ((gpio->OTYPER & BIT(pin)) && out) return -1; // open drain, released
+	return (int)out;
+}
+
+static int line_level(uint32_t port, uint32_t pin) {
+	GPIO_TypeDef *gpio = sim_alias(gpio_base(port));
+	gpio_port *p = &ports[port];
+	int drive = mcu_drive(port, pin);
+
+	if (drive >= 0) return drive;
+	if (p->drive[pin] >= 0) return p->drive[pin];
+	if (p->pull[pin] >= 0) return p->pull[pin];
+	switch ((gpio->PUPDR >> (pin * 2)) & 3) {
+		case 1: return 1;
+		default: return 0;
+	}
+}
+
+static void gpio_update(uint32_t port) {
+	GPIO_TypeDef *gpio = sim_alias(gpio_base(port));
+	gpio_port *p = &ports[port];
+	uint16_t level = 0;
+	uint32_t idr = 0;
+
+	for (uint32_t pin = 0; pin < 16; pin++) {
+		if (line_level(port, pin)) level |= BIT(pin);
+		if (((gpio->MODER >> (pin * 2)) & 3) != 3) idr |= level & BIT(pin);
+	}
+	gpio->IDR = idr;
+
+	uint16_t changed = p->level ^ level;
+	p->level = level;
+	for (uint32_t pin = 0; pin < 16; pin++) {
+		if ((changed & BIT(pin)) && exti_port(pin) == port) {
+			exti_edge(pin, (level >> pin) & 1);
+		}
+		if (changed & BIT(pin)) tim_input_edge(port, pin, (level >> pin) & 1);
+	}
+
+	for (uint32_t pin = 0; pin < 16; pin++) {
+		int drive = mcu_drive(port, pin);
+		if (drive != p->mcu[pin]) {
+			p->mcu[pin] = (int8_t)drive;
+			if (p->watch[pin]) p->watch[pin]((port << 16) | pin, drive);
+		}
+	}
+}
+
+static void gpio_reset_port(uint32_t port) {
+	GPIO_TypeDef *gpio = sim_alias(gpio_base(port));
+	plain_reset_zero(gpio_base(port), sizeof(GPIO_TypeDef));
+	if (port == 0) {
+		gpio->MODER = 0x0C000000;
+		gpio->OSPEEDR = 0x0C000000;
+		gpio->PUPDR = 0x64000000;
+	} else if (port == 1) {
+		gpio->MODER = 0x00000280;
+		gpio->OSPEEDR = 0x000000C0;
+		gpio->PUPDR = 0x00000100;
+	}
+	memset(ports[port].mcu, -1, sizeof(ports[port].mcu));
+	gpio_update(port);
+}
+
+static void gpio_write(uint32_t addr, uint32_t old) {
+	uint32_t port = (addr - AHB1PERIPH_BASE) / 0x0400;
+	GPIO_TypeDef *gpio = sim_alias(gpio_base(port));
+
+	switch (addr & 0x3FF) {
+		case 0x10: // IDR is read-only
+			gpio->IDR = old;
+			return;
+		case 0x14: // ODR
+			gpio->ODR &= 0xFFFF;
+			break;
+		case 0x18: { // BSRR, set wins over reset
+			uint32_t bsrr = gpio->BSRR;
+			gpio->ODR = ((gpio->ODR & ~(bsrr >> 16)) | bsrr) & 0xFFFF;
+			gpio->BSRR = 0;
+			break;
+		}
+	}
+	gpio_update(port);
+}
+
+#define GPIO_MODEL(letter, index) \
+	static void gpio##letter##_reset(void) { gpio_reset_port(index); } \
+	static const sim_model gpio##letter##_model = { \
+		.name = "GPIO" #letter, .base = AHB1PERIPH_BASE + 0x0400 * index, \
+		.size = sizeof(GPIO_TypeDef), .reset = gpio##letter##_reset, .write = gpio_write, \
+	};
+
+GPIO_MODEL(A, 0)
+GPIO_MODEL(B, 1)
+GPIO_MODEL(C, 2)
+GPIO_MODEL(D, 3)
+GPIO_MODEL(E, 4)
+GPIO_MODEL(H, 7)
+
+void sim_gpio_drive(uint32_t pin, int level) {
+	uint32_t port = pin >> 16;
+	ports[port].drive[pin & 0xF] = (int8_t)level;
+	gpio_update(port);
+}
+
+void sim_gpio_external_pull(uint32_t pin, int level) {
+	uint32_t port = pin >> 16;
+	ports[port].pull[pin & 0xF] = (int8_t)level;
+	gpio_update(port);
+}
+
+int sim_gpio_level(uint32_t pin) {
+	return (ports[pin >> 16].level >> (pin & 0xF)) & 1;
+}
+
+int sim_gpio_mcu_drive(uint32_t pin) {
+	return mcu_drive(pin >> 16, pin & 0xF);
+}
+
+void sim_gpio_watch(uint32_t pin, void (*callback)(uint32_t pin, int drive)) {
+	ports[pin >> 16].watch[pin & 0xF] = callback;
+}
+
+/* ------------------------------------------------------------------ */
+/*                            DMA1, DMA2                              */
+/* ------------------------------------------------------------------ */
+
+static const IRQn_Type dma_irqs[2][8] = {
+	{ DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+	  DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn },
+	{ DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+	  DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn },
+};
+
+static struct {
+	uint32_t total[2][8];           // NDTR when the stream was enabled
+	uint8_t request[2][8][8];       // request levels by stream and channel
+	int busy;
+} dma;
+
+static uint32_t dma_base(int c) {
+	return c ? DMA2_BASE : DMA1_BASE;
+}
+
+static DMA_Stream_TypeDef *dma_stream(int c, int s) {
+	return sim_alias(dma_base(c) + 0x10 + 0x18 * s);
+}
+
+/* Flags of stream s sit at bit 0, 6, 16 or 22 of LISR (0-3) or HISR (4-7). */
+static uint32_t dma_flag_shift(int s) {
+	static const uint8_t shift[4] = { 0, 6, 16, 22 };
+	return shift[s & 3];
+}
+
+static volatile uint32_t *dma_isr(int c, int s) {
+	return (volatile uint32_t *)sim_alias(dma_base(c) + (s < 4 ? 0x00 : 0x04));
+}
+
+static void dma_irq_update(int c, int s) {
+	DMA_Stream_TypeDef *st = dma_stream(c, s);
+	uint32_t flags = (*dma_isr(c, s) >> dma_flag_shift(s)) & 0x3D;
+	uint32_t enabled = 0;
+
+	if (st->CR & DMA_SxCR_TCIE) enabled |= 0x20;
+	if (st->CR & DMA_SxCR_HTIE) enabled |= 0x10;
+	if (st->CR & DMA_SxCR_TEIE) enabled |= 0x08;
+	if (st->CR & DMA_SxCR_DMEIE) enabled |= 0x04;
+	if (st->FCR & DMA_SxFCR_FEIE) enabled |= 0x01;
+	sim_irq_level(dma_irqs[c][s], flags & enabled);
+}
+
+/* Moves one data item; returns 0 once the stream has stopped. */
+static int dma_transfer(int c, int s) {
+	DMA_Stream_TypeDef *st = dma_stream(c, s);
+	uint32_t cr = st->CR;
+	uint32_t size = 1U << ((cr & DMA_SxCR_PSIZE) >> 11);
+	uint32_t index = dma.total[c][s] - st->NDTR;
+	uint32_t memory = (cr & DMA_SxCR_CT) ? st->M1AR : st->M0AR;
+	uint32_t paddr = st->PAR + ((cr & DMA_SxCR_PINC) ? index * size : 0);
+	uint32_t maddr = memory + ((cr & DMA_SxCR_MINC) ? index * size : 0);
+
+	// Direct mode: the memory side uses the peripheral data size. In
+	// memory to memory mode PAR is the source, as for peripheral to memory.
+	if ((cr & DMA_SxCR_DIR) == DMA_SxCR_DIR_0) {
+		sim_bus_write(paddr, sim_bus_read(maddr, size), size);
+	} else {
+		sim_bus_write(maddr, sim_bus_read(paddr, size), size);
+	}
+
+	st->NDTR--;
+	if (st->NDTR == dma.total[c][s] / 2) {
+		*dma_isr(c, s) |= 0x10U << dma_flag_shift(s);      // HTIF
+	}
+	if (st->NDTR == 0) {
+		*dma_isr(c, s) |= 0x20U << dma_flag_shift(s);      // TCIF
+		if (cr & DMA_SxCR_DBM) {
+			st->CR ^= DMA_SxCR_CT;
+			st->NDTR = dma.total[c][s];
+		} else if (cr & DMA_SxCR_CIRC) {
+			st->NDTR = dma.total[c][s];
+		} else {
+			st->CR &= ~DMA_SxCR_EN;
+		}
+	}
+	dma_irq_update(c, s);
+	return (st->CR & DMA_SxCR_EN) != 0;
+}
+
+/* Serves the stream for as long as its request stays active. */
+static void dma_run(int c, int s) {
+	DMA_Stream_TypeDef *st = dma_stream(c, s);
+
+	if (dma.busy) return;
+	dma.busy = 1;
+	for (;;) {
+		uint32_t cr = st->CR;
+		int channel = (cr & DMA_SxCR_CHSEL) >> 25;
+		int mem2mem = (cr & DMA_SxCR_DIR) == DMA_SxCR_DIR_1;
+		if (!(cr & DMA_SxCR_EN) || !(mem2mem || dma.request[c][s][channel])) break;
+		if (!dma_transfer(c, s)) break;
+	}
+	dma.busy = 0;
+}
+
+void sim_dma_request(int controller, int stream, int channel, int level) {
+	int c = controller - 1;
+	dma.request[c][stream][channel] = level != 0;
+	if (level) dma_run(c, stream);
+}
+
+static void dma_reset(void) {
+	plain_reset_zero(DMA1_BASE, 0xD0);
+	plain_reset_zero(DMA2_BASE, 0xD0);
+	memset(&dma, 0, sizeof(dma));
+	for (int c = 0; c < 2; c++) {
+		for (int s = 0; s < 8; s++) {
+			dma_stream(c, s)->FCR = 0x21;
+			dma_irq_update(c, s);
+		}
+	}
+}
+
+static void dma_write(uint32_t addr, uint32_t old) {
+	int c = addr >= DMA2_BASE;
+	uint32_t offset = addr - dma_base(c);
+
+	if (offset < 0x10) {
+		volatile uint32_t *reg = sim_alias(addr);
+		switch (offset) {
+			case 0x00: case 0x04:   // LISR, HISR are read-only
+				*reg = old;
+				break;
+			case 0x08: case 0x0C:   // LIFCR, HIFCR clear the matching flags
+				*(volatile uint32_t *)sim_alias(addr - 8) &= ~(*reg & 0x0F7D0F7D);
+				*reg = 0;
+				for (int s = offset == 0x08 ? 0 : 4; s < (offset == 0x08 ? 4 : 8); s++) {
+					dma_irq_update(c, s);
+				}
+				break;
+		}
+		return;
+	}
+
+	int s = (offset - 0x10) / 0x18;
+	DMA_Stream_TypeDef *st = dma_stream(c, s);
+	uint32_t reg = (offset - 0x10) % 0x18;
+
+	if (reg != 0x00 && (st->CR & DMA_SxCR_EN) && reg != 0x14) {
+		// Configuration is locked while the stream runs, except M1AR.
+		SIM_REG(addr) = old;
+		return;
+	}
+	if (reg == 0x00) {
+		if (!(old & DMA_SxCR_EN) && (st->CR & DMA_SxCR_EN)) {
+			st->NDTR &= 0xFFFF;
+			dma.total[c][s] = st->NDTR;
+			if (!st->NDTR) st->CR &= ~DMA_SxCR_EN;
+		} else if ((old & DMA_SxCR_EN) && !(st->CR & DMA_SxCR_EN) && st->NDTR) {
+			// Disabled mid-transfer: the stream reports completion.
+			*dma_isr(c, s) |= 0x20U << dma_flag_shift(s);
+		}
+		dma_irq_update(c, s);
+		dma_run(c, s);
+	} else if (reg == 0x04) {
+		st->NDTR &= 0xFFFF;
+	}
+}
+
+static const sim_model dma1_model = {
+	.name = "DMA1", .base = DMA1_BASE, .size = 0xD0,
+	.reset = dma_reset, .write = dma_write,
+};
+
+static const sim_model dma2_model = {
+	.name = "DMA2", .base = DMA2_BASE, .size = 0xD0,
+	.write = dma_write,
+};
+
+/* ------------------------------------------------------------------ */
+/*                    General purpose timers (TIM2-5)                 */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+	uint32_t base;
+	IRQn_Type irq;
+	uint32_t max;           // counter mask, 16 or 32 bits
+	int8_t dma[4][2];       // DMA1 stream and channel of each CCx request
+	int8_t trgo;            // ADC1 EXTSEL of the trigger output, or -1
+	uint64_t origin;        // time the counter held cnt_origin
+	uint32_t cnt_origin;
+	uint32_t psc;           // active (shadow) prescaler
+	uint32_t arr;           // active (shadow) auto-reload
+} tim_state;
+
+static tim_state timers[] = {
+	{ TIM2_BASE, TIM2_IRQn, 0xFFFFFFFF, { { 5, 3 }, { 6, 3 }, { 1, 3 }, { 7, 3 } }, 6 },
+	{ TIM3_BASE, TIM3_IRQn, 0x0000FFFF, { { 4, 5 }, { 5, 5 }, { 7, 5 }, { 2, 5 } }, 8 },
+	{ TIM4_BASE, TIM4_IRQn, 0x0000FFFF, { { 0, 2 }, { 3, 2 }, { 7, 2 }, { -1, 0 } }, -1 },
+	{ TIM5_BASE, TIM5_IRQn, 0xFFFFFFFF, { { 2, 6 }, { 4, 6 }, { 0, 6 }, { 1, 6 } }, -1 },
+};
+
+static void adc_trigger(uint32_t source, uint64_t when);
+
+#define TIM_COUNT (sizeof(timers) / sizeof(timers[0]))
+
+/* Timer channel inputs by pin and alternate function (RM0383 / DS10314). */
+static const struct {
+	uint8_t port, pin, af, timer, channel;
+} tim_inputs[] = {
+	{ 0, 0, 1, 0, 0 }, { 0, 1, 1, 0, 1 }, { 0, 2, 1, 0, 2 }, { 0, 3, 1, 0, 3 },
+	{ 0, 5, 1, 0, 0 }, { 0, 15, 1, 0, 0 }, { 1, 3, 1, 0, 1 }, { 1, 10, 1, 0, 2 },
+	{ 0, 6, 2, 1, 0 }, { 0, 7, 2, 1, 1 }, { 1, 0, 2, 1, 2 }, { 1, 1, 2, 1, 3 },
+	{ 1, 4, 2, 1, 0 }, { 1, 5, 2, 1, 1 }, { 2, 6, 2, 1, 0 }, { 2, 7, 2, 1, 1 },
+	{ 2, 8, 2, 1, 2 }, { 2, 9, 2, 1, 3 },
+	{ 1, 6, 2, 2, 0 }, { 1, 7, 2, 2, 1 }, { 1, 8, 2, 2, 2 }, { 1, 9, 2, 2, 3 },
+	{ 0, 0, 2, 3, 0 }, { 0, 1, 2, 3, 1 }, { 0, 2, 2, 3, 2 }, { 0, 3, 2, 3, 3 },
+};
+
+static tim_state *tim_find(uint32_t addr) {
+	return &timers[(addr - TIM2_BASE) / 0x0400];
+}
+
+static int tim_running(tim_state *t) {
+	TIM_TypeDef *tim = sim_alias(t->base);
+	return tim->CR1 & TIM_CR1_CEN;
+}
+
+static uint32_t tim_counter(tim_state *t, uint64_t now) {
+	uint64_t ticks = (now - t->origin) / (t->psc + 1ULL);
+	return (uint32_t)((t->cnt_origin + ticks) & t->max);
+}
+
+static uint64_t tim_overflow_time(tim_state *t) {
+	uint64_t remaining;
+	if (t->cnt_origin <= t->arr) {
+		remaining = (uint64_t)t->arr - t->cnt_origin + 1;
+	} else {
+		remaining = (uint64_t)t->max - t->cnt_origin + 1;
+	}
+	return t->origin + remaining * (t->psc + 1ULL);
+}
+
+/* Moves the origin up to the current tick, so compare times are worked
+ * out from the counter as it is now and not as it was when it started. */
+static void tim_rebase(tim_state *t) {
+	uint64_t ticks = (sim_now - t->origin) / (t->psc + 1ULL);
+
+	t->cnt_origin = (uint32_t)((t->cnt_origin + ticks) & t->max);
+	t->origin += ticks * (t->psc + 1ULL);
+}
+
+/* CCMR1 holds channels 1 and 2, CCMR2 channels 3 and 4, a byte each. */
+static uint32_t tim_ccmr(TIM_TypeDef *tim, int ch) {
+	return ((ch < 2 ? tim->CCMR1 : tim->CCMR2) >> (8 * (ch & 1))) & 0xFF;
+}
+
+static volatile uint32_t *tim_ccr(TIM_TypeDef *tim, int ch) {
+	return &(&tim->CCR1)[ch];
+}
+
+static int tim_is_capture(TIM_TypeDef *tim, int ch) {
+	return (tim_ccmr(tim, ch) & 3) == 1;    // only ICx mapped on TIx
+}
+
+/* Output compare flags are only produced for channels whose interrupt or
+ * DMA request is enabled, so idle channels cost no events. */
+static uint64_t tim_compare_time(tim_state *t, int ch) {
+	TIM_TypeDef *tim = sim_alias(t->base);
+	uint32_t ccr = *tim_ccr(tim, ch) & t->max;
+
+	if (tim_ccmr(tim, ch) & 3) return SIM_NEVER;          // not an output
+	if (!(tim->DIER & ((TIM_DIER_CC1IE | TIM_DIER_CC1DE) << ch))) return SIM_NEVER;
+	if (ccr > t->arr) return SIM_NEVER;
+	if (ccr > t->cnt_origin && t->cnt_origin <= t->arr) {
+		return t->origin + (uint64_t)(ccr - t->cnt_origin) * (t->psc + 1ULL);
+	}
+	// Matched on the next period; a match on 0 coincides with the update.
+	return tim_overflow_time(t) + (uint64_t)ccr * (t->psc + 1ULL);
+}
+
+static void tim_irq_update(tim_state *t) {
+	TIM_TypeDef *tim = sim_alias(t->base);
+
+	for (int ch = 0; ch < 4; ch++) {
+		if (t->dma[ch][0] >= 0) {
+			uint32_t flag = TIM_SR_CC1IF << ch;
+			sim_dma_request(1, t->dma[ch][0], t->dma[ch][1],
+			                (tim->SR & flag) && (tim->DIER & (TIM_DIER_CC1DE << ch)));
+		}
+	}
+	sim_irq_level(t->irq, tim->SR & tim->DIER & 0x5F);
+}
+
+static void tim_update_event(tim_state *t, uint64_t when, int set_flag) {
+	TIM_TypeDef *tim = sim_alias(t->base);
+
+	t->origin = when;
+	t->cnt_origin = 0;
+	t->psc = tim->PSC & 0xFFFF;
+	t->arr = tim->ARR & t->max;
+	tim->CNT = 0;
+	if (set_flag) tim->SR |= TIM_SR_UIF;
+	if (tim->CR1 & TIM_CR1_OPM) tim->CR1 &= ~TIM_CR1_CEN;
+	// Master mode "update": TRGO pulses, and may start ADC1
+	if (set_flag && t->trgo >= 0 && (tim->CR2 & TIM_CR2_MMS) == TIM_CR2_MMS_1) {
+		adc_trigger((uint32_t)t->trgo, when);
+	}
+	tim_irq_update(t);
+}
+
+/* An edge on a channel input: CCRx latches the counter when the channel
+ * is an enabled input capture of the matching polarity. */
+static void tim_capture(tim_state *t, int ch, int rising) {
+	TIM_TypeDef *tim = sim_alias(t->base);
+	uint32_t ccer = tim->CCER >> (4 * ch);
+	uint32_t flag = TIM_SR_CC1IF << ch;
+
+	if (!tim_is_capture(tim, ch) || !(ccer & TIM_CCER_CC1E)) return;
+	switch (ccer & (TIM_CCER_CC1P | TIM_CCER_CC1NP)) {
+		case 0: if (!rising) return; break;
+		case TIM_CCER_CC1P: if (rising) return; break;
+		case TIM_CCER_CC1P | TIM_CCER_CC1NP: break;
+		default: return;        // reserved
+	}
+	*tim_ccr(tim, ch) = tim_running(t) ? tim_counter(t, sim_now) : tim->CNT;
+	if (tim->SR & flag) tim->SR |= TIM_SR_CC1OF << ch;
+	tim->SR |= flag;
+	tim_irq_update(t);
+}
+
+static void tim_input_edge(uint32_t port, uint32_t pin, int rising) {
+	GPIO_TypeDef *gpio = sim_alias(gpio_base(port));
+	uint32_t af;
+
+	if (((gpio->MODER >> (pin * 2)) & 3) != 2) return;
+	af = (gpio->AFR[pin >> 3] >> (4 * (pin & 7))) & 0xF;
+	for (unsigned int i = 0; i < sizeof(tim_inputs) / sizeof(tim_inputs[0]); i++) {
+		if (tim_inputs[i].port == port && tim_inputs[i].pin == pin && tim_inputs[i].af == af) {
+			tim_capture(&timers[tim_inputs[i].timer], tim_inputs[i].channel, rising);
+		}
+	}
+}
+
+static void tim_reset(void) {
+	for (unsigned int i = 0; i < TIM_COUNT; i++) {
+		tim_state *t = &timers[i];
+		TIM_TypeDef *tim = sim_alias(t->base);
+		plain_reset_zero(t->base, sizeof(TIM_TypeDef));
+		tim->ARR = t->max;
+		t->origin = sim_now;
+		t->cnt_origin = 0;
+		t->psc = 0;
+		t->arr = t->max;
+		tim_irq_update(t);
+	}
+}
+
+static void tim_refresh(uint32_t addr) {
+	tim_state *t = tim_find(addr);
+	TIM_TypeDef *tim = sim_alias(t->base);
+	if (tim_running(t)) tim->CNT = tim_counter(t, sim_now);
+}
+
+static void tim_read(uint32_t addr) {
+	tim_state *t = tim_find(addr);
+	TIM_TypeDef *tim = sim_alias(t->base);
+	uint32_t offset = addr - t->base;
+
+	// Reading a captured value clears its flag, which ends the DMA request.
+	if (offset >= 0x34 && offset <= 0x40 && tim_is_capture(tim, (offset - 0x34) / 4)) {
+		tim->SR &= ~(TIM_SR_CC1IF << ((offset - 0x34) / 4));
+		tim_irq_update(t);
+	}
+}
+
+static void tim_write(uint32_t addr, uint32_t old) {
+	tim_state *t = tim_find(addr);
+	TIM_TypeDef *tim = sim_alias(t->base);
+
+	if (tim_running(t)) tim_rebase(t);
+	switch (addr - t->base) {
+		case 0x00: // CR1
+			if (!(old & TIM_CR1_CEN) && (tim->CR1 & TIM_CR1_CEN)) {
+				t->origin = sim_now;
+				t->cnt_origin = tim->CNT & t->max;
+			}
+			break;
+		case 0x10: // SR, write zero to clear
+			tim->SR = old & tim->SR;
+			break;
+		case 0x14: // EGR
+			if (tim->EGR & TIM_EGR_UG) {
+				tim_update_event(t, sim_now, !(tim->CR1 & TIM_CR1_URS));
+			}
+			tim->EGR = 0;
+			break;
+		case 0x24: // CNT
+			tim->CNT &= t->max;
+			t->origin = sim_now;
+			t->cnt_origin = tim->CNT;
+			break;
+		case 0x2C: // ARR, preloaded only with ARPE
+			if (!(tim->CR1 & TIM_CR1_ARPE)) t->arr = tim->ARR & t->max;
+			break;
+		case 0x34: case 0x38: case 0x3C: case 0x40: // CCRx, read-only in capture mode
+			if (tim_is_capture(tim, (addr - t->base - 0x34) / 4)) SIM_REG(addr) = old;
+			break;
+	}
+	tim_irq_update(t);
+}
+
+/* Earliest update or compare match of a running timer. */
+static uint64_t tim_event_time(tim_state *t) {
+	uint64_t next = tim_overflow_time(t);
+	for (int ch = 0; ch < 4; ch++) {
+		uint64_t when = tim_compare_time(t, ch);
+		if (when < next) next = when;
+	}
+	return next;
+}
+
+static uint64_t tim_next_event(void) {
+	uint64_t next = SIM_NEVER;
+	for (unsigned int i = 0; i < TIM_COUNT; i++) {
+		if (tim_running(&timers[i])) {
+			uint64_t when = tim_event_time(&timers[i]);
+			if (when < next) next = when;
+		}
+	}
+	return next;
+}
+
+static void tim_update(uint64_t now) {
+	for (unsigned int i = 0; i < TIM_COUNT; i++) {
+		tim_state *t = &timers[i];
+		while (tim_running(t) && tim_event_time(t) <= now) {
+			TIM_TypeDef *tim = sim_alias(t->base);
+			uint64_t when = tim_event_time(t);
+			uint32_t matched = 0;
+
+			for (int ch = 0; ch < 4; ch++) {
+				if (tim_compare_time(t, ch) == when) matched |= TIM_SR_CC1IF << ch;
+			}
+			if (when == tim_overflow_time(t)) {
+				if (t->cnt_origin <= t->arr) {
+					tim_update_event(t, when, !(tim->CR1 & TIM_CR1_UDIS));
+				} else {
+					// Counter was beyond ARR: it wraps without an update event.
+					t->origin = when;
+					t->cnt_origin = 0;
+				}
+			} else {
+				t->cnt_origin = tim_counter(t, when);
+				t->origin = when;
+			}
+			if (matched) {
+				tim->SR |= matched;
+				tim_irq_update(t);
+			}
+		}
+	}
+}
+
+static const sim_model tim_model = {
+	.name = "TIM2-5", .base = TIM2_BASE, .size = 0x1000,
+	.reset = tim_reset, .refresh = tim_refresh, .read = tim_read, .write = tim_write,
+	.next_event = tim_next_event, .update = tim_update,
+};
+
+/* ------------------------------------------------------------------ */
+/*                              USART2                                */
+/* ------------------------------------------------------------------ */
+
+#define UART_RX_FIFO 4096
+
+static struct {
+	uint64_t tx_done;           // end of the frame in the shift register
+	uint8_t tx_shift;
+	int tdr_full;
+	uint8_t tdr;
+	uint8_t rdr;
+	int sr_read;                // SR read, first half of the clear sequences
+	uint64_t rx_done;           // end of the frame being received
+	uint64_t idle_at;           // time the line is detected idle
+	uint8_t fifo[UART_RX_FIFO]; // bytes waiting on the wire
+	uint32_t head, tail;
+} u2;
+
+static USART_TypeDef *uart_regs(void) {
+	return sim_alias(USART2_BASE);
+}
+
+static uint64_t uart_frame(void) {
+	USART_TypeDef *u = uart_regs();
+	uint32_t bits = 10;
+	if (u->CR1 & USART_CR1_M) bits++;
+	if ((u->CR2 & USART_CR2_STOP) == USART_CR2_STOP_1) bits++;
+	uint32_t brr = u->BRR & 0xFFFF;
+	// A bit lasts USARTDIV * 16 (or * 8 with OVER8) clock cycles.
+	uint64_t bit = (u->CR1 & USART_CR1_OVER8) ? ((brr >> 4) << 3) + (brr & 7) : brr;
+	return bit * bits;
+}
+
+static int uart_enabled(uint32_t direction) {
+	USART_TypeDef *u = uart_regs();
+	return (u->CR1 & USART_CR1_UE) && (u->CR1 & direction) && (u->BRR & 0xFFFF);
+}
+
+static void uart_irq_update(void) {
+	USART_TypeDef *u = uart_regs();
+	uint32_t sr = u->SR, cr1 = u->CR1;
+	int level = ((sr & USART_SR_TXE) && (cr1 & USART_CR1_TXEIE)) ||
+	            ((sr & USART_SR_TC) && (cr1 & USART_CR1_TCIE)) ||
+	            ((sr & (USART_SR_RXNE | USART_SR_ORE)) && (cr1 & USART_CR1_RXNEIE)) ||
+	            ((sr & USART_SR_IDLE) && (cr1 & USART_CR1_IDLEIE)) ||
+	            ((sr & USART_SR_PE) && (cr1 & USART_CR1_PEIE));
+	sim_irq_level(USART2_IRQn, level);
+	// DMA1 channel 4: stream 6 serves TX, stream 5 serves RX.
+	sim_dma_request(1, 6, 4, (sr & USART_SR_TXE) && (u->CR3 & USART_CR3_DMAT));
+	sim_dma_request(1, 5, 4, (sr & USART_SR_RXNE) && (u->CR3 & USART_CR3_DMAR));
+}
+
+static void uart_rx_start(void) {
+	if (u2.rx_done == SIM_NEVER && u2.head != u2.tail && uart_enabled(USART_CR1_RE)) {
+		u2.rx_done = sim_now + uart_frame();
+	}
+}
+
+void sim_uart_input(const uint8_t *data, uint32_t length) {
+	for (uint32_t i = 0; i < length; i++) {
+		uint32_t next = (u2.tail + 1) % UART_RX_FIFO;
+		if (next == u2.head) break;
+		u2.fifo[u2.tail] = data[i];
+		u2.tail = next;
+	}
+	uart_rx_start();
+}
+
+uint32_t sim_uart_input_pending(void) {
+	return (u2.tail - u2.head + UART_RX_FIFO) % UART_RX_FIFO;
+}
+
+static void uart_reset(void) {
+	USART_TypeDef *u = uart_regs();
+	plain_reset_zero(USART2_BASE, sizeof(USART_TypeDef));
+	u->SR = USART_SR_TXE | USART_SR_TC;
+	u2.tx_done = SIM_NEVER;
+	u2.rx_done = SIM_NEVER;
+	u2.idle_at = SIM_NEVER;
+	u2.tdr_full = 0;
+	u2.sr_read = 0;
+	uart_irq_update();
+}
+
+static void uart_read(uint32_t addr) {
+	USART_TypeDef *u = uart_regs();
+
+	if (addr == USART2_BASE) {
+		u2.sr_read = 1;
+	} else if (addr == USART2_BASE + 0x04) {
+		u->SR &= ~USART_SR_RXNE;
+		if (u2.sr_read) {
+			u->SR &= ~(USART_SR_ORE | USART_SR_IDLE | USART_SR_NE | USART_SR_FE | USART_SR_PE);
+		}
+		u2.sr_read = 0;
+		uart_irq_update();
+	}
+}
+
+static void uart_write(uint32_t addr, uint32_t old) {
+	USART_TypeDef *u = uart_regs();
+
+	switch (addr - USART2_BASE) {
+		case 0x00: // SR: CTS, LBD, TC and RXNE are write zero to clear
+			u->SR = (old & ~0x360U) | (old & u->SR & 0x360U);
+			break;
+		case 0x04: { // DR: the write goes to TDR, reads keep returning RDR
+			uint8_t byte = (uint8_t)u->DR;
+			u->DR = u2.rdr;
+			if (!uart_enabled(USART_CR1_TE)) break;
+			if (u2.sr_read) u->SR &= ~USART_SR_TC;
+			u2.sr_read = 0;
+			u->SR &= ~USART_SR_TC;
+			if (u2.tx_done == SIM_NEVER) {
+				u2.tx_shift = byte;
+				u2.tx_done = sim_now + uart_frame();
+			} else {
+				u2.tdr = byte;
+				u2.tdr_full = 1;
+				u->SR &= ~USART_SR_TXE;
+			}
+			break;
+		}
+		case 0x0C: // CR1
+			if (!(u->CR1 & USART_CR1_UE)) {
+				u2.rx_done = SIM_NEVER;
+			}
+			uart_rx_start();
+			break;
+	}
+	uart_irq_update();
+}
+
+static uint64_t uart_next_event(void) {
+	uint64_t next = u2.tx_done;
+	if (u2.rx_done < next) next = u2.rx_done;
+	if (u2.idle_at < next) next = u2.idle_at;
+	return next;
+}
+
+static void uart_update(uint64_t now) {
+	USART_TypeDef *u = uart_regs();
+
+	if (u2.tx_done <= now) {
+		sim_uart_output(u2.tx_shift);
+		sim_stats.uart_tx_bytes++;
+		if (u2.tdr_full) {
+			u2.tx_shift = u2.tdr;
+			u2.tdr_full = 0;
+			u->SR |= USART_SR_TXE;
+			u2.tx_done += uart_frame();
+		} else {
+			u2.tx_done = SIM_NEVER;
+			u->SR |= USART_SR_TC;
+		}
+	}
+
+	if (u2.rx_done <= now) {
+		uint8_t byte = u2.fifo[u2.head];
+		u2.head = (u2.head + 1) % UART_RX_FIFO;
+		sim_stats.uart_rx_bytes++;
+		if (u->SR & USART_SR_RXNE) {
+			// RDR still full: the new byte is lost.
+			u->SR |= USART_SR_ORE;
+			sim_stats.uart_overruns++;
+		} else {
+			u2.rdr = byte;
+			u->DR = byte;
+			u->SR |= USART_SR_RXNE;
+		}
+		if (u2.head != u2.tail) {
+			u2.rx_done += uart_frame();
+		} else {
+			u2.rx_done = SIM_NEVER;
+			u2.idle_at = now + uart_frame();
+		}
+	}
+
+	if (u2.idle_at <= now) {
+		u->SR |= USART_SR_IDLE;
+		u2.idle_at = SIM_NEVER;
+	}
+	uart_irq_update();
+}
+
+static const sim_model uart_model = {
+	.name = "USART2", .base = USART2_BASE, .size = sizeof(USART_TypeDef),
+	.reset = uart_reset, .read = uart_read, .write = uart_write,
+	.next_event = uart_next_event, .update = uart_update,
+};
+
+/* ------------------------------------------------------------------ */
+/*                               ADC1                                 */
+/* ------------------------------------------------------------------ */
+
+#define ADC_COMMON_BASE (ADC1_BASE + 0x300)
+
+static struct {
+	uint16_t input[19];     // raw 12-bit value of every channel
+	uint64_t done;          // end of the conversion in progress
+	uint32_t index;         // position in the regular sequence
+	int unread;             // DR holds a result not read yet
+} adc;
+
+void sim_adc_set_channel(uint32_t channel, uint16_t value) {
+	if (channel < 19) adc.input[channel] = value & 0x0FFF;
+}
+
+static uint32_t adc_channel(uint32_t index) {
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+	if (index < 6) return (a->SQR3 >> (index * 5)) & 0x1F;
+	if (index < 12) return (a->SQR2 >> ((index - 6) * 5)) & 0x1F;
+	return (a->SQR1 >> ((index - 12) * 5)) & 0x1F;
+}
+
+static uint64_t adc_conversion_time(uint32_t channel) {
+	static const uint32_t sample[8] = { 3, 15, 28, 56, 84, 112, 144, 480 };
+	static const uint32_t resolution[4] = { 12, 10, 8, 6 };
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+	ADC_Common_TypeDef *common = sim_alias(ADC_COMMON_BASE);
+	uint32_t smp = channel < 10 ? (a->SMPR2 >> (channel * 3)) & 7 : (a->SMPR1 >> ((channel - 10) * 3)) & 7;
+	uint32_t prescaler = (((common->CCR & ADC_CCR_ADCPRE) >> 16) + 1) * 2;
+	return (uint64_t)(sample[smp] + resolution[(a->CR1 & ADC_CR1_RES) >> 24]) * prescaler;
+}
+
+/* Also the DMA request, DMA2 Stream0 or Stream4 channel 0, held while
+ * DR has a result; the stream reading DR ends it. */
+static void adc_irq_update(void) {
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+	uint32_t sr = a->SR, cr1 = a->CR1;
+	int request = adc.unread && (a->CR2 & ADC_CR2_DMA);
+
+	sim_dma_request(2, 0, 0, request);
+	sim_dma_request(2, 4, 0, request);
+	sim_irq_level(ADC_IRQn, ((sr & ADC_SR_EOC) && (cr1 & ADC_CR1_EOCIE)) ||
+	                        ((sr & ADC_SR_AWD) && (cr1 & ADC_CR1_AWDIE)) ||
+	                        ((sr & ADC_SR_JEOC) && (cr1 & ADC_CR1_JEOCIE)) ||
+	                        ((sr & ADC_SR_OVR) && (cr1 & ADC_CR1_OVRIE)));
+}
+
+static void adc_start(uint64_t when) {
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+	a->SR |= ADC_SR_STRT;
+	adc.done = when + adc_conversion_time(adc_channel(adc.index));
+}
+
+/* A pulse on external trigger \a source starts the regular sequence, if
+ * that is the selected trigger and no conversion is under way. */
+static void adc_trigger(uint32_t source, uint64_t when) {
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+
+	if (!(a->CR2 & ADC_CR2_ADON) || !(a->CR2 & ADC_CR2_EXTEN)) return;
+	if (((a->CR2 & ADC_CR2_EXTSEL) >> 24) != source || adc.done != SIM_NEVER) return;
+	adc.index = 0;
+	adc_start(when);
+}
+
+static void adc_reset(void) {
+	plain_reset_zero(ADC1_BASE, sizeof(ADC_TypeDef));
+	plain_reset_zero(ADC_COMMON_BASE, sizeof(ADC_Common_TypeDef));
+	((ADC_TypeDef *)sim_alias(ADC1_BASE))->HTR = 0x0FFF;
+	for (int i = 0; i < 16; i++) adc.input[i] = 0x0800;
+	adc.input[16] = 943;    // temperature sensor at 25 C
+	adc.input[17] = 1502;   // VREFINT, 1.21 V
+	adc.input[18] = 1024;   // VBAT / 4 at 3.3 V
+	adc.done = SIM_NEVER;
+	adc.index = 0;
+	adc.unread = 0;
+	adc_irq_update();
+}
+
+static void adc_read(uint32_t addr) {
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+	if (addr == (uint32_t)(uintptr_t)&ADC1->DR) {
+		a->SR &= ~ADC_SR_EOC;
+		adc.unread = 0;
+		adc_irq_update();
+	}
+}
+
+static void adc_write(uint32_t addr, uint32_t old) {
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+
+	if (addr == (uint32_t)(uintptr_t)&ADC1->SR) {
+		a->SR = old & a->SR & 0x3F;
+	} else if (addr == (uint32_t)(uintptr_t)&ADC1->CR2) {
+		if (!(a->CR2 & ADC_CR2_ADON)) {
+			adc.done = SIM_NEVER;
+		} else if (a->CR2 & ADC_CR2_SWSTART) {
+			if (adc.done == SIM_NEVER && (old & ADC_CR2_ADON)) {
+				adc.index = 0;
+				adc_start(sim_now);
+			}
+		}
+		a->CR2 &= ~(ADC_CR2_SWSTART | ADC_CR2_JSWSTART);
+	} else if (addr == (uint32_t)(uintptr_t)&ADC1->DR) {
+		a->DR = old;
+	}
+	adc_irq_update();
+}
+
+static uint64_t adc_next_event(void) {
+	return adc.done;
+}
+
+static void adc_update(uint64_t now) {
+	ADC_TypeDef *a = sim_alias(ADC1_BASE);
+
+	while (adc.done <= now) {
+		uint32_t channel = adc_channel(adc.index);
+		uint32_t value = adc.input[channel < 19 ? channel : 0];
+		uint32_t length = ((a->SQR1 & ADC_SQR1_L) >> 20) + 1;
+		int scan = (a->CR1 & ADC_CR1_SCAN) != 0;
+		int last = !scan || adc.index + 1 >= length;
+
+		if ((a->CR1 & ADC_CR1_AWDEN) &&
+		    (!(a->CR1 & ADC_CR1_AWDSGL) || channel == (a->CR1 & ADC_CR1_AWDCH)) &&
+		    (value > (a->HTR & 0x0FFF) || value < (a->LTR & 0x0FFF))) {
+			a->SR |= ADC_SR_AWD;
+		}
+
+		value >>= ((a->CR1 & ADC_CR1_RES) >> 24) * 2;
+		if (a->CR2 & ADC_CR2_ALIGN) value <<= 4;
+
+		if (adc.unread && (a->CR2 & (ADC_CR2_DMA | ADC_CR2_EOCS))) {
+			// Previous result never read: data lost, conversions stop.
+			a->SR |= ADC_SR_OVR;
+			adc.done = SIM_NEVER;
+			break;
+		}
+		a->DR = value;
+		adc.unread = 1;
+		if ((a->CR2 & ADC_CR2_EOCS) || last) a->SR |= ADC_SR_EOC;
+		adc_irq_update(); // DMA takes the result now
+
+		adc.index = last ? 0 : adc.index + 1;
+		if (!last || (a->CR2 & ADC_CR2_CONT)) {
+			adc.done += adc_conversion_time(adc_channel(adc.index));
+		} else {
+			adc.done = SIM_NEVER;
+			a->SR &= ~ADC_SR_STRT;
+		}
+	}
+	adc_irq_update();
+}
+
+static const sim_model adc_model = {
+	.name = "ADC1", .base = ADC1_BASE, .size = 0x310,
+	.reset = adc_reset, .read = adc_read, .write = adc_write,
+	.next_event = adc_next_event, .update = adc_update,
+};
+
+/* ------------------------------------------------------------------ */
+/*                               I2C1                                 */
+/* ------------------------------------------------------------------ */
+
+#define I2C_MAX_SLAVES 4
+
+typedef enum {
+	I2C_IDLE,
+	I2C_START,          // generating a start condition
+	I2C_ADDRESS,        // shifting out the address byte
+	I2C_ADDRESSED,      // waiting for ADDR to be cleared
+	I2C_TRANSMIT,       // shifting out a data byte
+	I2C_RECEIVE,        // shifting in a data byte
+	I2C_HOLD,           // clock stretched by the master
+	I2C_STOP,           // generating a stop condition
+} i2c_phase;
+
+static struct {
+	const sim_i2c_slave *slaves[I2C_MAX_SLAVES];
+	int slave_count;
+	const sim_i2c_slave *target;
+	i2c_phase phase;
+	uint64_t done;
+	int reading;
+	uint8_t shift;
+	int dr_full;            // transmitter: DR holds a byte for the shift register
+	int nacked;             // receiver: the master sent NACK, no more bytes
+	int sr1_read;
+} i2c;
+
+void sim_i2c_attach(const sim_i2c_slave *slave) {
+	if (i2c.slave_count < I2C_MAX_SLAVES) i2c.slaves[i2c.slave_count++] = slave;
+}
+
+static I2C_TypeDef *i2c_regs(void) {
+	return sim_alias(I2C1_BASE);
+}
+
+static uint64_t i2c_bit(void) {
+	I2C_TypeDef *r = i2c_regs();
+	uint64_t ccr = r->CCR & I2C_CCR_CCR;
+	if (!ccr) ccr = 80;
+	if (!(r->CCR & I2C_CCR_FS)) return 2 * ccr;
+	return (r->CCR & I2C_CCR_DUTY) ? 25 * ccr : 3 * ccr;
+}
+
+static void i2c_irq_update(void) {
+	I2C_TypeDef *r = i2c_regs();
+	uint32_t sr1 = r->SR1, cr2 = r->CR2;
+	int ev = (cr2 & I2C_CR2_ITEVTEN) &&
+	         ((sr1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF | I2C_SR1_STOPF | I2C_SR1_ADD10)) ||
+	          ((cr2 & I2C_CR2_ITBUFEN) && (sr1 & (I2C_SR1_TXE | I2C_SR1_RXNE))));
+	int er = (cr2 & I2C_CR2_ITERREN) && (sr1 & 0xDF00);
+	int dma = (cr2 & I2C_CR2_DMAEN) != 0;
+
+	sim_irq_level(I2C1_EV_IRQn, ev);
+	sim_irq_level(I2C1_ER_IRQn, er);
+	// DMA1 channel 1: streams 6 and 7 serve TX, streams 0 and 5 RX.
+	sim_dma_request(1, 6, 1, dma && (sr1 & I2C_SR1_TXE));
+	sim_dma_request(1, 7, 1, dma && (sr1 & I2C_SR1_TXE));
+	sim_dma_request(1, 0, 1, dma && (sr1 & I2C_SR1_RXNE));
+	sim_dma_request(1, 5, 1, dma && (sr1 & I2C_SR1_RXNE));
+}
+
+/* Whether the master acknowledges a byte it receives. With DMAEN and
+ * LAST the byte the RX stream ends on is not: \a ahead is the number of
+ * bytes the stream has still to count before it. */
+static int i2c_acknowledges(uint32_t ahead) {
+	I2C_TypeDef *r = i2c_regs();
+
+	if (!(r->CR1 & I2C_CR1_ACK) || (r->CR1 & I2C_CR1_STOP)) return 0;
+	if ((r->CR2 & (I2C_CR2_DMAEN | I2C_CR2_LAST)) != (I2C_CR2_DMAEN | I2C_CR2_LAST)) return 1;
+	for (int s = 0; s < 8; s += 5) {
+		DMA_Stream_TypeDef *st = dma_stream(0, s);
+		if ((st->CR & DMA_SxCR_EN) && ((st->CR & DMA_SxCR_CHSEL) >> 25) == 1 && st->NDTR == ahead + 1) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void i2c_schedule(i2c_phase phase, uint64_t bits) {
+	i2c.phase = phase;
+	i2c.done = sim_now + bits * i2c_bit();
+}
+
+static void i2c_reset(void) {
+	plain_reset_zero(I2C1_BASE, sizeof(I2C_TypeDef));
+	i2c.phase = I2C_IDLE;
+	i2c.done = SIM_NEVER;
+	i2c.target = 0;
+	i2c.dr_full = 0;
+	i2c.sr1_read = 0;
+	i2c_irq_update();
+}
+
+static int i2c_shifting(void) {
+	return i2c.phase == I2C_ADDRESS || i2c.phase == I2C_TRANSMIT || i2c.phase == I2C_RECEIVE;
+}
+
+/* A stop or repeated start set while a byte was shifted comes after it. */
+static void i2c_condition(void) {
+	I2C_TypeDef *r = i2c_regs();
+
+	if (i2c.phase != I2C_HOLD) return;
+	if ((r->CR1 & I2C_CR1_STOP) && (r->SR2 & I2C_SR2_MSL)) {
+		i2c_schedule(I2C_STOP, 1);
+	} else if (r->CR1 & I2C_CR1_START) {
+		i2c_schedule(I2C_START, 1);
+	}
+}
+
+static void i2c_next_transfer(void) {
+	I2C_TypeDef *r = i2c_regs();
+
+	if (i2c.reading) {
+		if (!i2c.nacked) i2c_schedule(I2C_RECEIVE, 9);
+		else i2c.phase = I2C_HOLD;
+	} else if (i2c.dr_full) {
+		i2c.shift = (uint8_t)r->DR;
+		i2c.dr_full = 0;
+		r->SR1 |= I2C_SR1_TXE;
+		i2c_schedule(I2C_TRANSMIT, 9);
+	} else {
+		r->SR1 |= I2C_SR1_BTF;
+		i2c.phase = I2C_HOLD;
+	}
+}
+
+static void i2c_read(uint32_t addr) {
+	I2C_TypeDef *r = i2c_regs();
+
+	switch (addr - I2C1_BASE) {
+		case 0x10: // DR
+			r->SR1 &= ~I2C_SR1_RXNE;
+			if (i2c.sr1_read) r->SR1 &= ~I2C_SR1_BTF;
+			if (i2c.phase == I2C_HOLD && i2c.reading && !i2c.nacked) {
+				// The byte waiting in the shift register moves up.
+				r->DR = i2c.shift;
+				r->SR1 |= I2C_SR1_RXNE;
+				i2c.nacked = !i2c_acknowledges((r->CR2 & I2C_CR2_DMAEN) ? 1 : 0);
+				i2c_next_transfer();
+			}
+			break;
+		case 0x14: // SR1
+			i2c.sr1_read = 1;
+			return;
+		case 0x18: // SR2 after SR1 clears ADDR
+			if (i2c.sr1_read && (r->SR1 & I2C_SR1_ADDR)) {
+				r->SR1 &= ~I2C_SR1_ADDR;
+				if (i2c.reading) {
+					i2c_next_transfer();
+				} else {
+					r->SR1 |= I2C_SR1_TXE;
+					i2c.phase = I2C_HOLD;
+				}
+			}
+			break;
+	}
+	i2c.sr1_read = 0;
+	i2c_irq_update();
+}
+
+static void i2c_write(uint32_t addr, uint32_t old) {
+	I2C_TypeDef *r = i2c_regs();
+
+	switch (addr - I2C1_BASE) {
+		case 0x00: // CR1
+			if (r->CR1 & I2C_CR1_SWRST) {
+				uint32_t cr1 = r->CR1;
+				i2c_reset();
+				r->CR1 = cr1;
+				break;
+			}
+			if (!(r->CR1 & I2C_CR1_PE)) {
+				r->CR1 &= ~(I2C_CR1_START | I2C_CR1_STOP);
+				break;
+			}
+			if (i2c_shifting()) {
+				// After the current byte, see i2c_condition()
+			} else if ((r->CR1 & I2C_CR1_STOP) && !(old & I2C_CR1_STOP) && (r->SR2 & I2C_SR2_MSL)) {
+				i2c_schedule(I2C_STOP, 1);
+			} else if ((r->CR1 & I2C_CR1_START) && !(old & I2C_CR1_START) && i2c.phase != I2C_STOP) {
+				i2c_schedule(I2C_START, 1);
+			}
+			break;
+		case 0x10: { // DR
+			uint8_t byte = (uint8_t)r->DR;
+			if (i2c.sr1_read) r->SR1 &= ~I2C_SR1_BTF;
+			if (r->SR1 & I2C_SR1_SB) {
+				r->SR1 &= ~I2C_SR1_SB;
+				i2c.shift = byte;
+				i2c.reading = byte & 1;
+				i2c_schedule(I2C_ADDRESS, 9);
+			} else if (!i2c.reading && (r->SR2 & I2C_SR2_MSL)) {
+				r->SR1 &= ~I2C_SR1_TXE;
+				i2c.dr_full = 1;
+				if (i2c.phase == I2C_HOLD) {
+					r->SR1 &= ~I2C_SR1_BTF;
+					i2c_next_transfer();
+				}
+			}
+			break;
+		}
+		case 0x14: // SR1: error flags are write zero to clear
+			r->SR1 = (old & 0x00FF) | (old & r->SR1 & 0xDF00);
+			break;
+		case 0x18: // SR2 is read-only
+			r->SR2 = old;
+			break;
+	}
+	i2c.sr1_read = 0;
+	i2c_irq_update();
+}
+
+static uint64_t i2c_next_event(void) {
+	return i2c.done;
+}
+
+static void i2c_update(uint64_t now) {
+	I2C_TypeDef *r = i2c_regs();
+
+	if (i2c.done > now) return;
+	i2c.done = SIM_NEVER;
+
+	switch (i2c.phase) {
+		case I2C_START:
+			r->CR1 &= ~I2C_CR1_START;
+			r->SR1 |= I2C_SR1_SB;
+			r->SR2 |= I2C_SR2_MSL | I2C_SR2_BUSY;
+			i2c.dr_full = 0;
+			i2c.nacked = 0;
+			i2c.phase = I2C_IDLE;
+			break;
+		case I2C_ADDRESS:
+			i2c.target = 0;
+			for (int i = 0; i < i2c.slave_count; i++) {
+				if (i2c.slaves[i]->address == (i2c.shift >> 1)) i2c.target = i2c.slaves[i];
+			}
+			if (i2c.target && (!i2c.target->start || i2c.target->start(i2c.reading))) {
+				r->SR1 |= I2C_SR1_ADDR;
+				if (i2c.reading) r->SR2 &= ~I2C_SR2_TRA;
+				else r->SR2 |= I2C_SR2_TRA;
+				i2c.phase = I2C_ADDRESSED;
+			} else {
+				i2c.target = 0;
+				r->SR1 |= I2C_SR1_AF;
+				i2c.phase = I2C_HOLD;
+			}
+			break;
+		case I2C_TRANSMIT:
+			if (i2c.target && i2c.target->write && !i2c.target->write(i2c.shift)) {
+				r->SR1 |= I2C_SR1_AF;
+				i2c.phase = I2C_HOLD;
+				break;
+			}
+			i2c_next_transfer();
+			break;
+		case I2C_RECEIVE: {
+			uint8_t byte = (i2c.target && i2c.target->read) ? i2c.target->read() : 0xFF;
+			if (r->SR1 & I2C_SR1_RXNE) {
+				// DR still full: hold the byte and stretch the clock.
+				i2c.shift = byte;
+				r->SR1 |= I2C_SR1_BTF;
+				i2c.phase = I2C_HOLD;
+			} else {
+				r->DR = byte;
+				r->SR1 |= I2C_SR1_RXNE;
+				i2c.nacked = !i2c_acknowledges(0);
+				i2c_next_transfer();
+			}
+			break;
+		}
+		case I2C_STOP:
+			r->CR1 &= ~I2C_CR1_STOP;
+			r->SR2 &= ~(I2C_SR2_MSL | I2C_SR2_BUSY | I2C_SR2_TRA);
+			r->SR1 &= ~(I2C_SR1_TXE | I2C_SR1_BTF);
+			if (i2c.target && i2c.target->stop) i2c.target->stop();
+			i2c.target = 0;
+			i2c.phase = I2C_IDLE;
+			if (r->CR1 & I2C_CR1_START) i2c_schedule(I2C_START, 1);
+			break;
+		default:
+			break;
+	}
+	i2c_condition();
+	i2c_irq_update();
+}
+
+static const sim_model i2c_model = {
+	.name = "I2C1", .base = I2C1_BASE, .size = sizeof(I2C_TypeDef),
+	.reset = i2c_reset, .read = i2c_read, .write = i2c_write,
+	.next_event = i2c_next_event, .update = i2c_update,
+};
+
+/* ------------------------------------------------------------------ */
+
+void sim_periph_init(void) {
+	for (int port = 0; port < GPIO_PORTS; port++) {
+		memset(ports[port].drive, -1, sizeof(ports[port].drive));
+		memset(ports[port].pull, -1, sizeof(ports[port].pull));
+	}
+
+	sim_register(&rcc_model);
+	sim_register(&dbgmcu_model);
+	sim_register(&crc_model);
+	sim_register(&syscfg_model);
+	sim_register(&exti_model);
+	sim_register(&gpioA_model);
+	sim_register(&gpioB_model);
+	sim_register(&gpioC_model);
+	sim_register(&gpioD_model);
+	sim_register(&gpioE_model);
+	sim_register(&gpioH_model);
+	sim_register(&dma1_model);
+	sim_register(&dma2_model);
+	sim_register(&tim_model);
+	sim_register(&uart_model);
+	sim_register(&adc_model);
+	sim_register(&i2c_model);
+}
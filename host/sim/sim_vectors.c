@@ -0,0 +1,100 @@
+/*!
+ * \file      sim_vectors.c
+ * \brief     Vector table of the simulated STM32F411.
+ *
+ * Mirrors startup_stm32f411xe.s: every handler is a weak alias of
+ * Default_Handler, so the handlers defined by the firmware take over at
+ * link time exactly as they do on target.
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include "sim.h"
+
+#define SIM_HANDLERS(X) \
+	X(2,  NMI_Handler) \
+	X(3,  HardFault_Handler) \
+	X(4,  MemManage_Handler) \
+	X(5,  BusFault_Handler) \
+	X(6,  UsageFault_Handler) \
+	X(11, SVC_Handler) \
+	X(12, DebugMon_Handler) \
+	X(14, PendSV_Handler) \
+	X(15, SysTick_Handler) \
+	X(16, WWDG_IRQHandler) \
+	X(17, PVD_IRQHandler) \
+	X(18, TAMP_STAMP_IRQHandler) \
+	X(19, RTC_WKUP_IRQHandler) \
+	X(20, FLASH_IRQHandler) \
+	X(21, RCC_IRQHandler) \
+	X(22, EXTI0_IRQHandler) \
+	X(23, EXTI1_IRQHandler) \
+	X(24, EXTI2_IRQHandler) \
+	X(25, EXTI3_IRQHandler) \
+	X(26, EXTI4_IRQHandler) \
+	X(27, DMA1_Stream0_IRQHandler) \
+	X(28, DMA1_Stream1_IRQHandler) \
+	X(29, DMA1_Stream2_IRQHandler) \
+	X(30, DMA1_Stream3_IRQHandler) \
+	X(31, DMA1_Stream4_IRQHandler) \
+	X(32, DMA1_Stream5_IRQHandler) \
+	X(33, DMA1_Stream6_IRQHandler) \
+	X(34, ADC_IRQHandler) \
+	X(39, EXTI9_5_IRQHandler) \
+	X(40, TIM1_BRK_TIM9_IRQHandler) \
+	X(41, TIM1_UP_TIM10_IRQHandler) \
+	X(42, TIM1_TRG_COM_TIM11_IRQHandler) \
+	X(43, TIM1_CC_IRQHandler) \
+	X(44, TIM2_IRQHandler) \
+	X(45, TIM3_IRQHandler) \
+	X(46, TIM4_IRQHandler) \
+	X(47, I2C1_EV_IRQHandler) \
+	X(48, I2C1_ER_IRQHandler) \
+	X(49, I2C2_EV_IRQHandler) \
+	X(50, I2C2_ER_IRQHandler) \
+	X(51, SPI1_IRQHandler) \
+	X(52, SPI2_IRQHandler) \
+	X(53, USART1_IRQHandler) \
+	X(54, USART2_IRQHandler) \
+	X(56, EXTI15_10_IRQHandler) \
+	X(57, RTC_Alarm_IRQHandler) \
+	X(58, OTG_FS_WKUP_IRQHandler) \
+	X(63, DMA1_Stream7_IRQHandler) \
+	X(65, SDIO_IRQHandler) \
+	X(66, TIM5_IRQHandler) \
+	X(67, SPI3_IRQHandler) \
+	X(72, DMA2_Stream0_IRQHandler) \
+	X(73, DMA2_Stream1_IRQHandler) \
+	X(74, DMA2_Stream2_IRQHandler) \
+	X(75, DMA2_Stream3_IRQHandler) \
+	X(76, DMA2_Stream4_IRQHandler) \
+	X(83, OTG_FS_IRQHandler) \
+	X(84, DMA2_Stream5_IRQHandler) \
+	X(85, DMA2_Stream6_IRQHandler) \
+	X(86, DMA2_Stream7_IRQHandler) \
+	X(87, USART6_IRQHandler) \
+	X(88, I2C3_EV_IRQHandler) \
+	X(89, I2C3_ER_IRQHandler) \
+	X(97, FPU_IRQHandler) \
+	X(100, SPI4_IRQHandler) \
+	X(101, SPI5_IRQHandler)
+
+extern int sim_current_exception(void);
+
+void Default_Handler(void) {
+	// On target this is an endless loop; stop the run instead.
+	fprintf(stderr, "sim: unhandled exception %d\n", sim_current_exception());
+	sim_exit(1);
+}
+
+#define DECLARE_HANDLER(n, name) void name(void) __attribute__((weak, alias("Default_Handler")));
+SIM_HANDLERS(DECLARE_HANDLER)
+
+#define VECTOR_ENTRY(n, name) [n] = name,
+void (*const sim_vectors[SIM_EXC_COUNT])(void) = {
+	SIM_HANDLERS(VECTOR_ENTRY)
+};
+
+#define NAME_ENTRY(n, name) [n] = #name,
+const char *const sim_vector_names[SIM_EXC_COUNT] = {
+	SIM_HANDLERS(NAME_ENTRY)
+};
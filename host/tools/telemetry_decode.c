@@ -0,0 +1,181 @@
+/*!
+ * \file      telemetry_decode.c
+ * \brief     Reads the telemetry frames of the board, see drivers/telemetry.h.
+ *
+ * Reads a serial port, a file or the standard input and writes one CSV
+ * line per reading on the standard output. Text between the frames (the
+ * screen, when the board sends both) is dropped, or copied to the
+ * standard error with --ui. On exit the counts of frames, CRC errors and
+ * readings lost (gaps in the sequence numbers) go to the standard error.
+ *
+ *     telemetry_decode /dev/ttyACM0
+ *     build/host/lab3 --stdio --input '...telemetry only\r' | telemetry_decode
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "telemetry.h"
+
+#define MAX_FRAME TELEMETRY_FRAME_SIZE(TELEMETRY_MAX_PAYLOAD)
+
+static struct {
+	unsigned long long bytes, frames, readings, crc_errors, lost, other;
+} stats;
+static int show_ui;
+static int have_sequence;
+static uint16_t last_sequence;
+
+// As checksum_crc16() on the board, a bit at a time.
+static uint16_t crc16(const uint8_t *data, uint32_t length) {
+	uint16_t crc = 0xFFFF;
+
+	while (length--) {
+		crc ^= (uint16_t)(*data++ << 8);
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Undoes COBS; returns the length, or -1 if the frame is not COBS.
+static int cobs_decode(const uint8_t *in, uint32_t length, uint8_t *out) {
+	uint32_t i = 0, n = 0;
+
+	while (i < length) {
+		uint8_t code = in[i++];
+
+		if (code == 0 || i + code - 1 > length) {
+			return -1;
+		}
+		for (int k = 1; k < code; k++) {
+			out[n++] = in[i++];
+		}
+		if (code != 0xFF && i < length) {
+			out[n++] = 0;
+		}
+	}
+	return (int)n;
+}
+
+static void print_reading(const uint8_t *payload) {
+	const uint8_t *data = payload + TELEMETRY_READING_DATA;
+	uint16_t sequence = (uint16_t)(payload[TELEMETRY_READING_SEQUENCE] | payload[TELEMETRY_READING_SEQUENCE + 1] << 8);
+
+	uint16_t gap = (uint16_t)(sequence - last_sequence - 1);
+
+	if (have_sequence && gap < 0x8000) {
+		stats.lost += gap; // Else the numbers went back: the board was reset
+	}
+	have_sequence = 1;
+	last_sequence = sequence;
+	stats.readings++;
+	printf("%u,%u,%u,%u.%u,%u.%u,%c,%u\n", sequence, get32(payload + TELEMETRY_READING_TIME),
+	       payload[TELEMETRY_READING_STATUS], data[0], data[1], data[2], data[3],
+	       payload[TELEMETRY_READING_MODE], get32(payload + TELEMETRY_READING_CLICKS));
+}
+
+// What was between two zeros: a frame, or text.
+static void chunk(const uint8_t *data, uint32_t length) {
+	uint8_t payload[MAX_FRAME];
+	int n = length <= MAX_FRAME ? cobs_decode(data, length, payload) : -1;
+
+	if (n >= 3 && crc16(payload, n - 2) == (payload[n - 2] | payload[n - 1] << 8)) {
+		stats.frames++;
+		if (payload[0] == TELEMETRY_READING && n - 2 == TELEMETRY_READING_SIZE) {
+			print_reading(payload);
+		} else {
+			stats.other++;
+		}
+		return;
+	}
+	if (n == TELEMETRY_READING_SIZE + 2 && payload[0] == TELEMETRY_READING) {
+		stats.crc_errors++; // A damaged reading, rather than text
+	}
+	if (show_ui) {
+		fwrite(data, 1, length, stderr);
+	}
+}
+
+static int open_input(const char *path) {
+	struct termios tio;
+	int fd;
+
+	if (!path || !strcmp(path, "-")) {
+		return 0;
+	}
+	fd = open(path, O_RDONLY | O_NOCTTY);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		cfsetspeed(&tio, B115200);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	return fd;
+}
+
+int main(int argc, char **argv) {
+	static const struct option long_options[] = {
+		{ "ui",   no_argument, 0, 'u' },
+		{ "help", no_argument, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+	static uint8_t input[65536];
+	static uint8_t pending[MAX_FRAME + 1];
+	uint32_t held = 0;
+	struct timespec start, end;
+	ssize_t got;
+	int c, fd;
+
+	while ((c = getopt_long(argc, argv, "", long_options, 0)) != -1) {
+		if (c == 'u') {
+			show_ui = 1;
+		} else {
+			fprintf(stderr, "usage: %s [--ui] [DEVICE|FILE|-]\n"
+			        "  --ui   copy the text between the frames to the standard error\n", argv[0]);
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	fd = open_input(optind < argc ? argv[optind] : 0);
+
+	printf("sequence,time_ms,status,humidity,temperature,mode,clicks\n");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while ((got = read(fd, input, sizeof(input))) > 0) {
+		stats.bytes += (unsigned long long)got;
+		for (ssize_t i = 0; i < got; i++) {
+			if (input[i] == 0) {
+				chunk(pending, held);
+				held = 0;
+			} else if (held < sizeof(pending)) {
+				pending[held++] = input[i];
+			} else {
+				// Too long for a frame, it is text
+				chunk(pending, held);
+				pending[0] = input[i];
+				held = 1;
+			}
+		}
+		fflush(stdout); // Whatever reads us sees the readings as they come
+	}
+	chunk(pending, held);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "telemetry: %llu bytes, %llu frames (%llu readings, %llu other), %llu CRC errors, "
+	        "%llu readings lost; %.0f readings/s\n", stats.bytes, stats.frames, stats.readings, stats.other,
+	        stats.crc_errors, stats.lost, seconds > 0 ? stats.readings / seconds : 0.0);
+	return 0;
+}
@@ -1,5 +1,4 @@
 #include "platform.h"
-#include <stdio.h>
 #include <stdint.h>
 #include "uart.h"
 #include <string.h>
@@ -8,6 +7,17 @@
 #include "timer.h"
 #include <stdbool.h>
 #include "delay.h"
+#include "dht11_capture.h"
+#include "sht3x.h"
+#include "event.h"
+#include "screen.h"
+#include "format.h"
+#include "history.h"
+#include "flash_log.h"
+#include "telemetry.h"
+#include "checksum.h"
+#include "bench.h"
+#include "benchmarks.h"
 
 
 /*
@@ -18,8 +28,20 @@
 
 /*         UART variable definitions         */
 #define BUFF_SIZE 128 // read buffer length
-#define MENU_LINES 9
-#define MAX_STATE_TIME 700
+
+/*         Screen lines         */
+#define TITLE_ROW 0
+#define PROMPT_ROW 1   // login phase
+#define OPTIONS_ROW 1
+#define MENU_ROW 2     // first of the 4 options
+#define DATA_ROW 7
+#define STATUS_ROW 8
+#define COMMAND_ROW 9
+#define DATA_COLUMN 28 // data and status are indented
+
+/*         Log in flash, after the program         */
+#define LOG_FIRST_SECTOR 5 // 0x08020000, the program must fit below
+#define LOG_SECTORS 3      // 128 KB each
 
 #define DHT11 PC_8
 #define TOUCH PC_6
@@ -34,24 +56,30 @@ menu_text test[4] = {"1. Increase period of read/write data by 1s (max 10s).",
 														"3. Switch between temperature/ humidity/ both.",
 														"4. Print current data and System Mode."};
 const char *password = "password";
-const char *menu = "                ==== Environmental System ====\r\nOptions:\r\n";
-const char *highlight_front = "\033[43;30m";
-const char *highlight_back = "\033[0m";
-char display_message[1500];
+const char *title = "                ==== Environmental System ====";
+const char *prompt = "Enter your password: "; // the line being typed follows it
+char display_message[SCREEN_COLS + 1];
 int aem_sum;
 bool danger = false;
-bool print_mode = true;
 bool print_menu = false;
-bool update_values = false;
-bool update_touch_sensor = false;
+bool status_pending = false; // the status line waits for the next reading
 unsigned int dangerous_values = 0;
 unsigned int touch_sensor_clicks = 0;
 uint8_t reading_period = 6;
 uint8_t selection = 0;
 
+uint8_t rx_storage[128]; // Storage of rx_queue, a power of two
 Queue rx_queue;       // Queue for storing received characters
 char buff[BUFF_SIZE]; // The UART read string will be stored here
 uint32_t buff_index;
+
+SoftTimer read_timer;   // DHT11 reading period
+SoftTimer status_timer; // Clears the status line
+SoftTimer blink_timer;  // LED blinking in mode B
+
+uint8_t history_storage[4096]; // Storage of history, a power of two
+History history;               // Past readings: temperature (tenths), humidity
+const int16_t no_values[FLASH_LOG_VALUES];
 														
 enum DHT11_output_options {
 	BOTH = 0,
@@ -59,6 +87,30 @@ enum DHT11_output_options {
 	HUMIDITY
 };
 
+/* Events posted by the interrupt handlers, highest priority first */
+enum events {
+	EVENT_READING = 0,    // a DHT11 acquisition has completed
+	EVENT_RX,             // characters are waiting in rx_queue
+	EVENT_TOUCH,          // the touch sensor was pressed
+	EVENT_PERIOD,         // the reading period elapsed
+	EVENT_STATUS_TIMEOUT  // the status line is to be erased
+};
+
+/* Records of the flash log */
+enum log_records {
+	LOG_BOOT = 1,  // detail: RCC reset flags (CSR bits 31..24)
+	LOG_READING,   // values: temperature (tenths), humidity
+	LOG_RESET      // the software reset on dangerous values, with the last reading
+};
+
+/* What is sent on the UART */
+enum telemetry_modes {
+	TELEMETRY_OFF = 0, // the screen only
+	TELEMETRY_ON,      // a telemetry frame after every reading, between the screen updates
+	TELEMETRY_ONLY     // the frames only, the screen is kept up to date but not sent
+};
+enum telemetry_modes telemetry = TELEMETRY_OFF;
+
 enum uart_mode {
 	MAIN = 0,
 	PASSWORD,
@@ -67,8 +119,10 @@ enum uart_mode {
 enum uart_mode MODE = PASSWORD;
 
 enum DHT11_output_options display_cases = BOTH;
-float temperature;
-int humidity;
+DHT11_Reading reading;
+int (*sensor_start)(void (*callback)(const DHT11_Reading *)) = dht11_capture_start; // or sht3x_start
+int temperature; // tenths of a degree Celsius
+int humidity;    // %
 
 /*
 enum mode_options {
@@ -86,165 +140,108 @@ uint8_t safe_values_count = 0;
 /* ----------------------------------------------------------------- */
 
 void uart_menu_handler(uint8_t selection, bool highlight) {
-	
-	// Move up enough lines to clear the previous menu instance
-	for (int i = 0; i < MENU_LINES; i++) {
-		uart_print("\033[A\r");
-	}
-	
-	display_message[0] = '\0';
-	strcat(display_message, menu);
+	// Only the options whose highlight changed are sent
+	screen_set_line(TITLE_ROW, title, 0);
+	screen_set_line(OPTIONS_ROW, "Options:", 0);
 	for (int i = 0; i < 4; i++) {
-		if (i == selection && highlight) {
-			strcat(display_message, highlight_front);
-			strcat(display_message, test[i].text);
-			strcat(display_message, highlight_back);
-		} else {
-			strcat(display_message, test[i].text);
-		}
-		strcat(display_message, "\r\n");
-	}
-	strcat(display_message, "\n\n\n");
-	strcat(display_message, "Command: ");
-	uart_print(display_message);
-	
-	for (int i = 0; i < buff_index; i++) {
-		uart_print("\033[1C");
+		screen_set_line(MENU_ROW + i, test[i].text, i == selection && highlight);
 	}
+	prompt = "Command: ";
+}
+
+/*      Shows the line being typed and sends the changes of the screen      */
+void display_handler() {
+	uint32_t length = buff_index;
+	uint32_t prompt_length = strlen(prompt);
+	
+	// A '\r' ends the line, it is not shown
+	if (length > 0 && buff[length - 1] == '\r') length--;
+	if (length > SCREEN_COLS - prompt_length) length = SCREEN_COLS - prompt_length;
+	
+	strcpy(display_message, prompt);
+	memcpy(display_message + prompt_length, buff, length);
+	display_message[prompt_length + length] = '\0';
+	screen_set_line(MODE == MAIN ? COMMAND_ROW : PROMPT_ROW, display_message, 0);
+	screen_set_cursor(MODE == MAIN ? COMMAND_ROW : PROMPT_ROW, prompt_length + length);
+	if (telemetry != TELEMETRY_ONLY) screen_render();
+}
+
+// Puts text in a line, DATA_COLUMN columns in
+void indented_line(uint32_t row, const char *text) {
+	format_string(display_message, sizeof(display_message), "%*s%s", DATA_COLUMN, "", text);
+	screen_set_line(row, display_message, 0);
 }
 
 void DHT11_data_handler() {		
+	char line[SCREEN_COLS + 1];
 	
 	switch (display_cases){
 		case BOTH:
-			sprintf(display_message, "Humidity: %d, Temperature: %f, reading with period = %d sec \r\n\n", humidity, temperature, reading_period);
+			format_string(line, sizeof(line), "Humidity: %d, Temperature: %.1d, reading with period = %d sec ", humidity, temperature, reading_period);
 			break;
 		case FREQUENCY:
-			sprintf(display_message, "Temperature: %f,               reading with period = %d sec \r\n\n", temperature, reading_period);
+			format_string(line, sizeof(line), "Temperature: %.1d,               reading with period = %d sec ", temperature, reading_period);
 			break;
 		case HUMIDITY:
-			sprintf(display_message, "Humidity: %d,                         reading with period = %d sec \r\n\n", humidity, reading_period);
+			format_string(line, sizeof(line), "Humidity: %d,                    reading with period = %d sec ", humidity, reading_period);
 			break;
 	}
 	
-	
-	// print in correct place
-	uart_print("\033[?25l"); // Hide the cursor
-	uart_print("\033[A\033[A\r                            ");
-	uart_print(display_message);
-	// return the cursor where it was, buff_index + 9 to the right (9 is from the "Command: " text)
-	for (int i = 0; i < buff_index + 9; i++) {
-		uart_print("\033[1C");
-	}
-	uart_print("\033[?25h"); // Reveal the cursor
+	// Nothing is sent if the line has not changed
+	indented_line(DATA_ROW, line);
 }
 
 void update_timer_frequency(uint32_t new_reading_period_seconds) {
-    TIM2->CR1 &= ~TIM_CR1_CEN;  // 1. Stop the timer
-
-    // 2. Update the prescaler and ARR
-    TIM2->PSC = 15999;  // 16 MHz / 16000 = 1 kHz tick
-    TIM2->ARR = 1000 * new_reading_period_seconds - 1;  // 3. Set new period in milliseconds
-
-    TIM2->CNT = 0;  // 4. Reset the counter (optional but recommended)
-    TIM2->CR1 |= TIM_CR1_CEN;  // 5. Restart the timer
+	// Restarts the period, the next reading is a whole period away
+	soft_timer_start(&read_timer, 1000 * new_reading_period_seconds, 1000 * new_reading_period_seconds);
 }
 
-int observer(Pin pin, int state) {
-	unsigned int n = 0;
-	
-	while (n < MAX_STATE_TIME) {
-		delay_us(2);
-		n++;
-		if ((state && gpio_get(pin) > 0) || (!state && !gpio_get(pin))) {
-			return n;
-		}
-	}
-	
-	return 0;
-}
-
-void DHT11_read_data(Pin pin) {
-	uint8_t Bits = 0;
-	uint8_t Packets[DHT11_MAX_BYTE_PACKETS] = {0};
-	uint8_t PacketIndex = 0;
-	uint8_t state_time;
-	
-	__disable_irq();
-	
-	gpio_set_mode(DHT11, Output);
-	// PULLING the Line to Low and waits for 20ms
-	gpio_set(DHT11, 0);
-	delay_ms(20);
-	// PULLING the Line to HIGH and waits for 40us
-	gpio_set(DHT11, 1);
-	delay_us(40);
-
-	// __disable_irq();
-	gpio_set_mode(DHT11, Input);
+void dht11_isr(const DHT11_Reading *result);
 
-	// If the Line is still HIGH, that means DHT11 is not responding
-	if(gpio_get(DHT11)) {
-		uart_print("ERROR!\r\n");
-	}
-	
-	// Wait for HIGH
-	if(!observer(DHT11, 1)) {
-		uart_print("TIMEOUT OUTSIDE 1!\r\n");
-	}
-
-	// Now DHT11 have pulled the Line to HIGH, we will wait till it PULLS is to LOW
-	// which means the handshake is done
-	if(!observer(DHT11, 0)) {
-		uart_print("TIMEOUT OUTSIDE 2!\r\n");
-	}
-	
-	// WE ARE LOW HERE
-	while(Bits < 40) {
-
-		// DHT11 is now starting to transmit One Bit
-		// We will wait till it PULL the Line to HIGH
-		if(!observer(DHT11, 1)) {
-			uart_print("TIMEOUT 1!\r\n");
-		}
-
-		// Now we will just count the us it stays HIGH
-		// 28us means 0
-		// 70us means 1
-		state_time = 2 * observer(DHT11, 0);
-		if (!(state_time)) {
-			uart_print("TIMEOUT 2!\r\n");
-		}
+void DHT11_read_data() {
+	// Completes in the background, dht11_isr() reports the result
+	sensor_start(dht11_isr);
+}
 
-		Packets[PacketIndex] = Packets[PacketIndex] << 1;
-		Packets[PacketIndex] |= (state_time > 10); // 50us is good in between
-		Bits++;
-		if(!(Bits % 8)) PacketIndex++;
+void DHT11_reading_handler() {
+	switch (reading.status) {
+		case DHT11_OK:
+			break;
+		case DHT11_CHECKSUM_MISMATCH:
+			indented_line(DATA_ROW, "MISMATCH!");
+			return;
+		case DHT11_TIMEOUT:
+			indented_line(DATA_ROW, "TIMEOUT!");
+			return;
+		default:
+			indented_line(DATA_ROW, "ERROR!");
+			return;
 	}
 	
-	__enable_irq();
+	humidity = reading.data[0];
+	temperature = reading.data[2] * 10 + (reading.data[3] & 0x7F);
+	if (reading.data[3] & 0x80) temperature = -temperature; // below 0 C, the SHT3x only
 	
-	// Last 8 bits are Checksum, which is the sum of all the previously transmitted 4 bytes
-	if(Packets[4] != (Packets[0] + Packets[1] + Packets[2] + Packets[3])) {
-		uart_print("MISMATCH!\r\n");
-	}
+	int16_t sample[HISTORY_CHANNELS] = {(int16_t)temperature, (int16_t)humidity};
+	history_append(&history, timer_ticks() / TIMER_TICK_HZ, sample);
+	flash_log_append(LOG_READING, 0, timer_ticks() / TIMER_TICK_HZ, sample);
 	
-	humidity = Packets[0] + (Packets[1] * 0.1f);
-	temperature = Packets[2] + (Packets[3] * 0.1f);
-	
-	if (temperature > 35 || humidity > 80) {
+	if (temperature > 350 || humidity > 80) {
 		dangerous_values++;
 		if (dangerous_values % 3 == 0) {
 			__disable_irq();
+			flash_log_append(LOG_RESET, 0, timer_ticks() / TIMER_TICK_HZ, sample);
+			flash_log_flush(); // The batch in RAM would be lost
 			uart_print("\033[2J\033[H\n");
 			uart_print("TRIGGERING SOFTWARE RESET IN 1 SECOND");
+			uart_flush();
 			delay_ms(1000);
 			NVIC_SystemReset();
 		}
-	} else if (mode == 'B' && (temperature > 25 || humidity > 60)) {
+	} else if (mode == 'B' && (temperature > 250 || humidity > 60)) {
 		safe_values_count = 0;
 		danger = true;
-	} else if (danger && temperature < 25 && humidity < 60) {
+	} else if (danger && temperature < 250 && humidity < 60) {
 		safe_values_count++;
 		if (safe_values_count >= 5) {
 			danger = false;
@@ -252,56 +249,205 @@ void DHT11_read_data(Pin pin) {
 	}
 }
 
-void status_handler() {
+// The number after a command word of the given length, 10 if there is none
+uint32_t command_count(uint32_t length) {
+	uint32_t n = 0;
+	const char *digits = buff + length;
 	
-	// update menu, show higlight
-	__disable_irq();
-	uart_menu_handler(selection, 1);
-	__enable_irq();
+	if (buff[length] == '\0') return 10;
+	while (*digits == ' ') digits++;
+	while (*digits >= '0' && *digits <= '9') n = n * 10 + (*digits++ - '0');
+	return n;
+}
+
+/*      "history [n]": logs the last n readings, 10 by default      */
+void history_handler() {
+	HistoryIterator iterator;
+	uint32_t n = command_count(7);
+	
+	if (telemetry == TELEMETRY_ONLY) return;
+	if (n > history.count) n = history.count;
+	
+	// Decoded one at a time, straight to the UART
+	screen_log_start();
+	format_uart("\r\nhistory: last %lu of %lu readings, %lu bytes", (unsigned long)n,
+	            (unsigned long)history.count, (unsigned long)history_bytes(&history));
+	history_iterate(&history, &iterator, history.count - n);
+	while (history_next(&history, &iterator)) {
+		format_uart("\r\n%8lu s  %.1d C  %d %%", (unsigned long)iterator.sample.time,
+		            iterator.sample.value[0], iterator.sample.value[1]);
+	}
+}
+
+/*      "log [n]": logs the last n records of the flash log, 10 by default      */
+void log_handler() {
+	FlashLogIterator iterator;
+	FlashLogRecord record;
+	FlashLogStats stats;
+	uint32_t n = command_count(3);
+	
+	if (telemetry == TELEMETRY_ONLY) return;
+	flash_log_flush(); // The records waiting in RAM are shown too
+	flash_log_get_stats(&stats);
+	if (n > stats.records) n = stats.records;
+	
+	screen_log_start();
+	format_uart("\r\nlog: last %lu of %lu records, boot %u, sector %lu erased %lu times", (unsigned long)n,
+	            (unsigned long)stats.records, stats.boot, (unsigned long)stats.sector, (unsigned long)stats.erases);
+	flash_log_iterate(&iterator, stats.records - n);
+	while (flash_log_next(&iterator, &record)) {
+		format_uart("\r\n%5u %8lu s  ", record.boot, (unsigned long)record.time);
+		switch (record.type) {
+			case LOG_BOOT:
+				format_uart("boot, reset flags 0x%02x", record.detail);
+				break;
+			case LOG_READING:
+				format_uart("%.1d C  %d %%", record.value[0], record.value[1]);
+				break;
+			case LOG_RESET:
+				format_uart("software reset at %.1d C  %d %%", record.value[0], record.value[1]);
+				break;
+		}
+	}
+}
+
+/*      The full acquisition of a reading, from the start signal to the callback      */
+volatile bool bench_reading_done;
+
+void bench_reading_isr(const DHT11_Reading *result) {
+	bench_reading_done = true;
+}
+
+// The sensor needs a second between readings
+void bench_reading_setup() {
+	while (dht11_capture_busy()) __WFI();
+	delay_ms(1000);
+}
+
+void bench_reading_run() {
+	bench_reading_done = false;
+	dht11_capture_start(bench_reading_isr);
+	while (!bench_reading_done) __WFI();
+}
+
+BenchCase reading_bench = { "dht11_read_data", bench_reading_setup, bench_reading_run, 1, 3 };
+
+// A single shot of the SHT3x, from the command to the callback
+void bench_sht3x_setup() {
+	while (sht3x_busy()) __WFI();
+}
+
+void bench_sht3x_run() {
+	bench_reading_done = false;
+	sht3x_start(bench_reading_isr);
+	while (!bench_reading_done) __WFI();
+}
+
+// The latest of the periodic measurements, fetched once there is a new one
+void bench_fetch_setup() {
+	bench_sht3x_setup();
+	if (!sht3x_periodic_start(10, 0)) return;
+	delay_ms(SHT3X_MEASURE_MS + 10);
+}
+
+void bench_fetch_run() {
+	bench_reading_done = false;
+	sht3x_fetch(bench_reading_isr);
+	while (!bench_reading_done) __WFI();
+}
+
+void bench_fetch_teardown() {
+	sht3x_periodic_stop();
+}
+
+BenchCase sht3x_bench = { "sht3x_single_shot", bench_sht3x_setup, bench_sht3x_run, 1, 5 };
+BenchCase fetch_bench = { "sht3x_fetch", bench_fetch_setup, bench_fetch_run, 1, 5, 0, bench_fetch_teardown };
+
+/*      "bench [name]": runs the benchmarks whose name starts with the argument      */
+void bench_handler() {
+	const char *prefix = buff + 5;
+	
+	if (telemetry == TELEMETRY_ONLY) return;
+	while (*prefix == ' ') prefix++;
 	
-	// unwrite command
-	for (int i = 0; i < buff_index; i++){
-		uart_tx(0x7F);
+	screen_log_start();
+	if (bench_run(prefix) == 0) format_uart("\r\nbench: no benchmark starts with %s", prefix);
+}
+
+/*      "telemetry off|on|only": what is sent on the UART      */
+void telemetry_command_handler() {
+	const char *setting = buff + 9;
+	
+	while (*setting == ' ') setting++;
+	if (!strcmp(setting, "off") || !strcmp(setting, "on")) {
+		if (telemetry == TELEMETRY_ONLY) screen_redraw(); // The terminal shows frames
+		telemetry = setting[1] == 'f' ? TELEMETRY_OFF : TELEMETRY_ON;
+	} else if (!strcmp(setting, "only")) {
+		telemetry = TELEMETRY_ONLY;
 	}
+}
+
+// Sends the last DHT11 reading as a telemetry frame
+void telemetry_handler() {
+	TelemetryReading record;
+	
+	record.time_ms = timer_ticks() * (1000 / TIMER_TICK_HZ);
+	memcpy(record.data, reading.data, sizeof(record.data));
+	record.status = (uint8_t)reading.status;
+	record.mode = (uint8_t)mode;
+	record.clicks = touch_sensor_clicks;
+	telemetry_send_reading(&record);
+}
+
+void status_handler() {
+	
+	// update menu, show higlight, the command is cleared once handled
+	uart_menu_handler(selection, 1);
 	
 	if (!strcmp(buff, "status")){
-		// STATUS ACTION HERE
-		NVIC_EnableIRQ(TIM3_IRQn);
-		TIM3->CR1 |= TIM_CR1_CEN;
-		DHT11_read_data(DHT11);
-		DHT11_data_handler();
-		sprintf(display_message, "\033[A\r                            MODE: %c, Number of MODE changes: %d\r\n\033[9C", mode, touch_sensor_clicks);
-		uart_print(display_message);
-		print_mode = true;
+		// STATUS ACTION HERE, the status line is printed with the reading
+		status_pending = true;
+		DHT11_read_data();
+	} else if (!strncmp(buff, "history", 7) && (buff[7] == '\0' || buff[7] == ' ')) {
+		history_handler();
+	} else if (!strncmp(buff, "log", 3) && (buff[3] == '\0' || buff[3] == ' ')) {
+		log_handler();
+	} else if (!strncmp(buff, "telemetry ", 10)) {
+		telemetry_command_handler();
+	} else if (!strncmp(buff, "bench", 5) && (buff[5] == '\0' || buff[5] == ' ')) {
+		bench_handler();
 	}
 }
 
+void status_line_handler() {
+	char line[SCREEN_COLS + 1];
+	
+	soft_timer_start(&status_timer, 2000, 0);
+	format_string(line, sizeof(line), "MODE: %c, Number of MODE changes: %u", mode, touch_sensor_clicks);
+	indented_line(STATUS_ROW, line);
+	status_pending = false;
+}
+
 void password_handler() {
 	if (!strcmp(buff, password)){
 		MODE = AEM;
-		uart_print("\r                                                  \r"); // ???
-		uart_print("Enter your AEM: ");
+		prompt = "Enter your AEM: "; // replaces what was written
 	} else {
 		// login phase, wrong password
-		// delete written 
-		uart_print("\r                                                \r");
-		
-		uart_print("Incorrect password! Try again: ");
+		prompt = "Incorrect password! Try again: ";
 	}
 }
 
 void aem_handler(){
 	
 	if (buff_index > 6 || buff_index < 2) {
-		uart_print("\r                                                  \r"); // ???
-		uart_print("Please enter a valid AEM: ");
+		prompt = "Please enter a valid AEM: ";
 		return;
 	}
 
 	for (int i = 0; i < buff_index - 1; i++){
 		if ((buff[i] < '0' || buff[i] > '9')){
-			uart_print("\r                                                  \r"); // ???
-			uart_print("Please enter a valid AEM: ");
+			prompt = "Please enter a valid AEM: ";
 			return;
 		}
 	}
@@ -309,10 +455,104 @@ void aem_handler(){
 	if (aem_sum < 2) aem_sum = 2;
 	else if (aem_sum > 10) aem_sum = 10;
 	MODE = MAIN;
-	uart_print("\r                                                  \r"); // ???
-	uart_menu_handler(selection, 1);
-	NVIC_EnableIRQ(TIM2_IRQn);
-	TIM2->CR1 |= TIM_CR1_CEN;	   // Start TIM2
+	uart_menu_handler(selection, 1); // replaces the login prompt
+	update_timer_frequency(reading_period); // Start reading
+}
+
+void reading_event_handler() {
+	DHT11_reading_handler();
+	if (reading.status == DHT11_OK) DHT11_data_handler();
+	if (status_pending) status_line_handler();
+	display_handler();
+	if (telemetry != TELEMETRY_OFF) telemetry_handler();
+}
+
+void touch_event_handler() {
+	if (touch_sensor_clicks % 3 == 0) {
+		reading_period = aem_sum;
+		update_timer_frequency(reading_period);
+		DHT11_data_handler();
+		display_handler();
+	}
+}
+
+void status_timeout_handler() {
+	// Erase the status display message
+	screen_set_line(STATUS_ROW, "", 0);
+	display_handler();
+}
+
+void rx_char_handler(uint8_t rx_char) {
+	if (rx_char == 0x9 && MODE == MAIN && buff_index == 0) { // if buff_index > 0 then a command is being written
+		selection = (selection + 1) % 4;
+		uart_menu_handler(selection, 1);
+		return;
+	}
+
+	if (MODE == MAIN && rx_char == '\r' && buff_index == 0) {
+		// no command was written
+		// act based on selected option
+		switch(selection) {
+			case 0:
+				if (reading_period < 10) reading_period++;
+				update_timer_frequency(reading_period);
+				DHT11_data_handler();
+				break;		
+			case 1:
+				if (reading_period > 2) reading_period--;
+				update_timer_frequency(reading_period);
+				DHT11_data_handler();
+				break;
+			case 2:
+				display_cases = (display_cases + 1) % 3;
+				DHT11_data_handler();
+				break;
+			case 3:
+				DHT11_read_data();
+				break;
+		}
+		return;
+	} else if (rx_char == 0x7F && buff_index > 0) { // Handle backspace character
+			buff_index--; // Move buffer index back, the character is erased on screen
+	} else if (rx_char >= 0x20 && rx_char <= 0x7E || rx_char == '\r') {
+		// Store the received character, display_handler() echoes it
+		buff[buff_index++] = (char)rx_char; // Store digit or dash in buffer
+		
+		if (MODE == MAIN && rx_char != '\r'){ // a character has been typed and we are not on login phase, so it's a command 
+			// update menu, hide highlight
+			uart_menu_handler(selection, 0);
+		}
+	}
+	
+	if (rx_char != '\r' && buff_index < BUFF_SIZE) {
+		return; // Continue until Enter key or buffer full
+	}
+	
+	// Replace the last character with null terminator to make it a valid C string
+	buff[buff_index - 1] = '\0';
+	
+	switch (MODE) {
+		case MAIN:
+			status_handler();
+			break;
+		case PASSWORD:
+			password_handler();
+			break;
+		case AEM:
+			aem_handler();
+			break;
+	}
+	
+	buff_index = 0; // Reset buffer index
+}
+
+void rx_event_handler() {
+	uint8_t rx_char = 0;
+	
+	while (queue_dequeue(&rx_queue, &rx_char)) {
+		rx_char_handler(rx_char);
+	}
+	display_handler(); // Once for everything received
 }
 
 /* --------------------------------------------------------------- */
@@ -327,49 +567,37 @@ void aem_handler(){
 /* ------------------------------------------------------------- */
 
 /*       Interrupt Service Routine for UART receive       */
-void uart_rx_isr(uint8_t rx) {
-	// Check if the received character is a printable ASCII character
-	if (rx >= 0x0 && rx <= 0x7F ) {
-		// Store the received character
-		queue_enqueue(&rx_queue, rx);
-	}
+void uart_rx_isr(const uint8_t *data, uint32_t length) {
+	// Store the received characters, the main loop skips anything that is not ASCII
+	queue_enqueue_bulk(&rx_queue, data, length);
+	event_post(EVENT_RX);
 }
 
-/*      Interrupt Sevice Routine for reading DHT11      */
-void TIM2_IRQHandler(void) {
-
-	if (TIM2->SR & TIM_SR_UIF) {	// Check if update interrupt flag is set
-		TIM2->SR &= ~TIM_SR_UIF;		// Clear the flag immediately
-	}
-	
-	update_values = true;
+/*      Completion of a reading, from either sensor      */
+void dht11_isr(const DHT11_Reading *result) {
+	reading = *result;
+	event_post(EVENT_READING);
 }
 
-/*      Interrupt Sevice Routine for erasing the status display message      */
-void TIM3_IRQHandler(void) {
-	
-	if (TIM3->SR & TIM_SR_UIF) {	// Check if update interrupt flag is set
-		TIM3->SR &= ~TIM_SR_UIF;		// Clear the flag immediately
-	}
-	
-	print_mode = false;
+/*      Posts the event passed as the context of a software timer      */
+void timer_event_isr(void *context) {
+	event_post((uint32_t)(uintptr_t)context);
 }
 
-void led_blinking_isr() {
+void led_blinking_isr(void *context) {
 	if (danger) gpio_toggle(LED);
 }
 
 void touch_sensor_isr(int status) {
 	
 	touch_sensor_clicks++;
-	update_touch_sensor = true;
+	event_post(EVENT_TOUCH);
 	if (mode == 'A') {
 		mode = 'B';
-		timer_init(500000);
-		timer_enable();
+		soft_timer_start(&blink_timer, 500, 500);
 	} else {
 		mode = 'A';
-		timer_disable();
+		soft_timer_stop(&blink_timer);
 		gpio_set(LED, LED_OFF);
 	}
 }
@@ -381,35 +609,48 @@ void touch_sensor_isr(int status) {
 
 int main() {
 	
+	// Time the delay loop against the cycle counter, at the clock set up by SystemInit()
+	delay_calibrate();
+	
 	// Initialize the receive queue and UART
-	queue_init(&rx_queue, 128);
+	queue_init(&rx_queue, rx_storage, sizeof(rx_storage));
+	history_init(&history, history_storage, sizeof(history_storage));
+	
+	// Open the log in flash and record why the board started
+	checksum_init();
+	flash_log_init(LOG_FIRST_SECTOR, LOG_SECTORS);
+	flash_log_append(LOG_BOOT, (uint8_t)(RCC->CSR >> 24), 0, no_values);
+	flash_log_flush(); // The next boot is numbered after this one
+	RCC->CSR |= RCC_CSR_RMVF;
+	
 	uart_init(115200);
-	uart_set_rx_callback(uart_rx_isr); // Set the UART receive callback function
+	uart_set_rx_span_callback(uart_rx_isr); // Set the UART receive callback function
 	uart_enable(); // Enable UART module
 	
-	// Initialize the temperature / humidity timer interrupt
-	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;  // Enable clock for TIM2
-	// set the amount of ticks relative to the clock speed
-	TIM2->PSC = 15999;  // Prescaler: divide 16 MHz by 16000 = 1 kHz
-	TIM2->ARR = 1000 * reading_period - 1;   // Auto-reload: 1000 * period ticks at 1 kHz = period sec
-	TIM2->DIER |= TIM_DIER_UIE;     // Enable update interrupt (overflow interrupt)
-	NVIC_SetPriority(TIM2_IRQn, 3);  // set the priority
-	
-	// Initialize the temperature / humidity timer interrupt
-	RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;  // Enable clock for TIM3
-	// set the amount of ticks relative to the clock speed
-	TIM3->PSC = 15999;  // Prescaler: divide 16 MHz by 16000 = 1 kHz
-	TIM3->ARR = 2000;   // Auto-reload: 2000 ticks at 1 kHz = period sec
-	TIM3->DIER |= TIM_DIER_UIE;     // Enable update interrupt (overflow interrupt)
-	NVIC_SetPriority(TIM3_IRQn, 4);  // set the priority
-	
-	// Initialize the SysTick timer for the LED blinking
-	timer_set_callback(led_blinking_isr);
+	// Initialize the event handlers, run by the main loop
+	event_init();
+	event_set_handler(EVENT_READING, reading_event_handler);
+	event_set_handler(EVENT_RX, rx_event_handler);
+	event_set_handler(EVENT_TOUCH, touch_event_handler);
+	event_set_handler(EVENT_PERIOD, DHT11_read_data);
+	event_set_handler(EVENT_STATUS_TIMEOUT, status_timeout_handler);
+	
+	// Initialize the software timers, all of them run on the SysTick
+	timer_wheel_init();
+	soft_timer_init(&read_timer, timer_event_isr, (void *)EVENT_PERIOD, 0);
+	soft_timer_init(&status_timer, timer_event_isr, (void *)EVENT_STATUS_TIMEOUT, 0);
+	soft_timer_init(&blink_timer, led_blinking_isr, 0, 0);
+	
+	// Initialize the DHT11 acquisition (TIM3 input capture and DMA)
+	dht11_capture_init();
 	
 	__enable_irq(); // Enable interrupts
 	
+	// The SHT3x on I2C1 is read instead if it answers: 0.1 C, 20 ms a reading
+	if (sht3x_init()) sensor_start = sht3x_start;
+	
 	// clear visible page
-	uart_print("\033[2J\033[H\n");
+	screen_init();
 	
 	// Initialize the Touch sensor
 	gpio_set_mode(TOUCH, PullDown); // Set touch sensor out pin to PullDown (input)
@@ -418,108 +659,16 @@ int main() {
 	
 	// Initialize the lED
 	gpio_set_mode(LED, Output);
-
-	uart_print("Enter your password: ");
 	
-	// Variables to help with UART read / write
-	uint8_t rx_char = 0;
-	
-	while(1) {
-		
-		buff_index = 0; // Reset buffer index
-		
-		do {
-			// Wait until a digit or dash is received in the queue
-			rx_char = 0;
-			while (!queue_dequeue(&rx_queue, &rx_char) && print_mode && !update_values && !update_touch_sensor)
-				__WFI(); // Wait for Interrupt
-			
-			if (update_values) {
-				DHT11_read_data(DHT11);
-				DHT11_data_handler();
-				update_values = false;
-			}
-			
-			if (update_touch_sensor && (touch_sensor_clicks % 3 == 0) && touch_sensor_clicks > 0) {
-				reading_period = aem_sum;
-				update_timer_frequency(reading_period);
-				DHT11_data_handler();
-				update_touch_sensor = false;
-			}
-			
-			if (rx_char == 0x9 && MODE == MAIN && buff_index == 0) { // if buff_index > 0 then a command is being written
-				selection = (selection + 1) % 4;
-				uart_print("\033[?25l");
-				uart_menu_handler(selection, 1);
-				uart_print("\033[?25h");
-				continue;
-			}
-		
-			if (MODE == MAIN && rx_char == '\r' && buff_index == 0) {
-				// no command was written
-				// act based on selected option
-				rx_char = 0; // We zero it out so it doesn't escape the while...
-				switch(selection) {
-					case 0:
-						if (reading_period < 10) reading_period++;
-						update_timer_frequency(reading_period);
-						DHT11_data_handler();
-						break;		
-					case 1:
-						if (reading_period > 2) reading_period--;
-						update_timer_frequency(reading_period);
-						DHT11_data_handler();
-						break;
-					case 2:
-						display_cases = (display_cases + 1) % 3;
-						DHT11_data_handler();
-						break;
-					case 3:
-						__disable_irq();
-						DHT11_read_data(DHT11);
-						DHT11_data_handler();
-						__enable_irq();
-						break;
-				}
-				buff_index = 0;
-			} else if (rx_char == 0x7F && buff_index > 0) { // Handle backspace character
-					buff_index--; // Move buffer index back
-					uart_tx(rx_char); // Send backspace character to erase on terminal
-			} else if (rx_char >= 0x20 && rx_char <= 0x7E || rx_char == '\r') {
-				// Store and echo the received character back
-				buff[buff_index++] = (char)rx_char; // Store digit or dash in buffer
-				uart_tx(rx_char); // Echo digit or dash back to terminal
-				
-				if (MODE == MAIN && rx_char != '\r'){ // a character has been typed and we are not on login phase, so it's a command 
-					// update menu, hide highlight
-					__disable_irq();
-					uart_menu_handler(selection, 0);
-					__enable_irq();
-				}
-			}
-			
-			if (MODE == MAIN && !print_mode) {
-				sprintf(display_message, "\033[A\r                                                                 \r\n\033[9C");
-				uart_print(display_message);
-				NVIC_DisableIRQ(TIM3_IRQn);
-				print_mode = true;
-			}
-			
-		} while (rx_char != '\r' && buff_index < BUFF_SIZE); // Continue until Enter key or buffer full
-		
-		// Replace the last character with null terminator to make it a valid C string
-		buff[buff_index - 1] = '\0';
-		
-		switch (MODE) {
-			case MAIN:
-				status_handler();
-				break;
-			case PASSWORD:
-				password_handler();
-				break;
-			case AEM:
-				aem_handler();
-				break;
-		}
+	// The bench command times the drivers and the sensor readings
+	benchmarks_register(LED, P_ADC);
+	bench_register(&reading_bench);
+	if (sensor_start == sht3x_start) {
+		bench_register(&sht3x_bench);
+		bench_register(&fetch_bench);
 	}
+
+	display_handler(); // Shows the password prompt
+	
+	event_loop(); // Runs the handlers as their events are posted
 }